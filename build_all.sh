@@ -52,6 +52,11 @@ if [[ $USE_MPI_OPENMP -eq 1 ]]; then
     )
 fi
 
+if [[ $USE_SHMEM -eq 1 ]]; then
+    make -C shmem clean
+    make -C shmem all -j$THREADS
+fi
+
 if [[ $USE_GASNET -eq 1 ]]; then
     make -C "$GASNET_DIR"
 fi
@@ -228,6 +233,39 @@ if [[ $USE_OPENMP -eq 1 ]]; then
     make -C openmp -j$THREADS
 fi
 
+if [[ $USE_CPP_THREADS -eq 1 ]]; then
+    make -C cpp_threads clean
+    make -C cpp_threads -j$THREADS
+fi
+
+if [[ $USE_SIMULATOR -eq 1 ]]; then
+    make -C simulator clean
+    make -C simulator -j$THREADS
+fi
+
+if [[ $USE_TBB -eq 1 ]]; then
+    make -C tbb clean
+    make -C tbb -j$THREADS
+fi
+
+if [[ $USE_HPX -eq 1 ]]; then
+    mkdir -p "$HPX_SRC_DIR"/build
+    pushd "$HPX_SRC_DIR"/build
+    cmake .. -DCMAKE_BUILD_TYPE=Release -DCMAKE_INSTALL_PREFIX="$HPX_DIR" \
+        -DHPX_WITH_MALLOC=system -DHPX_WITH_FETCH_ASIO=ON \
+        -DHPX_WITH_EXAMPLES=OFF -DHPX_WITH_TESTS=OFF
+    make -j$THREADS
+    make install
+    popd
+    make -C hpx clean
+    make -C hpx -j$THREADS
+fi
+
+if [[ $USE_TASKFLOW -eq 1 ]]; then
+    make -C taskflow clean
+    make -C taskflow -j$THREADS
+fi
+
 if [[ $USE_OMPSS -eq 1 ]]; then
     pushd "$NANOS_SRC_DIR"
     if [[ ! -d build ]]; then
@@ -303,7 +341,8 @@ fi
     swig -c++ -java -outcurrentdir -I../core -outdir "$SPARK_PROJ_DIR"/src/main/java core_c.i
 
     g++ -fpic -c -O3 -std=c++11 -I../core -I"$JAVA_HOME"/include -I"$JAVA_HOME"/include/linux core_c_wrap.cxx
-    g++ -shared -O3 -z noexecstack -std=c++11 core_c_wrap.o -L"$CORE_DIR" -lcore -o libcore_c.so
+    g++ -fpic -c -O3 -std=c++11 -I../core -I"$JAVA_HOME"/include -I"$JAVA_HOME"/include/linux task_bench_jni.cc
+    g++ -shared -O3 -z noexecstack -std=c++11 core_c_wrap.o task_bench_jni.o -L"$CORE_DIR" -lcore -o libcore_c.so
     popd
 
     #make jar in sbt dir
@@ -0,0 +1,13 @@
+
+#ifndef _AGGREGATEMSG_H_
+#define _AGGREGATEMSG_H_
+
+/* Charm++ message class carrying the coalesced outputs for one PE */
+class AggregateMsg : public CMessage_AggregateMsg {
+ public:
+  size_t size;
+  char *data;
+};
+
+#endif
+
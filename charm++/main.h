@@ -19,6 +19,7 @@
 #include "main.decl.h"
 #include "subchare.decl.h"
 #include "../core/core.h"
+#include "../core/placement.h"
 #include "../core/timer.h"
 #include <vector>
 
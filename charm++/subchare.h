@@ -17,10 +17,45 @@
 #define __SUBCHARE_H__
 
 #include "multicastMsg.h"
+#include "aggregateMsg.h"
 #include "../core/core.h"
 #include <vector>
 #include <set>
 
+/**
+ * Per-PE buffer that coalesces outputs by destination PE (-aggregate).
+ * Each output is stored once per PE with the list of its targets there.
+ * Buffers are flushed when they reach flushBytes, and all of them once
+ * every local chare of a graph has sent its outputs for a timestep.
+ */
+class Aggregator : public CBase_Aggregator {
+
+ private:
+
+  bool enabled;
+  size_t flushBytes;
+  std::vector<CProxy_Subchare> arrays; // by graph
+  std::vector<long> localChares; // by graph
+  std::vector<std::map<long, long> > sendsDone; // graph -> timestep -> chares
+  std::map<int, std::vector<char> > buffers; // by PE
+
+  void flush(int pe);
+  void flushAll();
+
+ public:
+
+  Aggregator(bool enabled, size_t flushBytes);
+
+  bool isEnabled() const { return enabled; }
+  void registerChare(int graphIndex, const CProxy_Subchare &array);
+  void send(int graphIndex, const std::set<long> &targets, const std::vector<char> &output);
+  void doneSending(int graphIndex, long timestep);
+
+  /// Entry Methods ///
+  void deliver(AggregateMsg *msg);
+
+};
+
 class Subchare : public CBase_Subchare {
 
  private:
@@ -41,6 +76,7 @@ class Subchare : public CBase_Subchare {
   App app;
   TaskGraph graph;
   CkSectionInfo sid;
+  Aggregator *aggregator; // NULL unless -aggregate
 
   void checkAndRun(bool receiving);
 
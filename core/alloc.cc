@@ -0,0 +1,326 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "alloc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+
+#include <dirent.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+
+// From <linux/mempolicy.h>; defined here to avoid depending on libnuma.
+#define MPOL_BIND 2
+#define NUMA_MASK_WORDS 16
+
+#define DEFAULT_HUGE_PAGE_BYTES (2 << 20)
+
+static HugePageMode huge_page_mode = HugePageMode::NONE;
+static bool numa_binding = false;
+
+// Mapping length of every live buffer, for munmap, and their total.
+static std::mutex buffer_mutex;
+static std::map<char *, size_t> buffer_lengths;
+static size_t bytes_in_use = 0;
+static size_t peak_bytes = 0;
+
+void alloc_set_huge_pages(HugePageMode mode)
+{
+  huge_page_mode = mode;
+}
+
+void alloc_set_numa(bool enabled)
+{
+  numa_binding = enabled;
+}
+
+bool alloc_numa_enabled()
+{
+  return numa_binding;
+}
+
+// Highest node in a sysfs list such as "0-3" or "0,2-5", plus one.
+static int read_node_count()
+{
+  FILE *f = fopen("/sys/devices/system/node/online", "r");
+  if (!f) {
+    return 1;
+  }
+  int count = 1;
+  char buffer[256];
+  if (fgets(buffer, sizeof(buffer), f)) {
+    char *p = buffer;
+    while (*p) {
+      char *end;
+      long node = strtol(p, &end, 10);
+      if (end == p) {
+        break;
+      }
+      if (node + 1 > count) {
+        count = node + 1;
+      }
+      p = end;
+      if (*p == '-' || *p == ',') {
+        p++;
+      }
+    }
+  }
+  fclose(f);
+  return count;
+}
+
+int numa_node_count()
+{
+  static int count = read_node_count();
+  return count;
+}
+
+int numa_node_of_cpu(int cpu)
+{
+  char path[64];
+  snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d", cpu);
+  DIR *dir = opendir(path);
+  if (!dir) {
+    return 0;
+  }
+  int node = 0;
+  while (struct dirent *entry = readdir(dir)) {
+    if (!strncmp(entry->d_name, "node", 4) && entry->d_name[4] >= '0' && entry->d_name[4] <= '9') {
+      node = atoi(entry->d_name + 4);
+      break;
+    }
+  }
+  closedir(dir);
+  return node;
+}
+
+int numa_current_node()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, NULL) == 0) {
+    return node;
+  }
+#endif
+  return 0;
+}
+
+std::vector<int> allowed_cpus()
+{
+  std::vector<int> cpus;
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  if (sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0) {
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+      if (CPU_ISSET(cpu, &cpuset)) {
+        cpus.push_back(cpu);
+      }
+    }
+  }
+#endif
+  if (cpus.empty()) {
+    cpus.push_back(0);
+  }
+  return cpus;
+}
+
+void bind_thread(int cpu)
+{
+#ifdef __linux__
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(cpu, &cpuset);
+  if (sched_setaffinity(0, sizeof(cpuset), &cpuset) != 0) {
+    fprintf(stderr, "warning: unable to bind thread to cpu %d: %s\n", cpu, strerror(errno));
+  }
+#endif
+}
+
+static size_t read_huge_page_bytes()
+{
+  FILE *f = fopen("/proc/meminfo", "r");
+  if (!f) {
+    return DEFAULT_HUGE_PAGE_BYTES;
+  }
+  size_t bytes = DEFAULT_HUGE_PAGE_BYTES;
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    unsigned long kb;
+    if (sscanf(line, "Hugepagesize: %lu kB", &kb) == 1) {
+      bytes = kb * 1024;
+      break;
+    }
+  }
+  fclose(f);
+  return bytes;
+}
+
+static size_t huge_page_bytes()
+{
+  static size_t bytes = read_huge_page_bytes();
+  return bytes;
+}
+
+static size_t round_up(size_t n, size_t alignment)
+{
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+static void *map_pages(size_t length, int extra_flags)
+{
+  return mmap(NULL, length, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | extra_flags, -1, 0);
+}
+
+// Maps length bytes starting on a huge page boundary and asks for THP.
+static void *map_transparent_huge_pages(size_t length)
+{
+  size_t huge = huge_page_bytes();
+  char *raw = reinterpret_cast<char *>(map_pages(length + huge, 0));
+  if (raw == MAP_FAILED) {
+    return MAP_FAILED;
+  }
+  char *aligned = reinterpret_cast<char *>(round_up(reinterpret_cast<uintptr_t>(raw), huge));
+  if (aligned > raw) {
+    munmap(raw, aligned - raw);
+  }
+  size_t tail = (raw + length + huge) - (aligned + length);
+  if (tail > 0) {
+    munmap(aligned + length, tail);
+  }
+#ifdef MADV_HUGEPAGE
+  madvise(aligned, length, MADV_HUGEPAGE);
+#endif
+  return aligned;
+}
+
+static void bind_to_node(void *ptr, size_t length, int node)
+{
+  static std::atomic<bool> warned(false);
+#if defined(__linux__) && defined(SYS_mbind)
+  const int bits = 8 * sizeof(unsigned long);
+  assert(node < NUMA_MASK_WORDS * bits);
+  unsigned long mask[NUMA_MASK_WORDS] = {0};
+  mask[node / bits] = 1UL << (node % bits);
+  if (syscall(SYS_mbind, ptr, length, MPOL_BIND, mask, NUMA_MASK_WORDS * bits + 1, 0) == 0) {
+    return;
+  }
+  if (!warned.exchange(true)) {
+    fprintf(stderr, "warning: mbind failed (%s), NUMA placement left to first touch\n", strerror(errno));
+  }
+#else
+  if (!warned.exchange(true)) {
+    fprintf(stderr, "warning: NUMA binding unsupported, placement left to first touch\n");
+  }
+#endif
+}
+
+char *alloc_buffer(size_t bytes, int node)
+{
+  if (bytes == 0) {
+    return NULL;
+  }
+
+  HugePageMode mode = huge_page_mode;
+  size_t length = 0;
+  void *ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (mode == HugePageMode::HUGETLB) {
+    length = round_up(bytes, huge_page_bytes());
+    ptr = map_pages(length, MAP_HUGETLB);
+    if (ptr == MAP_FAILED) {
+      static std::atomic<bool> warned(false);
+      if (!warned.exchange(true)) {
+        fprintf(stderr, "warning: MAP_HUGETLB failed (%s), using transparent huge pages\n", strerror(errno));
+      }
+      mode = HugePageMode::THP;
+    }
+  }
+#else
+  if (mode == HugePageMode::HUGETLB) {
+    mode = HugePageMode::THP;
+  }
+#endif
+  if (ptr == MAP_FAILED && mode == HugePageMode::THP) {
+    length = round_up(bytes, huge_page_bytes());
+    ptr = map_transparent_huge_pages(length);
+  }
+  if (ptr == MAP_FAILED) {
+    length = round_up(bytes, sysconf(_SC_PAGESIZE));
+    ptr = map_pages(length, 0);
+  }
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr, "error: Unable to allocate %zu bytes: %s\n", bytes, strerror(errno));
+    abort();
+  }
+
+  if (numa_binding && node >= 0 && numa_node_count() > 1) {
+    bind_to_node(ptr, length, node);
+  }
+
+  char *result = reinterpret_cast<char *>(ptr);
+  {
+    std::lock_guard<std::mutex> lock(buffer_mutex);
+    buffer_lengths[result] = length;
+    bytes_in_use += length;
+    peak_bytes = std::max(peak_bytes, bytes_in_use);
+  }
+  return result;
+}
+
+void free_buffer(char *ptr)
+{
+  if (!ptr) {
+    return;
+  }
+  size_t length;
+  {
+    std::lock_guard<std::mutex> lock(buffer_mutex);
+    auto it = buffer_lengths.find(ptr);
+    assert(it != buffer_lengths.end());
+    length = it->second;
+    buffer_lengths.erase(it);
+    bytes_in_use -= length;
+  }
+  munmap(ptr, length);
+}
+
+size_t alloc_bytes_in_use()
+{
+  std::lock_guard<std::mutex> lock(buffer_mutex);
+  return bytes_in_use;
+}
+
+size_t alloc_peak_bytes()
+{
+  std::lock_guard<std::mutex> lock(buffer_mutex);
+  return peak_bytes;
+}
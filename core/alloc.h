@@ -0,0 +1,61 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ALLOC_H
+#define ALLOC_H
+
+#include <cstddef>
+#include <vector>
+
+// Page-granular buffers for task scratch and outputs. Buffers come from
+// mmap, so the page size (-huge-pages) and NUMA placement (-numa) are
+// chosen by the benchmark and not by the allocator of the runtime.
+
+enum class HugePageMode {
+  NONE,    // default page size
+  THP,     // transparent huge pages (madvise)
+  HUGETLB, // MAP_HUGETLB, falling back to THP when none are reserved
+};
+
+void alloc_set_huge_pages(HugePageMode mode);
+
+// When enabled, buffers allocated for a node are bound to it (mbind).
+// Otherwise the node is ignored and pages land where they are first
+// touched.
+void alloc_set_numa(bool enabled);
+bool alloc_numa_enabled();
+
+// NUMA topology from sysfs. Machines without NUMA report one node 0.
+int numa_node_count();
+int numa_node_of_cpu(int cpu);
+int numa_current_node();
+
+// CPUs the process may run on, in increasing order, and pinning of the
+// calling thread to one of them. Binding is a no-op outside Linux.
+std::vector<int> allowed_cpus();
+void bind_thread(int cpu);
+
+// Returns a zero-filled buffer of at least bytes, aligned to the page
+// size, or NULL for zero bytes. node < 0 means no preference. Aborts
+// when out of memory.
+char *alloc_buffer(size_t bytes, int node);
+void free_buffer(char *ptr);
+
+// Mapped bytes of live buffers, now and at most so far.
+size_t alloc_bytes_in_use();
+size_t alloc_peak_bytes();
+
+#endif // ALLOC_H
@@ -20,78 +20,751 @@
 #include <cstring>
 #include <atomic>
 #include <algorithm>
+#include <chrono>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <numeric>
 #include <set>
 #include <string>
+#include <system_error>
+#include <thread>
 #include <math.h>
 #include <vector>
 #include <random>
 
+#if defined(__AVX512F__) || (__AVX2__ == 1)
+#include <immintrin.h>
+#endif
+
 #include "core.h"
+#include "alloc.h"
 #include "core_kernel.h"
 #include "core_random.h"
+#include "counters.h"
+#include "graph_file.h"
+#include "io_kernel.h"
+#include "latency.h"
+#include "memory.h"
+#include "noise.h"
+#include "placement.h"
+#include "report.h"
+#include "timer.h"
+#include "trace.h"
+#include "transfer.h"
+#include "utilization.h"
 
 #ifdef DEBUG_CORE
 typedef unsigned long long TaskGraphMask;
 static std::atomic<TaskGraphMask> has_executed_graph;
 #endif
 
+// Set by -latency; execute_point then records its duration per thread.
+static bool record_task_latency = false;
+
+// Latest end time of a task in the last timestep of each top-level graph
+// on this process, sized in App::App.
+static std::vector<std::atomic<double> > completion_times;
+
+// Set by App::start_arrivals; release times are relative to it.
+static bool arrivals_started = false;
+static double arrival_start = 0;
+
+// Release times of -arrival poisson graphs by graph_index, read-only
+// after App::App.
+static std::vector<std::vector<double> > release_tables;
+
+static double poisson_gap(const TaskGraph &g, long timestep)
+{
+  const long seed[3] = {g.graph_index, timestep, 3};
+  return -log(1 - random_uniform(&seed[0], sizeof(seed))) / g.arrival_rate;
+}
+
+static std::vector<double> make_release_table(const TaskGraph &g)
+{
+  std::vector<double> table(g.timesteps);
+  for (long t = 1; t < g.timesteps; ++t) {
+    table[t] = table[t-1] + poisson_gap(g, t);
+  }
+  return table;
+}
+
+static void record_completion(long graph_index, double end_time)
+{
+  if (graph_index >= (long)completion_times.size()) {
+    return;
+  }
+  std::atomic<double> &latest = completion_times[graph_index];
+  double seen = latest.load(std::memory_order_relaxed);
+  while (seen < end_time && !latest.compare_exchange_weak(seen, end_time, std::memory_order_relaxed)) {
+  }
+}
+
 static bool needs_period(DependenceType dtype) {
-  return dtype == DependenceType::SPREAD || dtype == DependenceType::RANDOM_NEAREST;
+  return dtype == DependenceType::SPREAD || dtype == DependenceType::RANDOM_NEAREST ||
+    dtype == DependenceType::ELASTIC_RAMP || dtype == DependenceType::ELASTIC_SAWTOOTH;
 }
 
-void Kernel::execute(long graph_index, long timestep, long point,
-                     char *scratch_ptr, size_t scratch_bytes) const
+static bool is_grid_stencil(DependenceType dtype) {
+  return dtype == DependenceType::STENCIL_2D || dtype == DependenceType::STENCIL_3D;
+}
+
+static int grid_rank(DependenceType dtype) {
+  return dtype == DependenceType::STENCIL_3D ? 3 : 2;
+}
+
+// Splits n into rank factors as equal as possible, largest first (like
+// MPI_Dims_create): prime factors, largest first, go to the smallest.
+static void balanced_factors(long n, int rank, long *factors)
+{
+  std::fill(factors, factors + rank, 1L);
+  std::vector<long> primes;
+  for (long f = 2; f * f <= n; ++f) {
+    for (; n % f == 0; n /= f) {
+      primes.push_back(f);
+    }
+  }
+  if (n > 1) {
+    primes.push_back(n);
+  }
+  for (auto prime = primes.rbegin(); prime != primes.rend(); ++prime) {
+    *std::min_element(factors, factors + rank) *= *prime;
+  }
+  std::sort(factors, factors + rank, std::greater<long>());
+}
+
+// Extent of a stencil_2d/3d grid in x, y and z (z is 1 in 2D): -dims if
+// given, otherwise max_width split evenly.
+static void stencil_grid(const TaskGraph &g, long grid[3])
+{
+  int rank = grid_rank(g.dependence);
+  grid[2] = 1;
+  if (g.dims[0] > 0) {
+    std::copy(g.dims, g.dims + rank, grid);
+  } else {
+    balanced_factors(g.max_width, rank, grid);
+  }
+}
+
+// Box stencils (radix 9 or 27) include the diagonal neighbors.
+static bool is_box_stencil(const TaskGraph &g) {
+  return g.radix == 9 || g.radix == 27;
+}
+
+// Dependencies of a stencil_2d/3d point, one interval per neighboring
+// row of the grid. The stencil is symmetric, so these are also its
+// reverse dependencies.
+static size_t stencil_dependencies(const TaskGraph &g, long point, std::pair<long, long> *deps)
+{
+  long grid[3];
+  stencil_grid(g, grid);
+  long x = point % grid[0];
+  long y = (point / grid[0]) % grid[1];
+  long z = point / (grid[0] * grid[1]);
+  long z_radius = g.dependence == DependenceType::STENCIL_3D ? 1 : 0;
+  bool box = is_box_stencil(g);
+
+  size_t idx = 0;
+  for (long dz = -z_radius; dz <= z_radius; ++dz) {
+    for (long dy = -1; dy <= 1; ++dy) {
+      long yy = y + dy, zz = z + dz;
+      if (yy < 0 || yy >= grid[1] || zz < 0 || zz >= grid[2]) {
+        continue;
+      }
+      long row = (zz * grid[1] + yy) * grid[0];
+      if (box || (dy == 0 && dz == 0)) {
+        deps[idx++] = std::pair<long, long>(row + std::max(0L, x-1), row + std::min(x+1, grid[0]-1));
+      } else if (dy == 0 || dz == 0) {
+        deps[idx++] = std::pair<long, long>(row + x, row + x);
+      }
+    }
+  }
+  return idx;
+}
+
+static bool is_multigrid(DependenceType dtype) {
+  return dtype == DependenceType::V_CYCLE || dtype == DependenceType::W_CYCLE;
+}
+
+// Multigrid levels: level 0 has max_width points, each further level half
+// as many (rounded up), down to a single point.
+static long multigrid_levels(const TaskGraph &g)
+{
+  long levels = 1;
+  while (((g.max_width - 1) >> (levels - 1)) > 0) {
+    levels++;
+  }
+  return levels;
+}
+
+static long multigrid_width(const TaskGraph &g, long level)
+{
+  return ((g.max_width - 1) >> level) + 1;
+}
+
+// Timesteps per cycle. A V-cycle visits levels 0, 1, ..., L-1, ..., 1; a
+// W-cycle W(0) follows W(l) = l, W(l+1), W(l+1), l (W(L-1) = L-1) without
+// its final level 0, which the next cycle starts with.
+static long multigrid_cycle_length(const TaskGraph &g)
+{
+  long levels = multigrid_levels(g);
+  if (levels == 1) {
+    return 1;
+  }
+  if (g.dependence == DependenceType::V_CYCLE) {
+    return 2 * (levels - 1);
+  }
+  return (3L << (levels - 1)) - 3;
+}
+
+static long multigrid_level(const TaskGraph &g, long timestep)
+{
+  long levels = multigrid_levels(g);
+  long length = multigrid_cycle_length(g);
+  long pos = ((timestep % length) + length) % length;
+  if (g.dependence == DependenceType::V_CYCLE) {
+    return pos < levels ? pos : length - pos;
+  }
+  long level = 0;
+  while (level < levels - 1) {
+    long sub_length = (3L << (levels - 2 - level)) - 2; // length of W(level+1)
+    if (pos == 0) {
+      break;
+    }
+    pos -= 1;
+    if (pos >= sub_length) {
+      pos -= sub_length;
+    }
+    if (pos >= sub_length) {
+      break; // trailing visit of this level
+    }
+    level++;
+  }
+  return level;
+}
+
+// Dependence sets of multigrid graphs encode the step between levels:
+// restriction onto level l is l-1, prolongation onto l is L-1+l, and a
+// second visit of level l is 2L-2+l.
+static long multigrid_dependence_set(long levels, long last_level, long level)
+{
+  if (level == last_level + 1) {
+    return level - 1;
+  } else if (level == last_level - 1) {
+    return levels - 1 + level;
+  }
+  return 2 * levels - 2 + level;
+}
+
+static void multigrid_levels_of_set(long levels, long dset, long &last_level, long &level)
+{
+  if (dset < levels - 1) {
+    level = dset + 1;
+    last_level = dset;
+  } else if (dset < 2 * levels - 2) {
+    level = dset - (levels - 1);
+    last_level = level + 1;
+  } else {
+    level = last_level = dset - (2 * levels - 2);
+  }
+}
+
+// Restriction reads the three nearest fine points (full weighting),
+// prolongation the one or two nearest coarse points, and a repeated
+// level the neighboring points. Reverse dependencies are the mirror.
+static size_t multigrid_dependencies(const TaskGraph &g, long dset, long point, bool reverse,
+                                     std::pair<long, long> *deps)
+{
+  long levels = multigrid_levels(g);
+  long last_level, level;
+  multigrid_levels_of_set(levels, dset, last_level, level);
+  if (reverse) {
+    std::swap(last_level, level);
+  }
+  if (point >= multigrid_width(g, level)) {
+    return 0;
+  }
+  long last_width = multigrid_width(g, last_level);
+  if (last_level == level + 1) {
+    deps[0] = std::pair<long, long>(point/2, std::min((point+1)/2, last_width-1));
+  } else if (last_level == level - 1) {
+    deps[0] = std::pair<long, long>(std::max(0L, 2*point-1), std::min(2*point+1, last_width-1));
+  } else {
+    deps[0] = std::pair<long, long>(std::max(0L, point-1), std::min(point+1, last_width-1));
+  }
+  return 1;
+}
+
+static bool is_elastic(DependenceType dtype) {
+  return dtype == DependenceType::ELASTIC_RAMP || dtype == DependenceType::ELASTIC_SAWTOOTH ||
+    dtype == DependenceType::ELASTIC_RANDOM;
+}
+
+// Default -period of elastic graphs: the width changes by one point per
+// timestep.
+static long elastic_default_period(const TaskGraph &g)
+{
+  long period = g.dependence == DependenceType::ELASTIC_RAMP ? 2 * (g.max_width - 1) : g.max_width;
+  return std::max(2L, period);
+}
+
+// Widths of an elastic_random graph: a random walk starting at half of
+// max_width that moves by up to a quarter of max_width per timestep,
+// staying within [1, max_width].
+static long elastic_walk_step(const TaskGraph &g, long timestep, long width)
+{
+  long step = std::max(1L, g.max_width / 4);
+  const long seed[3] = {g.graph_index, timestep, 2};
+  long delta = (long)floor(random_uniform(&seed[0], sizeof(seed)) * (2 * step + 1)) - step;
+  return std::min(g.max_width, std::max(1L, width + delta));
+}
+
+struct ElasticWalk {
+  long max_width;
+  std::vector<long> widths;
+};
+
+// Indexed by graph_index, and like dependency_tables read-only after App::App.
+static std::vector<std::unique_ptr<ElasticWalk> > elastic_walks;
+
+static std::unique_ptr<ElasticWalk> make_elastic_walk(const TaskGraph &g)
+{
+  std::unique_ptr<ElasticWalk> walk(new ElasticWalk);
+  walk->max_width = g.max_width;
+  walk->widths.resize(g.timesteps);
+  long width = std::max(1L, g.max_width / 2);
+  for (long t = 0; t < g.timesteps; ++t) {
+    if (t > 0) {
+      width = elastic_walk_step(g, t, width);
+    }
+    walk->widths[t] = width;
+  }
+  return walk;
+}
+
+// Ramps go from 1 to max_width and back once per period, sawtooths from
+// 1 to max_width and then drop back to 1.
+static long elastic_width(const TaskGraph &g, long timestep)
+{
+  if (g.dependence == DependenceType::ELASTIC_RANDOM) {
+    if (g.graph_index >= 0 && g.graph_index < (long)elastic_walks.size()) {
+      const ElasticWalk *walk = elastic_walks[g.graph_index].get();
+      if (walk && walk->max_width == g.max_width && timestep < (long)walk->widths.size()) {
+        return walk->widths[timestep];
+      }
+    }
+    long width = std::max(1L, g.max_width / 2);
+    for (long t = 1; t <= timestep; ++t) {
+      width = elastic_walk_step(g, t, width);
+    }
+    return width;
+  }
+
+  long phase = timestep % g.period;
+  if (g.dependence == DependenceType::ELASTIC_RAMP) {
+    long distance = std::min(phase, g.period - phase);
+    return 1 + (2 * distance * (g.max_width - 1) + g.period / 2) / g.period;
+  }
+  return 1 + phase * (g.max_width - 1) / (g.period - 1);
+}
+
+// Dependencies of a graph file point directly into the mapped file. The
+// dependence set is the timestep, and reverse dependencies are the
+// out-edges of the previous timestep.
+static const std::pair<long, long> *file_intervals(const GraphFile *file, long dset, long point,
+                                                   bool reverse, size_t &count)
+{
+  count = 0;
+  long timestep = reverse ? dset - 1 : dset;
+  if (timestep < 0 || point >= file->width(timestep)) {
+    return NULL;
+  }
+  long task = file->task(timestep, point);
+  const uint64_t *offsets = reverse ? file->out_offsets : file->in_offsets;
+  count = offsets[task+1] - offsets[task];
+  return (reverse ? file->out_intervals : file->in_intervals) + offsets[task];
+}
+
+// With deps NULL, only returns the number of intervals.
+static size_t file_dependencies(const TaskGraph &g, long dset, long point, bool reverse,
+                                std::pair<long, long> *deps)
+{
+  size_t count;
+  const std::pair<long, long> *intervals =
+    file_intervals(graph_file(g.graph_index), dset, point, reverse, count);
+  if (deps) {
+    std::copy(intervals, intervals + count, deps);
+  }
+  return count;
+}
+
+static size_t stencil_max_dependencies(const TaskGraph &g) {
+  if (g.dependence == DependenceType::STENCIL_3D) {
+    return is_box_stencil(g) ? 9 : 5;
+  }
+  return 3;
+}
+
+// Number of chunks parallel_for splits [0, n) into.
+static long parallel_chunks(long n)
+{
+  return std::max(1L, std::min<long>(std::thread::hardware_concurrency(), n));
+}
+
+// Calls f(chunk, first, last) on each of parallel_chunks(n) contiguous
+// chunks [first, last) of [0, n), one thread per chunk. Chunks that
+// cannot get a thread (e.g. not linked with -pthread) run inline.
+template <typename F>
+static void parallel_for(long n, F f)
+{
+  long n_chunks = parallel_chunks(n);
+  auto run = [&](long chunk) {
+    f(chunk, chunk * n / n_chunks, (chunk + 1) * n / n_chunks);
+  };
+  std::vector<std::thread> threads;
+  try {
+    for (long chunk = 1; chunk < n_chunks; ++chunk) {
+      threads.emplace_back(run, chunk);
+    }
+  } catch (const std::system_error &) {
+  }
+  run(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (long chunk = threads.size() + 1; chunk < n_chunks; ++chunk) {
+    run(chunk);
+  }
+}
+
+// Candidates of random patterns hashed per random_uniform_batch call.
+#define RANDOM_BATCH 64
+
+// Dependency tables indexed by graph_index. Populated by App::App and
+// read-only afterwards, so lookups need no synchronization.
+static std::vector<std::unique_ptr<DependencyTable> > dependency_tables;
+
+// Iteration counts of every dist_imbalance task of a graph, built by
+// App::App so that tasks look their count up instead of drawing it.
+// Graphs with more than DIST_TABLE_MAX_TASKS tasks, or counts that do
+// not fit in 32 bits, fall back to select_dist_iterations.
+#define DIST_TABLE_MAX_TASKS (1 << 22)
+
+struct DistIterationTable {
+  long timesteps;
+  long max_width;
+  Kernel kernel;
+  std::vector<uint32_t> iterations;
+
+  bool matches(const Kernel &k) const
+  {
+    return kernel.iterations == k.iterations &&
+      kernel.dist.type == k.dist.type &&
+      kernel.dist.max == k.dist.max &&
+      kernel.dist.std == k.dist.std &&
+      kernel.dist.a == k.dist.a &&
+      kernel.dist.b == k.dist.b;
+  }
+};
+
+// Indexed by graph_index, and like dependency_tables read-only after App::App.
+static std::vector<std::unique_ptr<DistIterationTable> > dist_tables;
+
+static std::unique_ptr<DistIterationTable> make_dist_table(const TaskGraph &g)
+{
+  std::unique_ptr<DistIterationTable> table;
+  long num_tasks = g.timesteps * g.max_width;
+  if (num_tasks > DIST_TABLE_MAX_TASKS) {
+    return table;
+  }
+
+  table.reset(new DistIterationTable);
+  table->timesteps = g.timesteps;
+  table->max_width = g.max_width;
+  table->kernel = g.kernel;
+  table->iterations.resize(num_tasks);
+  std::atomic<bool> overflow(false);
+  parallel_for(num_tasks, [&](long chunk, long first, long last) {
+    for (long idx = first; idx < last; ++idx) {
+      long iterations = select_dist_iterations(g.kernel, g.graph_index, idx / g.max_width, idx % g.max_width);
+      if (iterations > UINT32_MAX) {
+        overflow = true;
+      }
+      table->iterations[idx] = iterations;
+    }
+  });
+  if (overflow) {
+    table.reset();
+  }
+  return table;
+}
+
+static long dist_iterations(const Kernel &kernel, long graph_index, long timestep, long point)
+{
+  if (graph_index >= 0 && graph_index < (long)dist_tables.size()) {
+    const DistIterationTable *table = dist_tables[graph_index].get();
+    if (table && timestep < table->timesteps && point < table->max_width && table->matches(kernel)) {
+      return table->iterations[timestep * table->max_width + point];
+    }
+  }
+  return select_dist_iterations(kernel, graph_index, timestep, point);
+}
+
+// Returns the graph's table if (dset, point) is covered by it.
+static const DependencyTable *table_for_point(const TaskGraph &graph, long dset, long point)
+{
+  const DependencyTable *table = graph.dependency_table();
+  if (table && dset >= 0 && dset < table->num_dsets && point >= 0 && point < graph.max_width) {
+    return table;
+  }
+  return NULL;
+}
+
+// Kernels that execute_threaded can split across the threads of a task.
+static bool kernel_splits(KernelType type)
+{
+  switch (type) {
+  case KernelType::BUSY_WAIT:
+  case KernelType::MEMORY_BOUND:
+  case KernelType::MEMORY_STREAM:
+  case KernelType::MEMORY_STRIDED:
+  case KernelType::COMPUTE_DGEMM:
+  case KernelType::MEMORY_DAXPY:
+  case KernelType::COMPUTE_BOUND:
+  case KernelType::COMPUTE_BOUND2:
+  case KernelType::LOAD_IMBALANCE:
+  case KernelType::DIST_IMBALANCE:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Kernel::execute with the type fixed at compile time, so the switch
+// folds away.
+template <kernel_type_t TYPE>
+static void execute_kernel_type(const Kernel &kernel, long graph_index, long timestep, long point,
+                                char *scratch_ptr, size_t scratch_bytes)
 {
-  switch(type) {
+  switch(TYPE) {
   case KernelType::EMPTY:
-    execute_kernel_empty(*this);
+    execute_kernel_empty(kernel);
     break;
   case KernelType::BUSY_WAIT:
-    execute_kernel_busy_wait(*this);
+    execute_kernel_busy_wait(kernel);
     break;
   case KernelType::MEMORY_BOUND:
     assert(scratch_ptr != NULL);
     assert(scratch_bytes > 0);
-    execute_kernel_memory(*this, scratch_ptr, scratch_bytes, timestep);
+    execute_kernel_memory(kernel, scratch_ptr, scratch_bytes, timestep);
+    break;
+  case KernelType::MEMORY_STREAM:
+    assert(scratch_ptr != NULL);
+    assert(scratch_bytes > 0);
+    execute_kernel_memory_stream(kernel, scratch_ptr, scratch_bytes, timestep);
+    break;
+  case KernelType::MEMORY_STRIDED:
+    assert(scratch_ptr != NULL);
+    assert(scratch_bytes > 0);
+    execute_kernel_memory_strided(kernel, scratch_ptr, scratch_bytes, timestep);
+    break;
+  case KernelType::MEMORY_CHASE:
+    assert(scratch_ptr != NULL);
+    assert(scratch_bytes >= 2 * CACHE_LINE_BYTES);
+    execute_kernel_memory_chase(kernel, scratch_ptr, scratch_bytes, timestep);
     break;
   case KernelType::COMPUTE_DGEMM:
     assert(scratch_ptr != NULL);
     assert(scratch_bytes > 0);
-    execute_kernel_dgemm(*this, scratch_ptr, scratch_bytes);
+    execute_kernel_dgemm(kernel, scratch_ptr, scratch_bytes);
     break;
   case KernelType::MEMORY_DAXPY:
     assert(scratch_ptr != NULL);
     assert(scratch_bytes > 0);
-    execute_kernel_daxpy(*this, scratch_ptr, scratch_bytes, timestep);
+    execute_kernel_daxpy(kernel, scratch_ptr, scratch_bytes, timestep);
     break;
   case KernelType::COMPUTE_BOUND:
-    execute_kernel_compute(*this);
+    execute_kernel_compute(kernel);
     break;
   case KernelType::COMPUTE_BOUND2:
-    execute_kernel_compute2(*this);
+    execute_kernel_compute2(kernel);
     break;
   case KernelType::IO_BOUND:
-    execute_kernel_io(*this);
+    assert(timestep >= 0 && point >= 0);
+    execute_kernel_io(kernel, graph_index, timestep, point);
     break;
   case KernelType::LOAD_IMBALANCE:
     assert(timestep >= 0 && point >= 0);
-    execute_kernel_imbalance(*this, graph_index, timestep, point);
+    execute_kernel_imbalance(kernel, graph_index, timestep, point);
     break;
   case KernelType::DIST_IMBALANCE:
     assert(timestep >= 0 && point >= 0);
-    execute_kernel_distribution(*this, graph_index, timestep, point);
+    execute_kernel_distribution(kernel, dist_iterations(kernel, graph_index, timestep, point));
     break;
   case KernelType::COMPUTE_MEMORY:
     assert(scratch_ptr != NULL);
     assert(scratch_bytes > 0);
-    execute_kernel_compute_and_mem(*this, scratch_ptr, scratch_bytes, timestep);
+    execute_kernel_compute_and_mem(kernel, scratch_ptr, scratch_bytes, timestep);
     break;
   default:
     assert(false && "unimplemented kernel type");
   };
 }
 
+// Kernels that do nothing when kernel.iterations is zero.
+static bool kernel_idle_without_iterations(KernelType type)
+{
+  switch (type) {
+  case KernelType::BUSY_WAIT:
+  case KernelType::MEMORY_BOUND:
+  case KernelType::MEMORY_STREAM:
+  case KernelType::MEMORY_STRIDED:
+  case KernelType::MEMORY_CHASE:
+  case KernelType::COMPUTE_DGEMM:
+  case KernelType::COMPUTE_BOUND:
+  case KernelType::COMPUTE_BOUND2:
+  case KernelType::LOAD_IMBALANCE:
+  case KernelType::COMPUTE_MEMORY:
+    return true;
+  default:
+    return false;
+  }
+}
+
+Kernel::Function Kernel::resolve() const
+{
+  if (kernel_threads(*this) > 1 && kernel_splits(type)) {
+    return [](const Kernel &kernel, long graph_index, long timestep, long point,
+              char *scratch_ptr, size_t scratch_bytes) {
+      kernel.execute_threaded(graph_index, timestep, point, scratch_ptr, scratch_bytes);
+    };
+  }
+  if (iterations == 0 && kernel_idle_without_iterations(type)) {
+    return execute_kernel_type<KernelType::EMPTY>;
+  }
+
+#define RESOLVE_KERNEL(name) case KernelType::name: return execute_kernel_type<KernelType::name>
+  switch (type) {
+  RESOLVE_KERNEL(EMPTY);
+  RESOLVE_KERNEL(BUSY_WAIT);
+  RESOLVE_KERNEL(MEMORY_BOUND);
+  RESOLVE_KERNEL(MEMORY_STREAM);
+  RESOLVE_KERNEL(MEMORY_STRIDED);
+  RESOLVE_KERNEL(MEMORY_CHASE);
+  RESOLVE_KERNEL(COMPUTE_DGEMM);
+  RESOLVE_KERNEL(MEMORY_DAXPY);
+  RESOLVE_KERNEL(COMPUTE_BOUND);
+  RESOLVE_KERNEL(COMPUTE_BOUND2);
+  RESOLVE_KERNEL(IO_BOUND);
+  RESOLVE_KERNEL(LOAD_IMBALANCE);
+  RESOLVE_KERNEL(DIST_IMBALANCE);
+  RESOLVE_KERNEL(COMPUTE_MEMORY);
+  default:
+    assert(false && "unimplemented kernel type");
+    return NULL;
+  }
+#undef RESOLVE_KERNEL
+}
+
+void Kernel::execute(long graph_index, long timestep, long point,
+                     char *scratch_ptr, size_t scratch_bytes) const
+{
+  resolve()(*this, graph_index, timestep, point, scratch_ptr, scratch_bytes);
+}
+
+// Kernel functions resolved by App::App, indexed by graph_index and
+// read-only afterwards. An entry is used only while the graph's kernel
+// still has the type, iterations and threads it was resolved for.
+struct ResolvedKernel {
+  Kernel kernel;
+  Kernel::Function function;
+
+  bool matches(const Kernel &k) const
+  {
+    return function && kernel.type == k.type &&
+      kernel.iterations == k.iterations && kernel.threads == k.threads;
+  }
+};
+
+static std::vector<ResolvedKernel> resolved_kernels;
+
+static Kernel::Function kernel_function(const Kernel &kernel, long graph_index)
+{
+  if (graph_index >= 0 && graph_index < (long)resolved_kernels.size()) {
+    const ResolvedKernel &resolved = resolved_kernels[graph_index];
+    if (resolved.matches(kernel)) {
+      return resolved.function;
+    }
+  }
+  return kernel.resolve();
+}
+
+// Runs one task on kernel_threads() threads. Compute kernels divide their
+// iterations, scratch kernels their samples (with the iterations that
+// visit them) and DGEMM the columns of C, so the task performs the same
+// FLOPs and bytes as on one thread.
+void Kernel::execute_threaded(long graph_index, long timestep, long point,
+                              char *scratch_ptr, size_t scratch_bytes) const
+{
+  Kernel k(*this);
+  k.threads = 0;
+  if (type == KernelType::LOAD_IMBALANCE) {
+    k.type = KernelType::COMPUTE_BOUND;
+    k.iterations = select_imbalance_iterations(*this, graph_index, timestep, point);
+  } else if (type == KernelType::DIST_IMBALANCE) {
+    k.type = KernelType::COMPUTE_BOUND;
+    k.iterations = dist_iterations(*this, graph_index, timestep, point);
+  }
+
+  run_task_team(kernel_threads(*this), [&](int thread, int threads) {
+    Kernel part(k);
+    switch (k.type) {
+    case KernelType::COMPUTE_DGEMM:
+      assert(scratch_ptr != NULL);
+      assert(scratch_bytes > 0);
+      execute_kernel_dgemm(k, scratch_ptr, scratch_bytes, thread, threads);
+      break;
+    case KernelType::MEMORY_BOUND:
+    case KernelType::MEMORY_STREAM:
+    case KernelType::MEMORY_STRIDED:
+    case KernelType::MEMORY_DAXPY: {
+      // Contiguous samples per thread, so no two threads touch the same bytes.
+      long parts = std::min<long>(threads, k.samples);
+      if (thread < parts) {
+        long first = k.samples * thread / parts;
+        long last = k.samples * (thread + 1) / parts;
+        size_t sample_bytes = scratch_bytes / k.samples;
+        part.samples = last - first;
+        part.iterations = k.iterations * last / k.samples - k.iterations * first / k.samples;
+        part.execute(graph_index, timestep, point,
+                     scratch_ptr + first * sample_bytes, part.samples * sample_bytes);
+      }
+      break;
+    }
+    default:
+      part.iterations = k.iterations * (thread + 1) / threads - k.iterations * thread / threads;
+      part.execute(graph_index, timestep, point, scratch_ptr, scratch_bytes);
+    }
+  });
+}
+
+long TaskGraph::task_iterations(long timestep, long point) const
+{
+  Kernel k(kernel);
+  if (dependence == DependenceType::GRAPH_FILE) {
+    const GraphFile *file = graph_file(graph_index);
+    k.iterations = file->iterations[file->task(timestep, point)];
+  }
+  switch (k.type) {
+  case KernelType::LOAD_IMBALANCE:
+    return select_imbalance_iterations(k, graph_index, timestep, point);
+  case KernelType::DIST_IMBALANCE:
+    return dist_iterations(k, graph_index, timestep, point);
+  default:
+    return k.iterations;
+  }
+}
+
 static const std::map<std::string, KernelType> ktype_by_name = {
   {"empty", KernelType::EMPTY},
   {"busy_wait", KernelType::BUSY_WAIT},
@@ -104,6 +777,20 @@ static const std::map<std::string, KernelType> ktype_by_name = {
   {"load_imbalance", KernelType::LOAD_IMBALANCE},
   {"dist_imbalance", KernelType::DIST_IMBALANCE},
   {"compute_and_mem", KernelType::COMPUTE_MEMORY},
+  {"memory_stream", KernelType::MEMORY_STREAM},
+  {"memory_strided", KernelType::MEMORY_STRIDED},
+  {"memory_chase", KernelType::MEMORY_CHASE},
+};
+
+static const std::map<std::string, IoMode> iomode_by_name = {
+  {"sync", IoMode::IO_MODE_SYNC},
+  {"direct", IoMode::IO_MODE_DIRECT},
+  {"uring", IoMode::IO_MODE_URING},
+};
+
+static const std::map<std::string, ArrivalType> arrival_by_name = {
+  {"fixed", ArrivalType::ARRIVAL_FIXED},
+  {"poisson", ArrivalType::ARRIVAL_POISSON},
 };
 
 static const std::map<std::string, DistType> disttype_by_name = {
@@ -137,6 +824,21 @@ static std::map<KernelType, std::string> make_name_by_ktype()
 
 static const std::map<KernelType, std::string> name_by_ktype = make_name_by_ktype();
 
+bool kernel_type_by_name(const char *name, KernelType &type)
+{
+  auto it = ktype_by_name.find(name);
+  if (it == ktype_by_name.end()) {
+    return false;
+  }
+  type = it->second;
+  return true;
+}
+
+const char *kernel_type_name(KernelType type)
+{
+  return name_by_ktype.at(type).c_str();
+}
+
 static const std::map<std::string, DependenceType> dtype_by_name = {
   {"trivial", DependenceType::TRIVIAL},
   {"no_comm", DependenceType::NO_COMM},
@@ -150,6 +852,14 @@ static const std::map<std::string, DependenceType> dtype_by_name = {
   {"spread", DependenceType::SPREAD},
   {"random_nearest", DependenceType::RANDOM_NEAREST},
   {"random_spread", DependenceType::RANDOM_SPREAD},
+  {"stencil_2d", DependenceType::STENCIL_2D},
+  {"stencil_3d", DependenceType::STENCIL_3D},
+  {"v_cycle", DependenceType::V_CYCLE},
+  {"w_cycle", DependenceType::W_CYCLE},
+  {"graph_file", DependenceType::GRAPH_FILE},
+  {"elastic_ramp", DependenceType::ELASTIC_RAMP},
+  {"elastic_sawtooth", DependenceType::ELASTIC_SAWTOOTH},
+  {"elastic_random", DependenceType::ELASTIC_RANDOM},
 };
 
 static std::map<DependenceType, std::string> make_name_by_dtype()
@@ -168,17 +878,72 @@ static std::map<DependenceType, std::string> make_name_by_dtype()
 
 static std::map<DependenceType, std::string> name_by_dtype = make_name_by_dtype();
 
-long TaskGraph::offset_at_timestep(long timestep) const
+static const std::map<std::string, ValidationType> vtype_by_name = {
+  {"full", ValidationType::FULL_VALIDATION},
+  {"sample", ValidationType::SAMPLE_VALIDATION},
+  {"none", ValidationType::NO_VALIDATION},
+};
+
+static std::map<ValidationType, std::string> make_name_by_vtype()
 {
-  if (timestep < 0) {
-    return 0;
+  std::map<ValidationType, std::string> names;
+  for (auto pair : vtype_by_name) {
+    names[pair.second] = pair.first;
   }
+  return names;
+}
 
-  switch (dependence) {
-  case DependenceType::TRIVIAL:
+static const std::map<ValidationType, std::string> name_by_vtype = make_name_by_vtype();
+
+static const std::map<std::string, timer_source_t> timer_source_by_name = {
+  {"monotonic", TIMER_SOURCE_MONOTONIC},
+  {"tsc", TIMER_SOURCE_TSC},
+};
+
+static const std::map<std::string, HugePageMode> huge_page_mode_by_name = {
+  {"none", HugePageMode::NONE},
+  {"thp", HugePageMode::THP},
+  {"hugetlb", HugePageMode::HUGETLB},
+};
+
+// Distributions of output sizes over the points of a timestep, by
+// output_case.
+static const std::map<std::string, int> output_case_by_name = {
+  {"none", 0},
+  {"normal", 1},
+  {"normal_random", 2},
+  {"gamma", 3},
+};
+
+static const char *output_case_name(int output_case)
+{
+  for (auto &entry : output_case_by_name) {
+    if (entry.second == output_case) {
+      return entry.first.c_str();
+    }
+  }
+  return "unknown";
+}
+
+long TaskGraph::offset_at_timestep(long timestep) const
+{
+  if (timestep < 0) {
+    return 0;
+  }
+
+  switch (dependence) {
+  case DependenceType::TRIVIAL:
   case DependenceType::NO_COMM:
   case DependenceType::STENCIL_1D:
   case DependenceType::STENCIL_1D_PERIODIC:
+  case DependenceType::STENCIL_2D:
+  case DependenceType::STENCIL_3D:
+  case DependenceType::GRAPH_FILE:
+  case DependenceType::V_CYCLE:
+  case DependenceType::W_CYCLE:
+  case DependenceType::ELASTIC_RAMP:
+  case DependenceType::ELASTIC_SAWTOOTH:
+  case DependenceType::ELASTIC_RANDOM:
     return 0;
   case DependenceType::DOM:
     return std::max(0L, timestep + max_width - timesteps);
@@ -206,7 +971,18 @@ long TaskGraph::width_at_timestep(long timestep) const
   case DependenceType::NO_COMM:
   case DependenceType::STENCIL_1D:
   case DependenceType::STENCIL_1D_PERIODIC:
+  case DependenceType::STENCIL_2D:
+  case DependenceType::STENCIL_3D:
     return max_width;
+  case DependenceType::GRAPH_FILE:
+    return graph_file(graph_index)->width(timestep);
+  case DependenceType::V_CYCLE:
+  case DependenceType::W_CYCLE:
+    return multigrid_width(*this, multigrid_level(*this, timestep));
+  case DependenceType::ELASTIC_RAMP:
+  case DependenceType::ELASTIC_SAWTOOTH:
+  case DependenceType::ELASTIC_RANDOM:
+    return elastic_width(*this, timestep);
   case DependenceType::DOM:
     return std::min(max_width,
                     std::min(timestep + 1, timesteps - timestep));
@@ -232,11 +1008,21 @@ long TaskGraph::max_dependence_sets() const
   case DependenceType::NO_COMM:
   case DependenceType::STENCIL_1D:
   case DependenceType::STENCIL_1D_PERIODIC:
+  case DependenceType::STENCIL_2D:
+  case DependenceType::STENCIL_3D:
   case DependenceType::DOM:
   case DependenceType::TREE:
+  case DependenceType::ELASTIC_RAMP:
+  case DependenceType::ELASTIC_SAWTOOTH:
+  case DependenceType::ELASTIC_RANDOM:
     return 1;
   case DependenceType::FFT:
     return (long)ceil(log2(max_width));
+  case DependenceType::GRAPH_FILE:
+    return timesteps;
+  case DependenceType::V_CYCLE:
+  case DependenceType::W_CYCLE:
+    return 3 * multigrid_levels(*this) - 2;
   case DependenceType::ALL_TO_ALL:
   case DependenceType::NEAREST:
     return 1;
@@ -251,11 +1037,55 @@ long TaskGraph::max_dependence_sets() const
 
 long TaskGraph::timestep_period() const
 {
-  // For all the dependence types currently defined, the pattern
-  // repeats with a period equal to the number of timesteps.
+  // Multigrid cycles revisit their dependence sets out of order, so the
+  // pattern repeats once per cycle. For all the other dependence types
+  // the period is the number of dependence sets.
+  if (is_multigrid(dependence)) {
+    return multigrid_cycle_length(*this);
+  }
+  // Elastic widths repeat once per period, except for the random walk,
+  // which never does.
+  if (dependence == DependenceType::ELASTIC_RANDOM) {
+    return timesteps;
+  } else if (is_elastic(dependence)) {
+    return period;
+  }
   return max_dependence_sets();
 }
 
+double TaskGraph::release_time(long timestep) const
+{
+  if (arrival_rate == 0) {
+    return 0;
+  }
+  if (arrival == ArrivalType::ARRIVAL_FIXED) {
+    return timestep / arrival_rate;
+  }
+  if (graph_index < (long)release_tables.size() && timestep < (long)release_tables[graph_index].size()) {
+    return release_tables[graph_index][timestep];
+  }
+  double release = 0;
+  for (long t = 1; t <= timestep; ++t) {
+    release += poisson_gap(*this, t);
+  }
+  return release;
+}
+
+void TaskGraph::wait_for_release(long timestep) const
+{
+  if (arrival_rate == 0 || !arrivals_started) {
+    return;
+  }
+  double target = arrival_start + release_time(timestep);
+  double now;
+  while ((now = Timer::get_cur_time()) < target) {
+    // Sleep through most of the gap and spin for the rest.
+    if (target - now > 2e-4) {
+      std::this_thread::sleep_for(std::chrono::duration<double>(target - now - 1e-4));
+    }
+  }
+}
+
 long TaskGraph::dependence_set_at_timestep(long timestep) const
 {
   switch (dependence) {
@@ -263,11 +1093,22 @@ long TaskGraph::dependence_set_at_timestep(long timestep) const
   case DependenceType::NO_COMM:
   case DependenceType::STENCIL_1D:
   case DependenceType::STENCIL_1D_PERIODIC:
+  case DependenceType::STENCIL_2D:
+  case DependenceType::STENCIL_3D:
   case DependenceType::DOM:
   case DependenceType::TREE:
+  case DependenceType::ELASTIC_RAMP:
+  case DependenceType::ELASTIC_SAWTOOTH:
+  case DependenceType::ELASTIC_RANDOM:
     return 0;
   case DependenceType::FFT:
     return (timestep + max_dependence_sets() - 1) % max_dependence_sets();
+  case DependenceType::GRAPH_FILE:
+    return timestep;
+  case DependenceType::V_CYCLE:
+  case DependenceType::W_CYCLE:
+    return multigrid_dependence_set(multigrid_levels(*this), multigrid_level(*this, timestep - 1),
+                                    multigrid_level(*this, timestep));
   case DependenceType::ALL_TO_ALL:
   case DependenceType::NEAREST:
     return 0;
@@ -280,8 +1121,27 @@ long TaskGraph::dependence_set_at_timestep(long timestep) const
   };
 }
 
+bool TaskGraph::table_intervals(long dset, long point, bool reverse,
+                                const std::pair<long, long> *&deps, size_t &count) const
+{
+  const DependencyTable *table = table_for_point(*this, dset, point);
+  if (table) {
+    deps = reverse ? table->reverse_dependencies(dset, point, count) : table->dependencies(dset, point, count);
+    return true;
+  }
+  count = reverse ? num_reverse_dependencies(dset, point) : num_dependencies(dset, point);
+  return false;
+}
+
 std::vector<std::pair<long, long> > TaskGraph::reverse_dependencies(long dset, long point) const
 {
+  const DependencyTable *table = table_for_point(*this, dset, point);
+  if (table) {
+    size_t count;
+    const std::pair<long, long> *table_deps = table->reverse_dependencies(dset, point, count);
+    return std::vector<std::pair<long, long> >(table_deps, table_deps + count);
+  }
+
   size_t count = num_reverse_dependencies(dset, point);
   std::vector<std::pair<long, long> > deps(count);
   size_t actual_count = reverse_dependencies(dset, point, deps.data());
@@ -292,6 +1152,14 @@ std::vector<std::pair<long, long> > TaskGraph::reverse_dependencies(long dset, l
 
 size_t TaskGraph::reverse_dependencies(long dset, long point, std::pair<long, long> *deps) const
 {
+  const DependencyTable *table = table_for_point(*this, dset, point);
+  if (table) {
+    size_t count;
+    const std::pair<long, long> *table_deps = table->reverse_dependencies(dset, point, count);
+    std::copy(table_deps, table_deps + count, deps);
+    return count;
+  }
+
   switch (dependence) {
   case DependenceType::TRIVIAL:
     return 0;
@@ -299,6 +1167,9 @@ size_t TaskGraph::reverse_dependencies(long dset, long point, std::pair<long, lo
     deps[0] = std::pair<long, long>(point, point);
     return 1;
   case DependenceType::STENCIL_1D:
+  case DependenceType::ELASTIC_RAMP:
+  case DependenceType::ELASTIC_SAWTOOTH:
+  case DependenceType::ELASTIC_RANDOM:
     deps[0] = std::pair<long, long>(std::max(0L, point-1),
                                     std::min(point+1, max_width-1));
     return 1;
@@ -315,6 +1186,14 @@ size_t TaskGraph::reverse_dependencies(long dset, long point, std::pair<long, lo
       }
       return idx;
     }
+  case DependenceType::STENCIL_2D:
+  case DependenceType::STENCIL_3D:
+    return stencil_dependencies(*this, point, deps);
+  case DependenceType::GRAPH_FILE:
+    return file_dependencies(*this, dset, point, true, deps);
+  case DependenceType::V_CYCLE:
+  case DependenceType::W_CYCLE:
+    return multigrid_dependencies(*this, dset, point, true, deps);
   case DependenceType::DOM:
     deps[0] = std::pair<long, long>(point, std::min(max_width-1, point+1));
     return 1;
@@ -367,24 +1246,33 @@ size_t TaskGraph::reverse_dependencies(long dset, long point, std::pair<long, lo
     {
       size_t idx = 0;
       long run_start = -1;
-      long i, last_i;
-      for (i = std::max(0L, point - (radix-1)/2),
-             last_i = std::min(point + radix/2, max_width-1);
-           i <= last_i; ++i) {
-        // Figure out whether we're including this dependency or not.
-        const long hash_value[5] = {graph_index, radix, dset, point, i};
-        double value = random_uniform(&hash_value[0], sizeof(hash_value));
-        bool include = value < fraction_connected || (radix > 0 && i == point);
-
-        if (include) {
-          if (run_start < 0) {
-            run_start = i;
-          }
-        } else {
-          if (run_start >= 0) {
-            deps[idx++] = std::pair<long, long>(run_start, i-1);
+      long i = std::max(0L, point - (radix-1)/2);
+      long last_i = std::min(point + radix/2, max_width-1);
+      while (i <= last_i) {
+        // Figure out whether we're including each dependency or not,
+        // hashing a batch of candidates at once.
+        long hash_values[RANDOM_BATCH][5];
+        double values[RANDOM_BATCH];
+        long n = std::min(last_i - i + 1, (long)RANDOM_BATCH);
+        for (long j = 0; j < n; ++j) {
+          const long hash_value[5] = {graph_index, radix, dset, point, i + j};
+          std::copy(hash_value, hash_value + 5, hash_values[j]);
+        }
+        random_uniform_batch(&hash_values[0][0], sizeof(hash_values[0]), n, values);
+
+        for (long j = 0; j < n; ++j, ++i) {
+          bool include = values[j] < fraction_connected || (radix > 0 && i == point);
+
+          if (include) {
+            if (run_start < 0) {
+              run_start = i;
+            }
+          } else {
+            if (run_start >= 0) {
+              deps[idx++] = std::pair<long, long>(run_start, i-1);
+            }
+            run_start = -1;
           }
-          run_start = -1;
         }
       }
       if (run_start >= 0) {
@@ -402,14 +1290,32 @@ size_t TaskGraph::reverse_dependencies(long dset, long point, std::pair<long, lo
 
 size_t TaskGraph::num_reverse_dependencies(long dset, long point) const
 {
+  const DependencyTable *table = table_for_point(*this, dset, point);
+  if (table) {
+    size_t count;
+    table->reverse_dependencies(dset, point, count);
+    return count;
+  }
+
   switch (dependence) {
   case DependenceType::TRIVIAL:
     return 0;
   case DependenceType::NO_COMM:
   case DependenceType::STENCIL_1D:
+  case DependenceType::ELASTIC_RAMP:
+  case DependenceType::ELASTIC_SAWTOOTH:
+  case DependenceType::ELASTIC_RANDOM:
     return 1;
   case DependenceType::STENCIL_1D_PERIODIC:
     return max_width > 1 ? 2 : 3;
+  case DependenceType::STENCIL_2D:
+  case DependenceType::STENCIL_3D:
+    return stencil_max_dependencies(*this);
+  case DependenceType::GRAPH_FILE:
+    return file_dependencies(*this, dset, point, true, NULL);
+  case DependenceType::V_CYCLE:
+  case DependenceType::W_CYCLE:
+    return 1;
   case DependenceType::DOM:
   case DependenceType::TREE:
     return 1;
@@ -431,6 +1337,13 @@ size_t TaskGraph::num_reverse_dependencies(long dset, long point) const
 
 std::vector<std::pair<long, long> > TaskGraph::dependencies(long dset, long point) const
 {
+  const DependencyTable *table = table_for_point(*this, dset, point);
+  if (table) {
+    size_t count;
+    const std::pair<long, long> *table_deps = table->dependencies(dset, point, count);
+    return std::vector<std::pair<long, long> >(table_deps, table_deps + count);
+  }
+
   size_t count = num_dependencies(dset, point);
   std::vector<std::pair<long, long> > deps(count);
   size_t actual_count = dependencies(dset, point, deps.data());
@@ -441,6 +1354,14 @@ std::vector<std::pair<long, long> > TaskGraph::dependencies(long dset, long poin
 
 size_t TaskGraph::dependencies(long dset, long point, std::pair<long, long> *deps) const
 {
+  const DependencyTable *table = table_for_point(*this, dset, point);
+  if (table) {
+    size_t count;
+    const std::pair<long, long> *table_deps = table->dependencies(dset, point, count);
+    std::copy(table_deps, table_deps + count, deps);
+    return count;
+  }
+
   switch (dependence) {
   case DependenceType::TRIVIAL:
     return 0;
@@ -448,6 +1369,9 @@ size_t TaskGraph::dependencies(long dset, long point, std::pair<long, long> *dep
     deps[0] = std::pair<long, long>(point, point);
     return 1;
   case DependenceType::STENCIL_1D:
+  case DependenceType::ELASTIC_RAMP:
+  case DependenceType::ELASTIC_SAWTOOTH:
+  case DependenceType::ELASTIC_RANDOM:
     deps[0] = std::pair<long, long>(std::max(0L, point-1),
                                     std::min(point+1, max_width-1));
     return 1;
@@ -464,6 +1388,14 @@ size_t TaskGraph::dependencies(long dset, long point, std::pair<long, long> *dep
       }
       return idx;
     }
+  case DependenceType::STENCIL_2D:
+  case DependenceType::STENCIL_3D:
+    return stencil_dependencies(*this, point, deps);
+  case DependenceType::GRAPH_FILE:
+    return file_dependencies(*this, dset, point, false, deps);
+  case DependenceType::V_CYCLE:
+  case DependenceType::W_CYCLE:
+    return multigrid_dependencies(*this, dset, point, false, deps);
   case DependenceType::DOM:
     deps[0] = std::pair<long, long>(std::max(0L, point-1), point);
     return 1;
@@ -508,24 +1440,33 @@ size_t TaskGraph::dependencies(long dset, long point, std::pair<long, long> *dep
     {
       size_t idx = 0;
       long run_start = -1;
-      long i, last_i;
-      for (i = std::max(0L, point - radix/2),
-             last_i = std::min(point + (radix-1)/2, max_width-1);
-           i <= last_i; ++i) {
-        // Figure out whether we're including this dependency or not.
-        const long hash_value[5] = {graph_index, radix, dset, i, point};
-        double value = random_uniform(&hash_value[0], sizeof(hash_value));
-        bool include = value < fraction_connected || (radix > 0 && i == point);
-
-        if (include) {
-          if (run_start < 0) {
-            run_start = i;
-          }
-        } else {
-          if (run_start >= 0) {
-            deps[idx++] = std::pair<long, long>(run_start, i-1);
+      long i = std::max(0L, point - radix/2);
+      long last_i = std::min(point + (radix-1)/2, max_width-1);
+      while (i <= last_i) {
+        // Figure out whether we're including each dependency or not,
+        // hashing a batch of candidates at once.
+        long hash_values[RANDOM_BATCH][5];
+        double values[RANDOM_BATCH];
+        long n = std::min(last_i - i + 1, (long)RANDOM_BATCH);
+        for (long j = 0; j < n; ++j) {
+          const long hash_value[5] = {graph_index, radix, dset, i + j, point};
+          std::copy(hash_value, hash_value + 5, hash_values[j]);
+        }
+        random_uniform_batch(&hash_values[0][0], sizeof(hash_values[0]), n, values);
+
+        for (long j = 0; j < n; ++j, ++i) {
+          bool include = values[j] < fraction_connected || (radix > 0 && i == point);
+
+          if (include) {
+            if (run_start < 0) {
+              run_start = i;
+            }
+          } else {
+            if (run_start >= 0) {
+              deps[idx++] = std::pair<long, long>(run_start, i-1);
+            }
+            run_start = -1;
           }
-          run_start = -1;
         }
       }
       if (run_start >= 0) {
@@ -543,14 +1484,32 @@ size_t TaskGraph::dependencies(long dset, long point, std::pair<long, long> *dep
 
 size_t TaskGraph::num_dependencies(long dset, long point) const
 {
+  const DependencyTable *table = table_for_point(*this, dset, point);
+  if (table) {
+    size_t count;
+    table->dependencies(dset, point, count);
+    return count;
+  }
+
   switch (dependence) {
   case DependenceType::TRIVIAL:
     return 0;
   case DependenceType::NO_COMM:
   case DependenceType::STENCIL_1D:
+  case DependenceType::ELASTIC_RAMP:
+  case DependenceType::ELASTIC_SAWTOOTH:
+  case DependenceType::ELASTIC_RANDOM:
     return 1;
   case DependenceType::STENCIL_1D_PERIODIC:
     return max_width > 1 ? 2 : 3;
+  case DependenceType::STENCIL_2D:
+  case DependenceType::STENCIL_3D:
+    return stencil_max_dependencies(*this);
+  case DependenceType::GRAPH_FILE:
+    return file_dependencies(*this, dset, point, false, NULL);
+  case DependenceType::V_CYCLE:
+  case DependenceType::W_CYCLE:
+    return 1;
   case DependenceType::DOM:
   case DependenceType::TREE:
     return 1;
@@ -570,14 +1529,353 @@ size_t TaskGraph::num_dependencies(long dset, long point) const
   return SIZE_MAX;
 }
 
+const DependencyTable *TaskGraph::dependency_table() const
+{
+  if (graph_index < 0 || graph_index >= (long)dependency_tables.size()) {
+    return NULL;
+  }
+  const DependencyTable *table = dependency_tables[graph_index].get();
+  if (table && table->matches(*this)) {
+    return table;
+  }
+  return NULL;
+}
+
+DependencyTable::DependencyTable(const TaskGraph &graph)
+  : graph_index(graph.graph_index)
+  , max_width(graph.max_width)
+  , dependence(graph.dependence)
+  , radix(graph.radix)
+  , period(graph.period)
+  , fraction_connected(graph.fraction_connected)
+  , num_dsets(graph.max_dependence_sets())
+  , file(NULL)
+{
+  std::copy(graph.dims, graph.dims + 3, dims);
+  if (graph.dependence == DependenceType::GRAPH_FILE) {
+    file = graph_file(graph.graph_index);
+    return;
+  }
+  offsets.reserve(num_dsets * max_width + 1);
+  reverse_offsets.reserve(num_dsets * max_width + 1);
+  offsets.push_back(0);
+  reverse_offsets.push_back(0);
+
+  size_t max_deps = 0;
+  for (long dset = 0; dset < num_dsets; ++dset) {
+    for (long point = 0; point < max_width; ++point) {
+      max_deps = std::max(max_deps, graph.num_dependencies(dset, point));
+      max_deps = std::max(max_deps, graph.num_reverse_dependencies(dset, point));
+    }
+  }
+
+  std::vector<std::pair<long, long> > deps(max_deps);
+  for (long dset = 0; dset < num_dsets; ++dset) {
+    for (long point = 0; point < max_width; ++point) {
+      size_t count = graph.dependencies(dset, point, deps.data());
+      assert(count <= max_deps);
+      intervals.insert(intervals.end(), deps.begin(), deps.begin() + count);
+      offsets.push_back(intervals.size());
+
+      count = graph.reverse_dependencies(dset, point, deps.data());
+      assert(count <= max_deps);
+      reverse_intervals.insert(reverse_intervals.end(), deps.begin(), deps.begin() + count);
+      reverse_offsets.push_back(reverse_intervals.size());
+    }
+  }
+  intervals.shrink_to_fit();
+  reverse_intervals.shrink_to_fit();
+}
+
+bool DependencyTable::matches(const TaskGraph &graph) const
+{
+  return graph.graph_index == graph_index &&
+    graph.max_width == max_width &&
+    graph.dependence == dependence &&
+    graph.radix == radix &&
+    graph.period == period &&
+    graph.fraction_connected == fraction_connected &&
+    std::equal(dims, dims + 3, graph.dims);
+}
+
+const std::pair<long, long> *DependencyTable::dependencies(long dset, long point, size_t &count) const
+{
+  assert(dset >= 0 && dset < num_dsets);
+  assert(point >= 0 && point < max_width);
+  if (file) {
+    return file_intervals(file, dset, point, false, count);
+  }
+  size_t idx = dset * max_width + point;
+  count = offsets[idx + 1] - offsets[idx];
+  return intervals.data() + offsets[idx];
+}
+
+const std::pair<long, long> *DependencyTable::reverse_dependencies(long dset, long point, size_t &count) const
+{
+  assert(dset >= 0 && dset < num_dsets);
+  assert(point >= 0 && point < max_width);
+  if (file) {
+    return file_intervals(file, dset, point, true, count);
+  }
+  size_t idx = dset * max_width + point;
+  count = reverse_offsets[idx + 1] - reverse_offsets[idx];
+  return reverse_intervals.data() + reverse_offsets[idx];
+}
+
+// Number of elements checked per buffer with -validate sample.
+#define VALIDATION_SAMPLES 16
+
+// Distance between the elements of a buffer that are validated (and
+// generated) in the given validation mode.
+static size_t validation_stride(ValidationType validation, size_t n_elements)
+{
+  switch (validation) {
+  case ValidationType::FULL_VALIDATION:
+    return 1;
+  case ValidationType::SAMPLE_VALIDATION:
+    return std::max(n_elements / VALIDATION_SAMPLES, (size_t)1);
+  case ValidationType::NO_VALIDATION:
+    return n_elements;
+  default:
+    assert(false && "unexpected validation type");
+  };
+  return 1;
+}
+
+// Timestep stored in outputs. Each instance of a child graph counts its
+// timesteps from its own base so that outputs of different instances
+// never validate against each other.
+static long stored_timestep(const TaskGraph &graph, long timestep)
+{
+  return graph.instance * graph.timesteps + timestep;
+}
+
+static void validate_element(const TaskGraph &graph, const std::pair<long, long> *input, size_t i,
+                             long timestep, long point, size_t idx, long dep_timestep, long dep)
+{
+  if (input[i].first != dep_timestep || input[i].second != dep) {
+    printf("ERROR: Task Bench detected corrupted value in task (graph %ld timestep %ld point %ld) input %ld\n  At position %lu within the buffer, expected value (timestep %ld point %ld) but got (timestep %ld point %ld)\n",
+           graph.graph_index, timestep, point, idx,
+           i, dep_timestep, dep, input[i].first, input[i].second);
+    fflush(stdout);
+  }
+  assert(input[i].first == dep_timestep);
+  assert(input[i].second == dep);
+}
+
+// Write (timestep, point) to every element of output.
+static void fill_elements(std::pair<long, long> *output, size_t n_elements,
+                          long timestep, long point)
+{
+  size_t i = 0;
+#if defined(__AVX512F__)
+  __m512i value = _mm512_set_epi64(point, timestep, point, timestep,
+                                   point, timestep, point, timestep);
+  for ( ; i + 4 <= n_elements; i += 4) {
+    _mm512_storeu_si512(reinterpret_cast<void *>(output + i), value);
+  }
+#elif __AVX2__ == 1
+  __m256i value = _mm256_set_epi64x(point, timestep, point, timestep);
+  for ( ; i + 2 <= n_elements; i += 2) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(output + i), value);
+  }
+#endif
+  for ( ; i < n_elements; ++i) {
+    output[i].first = timestep;
+    output[i].second = point;
+  }
+}
+
+// Return the position of the first element of input that is not
+// (timestep, point), or n_elements if all of them match.
+static size_t find_mismatch(const std::pair<long, long> *input, size_t n_elements,
+                            long timestep, long point)
+{
+  size_t i = 0;
+#if defined(__AVX512F__)
+  __m512i value = _mm512_set_epi64(point, timestep, point, timestep,
+                                   point, timestep, point, timestep);
+  for ( ; i + 4 <= n_elements; i += 4) {
+    __m512i v = _mm512_loadu_si512(reinterpret_cast<const void *>(input + i));
+    if (_mm512_cmpneq_epi64_mask(v, value) != 0) {
+      break;
+    }
+  }
+#elif __AVX2__ == 1
+  __m256i value = _mm256_set_epi64x(point, timestep, point, timestep);
+  for ( ; i + 2 <= n_elements; i += 2) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(input + i));
+    if (_mm256_movemask_epi8(_mm256_cmpeq_epi64(v, value)) != -1) {
+      break;
+    }
+  }
+#endif
+  // Finish the tail (or locate the exact mismatch within the last vector).
+  for ( ; i < n_elements; ++i) {
+    if (input[i].first != timestep || input[i].second != point) {
+      return i;
+    }
+  }
+  return n_elements;
+}
+
 #define MAGIC_VALUE UINT64_C(0x5C4A7C8B) // can you read it? it says "SCRATCHB" (kinda)
 
+// Checks the elements of input that the validation mode covers.
+static void validate_input(const TaskGraph &graph, const std::pair<long, long> *input, size_t n_elements,
+                           long timestep, long point, size_t idx, long dep_timestep, long dep)
+{
+  if (graph.validation == ValidationType::FULL_VALIDATION) {
+    size_t i = find_mismatch(input, n_elements, dep_timestep, dep);
+    if (i < n_elements) {
+      validate_element(graph, input, i, timestep, point, idx, dep_timestep, dep);
+    }
+  } else {
+    size_t stride = validation_stride(graph.validation, n_elements);
+    for (size_t i = 0; i < n_elements; i += stride) {
+      validate_element(graph, input, i, timestep, point, idx, dep_timestep, dep);
+    }
+    if ((n_elements - 1) % stride != 0) {
+      validate_element(graph, input, n_elements - 1, timestep, point, idx, dep_timestep, dep);
+    }
+  }
+}
+
+// Child graphs by graph_index, read-only after App::App.
+static std::vector<TaskGraph> nested_graphs;
+
+TaskGraph TaskGraph::child_instance(long timestep, long point) const
+{
+  assert(child > 0 && child < (long)nested_graphs.size());
+  assert(0 <= timestep && timestep < timesteps);
+  assert(0 <= point && point < max_width);
+  TaskGraph result = nested_graphs[child];
+  result.instance = 1 + (instance * timesteps + timestep) * max_width + point;
+  return result;
+}
+
+// Buffers of run_instance for one child graph on one thread, reused by
+// every instance it runs so that parent tasks allocate nothing once the
+// rows have grown to the largest outputs.
+struct InstanceBuffers {
+  char *scratch_ptr;
+  std::vector<std::vector<char> > outputs, last_outputs;
+  std::vector<const char *> input_ptr, child_ptr;
+  std::vector<size_t> input_bytes, child_bytes;
+
+  explicit InstanceBuffers(const TaskGraph &graph)
+    : scratch_ptr(TaskGraph::allocate_scratch(graph.scratch_bytes_per_task, 1, -1))
+    , outputs(graph.max_width)
+    , last_outputs(graph.max_width)
+  {
+  }
+  ~InstanceBuffers() { TaskGraph::free_scratch(scratch_ptr); }
+  InstanceBuffers(const InstanceBuffers &) = delete;
+  InstanceBuffers &operator=(const InstanceBuffers &) = delete;
+};
+
+// By graph_index, so that nested children keep buffers of their own.
+static thread_local std::map<long, std::unique_ptr<InstanceBuffers> > instance_buffers;
+
+static InstanceBuffers &buffers_for_instance(const TaskGraph &graph)
+{
+  auto &buffers = instance_buffers[graph.graph_index];
+  if (!buffers) {
+    buffers.reset(new InstanceBuffers(graph));
+  }
+  return *buffers;
+}
+
+// Runs every task of a child instance on the calling thread, keeping the
+// outputs of the last two timesteps. Leaves the outputs of the last
+// timestep in buffers.outputs, indexed by point.
+static void run_instance(const TaskGraph &graph, InstanceBuffers &buffers)
+{
+  std::vector<std::vector<char> > &outputs = buffers.outputs;
+  std::vector<std::vector<char> > &last_outputs = buffers.last_outputs;
+  char *scratch_ptr = buffers.scratch_ptr;
+  std::vector<const char *> &input_ptr = buffers.input_ptr;
+  std::vector<size_t> &input_bytes = buffers.input_bytes;
+  for (long t = 0; t < graph.timesteps; ++t) {
+    std::swap(outputs, last_outputs);
+    long offset = graph.offset_at_timestep(t);
+    long width = graph.width_at_timestep(t);
+    long last_offset = graph.offset_at_timestep(t-1);
+    long last_width = graph.width_at_timestep(t-1);
+    long dset = graph.dependence_set_at_timestep(t);
+    for (long point = offset; point < offset + width; ++point) {
+      input_ptr.clear();
+      input_bytes.clear();
+      graph.for_each_dependency_point(dset, point, [&](long dp) {
+        if (last_offset <= dp && dp < last_offset + last_width) {
+          input_ptr.push_back(last_outputs[dp].data());
+          input_bytes.push_back(last_outputs[dp].size());
+        }
+      });
+      outputs[point].resize(graph.output_bytes_at(t, point));
+      graph.execute_point(t, point, outputs[point].data(), outputs[point].size(),
+                          input_ptr.data(), input_bytes.data(), input_ptr.size(),
+                          scratch_ptr, graph.scratch_bytes_per_task);
+    }
+  }
+}
+
 void TaskGraph::execute_point(long timestep, long point,
                               char *output_ptr, size_t output_bytes,
                               const char **input_ptr, const size_t *input_bytes,
                               size_t n_inputs,
                               char *scratch_ptr, size_t scratch_bytes) const
 {
+  if (!child) {
+    execute_task(timestep, point, output_ptr, output_bytes, input_ptr, input_bytes, n_inputs,
+                 NULL, NULL, 0, scratch_ptr, scratch_bytes);
+    return;
+  }
+
+  TaskGraph instance_graph = child_instance(timestep, point);
+  InstanceBuffers &buffers = buffers_for_instance(instance_graph);
+  run_instance(instance_graph, buffers);
+  const std::vector<std::vector<char> > &outputs = buffers.outputs;
+  long last = instance_graph.timesteps - 1;
+  long offset = instance_graph.offset_at_timestep(last);
+  long width = instance_graph.width_at_timestep(last);
+  std::vector<const char *> &child_ptr = buffers.child_ptr;
+  std::vector<size_t> &child_bytes = buffers.child_bytes;
+  child_ptr.resize(width);
+  child_bytes.resize(width);
+  for (long i = 0; i < width; ++i) {
+    child_ptr[i] = outputs[offset + i].data();
+    child_bytes[i] = outputs[offset + i].size();
+  }
+  execute_task(timestep, point, output_ptr, output_bytes, input_ptr, input_bytes, n_inputs,
+               child_ptr.data(), child_bytes.data(), width, scratch_ptr, scratch_bytes);
+}
+
+void TaskGraph::execute_parent_point(long timestep, long point,
+                                     char *output_ptr, size_t output_bytes,
+                                     const char **input_ptr, const size_t *input_bytes,
+                                     size_t n_inputs,
+                                     const char **child_ptr, const size_t *child_bytes,
+                                     size_t n_child_outputs,
+                                     char *scratch_ptr, size_t scratch_bytes) const
+{
+  assert(child);
+  execute_task(timestep, point, output_ptr, output_bytes, input_ptr, input_bytes, n_inputs,
+               child_ptr, child_bytes, n_child_outputs, scratch_ptr, scratch_bytes);
+}
+
+void TaskGraph::execute_task(long timestep, long point,
+                             char *output_ptr, size_t output_bytes,
+                             const char **input_ptr, const size_t *input_bytes,
+                             size_t n_inputs,
+                             const char **child_ptr, const size_t *child_bytes,
+                             size_t n_child_outputs,
+                             char *scratch_ptr, size_t scratch_bytes) const
+{
+  bool timed = record_task_latency || trace_enabled() || utilization_enabled();
+  double start_time = timed ? Timer::get_cur_time() : 0.0;
+  bool open_loop = arrival_rate != 0 && arrivals_started && instance == 0;
+
 #ifdef DEBUG_CORE
   // Validate graph_index
   assert(graph_index >= 0 && graph_index < sizeof(TaskGraphMask)*8);
@@ -591,51 +1889,25 @@ void TaskGraph::execute_point(long timestep, long point,
   long width = width_at_timestep(timestep);
   assert(offset <= point && point < offset+width);
 
-  long last_offset = offset_at_timestep(timestep-1);
-  long last_width = width_at_timestep(timestep-1);
+  validate_inputs(timestep, point, input_ptr, input_bytes, n_inputs);
+  if (transfer_enabled()) {
+    transfer_record(graph_index, input_bytes, n_inputs);
+  }
 
-  // Validate input
-  {
-    size_t idx = 0;
-    long dset = dependence_set_at_timestep(timestep);
-    size_t max_deps = num_dependencies(dset, point);
-    std::pair<long, long> *deps = reinterpret_cast<std::pair<long, long> *>(alloca(sizeof(std::pair<long, long>) * max_deps));
-    size_t num_deps = dependencies(dset, point, deps);
-    for (size_t span = 0; span < num_deps; span++) {
-      for (long dep = deps[span].first; dep <= deps[span].second; dep++) {
-        if (last_offset <= dep && dep < last_offset + last_width) {
-          assert(idx < n_inputs);
-
-          //assert(input_bytes[idx] == output_bytes_size[timestep][point]);//output_bytes_per_task);
-	  //printf("input_bytes[%d], %ld / %ld\n",idx, input_bytes[idx],sizeof(std::pair<long,long>));
-          assert(input_bytes[idx] >= sizeof(std::pair<long, long>));
-
-          const std::pair<long, long> *input = reinterpret_cast<const std::pair<long, long> *>(input_ptr[idx]);
-	  //printf("input_ptr[%d]: %s\n", idx, *input_ptr[idx]);
-	  //printf("output_ptr[%d]: %s\n", idx, output_ptr);
-	  //printf("input_bytes[%d]: %ld/%ld\n", idx, input_bytes[idx],sizeof(std::pair<long,long>));
-          for (size_t i = 0; i < input_bytes[idx]/sizeof(std::pair<long, long>); ++i) {
-//#ifdef DEBUG_CORE
-            if (input[i].first != timestep - 1 || input[i].second != dep) {
-              printf("ERROR: Task Bench detected corrupted value in task (graph %ld timestep %ld point %ld) input %ld\n  At position %lu within the buffer, expected value (timestep %ld point %ld) but got (timestep %ld point %ld)\n",
-                     graph_index, timestep, point, idx,
-                     i, timestep - 1, dep, input[i].first, input[i].second);
-              fflush(stdout);
-            }
-//#endif
-	    //printf("input[%d]\n", i);
-	    //printf("timestep-1 %ld input.first %ld\n", timestep-1, input[i].first);
-	    //printf("dep %ld, input.second %ld\n", dep, input[i].second);
-            assert(input[i].first == timestep - 1);
-            assert(input[i].second == dep);
-          }
-          idx++;
-        }
+  // Validate the last timestep of the child instance of this task
+  if (child) {
+    TaskGraph instance_graph = child_instance(timestep, point);
+    long last = instance_graph.timesteps - 1;
+    long child_offset = instance_graph.offset_at_timestep(last);
+    assert(n_child_outputs == (size_t)instance_graph.width_at_timestep(last));
+    if (validation != ValidationType::NO_VALIDATION) {
+      for (size_t i = 0; i < n_child_outputs; ++i) {
+        assert(child_bytes[i] >= sizeof(std::pair<long, long>));
+        const std::pair<long, long> *child_output = reinterpret_cast<const std::pair<long, long> *>(child_ptr[i]);
+        validate_input(*this, child_output, child_bytes[i]/sizeof(std::pair<long, long>), timestep, point,
+                       n_inputs + i, stored_timestep(instance_graph, last), child_offset + i);
       }
     }
-    // FIXME (Elliott): Legion is currently passing in uninitialized
-    // memory for dependencies outside of the last offset/width.
-    // assert(idx == n_inputs);
   }
 
   // Validate output
@@ -647,9 +1919,24 @@ void TaskGraph::execute_point(long timestep, long point,
 
   // Generate output
   std::pair<long, long> *output = reinterpret_cast<std::pair<long, long> *>(output_ptr);
-  for (size_t i = 0; i < output_bytes/sizeof(std::pair<long, long>); ++i) {
-    output[i].first = timestep;
-    output[i].second = point;
+  size_t n_elements = output_bytes/sizeof(std::pair<long, long>);
+  long output_timestep = stored_timestep(*this, timestep);
+  if (validation == ValidationType::FULL_VALIDATION) {
+    fill_elements(output, n_elements, output_timestep, point);
+  } else {
+    if (validation == ValidationType::NO_VALIDATION) {
+      // Only the header is written, consumers do not check the rest.
+      n_elements = 1;
+    }
+    size_t stride = validation_stride(validation, n_elements);
+    for (size_t i = 0; i < n_elements; i += stride) {
+      output[i].first = output_timestep;
+      output[i].second = point;
+    }
+    if ((n_elements - 1) % stride != 0) {
+      output[n_elements - 1].first = output_timestep;
+      output[n_elements - 1].second = point;
+    }
   }
 
   // Validate scratch
@@ -661,9 +1948,90 @@ void TaskGraph::execute_point(long timestep, long point,
 
   // Execute kernel
   Kernel k(kernel);
-  k.execute(graph_index, timestep, point, scratch_ptr, scratch_bytes);
+  if (dependence == DependenceType::GRAPH_FILE) {
+    const GraphFile *file = graph_file(graph_index);
+    k.iterations = file->iterations[file->task(timestep, point)];
+  }
+  bool counted = counters_enabled();
+  CounterSample counters_begin;
+  if (counted) {
+    counters_read(counters_begin);
+  }
+  double kernel_start = noise_enabled() ? Timer::get_cur_time() : 0.0;
+  kernel_function(k, graph_index)(k, graph_index, timestep, point, scratch_ptr, scratch_bytes);
+  if (counted) {
+    CounterSample counters_end;
+    counters_read(counters_end);
+    counters_accumulate(counters_begin, counters_end);
+  }
+  // After the counters, so that they do not count the injected spin.
+  if (noise_enabled()) {
+    noise_apply(kernel_start);
+  }
+
+  bool last = instance == 0 && timestep == timesteps - 1;
+  if (timed || last || open_loop) {
+    double end_time = Timer::get_cur_time();
+    if (record_task_latency) {
+      latency_record(graph_index, (uint64_t)((end_time - start_time) * 1e9));
+    }
+    if (trace_enabled()) {
+      trace_record(graph_index, timestep, point, start_time, end_time);
+    }
+    if (utilization_enabled()) {
+      utilization_record(start_time, end_time);
+    }
+    if (last) {
+      record_completion(graph_index, end_time);
+    }
+    if (open_loop) {
+      double response = end_time - (arrival_start + release_time(timestep));
+      latency_record(graph_index, (uint64_t)(std::max(0.0, response) * 1e9), LatencyKind::RESPONSE);
+    }
+  }
+}
+
+void TaskGraph::validate_inputs(long timestep, long point,
+                                const char **input_ptr, const size_t *input_bytes,
+                                size_t n_inputs) const
+{
+  if (validation == ValidationType::NO_VALIDATION) {
+    return;
+  }
+
+  long last_offset = offset_at_timestep(timestep-1);
+  long last_width = width_at_timestep(timestep-1);
+
+  size_t idx = 0;
+  long dset = dependence_set_at_timestep(timestep);
+  for_each_dependency_point(dset, point, [&](long dep) {
+    if (last_offset <= dep && dep < last_offset + last_width) {
+      assert(idx < n_inputs);
+
+      //assert(input_bytes[idx] == output_bytes_size[timestep][point]);//output_bytes_per_task);
+      assert(input_bytes[idx] >= sizeof(std::pair<long, long>));
+
+      const std::pair<long, long> *input = reinterpret_cast<const std::pair<long, long> *>(input_ptr[idx]);
+      size_t n_elements = input_bytes[idx]/sizeof(std::pair<long, long>);
+      validate_input(*this, input, n_elements, timestep, point, idx,
+                     stored_timestep(*this, timestep - 1), dep);
+      idx++;
+    }
+  });
+  // FIXME (Elliott): Legion is currently passing in uninitialized
+  // memory for dependencies outside of the last offset/width.
+  // assert(idx == n_inputs);
 }
 
+// Whether some graph (or child) of the App runs memory_chase, set by
+// App::App. Only then is the (random access) pointer chase built.
+static bool scratch_pointer_chase = false;
+
+// Whether some graph (or child) of the App runs io_bound reads, set by
+// App::App. Their extents are written by the first read (io_kernel.h),
+// so timed runs follow an untimed one.
+static bool io_prepare_runs = false;
+
 void TaskGraph::prepare_scratch(char *scratch_ptr, size_t scratch_bytes)
 {
   assert(scratch_bytes % sizeof(uint64_t) == 0);
@@ -671,6 +2039,48 @@ void TaskGraph::prepare_scratch(char *scratch_ptr, size_t scratch_bytes)
   for (long i = 0; i < scratch_bytes/sizeof(uint64_t); ++i) {
     base_ptr[i] = MAGIC_VALUE;
   }
+  // Word 1 of every cache line links the lines for memory_chase.
+  if (scratch_pointer_chase) {
+    prepare_pointer_chase(scratch_ptr, scratch_bytes);
+  }
+}
+
+char *TaskGraph::allocate_scratch(size_t scratch_bytes, long n_tasks, int node)
+{
+  char *scratch_ptr = alloc_buffer(scratch_bytes * n_tasks, node);
+  if (!scratch_ptr) {
+    return NULL;
+  }
+  // Threads spawned here may run on any node, so without a binding the
+  // first touch stays on the calling thread.
+  auto prepare = [&](long chunk, long first, long last) {
+    for (long task = first; task < last; ++task) {
+      prepare_scratch(scratch_ptr + scratch_bytes * task, scratch_bytes);
+    }
+  };
+  if (alloc_numa_enabled() && node >= 0) {
+    parallel_for(n_tasks, prepare);
+  } else {
+    prepare(0, 0, n_tasks);
+  }
+  return scratch_ptr;
+}
+
+void TaskGraph::free_scratch(char *scratch_ptr)
+{
+  free_buffer(scratch_ptr);
+}
+
+bool TaskGraph::measuring_transfer()
+{
+  return transfer_enabled();
+}
+
+void TaskGraph::tag_remote_inputs(const char *remote, size_t n_inputs)
+{
+  if (transfer_enabled()) {
+    transfer_tag_remote(remote, n_inputs);
+  }
 }
 
 static TaskGraph default_graph(long graph_index)
@@ -693,11 +2103,42 @@ static TaskGraph default_graph(long graph_index)
   graph.onormal_std = 2;
   graph.ogamma_alpha = 2;
   graph.ogamma_beta = 2;
+  graph.validation = ValidationType::FULL_VALIDATION;
+  std::fill(graph.dims, graph.dims + 3, 0L);
+  graph.child = 0;
+  graph.instance = 0;
+  graph.priority = 0;
+  graph.weight = 0;
+  graph.arrival_rate = 0;
+  graph.arrival = ArrivalType::ARRIVAL_FIXED;
   //vector<vector<size_t>>* graph.output_bytes;
 
   return graph;
 }
 
+// Defaults that depend on the other flags of the graph.
+static void finish_graph(TaskGraph &graph, bool radix_given)
+{
+  // Hack: set default value of period for random graph
+  if (graph.period < 0) {
+    if (is_elastic(graph.dependence)) {
+      graph.period = needs_period(graph.dependence) ? elastic_default_period(graph) : 0;
+    } else {
+      graph.period = needs_period(graph.dependence) ? 3 : 0;
+    }
+  }
+  if (is_grid_stencil(graph.dependence)) {
+    if (!radix_given) {
+      graph.radix = graph.dependence == DependenceType::STENCIL_3D ? 7 : 5;
+    }
+    if (graph.dims[0] == 0) {
+      long grid[3];
+      stencil_grid(graph, grid);
+      std::copy(grid, grid + grid_rank(graph.dependence), graph.dims);
+    }
+  }
+}
+
 static void needs_argument(int i, int argc, const char *flag) {
   if (i+1 >= argc) {
     fprintf(stderr, "error: Flag \"%s\" requires an argument\n", flag);
@@ -711,7 +2152,14 @@ static void needs_argument(int i, int argc, const char *flag) {
 #define RADIX_FLAG "-radix"
 #define PERIOD_FLAG "-period"
 #define FRACTION_FLAG "-fraction"
+#define DIMS_FLAG "-dims"
+#define GRAPH_FILE_FLAG "-graph-file"
 #define AND_FLAG "-and"
+#define CHILD_FLAG "-child"
+#define PRIORITY_FLAG "-priority"
+#define WEIGHT_FLAG "-weight"
+#define ARRIVAL_RATE_FLAG "-arrival-rate"
+#define ARRIVAL_FLAG "-arrival"
 
 #define KERNEL_FLAG "-kernel"
 #define ITER_FLAG "-iter"
@@ -721,6 +2169,12 @@ static void needs_argument(int i, int argc, const char *flag) {
 #define IMBALANCE_FLAG "-imbalance"
 #define MEM_FRAC_FLAG "-mem-fraction"
 #define DIST_FLAG "-dist"
+#define STRIDE_FLAG "-stride"
+#define IO_MODE_FLAG "-io-mode"
+#define IO_WRITE_FLAG "-io-write"
+#define IO_BLOCK_FLAG "-io-block"
+#define IO_DEPTH_FLAG "-io-depth"
+#define TASK_THREADS_FLAG "-task-threads"
 
 // distribution flags. All accept same datatype as result, which is a long
 #define DIST_MAX_FLAG "-dist-max" // for uniform
@@ -729,25 +2183,56 @@ static void needs_argument(int i, int argc, const char *flag) {
 #define DIST_ALPHA_FLAG "-dist-alpha" // for gamma
 
 #define NODES_FLAG "-nodes"
+#define WORKERS_FLAG "-workers"
 #define SKIP_GRAPH_VALIDATION_FLAG "-skip-graph-validation"
+#define VALIDATE_FLAG "-validate"
+#define TIMER_FLAG "-timer"
+#define LATENCY_FLAG "-latency"
+#define COUNTERS_FLAG "-counters"
+#define UTILIZATION_FLAG "-utilization"
+#define MEMORY_FLAG "-memory"
+#define MEASURE_TRANSFER_FLAG "-measure-transfer"
+#define MEMORY_PERIOD_FLAG "-memory-period"
+#define TRACE_FLAG "-trace"
+#define REPORT_FLAG "-report"
+#define IO_FILE_FLAG "-io-file"
+#define HUGE_PAGES_FLAG "-huge-pages"
+#define NUMA_FLAG "-numa"
+#define PLACEMENT_FLAG "-placement"
+#define PLACEMENT_BLOCK_FLAG "-placement-block"
+#define NOISE_FREQUENCY_FLAG "-noise-frequency"
+#define NOISE_DURATION_FLAG "-noise-duration"
+#define SLOW_WORKERS_FLAG "-slow-workers"
+#define SLOW_RANKS_FLAG "-slow-ranks"
+#define SLOW_FACTOR_FLAG "-slow-factor"
+#define NOISE_SEED_FLAG "-noise-seed"
+#define NOISE_DEFAULT_SLOW_FACTOR 2.0
 #define FIELD_FLAG "-field"
+#define METG_FLAG "-metg"
+#define METG_EFFICIENCY_FLAG "-metg-efficiency"
+#define WARMUP_FLAG "-warmup"
+#define REPS_FLAG "-reps"
 
 #define ODIST_FLAG "-output-dist"
 #define ONORMAL_MEAN_FLAG "-output-mean"
 #define ONORMAL_STD_FLAG "-output-std"
-#define ONORMAL_RANDOM_FLAG "-output-random"
-#define OUNIFORM_FLAG "-output-uniform"
 #define OGAMMA_ALPHA_FLAG "-output-gamma-a"
 #define OGAMMA_BETA_FLAG "-output-gamma-b"
 #define OCASE_FLAG "-output-case"
 
 
+#define METG_DEFAULT_EFFICIENCY 0.5
+#define METG_BISECTION_STEPS 6
+#define MEMORY_DEFAULT_PERIOD 0.01
+
 static void show_help_message(int argc, char **argv) {
   printf("%s: A Task Benchmark\n", argc > 0 ? argv[0] : "task_bench");
 
   printf("\nGeneral options:\n");
   printf("  %-18s show this help message and exit\n", "-h");
   printf("  %-18s number of nodes to use for estimating transfer statistics\n", NODES_FLAG);
+  printf("  %-18s number of workers of the ideal makespan (default: hardware threads\n"
+         "  %-18s times nodes)\n", WORKERS_FLAG " [INT]", "");
   printf("  %-18s enable verbose output\n", "-v");
   printf("  %-18s enable extra verbose output\n", "-vv");
 
@@ -755,20 +2240,44 @@ static void show_help_message(int argc, char **argv) {
   printf("  %-18s height of task graph\n", STEPS_FLAG " [INT]");
   printf("  %-18s width of task graph\n", WIDTH_FLAG " [INT]");
   printf("  %-18s dependency pattern (see available list below)\n", TYPE_FLAG " [DEP]");
-  printf("  %-18s radix of dependency pattern (only for nearest, spread, and random)\n", RADIX_FLAG " [INT]");
-  printf("  %-18s period of dependency pattern (only for spread and random)\n", PERIOD_FLAG " [INT]");
+  printf("  %-18s radix of dependency pattern (only for nearest, spread, and random;\n"
+         "  %-18s for stencil_2d/3d the points of the stencil: 5 or 9, 7 or 27)\n", RADIX_FLAG " [INT]", "");
+  printf("  %-18s period of dependency pattern (only for spread, random and elastic)\n", PERIOD_FLAG " [INT]");
   printf("  %-18s fraction of connected dependencies (only for random)\n", FRACTION_FLAG " [FLOAT]");
+  printf("  %-18s grid of points, e.g. 16,8 (only for stencil_2d/3d; sets width)\n", DIMS_FLAG " [X,Y[,Z]]");
+  printf("  %-18s load the graph from a file (see scripts/graph_import.py; sets\n"
+         "  %-18s type graph_file, steps, width and per-task iterations and output)\n", GRAPH_FILE_FLAG " [FILE]", "");
   printf("  %-18s start configuring next task graph\n", AND_FLAG);
+  printf("  %-18s start configuring the graph that each task of this one expands into\n", CHILD_FLAG);
+  printf("  %-18s priority of the tasks of this graph where the runtime supports it\n"
+         "  %-18s (default 0; OpenMP caps it at OMP_MAX_TASK_PRIORITY)\n", PRIORITY_FLAG " [INT]", "");
+  printf("  %-18s relative rate at which this graph is issued when interleaved with\n"
+         "  %-18s others (default: graphs are issued one after another)\n", WEIGHT_FLAG " [FLOAT]", "");
+  printf("  %-18s release timesteps at this rate per second and report task response\n"
+         "  %-18s times (default 0: all timesteps are available at once)\n", ARRIVAL_RATE_FLAG " [FLOAT]", "");
+  printf("  %-18s gaps between releases: fixed or poisson (default fixed)\n", ARRIVAL_FLAG " [TYPE]");
 
   printf("\nOptions for configuring kernels:\n");
   printf("  %-18s kernel type (see available list below)\n", KERNEL_FLAG " [KERNEL]");
   printf("  %-18s number of iterations\n", ITER_FLAG " [INT]");
-  printf("  %-18s output bytes per task\n", OUTPUT_FLAG " [INT]");
+  printf("  %-18s output bytes per task (the mean with " ODIST_FLAG ")\n", OUTPUT_FLAG " [INT]");
+  printf("  %-18s distribution of output sizes over the points of each timestep:\n"
+         "  %-18s none, normal, normal_random or gamma (default none)\n", ODIST_FLAG " [DIST]", "");
+  printf("  %-18s mean and standard deviation in points (only for normal)\n",
+         ONORMAL_MEAN_FLAG "/" ONORMAL_STD_FLAG);
+  printf("  %-18s shape and scale in points (only for gamma)\n",
+         OGAMMA_ALPHA_FLAG "/" OGAMMA_BETA_FLAG);
   printf("  %-18s scratch bytes per task (only for memory-bound kernel)\n", SCRATCH_FLAG " [INT]");
   printf("  %-18s number of samples (only for memory-bound kernel)\n", SAMPLE_FLAG " [INT]");
   printf("  %-18s amount of load imbalance\n", IMBALANCE_FLAG " [FLOAT]");
   printf("  %-18s fraction of memory iterations (only for memory-and-compute\n", MEM_FRAC_FLAG " [FLOAT]");
   printf("  %-18s distribution type (see available list below)\n", DIST_FLAG " [DIST]");
+  printf("  %-18s bytes between loads (only for memory_strided)\n", STRIDE_FLAG " [INT]");
+  printf("  %-18s I/O mode: sync, direct or uring (only for io_bound, default sync)\n", IO_MODE_FLAG " [MODE]");
+  printf("  %-18s write task extents instead of reading them (only for io_bound)\n", IO_WRITE_FLAG);
+  printf("  %-18s bytes per I/O request (only for io_bound, default %d)\n", IO_BLOCK_FLAG " [INT]", IO_DEFAULT_BLOCK);
+  printf("  %-18s requests in flight per task (only for uring, default %d)\n", IO_DEPTH_FLAG " [INT]", IO_DEFAULT_DEPTH);
+  printf("  %-18s threads that share each task (default 1)\n", TASK_THREADS_FLAG " [INT]");
 
   printf("\nSupported dependency patterns:\n");
   for (auto dtype : dtype_by_name) {
@@ -794,14 +2303,69 @@ static void show_help_message(int argc, char **argv) {
   printf("\nLess frequently used options:\n");
   printf("  %-18s number of fields (optimization for certain task bench implementations)\n", FIELD_FLAG " [INT]");
   printf("  %-18s skip task graph validation\n", SKIP_GRAPH_VALIDATION_FLAG);
+  printf("  %-18s task input/output validation: full, sample or none (default full)\n", VALIDATE_FLAG " [MODE]");
+  printf("  %-18s clock source: monotonic or tsc (default monotonic)\n", TIMER_FLAG " [CLOCK]");
+  printf("  %-18s report per-task latency percentiles (of this process)\n", LATENCY_FLAG);
+  printf("  %-18s count cycles, instructions and LLC misses of kernels (of this process)\n", COUNTERS_FLAG);
+  printf("  %-18s report busy time and gaps between tasks of each thread (of this process)\n", UTILIZATION_FLAG);
+  printf("  %-18s sample resident memory in the background and report peak and runtime overhead\n", MEMORY_FLAG);
+  printf("  %-18s sampling period of " MEMORY_FLAG " in milliseconds (default %.0f)\n", MEMORY_PERIOD_FLAG " [FLOAT]",
+         MEMORY_DEFAULT_PERIOD * 1e3);
+  printf("  %-18s count the dependencies and input bytes of tasks (of this process)\n", MEASURE_TRANSFER_FLAG);
+  printf("  %-18s write a task timeline at exit (Chrome JSON, or raw if FILE ends in .bin; %%p expands to pid)\n", TRACE_FLAG " [FILE]");
+  printf("  %-18s append one record per run and per graph to FILE (json or csv)\n", REPORT_FLAG " [FMT] [FILE]");
+  printf("  %-18s prefix of io_bound files (default task_bench_io)\n", IO_FILE_FLAG " [PATH]");
+  printf("  %-18s page size of scratch buffers: none, thp or hugetlb (default none)\n", HUGE_PAGES_FLAG " [MODE]");
+  printf("  %-18s bind scratch buffers to the NUMA node of their worker\n", NUMA_FLAG);
+  printf("  %-18s points on ranks: block, cyclic, block_cyclic or greedy (default block)\n", PLACEMENT_FLAG " [TYPE]");
+  printf("  %-18s points per block of block_cyclic placement (default %d)\n", PLACEMENT_BLOCK_FLAG " [INT]",
+         PLACEMENT_DEFAULT_BLOCK);
+  printf("  %-18s interrupt each thread this many times per second of kernel time\n", NOISE_FREQUENCY_FLAG " [FLOAT]");
+  printf("  %-18s seconds per interruption of " NOISE_FREQUENCY_FLAG "\n", NOISE_DURATION_FLAG " [FLOAT]");
+  printf("  %-18s fraction of threads whose kernels are " SLOW_FACTOR_FLAG " times slower\n", SLOW_WORKERS_FLAG " [FLOAT]");
+  printf("  %-18s fraction of ranks (processes) all of whose threads are slow\n", SLOW_RANKS_FLAG " [FLOAT]");
+  printf("  %-18s slowdown of slow threads (default %.1f)\n", SLOW_FACTOR_FLAG " [FLOAT]",
+         NOISE_DEFAULT_SLOW_FACTOR);
+  printf("  %-18s seed of the interruption phases and slow threads and ranks (default 0)\n", NOISE_SEED_FLAG " [INT]");
+  printf("  %-18s search for the minimum effective task granularity by rerunning with\n"
+         "  %-18s fewer iterations (where the implementation supports it)\n", METG_FLAG, "");
+  printf("  %-18s efficiency threshold of " METG_FLAG " (default %.1f)\n", METG_EFFICIENCY_FLAG " [FLOAT]",
+         METG_DEFAULT_EFFICIENCY);
+  printf("  %-18s untimed runs before the timed ones (default depends on the implementation)\n",
+         WARMUP_FLAG " [INT]");
+  printf("  %-18s timed runs, reported as the median with statistics (default 1)\n", REPS_FLAG " [INT]");
+}
+
+// Top-level graphs followed by child graphs, which is graph_index order.
+static std::vector<TaskGraph> graphs_and_children(const App &app)
+{
+  std::vector<TaskGraph> all(app.graphs);
+  all.insert(all.end(), app.child_graphs.begin(), app.child_graphs.end());
+  return all;
 }
 
 App::App(int argc, char **argv)
   : nodes(0)
+  , workers(0)
   , verbose(0)
   , enable_graph_validation(true)
+  , metg(false)
+  , metg_efficiency(METG_DEFAULT_EFFICIENCY)
+  , warmup(-1)
+  , reps(1)
 {
   TaskGraph graph = default_graph(graphs.size());
+  ValidationType validation = ValidationType::FULL_VALIDATION;
+  bool radix_given = false;
+  bool sample_memory = false;
+  double memory_period = MEMORY_DEFAULT_PERIOD;
+  NoiseConfig noise = {0, 0, 0, 0, NOISE_DEFAULT_SLOW_FACTOR, 0};
+  // Position of the parent of each parsed graph (-1: top level).
+  std::vector<long> parents;
+  long parent = -1;
+  // Graph file of each parsed graph (empty: none).
+  std::vector<std::string> graph_paths;
+  std::string graph_path;
 
   // Parse command line
   for (int i = 1; i < argc; i++) {
@@ -820,6 +2384,16 @@ App::App(int argc, char **argv)
       nodes = value;
     }
 
+    if (!strcmp(argv[i], WORKERS_FLAG)) {
+      needs_argument(i, argc, WORKERS_FLAG);
+      long value = atol(argv[++i]);
+      if (value <= 0) {
+        fprintf(stderr, "error: Invalid flag \"" WORKERS_FLAG " %ld\" must be > 0\n", value);
+        abort();
+      }
+      workers = value;
+    }
+
     if (!strcmp(argv[i], "-v")) {
       verbose++;
     }
@@ -832,28 +2406,229 @@ App::App(int argc, char **argv)
       enable_graph_validation = false;
     }
 
-    if (!strcmp(argv[i], STEPS_FLAG)) {
-      needs_argument(i, argc, STEPS_FLAG);
-      long value = atol(argv[++i]);
-      if (value <= 0) {
-        fprintf(stderr, "error: Invalid flag \"" STEPS_FLAG " %ld\" must be > 0\n", value);
+    if (!strcmp(argv[i], VALIDATE_FLAG)) {
+      needs_argument(i, argc, VALIDATE_FLAG);
+      auto name = argv[++i];
+      auto type = vtype_by_name.find(name);
+      if (type == vtype_by_name.end()) {
+        fprintf(stderr, "error: Invalid flag \"" VALIDATE_FLAG " %s\"\n", name);
         abort();
       }
-      graph.timesteps = value;
+      validation = type->second;
     }
 
-    if (!strcmp(argv[i], WIDTH_FLAG)) {
-      needs_argument(i, argc, WIDTH_FLAG);
-      long value = atol(argv[++i]);
-      if (value <= 0) {
-        fprintf(stderr, "error: Invalid flag \"" WIDTH_FLAG " %ld\" must be > 0\n", value);
-        abort();
-      }
-      graph.max_width = value;
+    if (!strcmp(argv[i], LATENCY_FLAG)) {
+      record_task_latency = true;
     }
 
-    if (!strcmp(argv[i], TYPE_FLAG)) {
-      needs_argument(i, argc, TYPE_FLAG);
+    if (!strcmp(argv[i], COUNTERS_FLAG)) {
+      counters_enable();
+    }
+
+    if (!strcmp(argv[i], UTILIZATION_FLAG)) {
+      utilization_enable();
+    }
+
+    if (!strcmp(argv[i], MEMORY_FLAG)) {
+      sample_memory = true;
+    }
+
+    if (!strcmp(argv[i], MEASURE_TRANSFER_FLAG)) {
+      transfer_enable();
+    }
+
+    if (!strcmp(argv[i], MEMORY_PERIOD_FLAG)) {
+      needs_argument(i, argc, MEMORY_PERIOD_FLAG);
+      double value = atof(argv[++i]);
+      if (value <= 0) {
+        fprintf(stderr, "error: Invalid flag \"" MEMORY_PERIOD_FLAG " %f\" must be > 0\n", value);
+        abort();
+      }
+      memory_period = value / 1e3;
+    }
+
+    if (!strcmp(argv[i], TRACE_FLAG)) {
+      needs_argument(i, argc, TRACE_FLAG);
+      trace_open(argv[++i]);
+    }
+
+    if (!strcmp(argv[i], REPORT_FLAG)) {
+      needs_argument(i, argc, REPORT_FLAG);
+      auto name = argv[++i];
+      ReportFormat format;
+      if (!report_format_by_name(name, format)) {
+        fprintf(stderr, "error: Invalid flag \"" REPORT_FLAG " %s\"\n", name);
+        abort();
+      }
+      needs_argument(i, argc, REPORT_FLAG);
+      report_open(format, argv[++i]);
+    }
+
+    if (!strcmp(argv[i], IO_FILE_FLAG)) {
+      needs_argument(i, argc, IO_FILE_FLAG);
+      io_kernel_set_prefix(argv[++i]);
+    }
+
+    if (!strcmp(argv[i], HUGE_PAGES_FLAG)) {
+      needs_argument(i, argc, HUGE_PAGES_FLAG);
+      auto name = argv[++i];
+      auto mode = huge_page_mode_by_name.find(name);
+      if (mode == huge_page_mode_by_name.end()) {
+        fprintf(stderr, "error: Invalid flag \"" HUGE_PAGES_FLAG " %s\"\n", name);
+        abort();
+      }
+      alloc_set_huge_pages(mode->second);
+    }
+
+    if (!strcmp(argv[i], NUMA_FLAG)) {
+      alloc_set_numa(true);
+    }
+
+    if (!strcmp(argv[i], PLACEMENT_FLAG)) {
+      needs_argument(i, argc, PLACEMENT_FLAG);
+      auto name = argv[++i];
+      PlacementType type;
+      if (!placement_by_name(name, type)) {
+        fprintf(stderr, "error: Invalid flag \"" PLACEMENT_FLAG " %s\"\n", name);
+        abort();
+      }
+      placement_set(type, placement_block_size());
+    }
+
+    if (!strcmp(argv[i], PLACEMENT_BLOCK_FLAG)) {
+      needs_argument(i, argc, PLACEMENT_BLOCK_FLAG);
+      long value = atol(argv[++i]);
+      if (value < 1) {
+        fprintf(stderr, "error: Invalid flag \"" PLACEMENT_BLOCK_FLAG " %ld\" must be >= 1\n", value);
+        abort();
+      }
+      placement_set(placement_type(), value);
+    }
+
+    if (!strcmp(argv[i], NOISE_FREQUENCY_FLAG)) {
+      needs_argument(i, argc, NOISE_FREQUENCY_FLAG);
+      double value = atof(argv[++i]);
+      if (value < 0) {
+        fprintf(stderr, "error: Invalid flag \"" NOISE_FREQUENCY_FLAG " %f\" must be >= 0\n", value);
+        abort();
+      }
+      noise.frequency = value;
+    }
+
+    if (!strcmp(argv[i], NOISE_DURATION_FLAG)) {
+      needs_argument(i, argc, NOISE_DURATION_FLAG);
+      double value = atof(argv[++i]);
+      if (value < 0) {
+        fprintf(stderr, "error: Invalid flag \"" NOISE_DURATION_FLAG " %f\" must be >= 0\n", value);
+        abort();
+      }
+      noise.duration = value;
+    }
+
+    if (!strcmp(argv[i], SLOW_WORKERS_FLAG)) {
+      needs_argument(i, argc, SLOW_WORKERS_FLAG);
+      double value = atof(argv[++i]);
+      if (value < 0 || value > 1) {
+        fprintf(stderr, "error: Invalid flag \"" SLOW_WORKERS_FLAG " %f\" must be in [0, 1]\n", value);
+        abort();
+      }
+      noise.slow_threads = value;
+    }
+
+    if (!strcmp(argv[i], SLOW_RANKS_FLAG)) {
+      needs_argument(i, argc, SLOW_RANKS_FLAG);
+      double value = atof(argv[++i]);
+      if (value < 0 || value > 1) {
+        fprintf(stderr, "error: Invalid flag \"" SLOW_RANKS_FLAG " %f\" must be in [0, 1]\n", value);
+        abort();
+      }
+      noise.slow_processes = value;
+    }
+
+    if (!strcmp(argv[i], SLOW_FACTOR_FLAG)) {
+      needs_argument(i, argc, SLOW_FACTOR_FLAG);
+      double value = atof(argv[++i]);
+      if (value < 1) {
+        fprintf(stderr, "error: Invalid flag \"" SLOW_FACTOR_FLAG " %f\" must be >= 1\n", value);
+        abort();
+      }
+      noise.slow_factor = value;
+    }
+
+    if (!strcmp(argv[i], NOISE_SEED_FLAG)) {
+      needs_argument(i, argc, NOISE_SEED_FLAG);
+      noise.seed = atol(argv[++i]);
+    }
+
+    if (!strcmp(argv[i], METG_FLAG)) {
+      metg = true;
+    }
+
+    if (!strcmp(argv[i], METG_EFFICIENCY_FLAG)) {
+      needs_argument(i, argc, METG_EFFICIENCY_FLAG);
+      double value = atof(argv[++i]);
+      if (value <= 0 || value >= 1) {
+        fprintf(stderr, "error: Invalid flag \"" METG_EFFICIENCY_FLAG " %f\" must be in (0, 1)\n", value);
+        abort();
+      }
+      metg_efficiency = value;
+    }
+
+    if (!strcmp(argv[i], WARMUP_FLAG)) {
+      needs_argument(i, argc, WARMUP_FLAG);
+      long value = atol(argv[++i]);
+      if (value < 0) {
+        fprintf(stderr, "error: Invalid flag \"" WARMUP_FLAG " %ld\" must be >= 0\n", value);
+        abort();
+      }
+      warmup = value;
+    }
+
+    if (!strcmp(argv[i], REPS_FLAG)) {
+      needs_argument(i, argc, REPS_FLAG);
+      long value = atol(argv[++i]);
+      if (value < 1) {
+        fprintf(stderr, "error: Invalid flag \"" REPS_FLAG " %ld\" must be >= 1\n", value);
+        abort();
+      }
+      reps = value;
+    }
+
+    if (!strcmp(argv[i], TIMER_FLAG)) {
+      needs_argument(i, argc, TIMER_FLAG);
+      auto name = argv[++i];
+      auto source = timer_source_by_name.find(name);
+      if (source == timer_source_by_name.end()) {
+        fprintf(stderr, "error: Invalid flag \"" TIMER_FLAG " %s\"\n", name);
+        abort();
+      }
+      if (Timer::set_source(source->second) != source->second) {
+        fprintf(stderr, "warning: \"" TIMER_FLAG " %s\" unavailable, using monotonic clock\n", name);
+      }
+    }
+
+    if (!strcmp(argv[i], STEPS_FLAG)) {
+      needs_argument(i, argc, STEPS_FLAG);
+      long value = atol(argv[++i]);
+      if (value <= 0) {
+        fprintf(stderr, "error: Invalid flag \"" STEPS_FLAG " %ld\" must be > 0\n", value);
+        abort();
+      }
+      graph.timesteps = value;
+    }
+
+    if (!strcmp(argv[i], WIDTH_FLAG)) {
+      needs_argument(i, argc, WIDTH_FLAG);
+      long value = atol(argv[++i]);
+      if (value <= 0) {
+        fprintf(stderr, "error: Invalid flag \"" WIDTH_FLAG " %ld\" must be > 0\n", value);
+        abort();
+      }
+      graph.max_width = value;
+    }
+
+    if (!strcmp(argv[i], TYPE_FLAG)) {
+      needs_argument(i, argc, TYPE_FLAG);
       auto name = argv[++i];
       auto type = dtype_by_name.find(name);
       if (type == dtype_by_name.end()) {
@@ -882,6 +2657,20 @@ App::App(int argc, char **argv)
         abort();
       }
       graph.radix = value;
+      radix_given = true;
+    }
+
+    if (!strcmp(argv[i], DIMS_FLAG)) {
+      needs_argument(i, argc, DIMS_FLAG);
+      auto value = argv[++i];
+      long dims[3] = {0, 0, 0};
+      int n = sscanf(value, "%ld,%ld,%ld", &dims[0], &dims[1], &dims[2]);
+      if (n < 2 || dims[0] <= 0 || dims[1] <= 0 || (n == 3 && dims[2] <= 0)) {
+        fprintf(stderr, "error: Invalid flag \"" DIMS_FLAG " %s\" must be two or three positive integers\n", value);
+        abort();
+      }
+      std::copy(dims, dims + 3, graph.dims);
+      graph.max_width = dims[0] * dims[1] * (n == 3 ? dims[2] : 1);
     }
 
     if (!strcmp(argv[i], PERIOD_FLAG)) {
@@ -894,6 +2683,47 @@ App::App(int argc, char **argv)
       graph.period = value;
     }
 
+    if (!strcmp(argv[i], PRIORITY_FLAG)) {
+      needs_argument(i, argc, PRIORITY_FLAG);
+      int value = atoi(argv[++i]);
+      if (value < 0) {
+        fprintf(stderr, "error: Invalid flag \"" PRIORITY_FLAG " %d\" must be >= 0\n", value);
+        abort();
+      }
+      graph.priority = value;
+    }
+
+    if (!strcmp(argv[i], WEIGHT_FLAG)) {
+      needs_argument(i, argc, WEIGHT_FLAG);
+      double value = atof(argv[++i]);
+      if (value <= 0) {
+        fprintf(stderr, "error: Invalid flag \"" WEIGHT_FLAG " %f\" must be > 0\n", value);
+        abort();
+      }
+      graph.weight = value;
+    }
+
+    if (!strcmp(argv[i], ARRIVAL_RATE_FLAG)) {
+      needs_argument(i, argc, ARRIVAL_RATE_FLAG);
+      double value = atof(argv[++i]);
+      if (value < 0) {
+        fprintf(stderr, "error: Invalid flag \"" ARRIVAL_RATE_FLAG " %f\" must be >= 0\n", value);
+        abort();
+      }
+      graph.arrival_rate = value;
+    }
+
+    if (!strcmp(argv[i], ARRIVAL_FLAG)) {
+      needs_argument(i, argc, ARRIVAL_FLAG);
+      auto name = argv[++i];
+      auto type = arrival_by_name.find(name);
+      if (type == arrival_by_name.end()) {
+        fprintf(stderr, "error: Invalid flag \"" ARRIVAL_FLAG " %s\"\n", name);
+        abort();
+      }
+      graph.arrival = type->second;
+    }
+
     if (!strcmp(argv[i], FRACTION_FLAG)) {
       needs_argument(i, argc, FRACTION_FLAG);
       double value = atof(argv[++i]);
@@ -976,6 +2806,61 @@ App::App(int argc, char **argv)
       graph.kernel.fraction_mem = value;
     }
 
+    if (!strcmp(argv[i], STRIDE_FLAG)) {
+      needs_argument(i, argc, STRIDE_FLAG);
+      long value = atol(argv[++i]);
+      if (value < (long)sizeof(uint64_t)) {
+        fprintf(stderr, "error: Invalid flag \"" STRIDE_FLAG " %ld\" must be >= %zu\n", value, sizeof(uint64_t));
+        abort();
+      }
+      graph.kernel.stride = value;
+    }
+
+    if (!strcmp(argv[i], IO_MODE_FLAG)) {
+      needs_argument(i, argc, IO_MODE_FLAG);
+      auto name = argv[++i];
+      auto mode = iomode_by_name.find(name);
+      if (mode == iomode_by_name.end()) {
+        fprintf(stderr, "error: Invalid flag \"" IO_MODE_FLAG " %s\"\n", name);
+        abort();
+      }
+      graph.kernel.io_mode = mode->second;
+    }
+
+    if (!strcmp(argv[i], IO_WRITE_FLAG)) {
+      graph.kernel.io_write = 1;
+    }
+
+    if (!strcmp(argv[i], IO_BLOCK_FLAG)) {
+      needs_argument(i, argc, IO_BLOCK_FLAG);
+      long value = atol(argv[++i]);
+      if (value <= 0) {
+        fprintf(stderr, "error: Invalid flag \"" IO_BLOCK_FLAG " %ld\" must be > 0\n", value);
+        abort();
+      }
+      graph.kernel.io_block = value;
+    }
+
+    if (!strcmp(argv[i], IO_DEPTH_FLAG)) {
+      needs_argument(i, argc, IO_DEPTH_FLAG);
+      int value = atoi(argv[++i]);
+      if (value <= 0) {
+        fprintf(stderr, "error: Invalid flag \"" IO_DEPTH_FLAG " %d\" must be > 0\n", value);
+        abort();
+      }
+      graph.kernel.io_depth = value;
+    }
+
+    if (!strcmp(argv[i], TASK_THREADS_FLAG)) {
+      needs_argument(i, argc, TASK_THREADS_FLAG);
+      int value = atoi(argv[++i]);
+      if (value <= 0) {
+        fprintf(stderr, "error: Invalid flag \"" TASK_THREADS_FLAG " %d\" must be > 0\n", value);
+        abort();
+      }
+      graph.kernel.threads = value;
+    }
+
     if (!strcmp(argv[i], FIELD_FLAG)) {
       needs_argument(i, argc, FIELD_FLAG);
       int value  = atoi(argv[++i]);
@@ -986,11 +2871,24 @@ App::App(int argc, char **argv)
       graph.nb_fields = value;
     }
 
+    if (!strcmp(argv[i], ODIST_FLAG)) {
+      needs_argument(i, argc, ODIST_FLAG);
+      auto name = argv[++i];
+      auto output_case = output_case_by_name.find(name);
+      if (output_case == output_case_by_name.end()) {
+        fprintf(stderr, "error: Invalid flag \"" ODIST_FLAG " %s\"\n", name);
+        abort();
+      }
+      graph.output_case = output_case->second;
+    }
+
+    // Same as -output-dist, by number.
     if (!strcmp(argv[i], OCASE_FLAG)) {
       needs_argument(i, argc, OCASE_FLAG);
       int value  = atoi(argv[++i]);
-      if (value < 0) {
-        fprintf(stderr, "error: Invalid flag \"" OCASE_FLAG " %d\" must be >= 0\n", value);
+      if (value < 0 || value >= (int)output_case_by_name.size()) {
+        fprintf(stderr, "error: Invalid flag \"" OCASE_FLAG " %d\" must be >= 0 and < %zu\n",
+                value, output_case_by_name.size());
         abort();
       }
       graph.output_case = value;
@@ -998,9 +2896,9 @@ App::App(int argc, char **argv)
 
     if (!strcmp(argv[i], ONORMAL_MEAN_FLAG)) {
       needs_argument(i, argc, ONORMAL_MEAN_FLAG);
-      int value  = atoi(argv[++i]);
+      double value = atof(argv[++i]);
       if (value < 0) {
-        fprintf(stderr, "error: Invalid flag \"" ONORMAL_MEAN_FLAG " %d\" must be > 0\n", value);
+        fprintf(stderr, "error: Invalid flag \"" ONORMAL_MEAN_FLAG " %f\" must be >= 0\n", value);
         abort();
       }
       graph.onormal_mu = value;
@@ -1008,9 +2906,9 @@ App::App(int argc, char **argv)
 
     if (!strcmp(argv[i], ONORMAL_STD_FLAG)) {
       needs_argument(i, argc, ONORMAL_STD_FLAG);
-      int value  = atoi(argv[++i]);
+      double value = atof(argv[++i]);
       if (value < 0) {
-        fprintf(stderr, "error: Invalid flag \"" ONORMAL_STD_FLAG " %d\" must be > 0\n", value);
+        fprintf(stderr, "error: Invalid flag \"" ONORMAL_STD_FLAG " %f\" must be >= 0\n", value);
         abort();
       }
       graph.onormal_std = value;
@@ -1018,9 +2916,9 @@ App::App(int argc, char **argv)
 
     if (!strcmp(argv[i], OGAMMA_ALPHA_FLAG)) {
       needs_argument(i, argc, OGAMMA_ALPHA_FLAG);
-      int value  = atoi(argv[++i]);
-      if (value < 0) {
-        fprintf(stderr, "error: Invalid flag \"" OGAMMA_ALPHA_FLAG " %d\" must be > 0\n", value);
+      double value = atof(argv[++i]);
+      if (value <= 0) {
+        fprintf(stderr, "error: Invalid flag \"" OGAMMA_ALPHA_FLAG " %f\" must be > 0\n", value);
         abort();
       }
       graph.ogamma_alpha = value;
@@ -1028,21 +2926,29 @@ App::App(int argc, char **argv)
 
     if (!strcmp(argv[i], OGAMMA_BETA_FLAG)) {
       needs_argument(i, argc, OGAMMA_BETA_FLAG);
-      int value  = atoi(argv[++i]);
-      if (value < 0) {
-        fprintf(stderr, "error: Invalid flag \"" OGAMMA_BETA_FLAG " %d\" must be > 0\n", value);
+      double value = atof(argv[++i]);
+      if (value <= 0) {
+        fprintf(stderr, "error: Invalid flag \"" OGAMMA_BETA_FLAG " %f\" must be > 0\n", value);
         abort();
       }
       graph.ogamma_beta = value;
     }
 
-    if (!strcmp(argv[i], AND_FLAG)) {
-      // Hack: set default value of period for random graph
-      if (graph.period < 0) {
-        graph.period = needs_period(graph.dependence) ? 3 : 0;
-      }
+    if (!strcmp(argv[i], GRAPH_FILE_FLAG)) {
+      needs_argument(i, argc, GRAPH_FILE_FLAG);
+      graph_path = argv[++i];
+      graph.dependence = DependenceType::GRAPH_FILE;
+    }
+
+    if (!strcmp(argv[i], AND_FLAG) || !strcmp(argv[i], CHILD_FLAG)) {
+      finish_graph(graph, radix_given);
       graphs.push_back(graph);
+      parents.push_back(parent);
+      graph_paths.push_back(graph_path);
+      graph_path.clear();
+      parent = !strcmp(argv[i], CHILD_FLAG) ? graphs.size() - 1 : -1;
       graph = default_graph(graphs.size());
+      radix_given = false;
     }
 
     if (!strcmp(argv[i], DIST_MAX_FLAG)) {
@@ -1106,49 +3012,276 @@ App::App(int argc, char **argv)
     }
   }
 
-  if (graph.period < 0) {
-    graph.period = needs_period(graph.dependence) ? 3 : 0;
+  finish_graph(graph, radix_given);
+  graphs.push_back(graph);
+  parents.push_back(parent);
+  graph_paths.push_back(graph_path);
+
+  // Number top-level graphs first so that runtimes can keep indexing
+  // graphs by graph_index, and move child graphs to child_graphs.
+  {
+    std::vector<long> index(graphs.size());
+    long next = 0;
+    for (size_t j = 0; j < graphs.size(); j++) {
+      if (parents[j] < 0) {
+        index[j] = next++;
+      }
+    }
+    for (size_t j = 0; j < graphs.size(); j++) {
+      if (parents[j] >= 0) {
+        index[j] = next++;
+      }
+    }
+    std::vector<TaskGraph> parsed;
+    parsed.swap(graphs);
+    for (size_t j = 0; j < parsed.size(); j++) {
+      parsed[j].graph_index = index[j];
+      if (parents[j] >= 0) {
+        parsed[parents[j]].child = index[j];
+      }
+      if (!graph_paths[j].empty()) {
+        const GraphFile &file = graph_file_open(index[j], graph_paths[j].c_str());
+        parsed[j].dependence = DependenceType::GRAPH_FILE;
+        parsed[j].timesteps = file.header->timesteps;
+        parsed[j].max_width = file.header->max_width;
+        parsed[j].output_bytes_per_task = std::max(parsed[j].output_bytes_per_task,
+                                                   (size_t)file.header->max_output_bytes);
+      }
+    }
+    for (size_t j = 0; j < parsed.size(); j++) {
+      (parents[j] < 0 ? graphs : child_graphs).push_back(parsed[j]);
+    }
+  }
+
+  // check nb_fields, if not set by user, set it to timesteps
+  for (std::vector<TaskGraph> *list : {&graphs, &child_graphs}) {
+    for (TaskGraph &g : *list) {
+      if (g.nb_fields == 0) {
+        g.nb_fields = g.timesteps;
+      }
+      g.validation = validation;
+    }
   }
 
-  // Dynamic array for output_bytes
-  graph.output_bytes_size = new size_t*[graph.timesteps];
-  for(int i = 0; i < graph.timesteps; i++)
-    graph.output_bytes_size[i] = new size_t[graph.max_width];
+  if (workers == 0) {
+    workers = std::max(1U, std::thread::hardware_concurrency()) * std::max(1L, nodes);
+  }
 
-  allocate_bytes(graph);
+  std::vector<std::atomic<double> >(graphs.size()).swap(completion_times);
 
-  /*for(int t = 0; t< graph.timesteps; t++){
-    for(int i = 0; i< graph.max_width; i++){
-      printf("t %d i %d; outputsize: %ld\n",t, i, graph.output_bytes_size[t][i]);
+  // Random walks go first since check() visits every timestep's width.
+  std::vector<TaskGraph> all = graphs_and_children(*this);
+  for (auto g : all) {
+    if (g.graph_index >= (long)elastic_walks.size()) {
+      elastic_walks.resize(g.graph_index + 1);
     }
-  }*/
+    elastic_walks[g.graph_index].reset();
+    if (g.dependence == DependenceType::ELASTIC_RANDOM && g.timesteps > 0 && g.max_width > 0) {
+      elastic_walks[g.graph_index] = make_elastic_walk(g);
+    }
+  }
 
+  check();
 
+  nested_graphs.assign(all.begin(), all.end());
 
-  graphs.push_back(graph);
+  // Precompute dependencies once so that validation and the runtimes
+  // read flat arrays rather than recomputing each pattern per task.
+  for (auto g : all) {
+    if (g.graph_index >= (long)dependency_tables.size()) {
+      dependency_tables.resize(g.graph_index + 1);
+    }
+    // Drop any stale table first so the new one is built from the
+    // dependence pattern itself.
+    dependency_tables[g.graph_index].reset();
+    dependency_tables[g.graph_index].reset(new DependencyTable(g));
+  }
 
-  // check nb_fields, if not set by user, set it to timesteps
-  for (int j = 0; j < graphs.size(); j++) {
-    TaskGraph &g = graphs[j];
-    if (g.nb_fields == 0) {
-      g.nb_fields = g.timesteps;
+  for (auto g : all) {
+    if (g.graph_index >= (long)release_tables.size()) {
+      release_tables.resize(g.graph_index + 1);
+    }
+    release_tables[g.graph_index].clear();
+    if (g.arrival_rate != 0 && g.arrival == ArrivalType::ARRIVAL_POISSON) {
+      release_tables[g.graph_index] = make_release_table(g);
     }
   }
 
-  check();
+  for (auto g : all) {
+    if (g.graph_index >= (long)dist_tables.size()) {
+      dist_tables.resize(g.graph_index + 1);
+    }
+    dist_tables[g.graph_index].reset();
+    if (g.kernel.type == KernelType::DIST_IMBALANCE) {
+      dist_tables[g.graph_index] = make_dist_table(g);
+    }
+  }
+
+  for (auto g : all) {
+    if (g.graph_index >= (long)resolved_kernels.size()) {
+      resolved_kernels.resize(g.graph_index + 1);
+    }
+    Kernel k(g.kernel);
+    resolved_kernels[g.graph_index] = {k, k.resolve()};
+  }
+
+  for (auto g : all) {
+    if (g.kernel.type == KernelType::IO_BOUND) {
+      io_kernel_prepare(g.kernel, g.graph_index, g.max_width);
+      if (io_kernel_prepares_on_read(g.kernel)) {
+        io_prepare_runs = true;
+      }
+    }
+    if (g.kernel.type == KernelType::MEMORY_CHASE) {
+      scratch_pointer_chase = true;
+    }
+  }
+
+  noise_configure(noise);
+
+  // The baseline includes the tables above, which belong to the benchmark.
+  if (sample_memory) {
+    memory_start(memory_period);
+  }
+}
+
+// Intervals are ascending, disjoint and below bound; returns the number
+// of points they cover, or -1 if they are invalid.
+static long count_interval_points(const std::pair<long, long> *intervals, size_t count, long bound)
+{
+  long points = 0;
+  for (size_t i = 0; i < count; ++i) {
+    if (intervals[i].first < 0 || intervals[i].second < intervals[i].first ||
+        intervals[i].second >= bound || (i > 0 && intervals[i].first <= intervals[i-1].second)) {
+      return -1;
+    }
+    points += intervals[i].second - intervals[i].first + 1;
+  }
+  return points;
+}
+
+static bool intervals_contain(const std::pair<long, long> *intervals, size_t count, long point)
+{
+  auto interval = std::upper_bound(intervals, intervals + count, point,
+                                   [](long p, const std::pair<long, long> &i) { return p < i.first; });
+  return interval != intervals && (interval - 1)->second >= point;
+}
+
+// Graph files are checked edge by edge rather than by materializing
+// every dependence set: each in-edge needs the matching out-edge, and
+// with equal numbers of both the reverse dependencies mirror the
+// dependencies.
+static void check_graph_file(const TaskGraph &g)
+{
+  const GraphFile *file = graph_file(g.graph_index);
+  if (!file) {
+    fprintf(stderr, "error: Graph type \"%s\" requires " GRAPH_FILE_FLAG "\n",
+            name_by_dtype.at(g.dependence).c_str());
+    abort();
+  }
+  if (g.kernel.type == KernelType::IO_BOUND) {
+    // Extents of io_bound are sized by -iter, not by per-task iterations.
+    fprintf(stderr, "error: Graph type \"%s\" does not support the io_bound kernel\n",
+            name_by_dtype.at(g.dependence).c_str());
+    abort();
+  }
+  std::atomic<long> invalid_task(-1);
+  std::atomic<long> in_points(0), out_points(0);
+  parallel_for(g.timesteps, [&](long chunk, long first, long last) {
+    for (long t = first; t < last; ++t) {
+      // Offsets and widths were validated by graph_file_open.
+      long width = file->width(t);
+      long last_width = t > 0 ? file->width(t-1) : 0;
+      long next_width = t + 1 < g.timesteps ? file->width(t+1) : 0;
+      for (long p = 0; p < width; ++p) {
+        long task = file->task(t, p);
+        size_t n_in, n_out;
+        const std::pair<long, long> *in = file_intervals(file, t, p, false, n_in);
+        const std::pair<long, long> *out = file_intervals(file, t+1, p, true, n_out);
+        long n_in_points = count_interval_points(in, n_in, last_width);
+        long n_out_points = count_interval_points(out, n_out, next_width);
+        bool valid = n_in_points >= 0 && n_out_points >= 0 &&
+          file->output_bytes[task] >= sizeof(std::pair<long, long>) &&
+          file->iterations[task] >= 0;
+        for (size_t i = 0; valid && i < n_in; ++i) {
+          for (long q = in[i].first; valid && q <= in[i].second; ++q) {
+            size_t n_producer;
+            const std::pair<long, long> *producer = file_intervals(file, t, q, true, n_producer);
+            valid = intervals_contain(producer, n_producer, p);
+          }
+        }
+        if (!valid) {
+          invalid_task = task;
+          continue;
+        }
+        in_points += n_in_points;
+        out_points += n_out_points;
+      }
+    }
+  });
+  if (invalid_task >= 0 || in_points != out_points) {
+    fprintf(stderr, "error: Graph file of graph %ld has invalid edges at task %ld\n",
+            g.graph_index, invalid_task.load());
+    abort();
+  }
 }
 
 void App::check() const
 {
+  std::vector<TaskGraph> all = graphs_and_children(*this);
+
 #ifdef DEBUG_CORE
-  if (graphs.size() >= sizeof(TaskGraphMask)*8) {
+  if (all.size() >= sizeof(TaskGraphMask)*8) {
     fprintf(stderr, "error: Can only execute up to %lu task graphs\n", sizeof(TaskGraphMask)*8);
     abort();
   }
 #endif
 
+  if (metg && (warmup >= 0 || reps > 1)) {
+    fprintf(stderr, "error: " METG_FLAG " chooses its own runs and does not support " WARMUP_FLAG " or " REPS_FLAG "\n");
+    abort();
+  }
+
+  if (metg) {
+    long max_iterations = 0;
+    for (auto g : all) {
+      if (g.arrival_rate > 0 || g.dependence == DependenceType::GRAPH_FILE) {
+        fprintf(stderr, "error: " METG_FLAG " does not support open-loop arrivals or graph files\n");
+        abort();
+      }
+      max_iterations = std::max(max_iterations, g.kernel.iterations);
+    }
+    if (max_iterations <= 1) {
+      fprintf(stderr, "error: " METG_FLAG " needs a kernel with more than one iteration\n");
+      abort();
+    }
+  }
+
+  // Stored timesteps of child instances (see stored_timestep) grow with
+  // the size of every enclosing graph and must fit in a long.
+  std::vector<long> max_instance(all.size(), 0);
+  for (auto g : all) {
+    if (!g.child) {
+      continue;
+    }
+    const TaskGraph &c = all[g.child];
+    long instances, stored;
+    if (__builtin_mul_overflow(max_instance[g.graph_index] + 1, g.timesteps * g.max_width, &instances) ||
+        __builtin_mul_overflow(instances + 1, c.timesteps, &stored)) {
+      fprintf(stderr, "error: Graph %ld nested in graph %ld has too many instances\n",
+              c.graph_index, g.graph_index);
+      abort();
+    }
+    max_instance[c.graph_index] = instances;
+  }
+
   // Validate task graph is well-formed
-  for (auto g : graphs) {
+  for (auto g : all) {
+    if (g.arrival_rate != 0 && g.graph_index >= (long)graphs.size()) {
+      fprintf(stderr, "error: Flag \"" ARRIVAL_RATE_FLAG "\" is not supported for graph %ld, which is nested in another\n",
+              g.graph_index);
+      abort();
+    }
     if (needs_period(g.dependence) && g.period == 0) {
       fprintf(stderr, "error: Graph type \"%s\" requires a non-zero period (specify with -period)\n",
               name_by_dtype.at(g.dependence).c_str());
@@ -1159,6 +3292,46 @@ void App::check() const
       abort();
     }
 
+    if (is_grid_stencil(g.dependence)) {
+      int rank = grid_rank(g.dependence);
+      long points = 1;
+      for (int d = 0; d < rank; ++d) {
+        points *= g.dims[d];
+      }
+      if ((rank == 2 && g.dims[2] != 0) || (rank == 3 && g.dims[2] == 0)) {
+        fprintf(stderr, "error: Graph type \"%s\" requires %d values for -dims\n",
+                name_by_dtype.at(g.dependence).c_str(), rank);
+        abort();
+      }
+      if (points != g.max_width) {
+        fprintf(stderr, "error: Grid of graph type \"%s\" has %ld points but width is %ld\n",
+                name_by_dtype.at(g.dependence).c_str(), points, g.max_width);
+        abort();
+      }
+      bool star = g.radix == 2 * rank + 1;
+      bool box = g.radix == (rank == 3 ? 27 : 9);
+      if (!star && !box) {
+        fprintf(stderr, "error: Graph type \"%s\" requires a radix of %d or %d\n",
+                name_by_dtype.at(g.dependence).c_str(), 2 * rank + 1, rank == 3 ? 27 : 9);
+        abort();
+      }
+    } else if (g.dims[0] != 0) {
+      fprintf(stderr, "error: Graph type \"%s\" does not support -dims\n",
+              name_by_dtype.at(g.dependence).c_str());
+      abort();
+    }
+
+    if (g.dependence == DependenceType::GRAPH_FILE) {
+      check_graph_file(g);
+      continue;
+    }
+
+    if (is_elastic(g.dependence) && needs_period(g.dependence) && g.period < 2) {
+      fprintf(stderr, "error: Graph type \"%s\" requires a period of at least 2\n",
+              name_by_dtype.at(g.dependence).c_str());
+      abort();
+    }
+
     // This is required to avoid wrapping around with later dependence sets.
     long spread = (g.max_width + g.radix - 1) / g.radix;
     if (g.dependence == DependenceType::SPREAD && g.period > spread) {
@@ -1207,23 +3380,76 @@ void App::display() const
   printf("Running Task Benchmark\n");
   printf("  Configuration:\n");
   int i = 0;
-  for (auto g : graphs) {
+  for (auto g : graphs_and_children(*this)) {
     ++i;
 
     printf("    Task Graph %d:\n", i);
+    if (g.child) {
+      printf("      Each Task Expands Into: Task Graph %ld\n", g.child + 1);
+    }
     printf("      Time Steps: %ld\n", g.timesteps);
     printf("      Max Width: %ld\n", g.max_width);
     printf("      Dependence Type: %s\n", name_by_dtype.at(g.dependence).c_str());
     printf("      Radix: %ld\n", g.radix);
     printf("      Period: %ld\n", g.period);
     printf("      Fraction Connected: %f\n", g.fraction_connected);
+    if (g.arrival_rate != 0) {
+      for (auto type : arrival_by_name) {
+        if (type.second == g.arrival) {
+          printf("      Arrivals: %s, %f timesteps/s\n", type.first.c_str(), g.arrival_rate);
+        }
+      }
+    }
+    if (g.priority != 0 || g.weight != 0) {
+      printf("      Priority: %d\n", g.priority);
+      printf("      Weight: %f\n", g.weight);
+    }
+    if (const GraphFile *file = g.dependence == DependenceType::GRAPH_FILE ? graph_file(g.graph_index) : NULL) {
+      printf("      Graph File: %llu tasks, %llu dependency intervals\n",
+             (unsigned long long)file->header->num_tasks,
+             (unsigned long long)file->header->num_in_intervals);
+    }
+    if (is_grid_stencil(g.dependence)) {
+      if (g.dependence == DependenceType::STENCIL_3D) {
+        printf("      Grid: %ldx%ldx%ld\n", g.dims[0], g.dims[1], g.dims[2]);
+      } else {
+        printf("      Grid: %ldx%ld\n", g.dims[0], g.dims[1]);
+      }
+    }
     printf("      Kernel:\n");
     printf("        Type: %s\n", name_by_ktype.at(g.kernel.type).c_str());
     printf("        Iterations: %ld\n", g.kernel.iterations);
     printf("        Samples: %d\n", g.kernel.samples);
     printf("        Imbalance: %f\n", g.kernel.imbalance);
+    printf("        Compute ISA: %s\n", compute_kernel_isa());
+    if (g.kernel.type == KernelType::COMPUTE_DGEMM) {
+      printf("        DGEMM: %s\n", dgemm_kernel_name());
+    }
+    if (g.kernel.type == KernelType::IO_BOUND) {
+      for (auto mode : iomode_by_name) {
+        if (mode.second == g.kernel.io_mode) {
+          printf("        I/O: %s %s, %ld byte blocks\n", mode.first.c_str(),
+                 g.kernel.io_write ? "write" : "read", io_kernel_block(g.kernel));
+        }
+      }
+    }
+    if (g.kernel.type == KernelType::MEMORY_STRIDED) {
+      printf("        Stride: %zu\n", kernel_stride(g.kernel));
+    }
+    if (kernel_threads(g.kernel) > 1) {
+      printf("        Task Threads: %d%s\n", kernel_threads(g.kernel),
+             kernel_splits(g.kernel.type) ? "" : " (kernel runs on one)");
+    }
     printf("      Output Bytes: %lu\n", g.output_bytes_per_task);
+    if (g.output_case == 1) {
+      printf("        Distribution: normal (mean %g, std %g points)\n", g.onormal_mu, g.onormal_std);
+    } else if (g.output_case == 3) {
+      printf("        Distribution: gamma (shape %g, scale %g points)\n", g.ogamma_alpha, g.ogamma_beta);
+    } else if (g.output_case != 0) {
+      printf("        Distribution: %s\n", output_case_name(g.output_case));
+    }
     printf("      Scratch Bytes: %lu\n", g.scratch_bytes_per_task);
+    printf("      Validation: %s\n", name_by_vtype.at(g.validation).c_str());
 
     if (verbose > 0) {
       for (long t = 0; t < g.timesteps; ++t) {
@@ -1277,12 +3503,36 @@ void App::display() const
 }
 
 // IMPORTANT: Keep this up-to-date with kernel implementations
+// The graph as seen by one task of a graph file, whose iterations come
+// from the file.
+static TaskGraph file_task_graph(const TaskGraph &g, long timestep, long point)
+{
+  const GraphFile *file = graph_file(g.graph_index);
+  TaskGraph task_graph(g);
+  task_graph.dependence = DependenceType::TRIVIAL;
+  task_graph.kernel.iterations = file->iterations[file->task(timestep, point)];
+  return task_graph;
+}
+
 long long count_flops_per_task(const TaskGraph &g, long timestep, long point)
 {
+  if (g.dependence == DependenceType::GRAPH_FILE) {
+    return count_flops_per_task(file_task_graph(g, timestep, point), timestep, point);
+  }
+
+  // These run the empty kernel (see Kernel::resolve), without even the
+  // final 64 multiplies of the compute kernels.
+  if (g.kernel.iterations == 0 && kernel_idle_without_iterations(g.kernel.type)) {
+    return 0;
+  }
+
   switch(g.kernel.type) {
   case KernelType::EMPTY:
   case KernelType::BUSY_WAIT:
   case KernelType::MEMORY_BOUND:
+  case KernelType::MEMORY_STREAM:
+  case KernelType::MEMORY_STRIDED:
+  case KernelType::MEMORY_CHASE:
     return 0;
 
   case KernelType::COMPUTE_DGEMM:
@@ -1295,7 +3545,7 @@ long long count_flops_per_task(const TaskGraph &g, long timestep, long point)
     return 0;
 
   case KernelType::COMPUTE_BOUND:
-    return 2 * 64 * g.kernel.iterations + 64;
+    return compute_kernel_flops_per_iteration() * g.kernel.iterations + 64;
 
   case KernelType::COMPUTE_BOUND2:
     return 2 * 32 * g.kernel.iterations;
@@ -1306,18 +3556,19 @@ long long count_flops_per_task(const TaskGraph &g, long timestep, long point)
   case KernelType::LOAD_IMBALANCE:
   {
     long iterations = select_imbalance_iterations(g.kernel, g.graph_index, timestep, point);
-    return 2 * 64 * iterations + 64;
+    return compute_kernel_flops_per_iteration() * iterations + 64;
   }
 
   case KernelType::DIST_IMBALANCE:
   {
-    long iterations = select_dist_iterations(g.kernel, g.graph_index, timestep, point);
-    return 2 * 64 * iterations + 64;
+    long iterations = dist_iterations(g.kernel, g.graph_index, timestep, point);
+    return compute_kernel_flops_per_iteration() * iterations + 64;
   }
 
   case KernelType::COMPUTE_MEMORY:
   {
-    return 2 * 64 * g.kernel.iterations * (1-g.kernel.fraction_mem) + 64;
+    long mem_iter = g.kernel.iterations * g.kernel.fraction_mem;
+    return compute_kernel_flops_per_iteration() * (g.kernel.iterations - mem_iter) + 64;
   }
 
   default:
@@ -1328,14 +3579,30 @@ long long count_flops_per_task(const TaskGraph &g, long timestep, long point)
 // IMPORTANT: Keep this up-to-date with kernel implementations
 long long count_bytes_per_task(const TaskGraph &g, long timestep, long point)
 {
+  if (g.dependence == DependenceType::GRAPH_FILE) {
+    return count_bytes_per_task(file_task_graph(g, timestep, point), timestep, point);
+  }
+
   switch(g.kernel.type) {
   case KernelType::EMPTY:
   case KernelType::BUSY_WAIT:
     return 0;
 
   case KernelType::MEMORY_BOUND:
+  case KernelType::MEMORY_STREAM:
     return g.scratch_bytes_per_task * g.kernel.iterations / g.kernel.samples;
 
+  case KernelType::MEMORY_STRIDED:
+  {
+    // Every load pulls in a whole cache line, or the stride if it is shorter.
+    long long bytes = g.scratch_bytes_per_task * g.kernel.iterations / g.kernel.samples;
+    long long stride = kernel_stride(g.kernel);
+    return bytes / stride * std::min(stride, (long long)CACHE_LINE_BYTES);
+  }
+
+  case KernelType::MEMORY_CHASE:
+    return chase_hops(g.kernel, g.scratch_bytes_per_task) * CACHE_LINE_BYTES;
+
   case KernelType::MEMORY_DAXPY:
     return g.scratch_bytes_per_task * g.kernel.iterations / g.kernel.samples;
 
@@ -1353,32 +3620,189 @@ long long count_bytes_per_task(const TaskGraph &g, long timestep, long point)
   };
 }
 
-static long long count_flops(const TaskGraph &g)
+// Graphs whose task cost depends on the (timestep, point) of the task.
+static bool has_varying_cost(const TaskGraph &g)
 {
-  long long flops = 0;
+  return g.kernel.type == KernelType::LOAD_IMBALANCE || g.kernel.type == KernelType::DIST_IMBALANCE ||
+    g.dependence == DependenceType::GRAPH_FILE;
+}
+
+static long long count_tasks(const TaskGraph &g)
+{
+  long long num_tasks = 0;
   for (long t = 0; t < g.timesteps; ++t) {
-    long offset = g.offset_at_timestep(t);
-    long width = g.width_at_timestep(t);
+    num_tasks += g.width_at_timestep(t);
+  }
+  return num_tasks;
+}
 
-    for (long point = offset; point < offset + width; ++point) {
-      flops += count_flops_per_task(g, t, point);
+// Sums per_task(g, timestep, point) over every task, in parallel.
+template <typename F>
+static long long sum_over_tasks(const TaskGraph &g, F per_task)
+{
+  std::vector<long long> first_task(g.timesteps + 1, 0);
+  for (long t = 0; t < g.timesteps; ++t) {
+    first_task[t+1] = first_task[t] + g.width_at_timestep(t);
+  }
+
+  std::vector<long long> chunk_sum(parallel_chunks(first_task.back()), 0);
+  parallel_for(first_task.back(), [&](long chunk, long first, long last) {
+    long t = std::upper_bound(first_task.begin(), first_task.end(), first) - first_task.begin() - 1;
+    for (long idx = first; idx < last; ++idx) {
+      while (idx >= first_task[t+1]) {
+        ++t;
+      }
+      chunk_sum[chunk] += per_task(g, t, g.offset_at_timestep(t) + idx - first_task[t]);
     }
+  });
+
+  long long sum = 0;
+  for (auto value : chunk_sum) {
+    sum += value;
   }
-  return flops;
+  return sum;
+}
+
+static long long count_flops(const TaskGraph &g)
+{
+  if (!has_varying_cost(g)) {
+    return count_flops_per_task(g, 0, 0) * count_tasks(g);
+  }
+  return sum_over_tasks(g, count_flops_per_task);
 }
 
 static long long count_bytes(const TaskGraph &g)
 {
-  long long bytes = 0;
+  if (!has_varying_cost(g)) {
+    return count_bytes_per_task(g, 0, 0) * count_tasks(g);
+  }
+  return sum_over_tasks(g, count_bytes_per_task);
+}
+
+static long long count_dependent_loads(const TaskGraph &g)
+{
+  if (g.kernel.type != KernelType::MEMORY_CHASE) {
+    return 0;
+  }
+  if (g.dependence == DependenceType::GRAPH_FILE) {
+    return sum_over_tasks(g, [](const TaskGraph &g, long t, long p) {
+      return chase_hops(file_task_graph(g, t, p).kernel, g.scratch_bytes_per_task);
+    });
+  }
+  return chase_hops(g.kernel, g.scratch_bytes_per_task) * count_tasks(g);
+}
+
+static long long count_io_operations(const TaskGraph &g)
+{
+  if (g.kernel.type != KernelType::IO_BOUND) {
+    return 0;
+  }
+  if (g.dependence == DependenceType::GRAPH_FILE) {
+    return sum_over_tasks(g, [](const TaskGraph &g, long t, long p) {
+      return (long long)file_task_graph(g, t, p).kernel.iterations;
+    });
+  }
+  return g.kernel.iterations * count_tasks(g);
+}
+
+// Kernel iterations of one task, the cost unit of critical paths.
+static long long task_iterations(const TaskGraph &g, long timestep, long point)
+{
+  if (g.dependence == DependenceType::GRAPH_FILE) {
+    return file_task_graph(g, timestep, point).kernel.iterations;
+  }
+  switch (g.kernel.type) {
+  case KernelType::LOAD_IMBALANCE:
+    return select_imbalance_iterations(g.kernel, g.graph_index, timestep, point);
+  case KernelType::DIST_IMBALANCE:
+    return dist_iterations(g.kernel, g.graph_index, timestep, point);
+  default:
+    return g.kernel.iterations;
+  }
+}
+
+struct CriticalPath {
+  long long work_tasks;
+  long long work_iterations;
+  long long span_tasks;
+  long long span_iterations;
+  long max_width;
+};
+
+// Timesteps at least this wide are split across threads.
+#define CRITICAL_PATH_PARALLEL_WIDTH 4096
+
+// Total and longest-path cost of a graph, in tasks and in iterations.
+// Streams over the timesteps, keeping only the finish times of the
+// previous one. A task with a child graph also costs the child's
+// critical path (child), which is the same for every instance.
+static CriticalPath critical_path(const TaskGraph &g, const CriticalPath &child)
+{
+  CriticalPath result = {0, 0, 0, 0, 0};
+  std::vector<long long> last_tasks(g.max_width, 0), last_iterations(g.max_width, 0);
+  std::vector<long long> next_tasks(g.max_width, 0), next_iterations(g.max_width, 0);
   for (long t = 0; t < g.timesteps; ++t) {
     long offset = g.offset_at_timestep(t);
     long width = g.width_at_timestep(t);
-
-    for (long point = offset; point < offset + width; ++point) {
-      bytes += count_bytes_per_task(g, t, point);
+    long last_offset = g.offset_at_timestep(t-1);
+    long last_width = g.width_at_timestep(t-1);
+    long dset = g.dependence_set_at_timestep(t);
+
+    auto visit = [&](long first, long last, CriticalPath &part) {
+      for (long p = offset + first; p < offset + last; ++p) {
+        long long ready_tasks = 0, ready_iterations = 0;
+        g.for_each_dependency_point(dset, p, [&](long dep) {
+          if (dep >= last_offset && dep < last_offset + last_width) {
+            ready_tasks = std::max(ready_tasks, last_tasks[dep]);
+            ready_iterations = std::max(ready_iterations, last_iterations[dep]);
+          }
+        });
+        long long iterations = task_iterations(g, t, p) + child.span_iterations;
+        next_tasks[p] = ready_tasks + 1 + child.span_tasks;
+        next_iterations[p] = ready_iterations + iterations;
+        part.work_tasks += 1 + child.work_tasks;
+        part.work_iterations += task_iterations(g, t, p) + child.work_iterations;
+        part.span_tasks = std::max(part.span_tasks, next_tasks[p]);
+        part.span_iterations = std::max(part.span_iterations, next_iterations[p]);
+      }
+    };
+
+    std::vector<CriticalPath> parts(width >= CRITICAL_PATH_PARALLEL_WIDTH ? parallel_chunks(width) : 1,
+                                    CriticalPath{0, 0, 0, 0, 0});
+    if (parts.size() > 1) {
+      parallel_for(width, [&](long chunk, long first, long last) { visit(first, last, parts[chunk]); });
+    } else {
+      visit(0, width, parts[0]);
+    }
+    for (auto part : parts) {
+      result.work_tasks += part.work_tasks;
+      result.work_iterations += part.work_iterations;
+      result.span_tasks = std::max(result.span_tasks, part.span_tasks);
+      result.span_iterations = std::max(result.span_iterations, part.span_iterations);
     }
+    result.max_width = std::max(result.max_width, width);
+    last_tasks.swap(next_tasks);
+    last_iterations.swap(next_iterations);
   }
-  return bytes;
+  return result;
+}
+
+// Prints the critical path of a graph (or of several running at once)
+// and the ideal makespan on workers: the longer of the span and the work
+// divided evenly. Costs are in iterations, or in tasks for graphs whose
+// kernels have none.
+static void print_critical_path(const CriticalPath &cp, long workers)
+{
+  bool by_tasks = cp.work_iterations == 0;
+  double work = by_tasks ? cp.work_tasks : cp.work_iterations;
+  double span = by_tasks ? cp.span_tasks : cp.span_iterations;
+  const char *unit = by_tasks ? "tasks" : "iterations";
+  double ideal = std::max(span, work / workers);
+  printf("  Work %lld tasks, %lld iterations\n", cp.work_tasks, cp.work_iterations);
+  printf("  Span %lld tasks, %lld iterations\n", cp.span_tasks, cp.span_iterations);
+  printf("  Parallelism max %ld, average %f\n", cp.max_width, span > 0 ? work / span : 0.0);
+  printf("  Ideal Makespan on %ld Workers %e %s (efficiency bound %f)\n",
+         workers, ideal, unit, ideal > 0 ? work / (workers * ideal) : 0.0);
 }
 
 static std::tuple<long, long> clamp(long start, long end, long min_value, long max_value) {
@@ -1391,88 +3815,762 @@ static std::tuple<long, long> clamp(long start, long end, long min_value, long m
   }
 }
 
-void allocate_bytes(TaskGraph&g){
-  std::default_random_engine generator;
-  if (g.output_bytes_per_task == 16){
-    for (int t = 0; t < g.timesteps; t++){
-      long width_t = g.width_at_timestep(t);
-      long offset_t = g.offset_at_timestep(t);
-      for (int i=0; i<width_t; ++i) {
-        g.output_bytes_size[t][i+offset_t] = 16;
+// Number of samples the output size histogram is scaled to.
+#define OUTPUT_SIZE_SAMPLES 10000
+
+static double normal_cdf(double x, double mu, double sigma)
+{
+  return 0.5 * erfc((mu - x) / (sigma * M_SQRT2));
+}
+
+// Gamma CDF: the regularized lower incomplete gamma function, by its
+// power series. Far in the tail (50 standard deviations) it is 1, which
+// also keeps the series from overflowing.
+static double gamma_cdf(double x, double shape, double scale)
+{
+  if (x <= 0) return 0;
+  double z = x / scale;
+  if (z > shape + 50 * sqrt(shape) + 50) return 1;
+  double term = 1 / shape;
+  double sum = term;
+  for (long n = 1; term > sum * 1e-15 && n < 100000; ++n) {
+    term *= z / (shape + n);
+    sum += term;
+  }
+  return std::min(1.0, exp(shape * log(z) - z - lgamma(shape)) * sum);
+}
+
+// Sizes for each active point of one timestep of an -output-case 1-3
+// graph. The histogram over points is the expected number of
+// OUTPUT_SIZE_SAMPLES draws landing in each point, taken directly from
+// the distribution's CDF; the only randomness (mu and sigma in case 2)
+// comes from random_uniform seeded by (graph_index, timestep), so every
+// process computes identical sizes for any timestep on its own.
+static void generate_output_sizes(const TaskGraph &g, long t, std::vector<size_t> &sizes)
+{
+  long width_t = g.width_at_timestep(t);
+  long nstars=(g.output_bytes_per_task-16)*width_t/16;    // total number output
+  long nrolls=OUTPUT_SIZE_SAMPLES;
+  std::vector<long> p(width_t);
+
+  double mu = 0, sigma = 0;
+  if (g.output_case==1){
+    //case 1: normal distribution with fixed mu and sigma
+    mu = g.onormal_mu;
+    sigma = g.onormal_std;
+  }else if (g.output_case==2){
+    //case 2: normal distribution with mu and sigma drawn per timestep
+    const long mu_seed[3] = {g.graph_index, t, 0};
+    const long sigma_seed[3] = {g.graph_index, t, 1};
+    mu = floor(random_uniform(&mu_seed[0], sizeof(mu_seed)) * width_t);
+    sigma = floor(random_uniform(&sigma_seed[0], sizeof(sigma_seed)) * width_t);
+  }
+
+  bool normal = g.output_case==1 || g.output_case==2;
+  double last_cdf = 0;
+  if (normal && sigma > 0) {
+    last_cdf = normal_cdf(0, mu, sigma);
+  }
+  for (long i=0; i<width_t; ++i) {
+    double cdf = 0;
+    if (normal) {
+      cdf = sigma > 0 ? normal_cdf(i+1, mu, sigma) : (i >= (long)mu ? 1 : 0);
+    } else if (g.output_case==3) {
+      cdf = gamma_cdf(i+1, g.ogamma_alpha, g.ogamma_beta);
+    }
+    p[i] = (long)((cdf - last_cdf)*nrolls);
+    last_cdf = cdf;
+  }
+
+  sizes.resize(width_t);
+  long iroll=0;
+  for (long i=0; i<width_t; ++i) {
+    sizes[i]=((p[i]*nstars/nrolls)+1)*16;
+    iroll = iroll+(sizes[i]-16)/16;
+  }
+  for (long i=0; i<width_t; ++i) {
+    size_t old_output = sizes[i];
+    sizes[i]=sizes[i]+((p[i]*(nstars-iroll)/nrolls))*16;
+    iroll = iroll+(sizes[i]-old_output)/16;
+  }
+  sizes[width_t-1]=sizes[width_t-1]+((nstars-iroll)*16);
+}
+
+// Run-length encoded output sizes of one timestep: (first point, size)
+// for each run of equal sizes, sorted by point.
+typedef std::vector<std::pair<long, size_t> > OutputSizeRuns;
+
+// Lazily generated output sizes for one graph. Maps live in a
+// process-wide list and are never freed, so rows may be read without
+// locking once published. Rows are generated without a lock; if two
+// threads race on one timestep the loser discards its (identical) copy.
+struct OutputSizeMap {
+  TaskGraph graph;
+  std::unique_ptr<std::atomic<const OutputSizeRuns *>[]> rows;
+  OutputSizeMap *next;
+
+  OutputSizeMap(const TaskGraph &g)
+    : graph(g)
+    , rows(new std::atomic<const OutputSizeRuns *>[g.timesteps])
+    , next(NULL)
+  {
+    for (long t = 0; t < g.timesteps; ++t) {
+      rows[t].store(NULL, std::memory_order_relaxed);
+    }
+  }
+
+  bool matches(const TaskGraph &g) const
+  {
+    return graph.graph_index == g.graph_index &&
+      graph.timesteps == g.timesteps &&
+      graph.max_width == g.max_width &&
+      graph.dependence == g.dependence &&
+      graph.output_bytes_per_task == g.output_bytes_per_task &&
+      graph.output_case == g.output_case &&
+      graph.onormal_mu == g.onormal_mu &&
+      graph.onormal_std == g.onormal_std &&
+      graph.ogamma_alpha == g.ogamma_alpha &&
+      graph.ogamma_beta == g.ogamma_beta;
+  }
+
+  const OutputSizeRuns &row(long timestep)
+  {
+    const OutputSizeRuns *runs = rows[timestep].load(std::memory_order_acquire);
+    if (runs) {
+      return *runs;
+    }
+
+    std::vector<size_t> sizes;
+    generate_output_sizes(graph, timestep, sizes);
+    long offset = graph.offset_at_timestep(timestep);
+    OutputSizeRuns *result = new OutputSizeRuns;
+    for (size_t i = 0; i < sizes.size(); ++i) {
+      if (result->empty() || result->back().second != sizes[i]) {
+        result->push_back(std::pair<long, size_t>(offset + i, sizes[i]));
       }
     }
-  }else{
+    result->shrink_to_fit();
+    if (!rows[timestep].compare_exchange_strong(runs, result, std::memory_order_acq_rel)) {
+      delete result;
+      return *runs;
+    }
+    return *result;
+  }
+};
+
+static std::atomic<OutputSizeMap *> output_size_maps(NULL);
+static std::mutex output_size_maps_mutex;
+
+static OutputSizeMap &output_size_map(const TaskGraph &g)
+{
+  for (OutputSizeMap *map = output_size_maps.load(std::memory_order_acquire); map; map = map->next) {
+    if (map->matches(g)) {
+      return *map;
+    }
+  }
+
+  std::lock_guard<std::mutex> lock(output_size_maps_mutex);
+  for (OutputSizeMap *map = output_size_maps.load(std::memory_order_relaxed); map; map = map->next) {
+    if (map->matches(g)) {
+      return *map;
+    }
+  }
+  OutputSizeMap *map = new OutputSizeMap(g);
+  map->next = output_size_maps.load(std::memory_order_relaxed);
+  output_size_maps.store(map, std::memory_order_release);
+  return *map;
+}
+
+static bool has_uniform_output(const TaskGraph &g)
+{
+  return g.output_case == 0 || g.output_bytes_per_task == 16;
+}
 
-  for (int t = 0; t < g.timesteps; t++){
-    long width_t = g.width_at_timestep(t);
-    long offset_t = g.offset_at_timestep(t);
-    int nstars=(g.output_bytes_per_task-16)*width_t/16;    // total number output
-    int nrolls=10000;  // number of experiment
-    int p [width_t] = {};
-    float mu,sigma;
-    if(g.output_case==0){
-      //case 0: uniform case (follow output_bytes_per_task)
-        for (int i=0; i<width_t; ++i) {
-          g.output_bytes_size[t][i+offset_t] = g.output_bytes_per_task;
+size_t TaskGraph::output_bytes_at(long timestep, long point) const
+{
+  if (dependence == DependenceType::GRAPH_FILE) {
+    const GraphFile *file = graph_file(graph_index);
+    if (point >= file->width(timestep)) {
+      return output_bytes_per_task;
+    }
+    return file->output_bytes[file->task(timestep, point)];
+  }
+  if (has_uniform_output(*this)) {
+    return output_bytes_per_task;
+  }
+
+  long offset = offset_at_timestep(timestep);
+  long width = width_at_timestep(timestep);
+  if (point < offset || point >= offset + width) {
+    return output_bytes_per_task;
+  }
+
+  const OutputSizeRuns &runs = output_size_map(*this).row(timestep);
+  auto run = std::upper_bound(runs.begin(), runs.end(), point,
+                              [](long p, const std::pair<long, size_t> &r) { return p < r.first; });
+  assert(run != runs.begin());
+  return (run - 1)->second;
+}
+
+size_t TaskGraph::max_output_bytes() const
+{
+  size_t result = output_bytes_per_task;
+  if (has_uniform_output(*this) || dependence == DependenceType::GRAPH_FILE) {
+    return result;
+  }
+
+  // Every timestep is needed here, so generate them in parallel.
+  OutputSizeMap &map = output_size_map(*this);
+  std::vector<size_t> chunk_max(parallel_chunks(timesteps), result);
+  parallel_for(timesteps, [&](long chunk, long first, long last) {
+    for (long t = first; t < last; ++t) {
+      for (auto run : map.row(t)) {
+        chunk_max[chunk] = std::max(chunk_max[chunk], run.second);
+      }
+    }
+  });
+  for (auto value : chunk_max) {
+    result = std::max(result, value);
+  }
+  return result;
+}
+
+// Dependencies of a timestep are determined by its dependence set and
+// the active points of it and the previous timestep, so timesteps with
+// the same shape (e.g. every period of a periodic pattern once TREE has
+// reached full width) only need to be counted once. When output sizes
+// vary by timestep, the bytes transferred do not repeat, so every
+// timestep is its own shape.
+struct TimestepShape {
+  long dset, offset, width, last_offset, last_width;
+  long timestep; // -1 unless output sizes vary
+
+  bool operator<(const TimestepShape &o) const
+  {
+    return std::tie(dset, offset, width, last_offset, last_width, timestep) <
+      std::tie(o.dset, o.offset, o.width, o.last_offset, o.last_width, o.timestep);
+  }
+};
+
+struct DependencyStats {
+  long long num_deps;
+  long long local_deps;
+  long long nonlocal_deps;
+  // Output bytes of the producers of local and nonlocal dependencies.
+  long long local_bytes;
+  long long nonlocal_bytes;
+};
+
+// Node owning each point in the local/nonlocal estimate. With
+// -placement other than block, nodes own the points point_owner gives
+// them. Otherwise points of stencil_2d/3d graphs are split into blocks
+// of the grid (the nodes factored like the grid, the largest factor
+// along the longest axis) and those of other graphs into contiguous
+// ranges, as the MPI implementations place them.
+struct NodeMap {
+  long nodes;
+  long max_width;
+  const std::vector<int> *placed;
+  bool grid;
+  long extent[3];
+  long split[3];
+
+  NodeMap(const TaskGraph &g, long nodes)
+    : nodes(nodes), max_width(g.max_width), placed(NULL), grid(false)
+  {
+    if (nodes > 0 && placement_type() != PlacementType::BLOCK) {
+      placed = &point_owners(g, nodes);
+      return;
+    }
+    grid = is_grid_stencil(g.dependence) && nodes > 0;
+    if (!grid) {
+      return;
+    }
+    int rank = grid_rank(g.dependence);
+    stencil_grid(g, extent);
+    long factors[3] = {1, 1, 1};
+    balanced_factors(nodes, rank, factors);
+    int axes[3] = {0, 1, 2};
+    std::stable_sort(axes, axes + rank, [&](int a, int b) { return extent[a] > extent[b]; });
+    split[2] = 1;
+    for (int d = 0; d < rank; ++d) {
+      split[axes[d]] = factors[d];
+    }
+  }
+
+  // Whether the points of a node may not be a contiguous range.
+  bool scattered() const
+  {
+    return grid || placed;
+  }
+
+  long node_of(long point) const
+  {
+    if (placed) {
+      return (*placed)[point];
+    }
+    if (!grid) {
+      // Node n owns the points from n * max_width / nodes.
+      return ((point + 1) * nodes - 1) / max_width;
+    }
+    long x = point % extent[0];
+    long y = (point / extent[0]) % extent[1];
+    long z = point / (extent[0] * extent[1]);
+    return x * split[0] / extent[0] +
+      split[0] * (y * split[1] / extent[1] + split[1] * (z * split[2] / extent[2]));
+  }
+};
+
+static DependencyStats count_dependencies(const TaskGraph &g, long nodes)
+{
+  const NodeMap node_map(g, nodes);
+
+  bool varying = g.dependence == DependenceType::GRAPH_FILE || !has_uniform_output(g);
+  std::map<TimestepShape, long long> repeats;
+  for (long t = 0; t < g.timesteps; ++t) {
+    TimestepShape shape = {g.dependence_set_at_timestep(t),
+                           g.offset_at_timestep(t), g.width_at_timestep(t),
+                           g.offset_at_timestep(t-1), g.width_at_timestep(t-1),
+                           varying ? t : -1};
+    repeats[shape]++;
+  }
+
+  // Flatten the points of all distinct shapes so that the work is split
+  // evenly however many shapes there are.
+  std::vector<std::pair<TimestepShape, long long> > shapes(repeats.begin(), repeats.end());
+  std::vector<long> first_point(shapes.size() + 1, 0);
+  for (size_t s = 0; s < shapes.size(); ++s) {
+    first_point[s+1] = first_point[s] + shapes[s].first.width;
+  }
+
+  std::vector<DependencyStats> chunk_stats(parallel_chunks(first_point.back()), DependencyStats{0, 0, 0, 0, 0});
+  parallel_for(first_point.back(), [&](long chunk, long first, long last) {
+    DependencyStats &stats = chunk_stats[chunk];
+    std::vector<std::pair<long, long> > deps;
+    size_t s = std::upper_bound(first_point.begin(), first_point.end(), first) - first_point.begin() - 1;
+    for (long idx = first; idx < last; ++idx) {
+      while (idx >= first_point[s+1]) {
+        ++s;
+      }
+      const TimestepShape &shape = shapes[s].first;
+      long long repeat = shapes[s].second;
+      long p = shape.offset + idx - first_point[s];
+      // Output bytes of the producers first .. last.
+      auto range_bytes = [&](long first, long last) {
+        if (shape.timestep < 0 || last < first) {
+          return std::max(last - first + 1, 0L) * (long long)g.output_bytes_per_task;
         }
-    }else if (g.output_case==1){
-      //case 1: normal distribution with fixed mu and sigma
-      //float mu = onormal_mu;
-      //float sigma = onormal_std;
-        mu = g.onormal_mu;
-        sigma = g.onormal_std;
-
-        std::normal_distribution<double> distribution(mu,sigma);
-        //int p [width_t] = {};
-
-        for (int i=0; i<nrolls; ++i) {
-          double number = distribution(generator);
-          if ((number>=0)&&(number<width_t)) ++p[int(number)];
+        long long bytes = 0;
+        for (long dep = first; dep <= last; ++dep) {
+          bytes += g.output_bytes_at(shape.timestep - 1, dep);
         }
+        return bytes;
+      };
+
+      long point_node = 0;
+      long node_first = 0;
+      long node_last = -1;
+      if (nodes > 0) {
+        point_node = node_map.node_of(p);
+        node_first = point_node * g.max_width / nodes;
+        node_last = (point_node + 1) * g.max_width / nodes - 1;
+      }
 
-    }else if (g.output_case==2){
-    //case 2: normal distribution with non fixed mu and sigma
-        mu = rand() % width_t;
-        sigma = rand() % (width_t);
-        std::normal_distribution<double> distribution(mu,sigma);
-        //int p [width_t] = {};
-
-        for (int i=0; i<nrolls; ++i) {
-          double number = distribution(generator);
-          if ((number>=0)&&(number<width_t)) ++p[int(number)];
+      deps.resize(g.num_dependencies(shape.dset, p));
+      size_t n_deps = g.dependencies(shape.dset, p, deps.data());
+      for (size_t span = 0; span < n_deps; ++span) {
+        long dep_first, dep_last;
+        std::tie(dep_first, dep_last) = clamp(deps[span].first, deps[span].second, shape.last_offset, shape.last_offset + shape.last_width - 1);
+        stats.num_deps += (dep_last - dep_first + 1) * repeat;
+        if (node_map.scattered()) {
+          for (long dep = dep_first; dep <= dep_last; ++dep) {
+            if (node_map.node_of(dep) == point_node) {
+              stats.local_deps += repeat;
+              stats.local_bytes += range_bytes(dep, dep) * repeat;
+            } else {
+              stats.nonlocal_deps += repeat;
+              stats.nonlocal_bytes += range_bytes(dep, dep) * repeat;
+            }
+          }
+        } else if (nodes > 0) {
+          long initial_first, initial_last, local_first, local_last, final_first, final_last;
+          std::tie(initial_first, initial_last) = clamp(dep_first, dep_last, 0, node_first - 1);
+          std::tie(local_first, local_last) = clamp(dep_first, dep_last, node_first, node_last);
+          std::tie(final_first, final_last) = clamp(dep_first, dep_last, node_last + 1, g.max_width - 1);
+          stats.nonlocal_deps += (initial_last - initial_first + 1) * repeat;
+          stats.local_deps += (local_last - local_first + 1) * repeat;
+          stats.nonlocal_deps += (final_last - final_first + 1) * repeat;
+          stats.nonlocal_bytes += (range_bytes(initial_first, initial_last) +
+                                   range_bytes(final_first, final_last)) * repeat;
+          stats.local_bytes += range_bytes(local_first, local_last) * repeat;
         }
-    }else if (g.output_case==3){
-          float alpha = 2;
-          float beta = 2;
+      }
+    }
+  });
+
+  DependencyStats result = {0, 0, 0, 0, 0};
+  for (auto stats : chunk_stats) {
+    result.num_deps += stats.num_deps;
+    result.local_deps += stats.local_deps;
+    result.nonlocal_deps += stats.nonlocal_deps;
+    result.local_bytes += stats.local_bytes;
+    result.nonlocal_bytes += stats.nonlocal_bytes;
+  }
+  return result;
+}
 
-        std::gamma_distribution<double> distribution(alpha,beta);
-        //int p [width_t] = {};
+// Summary of the elapsed times of -reps runs. ci95 is the half-width of
+// the 95% confidence interval of the mean (Student's t).
+struct RepStats {
+  double min, median, mean, stddev, ci95;
+};
 
-        for (int i=0; i<nrolls; ++i) {
-          double number = distribution(generator);
-          if ((number>=0)&&(number<width_t)) ++p[int(number)];
-        }
+static RepStats rep_stats(std::vector<double> samples)
+{
+  RepStats stats = {0, 0, 0, 0, 0};
+  size_t n = samples.size();
+  if (n == 0) {
+    return stats;
+  }
+  std::sort(samples.begin(), samples.end());
+  stats.min = samples[0];
+  stats.median = n % 2 ? samples[n/2] : (samples[n/2 - 1] + samples[n/2]) / 2;
+  for (auto sample : samples) {
+    stats.mean += sample / n;
+  }
+  if (n > 1) {
+    double sum_squares = 0;
+    for (auto sample : samples) {
+      sum_squares += (sample - stats.mean) * (sample - stats.mean);
     }
+    stats.stddev = std::sqrt(sum_squares / (n - 1));
+    // Two-sided 97.5% quantiles of t for 1 to 30 degrees of freedom.
+    static const double t_975[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042,
+    };
+    double t = n - 1 <= 30 ? t_975[n - 2] : 1.960;
+    stats.ci95 = t * stats.stddev / std::sqrt((double)n);
+  }
+  return stats;
+}
 
-    if(g.output_case>0){
-      int iroll=0;
-      for (int i=0; i<width_t; ++i) {
-        g.output_bytes_size[t][i+offset_t]=((p[i]*nstars/nrolls)+1)*16;
-        iroll = iroll+(g.output_bytes_size[t][i+offset_t]-16)/16;
+static void report_latency(ReportRecord &r, const std::string &prefix, const LatencyHistogram &h)
+{
+  r.set((prefix + "_tasks").c_str(), (long long)h.total);
+  if (h.total == 0) {
+    return;
+  }
+  r.set((prefix + "_min").c_str(), h.min_ns/1e9);
+  r.set((prefix + "_mean").c_str(), h.sum_ns/h.total/1e9);
+  r.set((prefix + "_p50").c_str(), h.quantile(0.5)/1e9);
+  r.set((prefix + "_p99").c_str(), h.quantile(0.99)/1e9);
+  r.set((prefix + "_p999").c_str(), h.quantile(0.999)/1e9);
+  r.set((prefix + "_max").c_str(), h.max_ns/1e9);
+}
+
+static void report_critical_path(ReportRecord &r, const CriticalPath &cp)
+{
+  r.set("work_tasks", cp.work_tasks);
+  r.set("work_iterations", cp.work_iterations);
+  r.set("span_tasks", cp.span_tasks);
+  r.set("span_iterations", cp.span_iterations);
+  r.set("max_parallelism", (long long)cp.max_width);
+}
+
+// Configuration columns of a graph's record; see App::display.
+static void report_graph_config(ReportRecord &r, const TaskGraph &g)
+{
+  r.set("record", "graph");
+  r.set("graph", (long long)g.graph_index);
+  r.set("type", name_by_dtype.at(g.dependence).c_str());
+  r.set("kernel", kernel_type_name(g.kernel.type));
+  r.set("steps", (long long)g.timesteps);
+  r.set("width", (long long)g.max_width);
+  r.set("iterations", (long long)g.kernel.iterations);
+  r.set("output_bytes", (long long)g.output_bytes_per_task);
+  r.set("scratch_bytes", (long long)g.scratch_bytes_per_task);
+  r.set("radix", (long long)g.radix);
+  r.set("period", (long long)g.period);
+  r.set("child", (long long)g.child);
+  r.set("samples", (long long)g.kernel.samples);
+  r.set("imbalance", g.kernel.imbalance);
+}
+
+// Kernel counters next to FLOP/s and B/s: per task, so that they compare
+// with the FLOPs and bytes of an average task whatever the number of
+// processes and runs. DRAM traffic is estimated as one cache line per
+// LLC miss.
+static void print_counters(const CounterTotals &totals, double flops_per_task, double bytes_per_task)
+{
+  printf("Kernel Counters (%llu tasks on this process):\n", (unsigned long long)totals.tasks);
+  if (totals.tasks == 0) {
+    return;
+  }
+  double tasks = totals.tasks;
+  double cycles = totals.values[COUNTER_CYCLES] / tasks;
+  double instructions = totals.values[COUNTER_INSTRUCTIONS] / tasks;
+  double misses = totals.values[COUNTER_LLC_MISSES] / tasks;
+  if (totals.available[COUNTER_CYCLES]) {
+    printf("  Cycles per Task %e\n", cycles);
+  }
+  if (totals.available[COUNTER_INSTRUCTIONS]) {
+    printf("  Instructions per Task %e\n", instructions);
+  }
+  if (totals.available[COUNTER_CYCLES] && totals.available[COUNTER_INSTRUCTIONS] && cycles > 0) {
+    printf("  Instructions per Cycle %.3f\n", instructions / cycles);
+  }
+  if (totals.available[COUNTER_CYCLES] && cycles > 0) {
+    printf("  FLOPs per Cycle %.3f\n", flops_per_task / cycles);
+  }
+  if (totals.available[COUNTER_LLC_MISSES]) {
+    printf("  LLC Misses per Task %e\n", misses);
+    printf("  DRAM Bytes per Task %e (estimated, %e kernel bytes)\n", misses * 64, bytes_per_task);
+  }
+  bool any = false;
+  for (int e = 0; e < NUM_COUNTER_EVENTS; e++) {
+    any = any || totals.available[e];
+  }
+  if (!any) {
+    printf("  Unavailable\n");
+  }
+}
+
+// Busy/idle breakdown over the threads that ran tasks on this process.
+// Thread-seconds not spent in tasks, per task, bound the runtime overhead
+// per task from above (idleness of the graph itself is included); the
+// mean gap between consecutive tasks of a thread is the same measure on
+// busy threads.
+struct UtilizationSummary {
+  std::vector<ThreadUtilization> threads;
+  long long tasks;
+  double busy_seconds;
+  double utilization;
+  double overhead_per_task;
+  double mean_gap;
+};
+
+static UtilizationSummary summarize_utilization(const std::vector<ThreadUtilization> &threads,
+                                                double timed_seconds)
+{
+  UtilizationSummary summary = {threads, 0, 0, 0, 0, 0};
+  long long gaps = 0;
+  double gap_seconds = 0;
+  for (auto &thread : threads) {
+    summary.tasks += thread.tasks;
+    summary.busy_seconds += thread.busy_seconds;
+    gaps += thread.gaps;
+    gap_seconds += thread.gap_seconds;
+  }
+  double thread_seconds = threads.size() * timed_seconds;
+  if (thread_seconds > 0) {
+    summary.utilization = summary.busy_seconds / thread_seconds;
+  }
+  if (summary.tasks > 0) {
+    summary.overhead_per_task = std::max(0.0, thread_seconds - summary.busy_seconds) / summary.tasks;
+  }
+  if (gaps > 0) {
+    summary.mean_gap = gap_seconds / gaps;
+  }
+  return summary;
+}
+
+static void print_utilization(const UtilizationSummary &summary, double timed_seconds)
+{
+  printf("Worker Utilization (%zu threads ran tasks on this process):\n", summary.threads.size());
+  for (size_t i = 0; i < summary.threads.size(); ++i) {
+    auto &thread = summary.threads[i];
+    printf("  Thread %zu: %llu tasks, busy %e seconds (%.3f), mean gap %e seconds\n",
+           i, (unsigned long long)thread.tasks, thread.busy_seconds,
+           timed_seconds > 0 ? thread.busy_seconds / timed_seconds : 0.0,
+           thread.gaps > 0 ? thread.gap_seconds / thread.gaps : 0.0);
+  }
+  printf("  Busy %e seconds of %e thread-seconds (%.3f)\n",
+         summary.busy_seconds, summary.threads.size() * timed_seconds, summary.utilization);
+  printf("  Runtime Overhead per Task %e seconds (idle time included)\n", summary.overhead_per_task);
+  printf("  Mean Gap between Tasks %e seconds\n", summary.mean_gap);
+}
+
+static void print_noise(const NoiseTotals &totals)
+{
+  printf("Injected Noise (timed runs, %llu threads ran tasks on this process):\n",
+         (unsigned long long)totals.threads);
+  printf("  Slow Threads %llu\n", (unsigned long long)totals.slow_threads);
+  printf("  Slowdown %e seconds\n", totals.slow_seconds);
+  printf("  Interruptions %llu, %e seconds\n", (unsigned long long)totals.interruptions,
+         totals.interruption_seconds);
+}
+
+// Memory of the runtime: the peak resident set minus what was resident
+// before the implementation started (core and its tables) and the data
+// of the benchmark itself. That data is the larger of the buffers
+// allocated through alloc_buffer (exact, but not every implementation
+// uses it) and a model of the scratch and two timesteps of outputs of
+// every point, which assumes -nodes processes (1 by default).
+struct MemorySummary {
+  MemoryStats stats;
+  size_t core_buffer_bytes;
+  size_t model_bytes;
+  size_t benchmark_bytes;
+  size_t runtime_bytes;
+  double runtime_bytes_per_task;
+};
+
+static MemorySummary summarize_memory(const App &app, const MemoryStats &stats, long long total_num_tasks)
+{
+  MemorySummary summary;
+  summary.stats = stats;
+  summary.core_buffer_bytes = alloc_peak_bytes();
+  long processes = std::max(app.nodes, 1L);
+  double model = 0;
+  for (auto g : graphs_and_children(app)) {
+    model += double(g.max_width) * (g.scratch_bytes_per_task + 2 * g.output_bytes_per_task);
+  }
+  summary.model_bytes = model / processes;
+  summary.benchmark_bytes = std::max(summary.core_buffer_bytes, summary.model_bytes);
+  size_t owned = stats.baseline_bytes + summary.benchmark_bytes;
+  summary.runtime_bytes = stats.peak_bytes > owned ? stats.peak_bytes - owned : 0;
+  double tasks = double(total_num_tasks) / processes;
+  summary.runtime_bytes_per_task = tasks > 0 ? summary.runtime_bytes / tasks : 0;
+  return summary;
+}
+
+static void print_memory(const MemorySummary &summary)
+{
+  const MemoryStats &stats = summary.stats;
+  printf("Memory (this process):\n");
+  printf("  Baseline RSS %zu bytes\n", stats.baseline_bytes);
+  printf("  Peak RSS %zu bytes\n", stats.peak_bytes);
+  if (stats.samples > 0) {
+    printf("  Steady-State RSS %zu bytes (%zu samples)\n", stats.steady_bytes, stats.samples);
+  }
+  for (size_t node = 0; node < stats.node_peak_bytes.size(); ++node) {
+    printf("  NUMA Node %zu Peak %zu bytes\n", node, stats.node_peak_bytes[node]);
+  }
+  printf("  Benchmark Data %zu bytes (core buffers %zu, model %zu)\n",
+         summary.benchmark_bytes, summary.core_buffer_bytes, summary.model_bytes);
+  printf("  Runtime Memory %zu bytes (peak minus baseline and benchmark data)\n", summary.runtime_bytes);
+  printf("  Runtime Memory per Task %e bytes\n", summary.runtime_bytes_per_task);
+}
+
+// Measured next to the estimates of the whole graph: per run and on this
+// process only, so with -nodes the estimates are divided evenly among the
+// processes for comparison.
+static void print_measured_transfer(const TransferCounts &measured, long long runs, long nodes,
+                                    long long estimated_deps, long long estimated_local,
+                                    long long estimated_nonlocal)
+{
+  long long processes = std::max(nodes, 1L);
+  printf("Transfer (measured on this process, per run):\n");
+  printf("  Tasks %llu\n", (unsigned long long)(measured.tasks / runs));
+  printf("  Dependencies %llu (estimated %lld per process)\n",
+         (unsigned long long)(measured.inputs / runs), estimated_deps / processes);
+  printf("  Input Bytes %llu\n", (unsigned long long)(measured.input_bytes / runs));
+  if (measured.tagged_tasks == 0) {
+    printf("  Inputs not tagged local/nonlocal by this implementation\n");
+    return;
+  }
+  unsigned long long tagged_bytes = measured.input_bytes - measured.untagged_bytes;
+  printf("  Local Bytes %llu", (tagged_bytes - measured.remote_bytes) / runs);
+  if (nodes > 0) {
+    printf(" (estimated %lld per process)", estimated_local / processes);
+  }
+  printf("\n");
+  printf("  Nonlocal Bytes %llu", (unsigned long long)(measured.remote_bytes / runs));
+  if (nodes > 0) {
+    printf(" (estimated %lld per process)", estimated_nonlocal / processes);
+  }
+  printf("\n");
+  printf("  Nonlocal Dependencies %llu\n", (unsigned long long)(measured.remote_inputs / runs));
+  if (measured.tagged_tasks < measured.tasks) {
+    printf("  Untagged Tasks %llu, Input Bytes %llu\n",
+           (unsigned long long)((measured.tasks - measured.tagged_tasks) / runs),
+           (unsigned long long)(measured.untagged_bytes / runs));
+  }
+}
+
+static void print_latency(const LatencyHistogram &h)
+{
+  if (h.total == 0) {
+    return;
+  }
+  printf("  Min %e seconds\n", h.min_ns/1e9);
+  printf("  Mean %e seconds\n", h.sum_ns/h.total/1e9);
+  printf("  p50 %e seconds\n", h.quantile(0.5)/1e9);
+  printf("  p99 %e seconds\n", h.quantile(0.99)/1e9);
+  printf("  p99.9 %e seconds\n", h.quantile(0.999)/1e9);
+  printf("  Max %e seconds\n", h.max_ns/1e9);
+}
+
+std::vector<std::pair<long, long> > App::issue_order() const
+{
+  std::vector<std::pair<long, long> > order;
+  bool weighted = false, open_loop = false;
+  for (auto g : graphs) {
+    weighted = weighted || g.weight != 0;
+    open_loop = open_loop || g.arrival_rate != 0;
+  }
+  if (!weighted || open_loop) {
+    for (size_t i = 0; i < graphs.size(); ++i) {
+      for (long t = 0; t < graphs[i].timesteps; ++t) {
+        order.emplace_back(i, t);
       }
-      for (int i=0; i<width_t; ++i) {
-        size_t old_output = g.output_bytes_size[t][i+offset_t];
-        g.output_bytes_size[t][i+offset_t]=g.output_bytes_size[t][i+offset_t]+((p[i]*(nstars-iroll)/nrolls))*16;
-        iroll = iroll+(g.output_bytes_size[t][i+offset_t]-old_output)/16;
+    }
+    if (open_loop) {
+      std::stable_sort(order.begin(), order.end(), [&](const std::pair<long, long> &a,
+                                                       const std::pair<long, long> &b) {
+        return graphs[a.first].release_time(a.second) < graphs[b.first].release_time(b.second);
+      });
+    }
+    return order;
+  }
+
+  // Each issued timestep advances the pass of its graph by 1/weight, and
+  // the graph with the lowest pass goes next.
+  std::vector<double> pass(graphs.size(), 0.0);
+  std::vector<long> next(graphs.size(), 0);
+  while (true) {
+    long best = -1;
+    for (size_t i = 0; i < graphs.size(); ++i) {
+      if (next[i] >= graphs[i].timesteps) {
+        continue;
       }
-      g.output_bytes_size[t][width_t-1+offset_t]=g.output_bytes_size[t][width_t-1+offset_t]+((nstars-iroll)*16);
+      if (best < 0 || pass[i] < pass[best] ||
+          (pass[i] == pass[best] && graphs[i].priority > graphs[best].priority)) {
+        best = i;
+      }
+    }
+    if (best < 0) {
+      break;
     }
+    order.emplace_back(best, next[best]++);
+    pass[best] += 1.0 / (graphs[best].weight != 0 ? graphs[best].weight : 1.0);
   }
+  return order;
 }
+
+void App::start_arrivals() const
+{
+  arrival_start = Timer::get_cur_time();
+  arrivals_started = true;
 }
 
 void App::report_timing(double elapsed_seconds) const
 {
+  if (metg) {
+    fprintf(stderr, "error: this implementation does not support " METG_FLAG "\n");
+    abort();
+  }
+  if ((warmup >= 0 || reps > 1) && rep_elapsed.empty()) {
+    fprintf(stderr, "error: this implementation does not support " WARMUP_FLAG " or " REPS_FLAG "\n");
+    abort();
+  }
+
+  // The timed region (the last run, with -reps) ended just before this call.
+  double last_elapsed = rep_elapsed.empty() ? elapsed_seconds : rep_elapsed.back();
+  double start_time = Timer::get_cur_time() - last_elapsed;
+
   long long total_num_tasks = 0;
   long long total_num_deps = 0;
   long long total_local_deps = 0;
@@ -1481,61 +4579,69 @@ void App::report_timing(double elapsed_seconds) const
   long long bytes = 0;
   long long local_transfer = 0;
   long long nonlocal_transfer = 0;
-  for (auto g : graphs) {
-    long long num_tasks = 0;
-    long long num_deps = 0;
-    long long local_deps = 0;
-    long long nonlocal_deps = 0;
+  long long dependent_loads = 0;
+  long long io_operations = 0;
+  long long io_bytes = 0;
+  std::vector<TaskGraph> all = graphs_and_children(*this);
+  // A child graph runs once per task of its parent, within that task.
+  std::vector<long long> instances(all.size(), 1);
+  for (auto g : all) {
+    if (g.child) {
+      instances[g.child] = instances[g.graph_index] * count_tasks(g);
+    }
+  }
+  // -report: the run, then each graph by graph_index.
+  std::vector<ReportRecord> records(report_enabled() ? all.size() + 1 : 0);
+  for (auto g : all) {
 #ifdef DEBUG_CORE
     if (enable_graph_validation) {
       assert((has_executed_graph.load() & (1 << g.graph_index)) != 0);
     }
 #endif
-    for (long t = 0; t < g.timesteps; ++t) {
-      long offset = g.offset_at_timestep(t);
-      long width = g.width_at_timestep(t);
-      long last_offset = g.offset_at_timestep(t-1);
-      long last_width = g.width_at_timestep(t-1);
-      long dset = g.dependence_set_at_timestep(t);
-
-      num_tasks += width;
-
-      for (long p = offset; p < offset + width; ++p) {
-        long point_node = 0;
-        long node_first = 0;
-        long node_last = -1;
-        if (nodes > 0) {
-          point_node = p*nodes/g.max_width;
-          node_first = point_node * g.max_width / nodes;
-          node_last = (point_node + 1) * g.max_width / nodes - 1;
-        }
-
-        auto deps = g.dependencies(dset, p);
-        for (auto dep : deps) {
-          long dep_first, dep_last;
-          std::tie(dep_first, dep_last) = clamp(dep.first, dep.second, last_offset, last_offset + last_width - 1);
-          num_deps += dep_last - dep_first + 1;
-          if (nodes > 0) {
-            long initial_first, initial_last, local_first, local_last, final_first, final_last;
-            std::tie(initial_first, initial_last) = clamp(dep_first, dep_last, 0, node_first - 1);
-            std::tie(local_first, local_last) = clamp(dep_first, dep_last, node_first, node_last);
-            std::tie(final_first, final_last) = clamp(dep_first, dep_last, node_last + 1, g.max_width - 1);
-            nonlocal_deps += initial_last - initial_first + 1;
-            local_deps += local_last - local_first + 1;
-            nonlocal_deps += final_last - final_first + 1;
-          }
-        }
-      }
+    long long n = instances[g.graph_index];
+    long long num_tasks = n * count_tasks(g);
+    DependencyStats stats = count_dependencies(g, nodes);
+    long long num_deps = n * stats.num_deps;
+    long long local_deps = n * stats.local_deps;
+    long long nonlocal_deps = n * stats.nonlocal_deps;
+    long long local_bytes = n * stats.local_bytes;
+    long long nonlocal_bytes = n * stats.nonlocal_bytes;
+    if (g.graph_index >= (long)graphs.size()) {
+      local_deps = num_deps;
+      nonlocal_deps = 0;
+      local_bytes += nonlocal_bytes;
+      nonlocal_bytes = 0;
     }
 
     total_num_tasks += num_tasks;
     total_num_deps += num_deps;
     total_local_deps += local_deps;
     total_nonlocal_deps += nonlocal_deps;
-    flops += count_flops(g);
-    bytes += count_bytes(g);
-    local_transfer += local_deps * g.output_bytes_per_task;
-    nonlocal_transfer += nonlocal_deps * g.output_bytes_per_task;
+    long long graph_flops = n * count_flops(g);
+    long long graph_bytes = n * count_bytes(g);
+    flops += graph_flops;
+    bytes += graph_bytes;
+    dependent_loads += n * count_dependent_loads(g);
+    io_operations += n * count_io_operations(g);
+    io_bytes += n * count_io_operations(g) * io_kernel_block(g.kernel);
+    local_transfer += local_bytes;
+    nonlocal_transfer += nonlocal_bytes;
+
+    if (report_enabled()) {
+      ReportRecord &r = records[g.graph_index + 1];
+      report_graph_config(r, g);
+      r.set("tasks", num_tasks);
+      r.set("dependencies", num_deps);
+      if (nodes > 0) {
+        r.set("local_dependencies", local_deps);
+        r.set("nonlocal_dependencies", nonlocal_deps);
+        r.set("local_transfer_bytes", local_bytes);
+        r.set("nonlocal_transfer_bytes", nonlocal_bytes);
+      }
+      r.set("flops", graph_flops);
+      r.set("bytes", graph_bytes);
+      r.set("elapsed_seconds", elapsed_seconds);
+    }
   }
 
   printf("Total Tasks %lld\n", total_num_tasks);
@@ -1550,10 +4656,51 @@ void App::report_timing(double elapsed_seconds) const
   printf("Total FLOPs %lld\n", flops);
   printf("Total Bytes %lld\n", bytes);
   printf("Elapsed Time %e seconds\n", elapsed_seconds);
+  RepStats stats = rep_stats(rep_elapsed);
+  if (rep_elapsed.size() > 1) {
+    printf("  Repetitions %zu (median reported)\n", rep_elapsed.size());
+    printf("  Min %e seconds\n", stats.min);
+    printf("  Median %e seconds\n", stats.median);
+    printf("  Mean %e seconds\n", stats.mean);
+    printf("  Stddev %e seconds\n", stats.stddev);
+    printf("  95%% CI of Mean [%e, %e] seconds\n", stats.mean - stats.ci95, stats.mean + stats.ci95);
+  }
   printf("FLOP/s %e\n", flops/elapsed_seconds);
   printf("B/s %e\n", bytes/elapsed_seconds);
+  if (dependent_loads > 0) {
+    printf("Total Dependent Loads %lld\n", dependent_loads);
+    printf("Latency per Load %e ns\n", elapsed_seconds * 1e9 / dependent_loads);
+  }
+  if (io_operations > 0) {
+    printf("Total I/O Operations %lld\n", io_operations);
+    printf("Total I/O Bytes %lld\n", io_bytes);
+    printf("IOPS %e\n", io_operations/elapsed_seconds);
+    printf("I/O B/s %e\n", io_bytes/elapsed_seconds);
+  }
+  if (counters_enabled()) {
+    print_counters(counters_collect(), double(flops)/total_num_tasks, double(bytes)/total_num_tasks);
+  }
+  // Wall time of all timed runs, which the thread totals cover.
+  double timed_seconds = elapsed_seconds;
+  if (!rep_elapsed.empty()) {
+    timed_seconds = std::accumulate(rep_elapsed.begin(), rep_elapsed.end(), 0.0);
+  }
+  UtilizationSummary utilization = summarize_utilization(utilization_collect(), timed_seconds);
+  if (utilization_enabled()) {
+    print_utilization(utilization, timed_seconds);
+  }
+  NoiseTotals noise = noise_collect();
+  if (noise_enabled()) {
+    print_noise(noise);
+  }
+  MemorySummary memory = {};
+  if (memory_enabled()) {
+    memory = summarize_memory(*this, memory_collect(), total_num_tasks);
+    print_memory(memory);
+  }
   printf("Transfer (estimated):\n");
   if (nodes > 0) {
+    printf("  Placement %s over %ld nodes\n", placement_name(placement_type()), nodes);
     printf("  Local Bytes %lld\n", local_transfer);
     printf("  Nonlocal Bytes %lld\n", nonlocal_transfer);
     printf("  Local Bandwidth %e B/s\n", local_transfer/elapsed_seconds);
@@ -1561,8 +4708,318 @@ void App::report_timing(double elapsed_seconds) const
   } else {
     printf("  Unable to estimate local/nonlocal transfer\n");
   }
+  TransferCounts measured = TransferCounts();
+  if (transfer_enabled()) {
+    for (auto g : all) {
+      TransferCounts counts = transfer_collect(g.graph_index);
+      measured.tasks += counts.tasks;
+      measured.inputs += counts.inputs;
+      measured.input_bytes += counts.input_bytes;
+      measured.tagged_tasks += counts.tagged_tasks;
+      measured.remote_inputs += counts.remote_inputs;
+      measured.remote_bytes += counts.remote_bytes;
+      measured.untagged_bytes += counts.untagged_bytes;
+    }
+    print_measured_transfer(measured, std::max<size_t>(rep_elapsed.size(), 1),
+                            nodes, total_num_deps, local_transfer, nonlocal_transfer);
+  }
+
+  if (graphs.size() > 1) {
+    printf("Completion Time (tasks on this process):\n");
+    for (auto g : graphs) {
+      double end_time = completion_times[g.graph_index].load();
+      if (end_time == 0) {
+        printf("  Task Graph %ld none\n", g.graph_index + 1);
+      } else {
+        printf("  Task Graph %ld %e seconds\n", g.graph_index + 1, end_time - start_time);
+        if (report_enabled()) {
+          records[g.graph_index + 1].set("completion_seconds", end_time - start_time);
+        }
+      }
+    }
+  }
+
+  // Children have higher graph indices than their parents.
+  std::vector<CriticalPath> paths(all.size(), CriticalPath{0, 0, 0, 0, 0});
+  for (auto g = all.rbegin(); g != all.rend(); ++g) {
+    CriticalPath none = {0, 0, 0, 0, 0};
+    paths[g->graph_index] = critical_path(*g, g->child ? paths[g->child] : none);
+    if (report_enabled()) {
+      report_critical_path(records[g->graph_index + 1], paths[g->graph_index]);
+    }
+  }
+  CriticalPath combined = {0, 0, 0, 0, 0};
+  for (auto g : graphs) {
+    const CriticalPath &cp = paths[g.graph_index];
+    printf("Critical Path (graph %ld):\n", g.graph_index);
+    print_critical_path(cp, workers);
+    combined.work_tasks += cp.work_tasks;
+    combined.work_iterations += cp.work_iterations;
+    combined.span_tasks = std::max(combined.span_tasks, cp.span_tasks);
+    combined.span_iterations = std::max(combined.span_iterations, cp.span_iterations);
+    combined.max_width += cp.max_width;
+  }
+  if (graphs.size() > 1) {
+    printf("Critical Path (all graphs):\n");
+    print_critical_path(combined, workers);
+  }
+  if (report_enabled()) {
+    report_critical_path(records[0], combined);
+  }
+
+  if (record_task_latency) {
+    for (auto g : all) {
+      LatencyHistogram h = latency_collect(g.graph_index);
+      printf("Task Latency (graph %ld, %llu tasks on this process):\n",
+             g.graph_index, (unsigned long long)h.total);
+      print_latency(h);
+      if (report_enabled()) {
+        report_latency(records[g.graph_index + 1], "latency", h);
+      }
+    }
+  }
+
+  for (auto g : graphs) {
+    if (g.arrival_rate == 0) {
+      continue;
+    }
+    printf("Task Response Time (graph %ld, %e timesteps/s offered", g.graph_index, g.arrival_rate);
+    if (!arrivals_started) {
+      printf("):\n  Not measured, this implementation does not release timesteps\n");
+      continue;
+    }
+    LatencyHistogram h = latency_collect(g.graph_index, LatencyKind::RESPONSE);
+    printf(", %llu tasks on this process):\n", (unsigned long long)h.total);
+    print_latency(h);
+    if (report_enabled()) {
+      report_latency(records[g.graph_index + 1], "response", h);
+    }
+  }
+
+  if (report_enabled()) {
+    ReportRecord &r = records[0];
+    r.set("record", "run");
+    r.set("ngraphs", (long long)graphs.size());
+    if (nodes > 0) {
+      r.set("nodes", (long long)nodes);
+      r.set("placement", placement_name(placement_type()));
+      r.set("local_dependencies", total_local_deps);
+      r.set("nonlocal_dependencies", total_nonlocal_deps);
+      r.set("local_transfer_bytes", local_transfer);
+      r.set("nonlocal_transfer_bytes", nonlocal_transfer);
+    }
+    r.set("workers", (long long)workers);
+    r.set("tasks", total_num_tasks);
+    r.set("dependencies", total_num_deps);
+    r.set("flops", flops);
+    r.set("bytes", bytes);
+    r.set("elapsed_seconds", elapsed_seconds);
+    r.set("flops_per_second", flops/elapsed_seconds);
+    r.set("bytes_per_second", bytes/elapsed_seconds);
+    if (rep_elapsed.size() > 1) {
+      r.set("reps", (long long)rep_elapsed.size());
+      r.set("elapsed_min", stats.min);
+      r.set("elapsed_median", stats.median);
+      r.set("elapsed_mean", stats.mean);
+      r.set("elapsed_stddev", stats.stddev);
+      r.set("elapsed_ci95", stats.ci95);
+    }
+    if (counters_enabled()) {
+      CounterTotals totals = counters_collect();
+      r.set("counter_tasks", (long long)totals.tasks);
+      const char *names[NUM_COUNTER_EVENTS] = {"cycles", "instructions", "llc_misses"};
+      for (int e = 0; e < NUM_COUNTER_EVENTS; e++) {
+        if (totals.available[e]) {
+          r.set(names[e], (long long)totals.values[e]);
+        }
+      }
+    }
+    if (utilization_enabled()) {
+      r.set("utilization_threads", (long long)utilization.threads.size());
+      r.set("busy_seconds", utilization.busy_seconds);
+      r.set("utilization", utilization.utilization);
+      r.set("overhead_per_task", utilization.overhead_per_task);
+      r.set("mean_gap", utilization.mean_gap);
+    }
+    if (noise_enabled()) {
+      r.set("slow_threads", (long long)noise.slow_threads);
+      r.set("noise_interruptions", (long long)noise.interruptions);
+      r.set("noise_seconds", noise.interruption_seconds);
+      r.set("slow_seconds", noise.slow_seconds);
+    }
+    if (transfer_enabled()) {
+      long long runs = std::max<size_t>(rep_elapsed.size(), 1);
+      r.set("measured_dependencies", (long long)measured.inputs / runs);
+      r.set("measured_input_bytes", (long long)measured.input_bytes / runs);
+      r.set("measured_nonlocal_dependencies", (long long)measured.remote_inputs / runs);
+      r.set("measured_nonlocal_bytes", (long long)measured.remote_bytes / runs);
+      r.set("measured_untagged_bytes", (long long)measured.untagged_bytes / runs);
+    }
+    if (memory_enabled()) {
+      r.set("rss_baseline", (long long)memory.stats.baseline_bytes);
+      r.set("rss_peak", (long long)memory.stats.peak_bytes);
+      r.set("rss_steady", (long long)memory.stats.steady_bytes);
+      r.set("benchmark_data_bytes", (long long)memory.benchmark_bytes);
+      r.set("runtime_memory_bytes", (long long)memory.runtime_bytes);
+      r.set("runtime_memory_per_task", memory.runtime_bytes_per_task);
+    }
+    if (trace_enabled()) {
+      size_t recorded, dropped;
+      trace_counts(recorded, dropped);
+      r.set("trace_events", (long long)recorded);
+      r.set("trace_dropped", (long long)dropped);
+    }
+    report_write(records);
+  }
 
 #ifdef DEBUG_CORE
   printf("Task Graph Execution Mask %llx\n", has_executed_graph.load());
 #endif
 }
+
+// Sets the iterations of every graph to original / scale (at least 1),
+// including the copies that child instances and the resolved kernels
+// are made from.
+static void scale_iterations(App &app, const std::vector<long> &original, double scale)
+{
+  for (std::vector<TaskGraph> *list : {&app.graphs, &app.child_graphs}) {
+    for (TaskGraph &g : *list) {
+      g.kernel.iterations = std::max(1L, std::lround(original[g.graph_index] / scale));
+      nested_graphs[g.graph_index].kernel = g.kernel;
+      Kernel k(g.kernel);
+      resolved_kernels[g.graph_index] = {k, k.resolve()};
+    }
+  }
+}
+
+void App::search_metg(const std::function<double()> &run, long n_workers, bool report)
+{
+  std::vector<TaskGraph> all = graphs_and_children(*this);
+  std::vector<long> original(all.size());
+  long max_iterations = 0;
+  for (auto g : all) {
+    original[g.graph_index] = g.kernel.iterations;
+    max_iterations = std::max(max_iterations, g.kernel.iterations);
+  }
+
+  // Iterations and tasks of one run, counting each child instance.
+  std::vector<long long> instances(all.size(), 1);
+  for (auto g : all) {
+    if (g.child) {
+      instances[g.child] = instances[g.graph_index] * count_tasks(g);
+    }
+  }
+  auto count_work = [&](long long &iterations, long long &tasks) {
+    iterations = tasks = 0;
+    for (auto g : graphs_and_children(*this)) {
+      long long n = instances[g.graph_index] * count_tasks(g);
+      iterations += n * g.kernel.iterations;
+      tasks += n;
+    }
+  };
+
+  struct Sample {
+    double scale;
+    double elapsed;
+    double efficiency;
+    long long tasks;
+  };
+  double base_rate = 0;
+  auto measure = [&](double scale) {
+    scale_iterations(*this, original, scale);
+    long long iterations, tasks;
+    count_work(iterations, tasks);
+    if (io_prepare_runs) {
+      run(); // writes the extents for the scaled iterations
+    }
+    double elapsed = run();
+    double rate = iterations / elapsed;
+    if (base_rate == 0) {
+      base_rate = rate;
+    }
+    Sample sample = {scale, elapsed, rate / base_rate, tasks};
+    if (report) {
+      printf("METG Run: iterations %ld, elapsed %e seconds, efficiency %.3f\n",
+             std::max(1L, std::lround(max_iterations / scale)), elapsed, sample.efficiency);
+    }
+    return sample;
+  };
+  auto same_iterations = [&](double a, double b) {
+    return std::lround(max_iterations / a) == std::lround(max_iterations / b);
+  };
+
+  // The iterations given on the command line are the reference: they
+  // should be large enough that overheads do not show. The first run
+  // only warms up.
+  scale_iterations(*this, original, 1.0);
+  run();
+  Sample best = measure(1.0);
+
+  // Halve the granularity until efficiency falls below the threshold...
+  double bad = 0;
+  while (std::lround(max_iterations / best.scale) > 1) {
+    Sample sample = measure(best.scale * 2);
+    if (sample.efficiency < metg_efficiency) {
+      bad = sample.scale;
+      break;
+    }
+    best = sample;
+  }
+
+  // ... then bisect (geometrically) between the last two runs.
+  for (int step = 0; bad > 0 && step < METG_BISECTION_STEPS; ++step) {
+    double scale = std::sqrt(best.scale * bad);
+    if (same_iterations(scale, best.scale) || same_iterations(scale, bad)) {
+      break;
+    }
+    Sample sample = measure(scale);
+    if (sample.efficiency < metg_efficiency) {
+      bad = scale;
+    } else {
+      best = sample;
+    }
+  }
+
+  scale_iterations(*this, original, 1.0);
+
+  if (report) {
+    // Task granularity as in scripts/chart_metg.py: wall time per task
+    // times the number of workers.
+    double granularity = best.elapsed * n_workers / best.tasks;
+    printf("METG (%.0f%% efficiency) %e us\n", metg_efficiency * 100, granularity * 1e6);
+    printf("  Iterations %ld\n", std::max(1L, std::lround(max_iterations / best.scale)));
+    printf("  Efficiency %.3f\n", best.efficiency);
+    printf("  Workers %ld\n", n_workers);
+    if (bad == 0) {
+      printf("  Efficiency stays above the threshold at 1 iteration, so this is an upper bound\n");
+    }
+  }
+}
+
+void App::execute_timed(const std::function<double()> &run, bool report, long default_warmup)
+{
+  long warmup_runs = warmup >= 0 ? warmup : default_warmup;
+  if (io_prepare_runs) {
+    warmup_runs = std::max(warmup_runs, 1L);
+  }
+  for (long i = 0; i < warmup_runs; ++i) {
+    run();
+  }
+  if (warmup_runs > 0) {
+    latency_reset();
+    counters_reset();
+    utilization_reset();
+    transfer_reset();
+    noise_reset();
+  }
+
+  rep_elapsed.clear();
+  for (long i = 0; i < reps; ++i) {
+    utilization_new_run();
+    rep_elapsed.push_back(run());
+  }
+
+  if (report) {
+    report_timing(rep_stats(rep_elapsed).median);
+  }
+}
@@ -18,6 +18,7 @@
 
 #include "core_c.h"
 
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -26,18 +27,34 @@ typedef dependence_type_t DependenceType;
 typedef kernel_type_t KernelType;
 
 typedef dist_type_t DistType;
+typedef io_mode_t IoMode;
+typedef arrival_type_t ArrivalType;
 
 typedef dist_param_type_t DistParam;
 
+typedef validation_type_t ValidationType;
+
 struct TaskGraph;
 
+struct DependencyTable;
+
+struct GraphFile;
+
 struct Kernel : public kernel_t {
   Kernel() = default;
   Kernel(kernel_t k) : kernel_t(k) {}
 
+  // Executes a task of this kernel; resolve() picks the function for the
+  // kernel's type (and threads) so that it can be looked up once per graph.
+  typedef void (*Function)(const Kernel &kernel, long graph_index, long timestep, long point,
+                           char *scratch_ptr, size_t scratch_bytes);
+  Function resolve() const;
+
 private:
   void execute(long graph_index, long timestep, long point,
                char *scratch_ptr, size_t scratch_bytes) const;
+  void execute_threaded(long graph_index, long timestep, long point,
+                        char *scratch_ptr, size_t scratch_bytes) const;
   friend struct TaskGraph;
 };
 
@@ -53,6 +70,12 @@ struct TaskGraph : public task_graph_t {
   long timestep_period() const;
   long dependence_set_at_timestep(long timestep) const;
 
+  // Open-loop arrivals (-arrival-rate): seconds after App::start_arrivals
+  // at which timestep is released, 0 for closed-loop graphs. Backends
+  // call wait_for_release before issuing the tasks of a timestep.
+  double release_time(long timestep) const;
+  void wait_for_release(long timestep) const;
+
   // std::pair(a, b) represents the INCLUSIVE interval from a to b
   std::vector<std::pair<long, long> > reverse_dependencies(long dset, long point) const;
   std::vector<std::pair<long, long> > dependencies(long dset, long point) const;
@@ -68,25 +91,203 @@ struct TaskGraph : public task_graph_t {
   size_t num_reverse_dependencies(long dset, long point) const;
   size_t num_dependencies(long dset, long point) const;
 
+  // Allocation-free iteration: f(first, last) for every INCLUSIVE
+  // interval, or f(dep) for every point with the _point variants.
+  // Intervals are read from the dependency table when there is one and
+  // otherwise generated into a stack buffer, so f may itself iterate
+  // dependencies.
+  template <typename F>
+  void for_each_dependency(long dset, long point, F f) const
+  {
+    for_each_interval(dset, point, false, f);
+  }
+  template <typename F>
+  void for_each_reverse_dependency(long dset, long point, F f) const
+  {
+    for_each_interval(dset, point, true, f);
+  }
+  template <typename F>
+  void for_each_dependency_point(long dset, long point, F f) const
+  {
+    for_each_dependency(dset, point, [&](long first, long last) {
+      for (long dep = first; dep <= last; ++dep) f(dep);
+    });
+  }
+  template <typename F>
+  void for_each_reverse_dependency_point(long dset, long point, F f) const
+  {
+    for_each_reverse_dependency(dset, point, [&](long first, long last) {
+      for (long dep = first; dep <= last; ++dep) f(dep);
+    });
+  }
+
+  // Precomputed dependencies for this graph (built by App), or NULL
+  // if no table is available in this process. When present, all of
+  // the dependency methods above read from the table.
+  const DependencyTable *dependency_table() const;
+
   void execute_point(long timestep, long point,
                      char *output_ptr, size_t output_bytes,
                      const char **input_ptr, const size_t *input_bytes,
                      size_t n_inputs,
                      char *scratch_ptr, size_t scratch_bytes) const;
-  void allocate_bytes(int output_case);
+  // Nested graphs (-child): when child is set, every task of this graph
+  // expands into an instance of the child graph, which runs after the
+  // task's inputs are validated and before its own kernel. execute_point
+  // runs the instance inline on the calling thread. Runtimes with nested
+  // launches run child_instance(timestep, point) like any other graph
+  // instead and pass the outputs of its last timestep (in point order) to
+  // execute_parent_point, which validates them.
+  TaskGraph child_instance(long timestep, long point) const;
+  void execute_parent_point(long timestep, long point,
+                            char *output_ptr, size_t output_bytes,
+                            const char **input_ptr, const size_t *input_bytes,
+                            size_t n_inputs,
+                            const char **child_ptr, const size_t *child_bytes,
+                            size_t n_child_outputs,
+                            char *scratch_ptr, size_t scratch_bytes) const;
+  // Output size of a task. Closed form for -output-case 0; otherwise
+  // generated per timestep on first use and kept run-length encoded.
+  // Inactive points report output_bytes_per_task.
+  size_t output_bytes_at(long timestep, long point) const;
+  size_t max_output_bytes() const;
+  // Kernel iterations a task performs: those of its graph file task, or
+  // as drawn by load_imbalance and dist_imbalance.
+  long task_iterations(long timestep, long point) const;
+  // The input checks of execute_point alone, for backends that run the
+  // kernel elsewhere (e.g. gpu_execute_point) and bring inputs back to
+  // the host to validate them.
+  void validate_inputs(long timestep, long point,
+                       const char **input_ptr, const size_t *input_bytes,
+                       size_t n_inputs) const;
   static void prepare_scratch(char *scratch_ptr, size_t scratch_bytes);
+  // Scratch for n_tasks consecutive tasks from alloc_buffer (alloc.h),
+  // each prepared separately. With -numa the pages are bound to node and
+  // prepared in parallel; otherwise the calling thread touches them.
+  static char *allocate_scratch(size_t scratch_bytes, long n_tasks, int node);
+  static void free_scratch(char *scratch_ptr);
+  // For -measure-transfer: implementations that know where inputs come
+  // from mark those of the calling thread's next execute_point that came
+  // from another process (remote[i] nonzero). Check measuring_transfer
+  // first to skip the work.
+  static bool measuring_transfer();
+  static void tag_remote_inputs(const char *remote, size_t n_inputs);
+
+private:
+  // Intervals generated on the stack by for_each_interval; larger sets
+  // (only possible without a dependency table) go to the heap.
+  static const size_t MAX_STACK_INTERVALS = 64;
+
+  // Points deps at the table's intervals and returns true, or returns
+  // false with an upper bound on the number of intervals in count.
+  bool table_intervals(long dset, long point, bool reverse,
+                       const std::pair<long, long> *&deps, size_t &count) const;
+  template <typename F>
+  void for_each_interval(long dset, long point, bool reverse, F &f) const
+  {
+    const std::pair<long, long> *deps;
+    size_t count;
+    if (table_intervals(dset, point, reverse, deps, count)) {
+      for (size_t i = 0; i < count; ++i) f(deps[i].first, deps[i].second);
+      return;
+    }
+    std::pair<long, long> stack[MAX_STACK_INTERVALS];
+    std::vector<std::pair<long, long> > heap;
+    std::pair<long, long> *buffer = stack;
+    if (count > MAX_STACK_INTERVALS) {
+      heap.resize(count);
+      buffer = heap.data();
+    }
+    count = reverse ? reverse_dependencies(dset, point, buffer) : dependencies(dset, point, buffer);
+    for (size_t i = 0; i < count; ++i) f(buffer[i].first, buffer[i].second);
+  }
+
+  void execute_task(long timestep, long point,
+                    char *output_ptr, size_t output_bytes,
+                    const char **input_ptr, const size_t *input_bytes,
+                    size_t n_inputs,
+                    const char **child_ptr, const size_t *child_bytes,
+                    size_t n_child_outputs,
+                    char *scratch_ptr, size_t scratch_bytes) const;
+};
+
+// Flattened (CSR) dependencies and reverse dependencies for every
+// dependence set of a graph. Intervals for (dset, point) are stored at
+// [offsets[dset*max_width + point], offsets[dset*max_width + point + 1]).
+// Graph files already store their intervals this way and are read in
+// place.
+struct DependencyTable {
+  // Parameters of the graph this table was built for.
+  long graph_index;
+  long max_width;
+  DependenceType dependence;
+  long radix;
+  long period;
+  double fraction_connected;
+  long dims[3];
+
+  long num_dsets;
+  // Set for graph files, whose intervals are read from the mapped file.
+  const GraphFile *file;
+  std::vector<size_t> offsets;
+  std::vector<std::pair<long, long> > intervals;
+  std::vector<size_t> reverse_offsets;
+  std::vector<std::pair<long, long> > reverse_intervals;
+
+  DependencyTable(const TaskGraph &graph);
+
+  bool matches(const TaskGraph &graph) const;
+
+  // Return a pointer into the table and store the number of intervals
+  // in count. Pointers remain valid for the lifetime of the App.
+  const std::pair<long, long> *dependencies(long dset, long point, size_t &count) const;
+  const std::pair<long, long> *reverse_dependencies(long dset, long point, size_t &count) const;
 };
 
 struct App {
   std::vector<TaskGraph> graphs;
+  // Graphs that the tasks of other graphs expand into (-child). They are
+  // numbered after graphs and only run through TaskGraph::child_instance.
+  std::vector<TaskGraph> child_graphs;
   long nodes;
+  long workers; // for the ideal makespan (-workers), 0 until App::App sets it
   int verbose;
   bool enable_graph_validation;
+  bool metg; // -metg: search for the METG instead of one timed run
+  double metg_efficiency; // -metg-efficiency threshold (default 0.5)
+  long warmup; // -warmup: untimed runs (-1: the implementation's default)
+  long reps; // -reps: timed runs (default 1)
+  std::vector<double> rep_elapsed; // seconds of each timed run, see execute_timed
 
   App(int argc, char **argv);
   void check() const;
   void display() const;
+  // Starts the clock of open-loop arrivals, at the start of the timed
+  // region. Task response times are measured from the release times.
+  void start_arrivals() const;
   void report_timing(double elapsed_seconds) const;
+  // For -metg, in place of report_timing. run() executes every graph once
+  // and returns the elapsed seconds, agreed on by all processes. The
+  // search divides kernel iterations until efficiency, relative to the
+  // iterations given on the command line, falls below metg_efficiency,
+  // bisects the last interval, and (if report) prints the METG. The
+  // granularity is per worker: n_workers is how many the implementation
+  // ran with (threads, or ranks times threads), not the -workers of the
+  // ideal makespan.
+  void search_metg(const std::function<double()> &run, long n_workers, bool report = true);
+  // Runs run() for the -warmup runs (default_warmup if not given), then
+  // for the -reps timed runs, and reports the median with statistics
+  // across the runs. As for search_metg, report is false on processes
+  // that do not print.
+  void execute_timed(const std::function<double()> &run, bool report = true,
+                     long default_warmup = 0);
+
+  // (graph, timestep) pairs of graphs, in the order a single thread
+  // should issue them. Without -weight the graphs go one after another;
+  // otherwise their timesteps are interleaved in proportion to their
+  // weights (stride scheduling), ties going to the higher -priority.
+  // With any open-loop graph, all timesteps go in order of release.
+  std::vector<std::pair<long, long> > issue_order() const;
 };
 
 // Make sure core types are POD
@@ -96,5 +297,8 @@ static_assert(std::is_pod<TaskGraph>::value, "TaskGraph must be POD");
 long long count_flops_per_task(const TaskGraph &g, long timestep, long point);
 long long count_bytes_per_task(const TaskGraph &g, long timestep, long point);
 
-void allocate_bytes(TaskGraph &g);
+// Kernel types by their -kernel names. kernel_type_by_name returns false
+// for unknown names.
+bool kernel_type_by_name(const char *name, KernelType &type);
+const char *kernel_type_name(KernelType type);
 #endif
@@ -56,6 +56,18 @@ App * unwrap(app_t a) {
   return reinterpret_cast<App *>(a.impl);
 }
 
+size_t task_graph_output_bytes_at(task_graph_t graph, long timestep, long point)
+{
+  TaskGraph t(graph);
+  return t.output_bytes_at(timestep, point);
+}
+
+size_t task_graph_max_output_bytes(task_graph_t graph)
+{
+  TaskGraph t(graph);
+  return t.max_output_bytes();
+}
+
 long task_graph_offset_at_timestep(task_graph_t graph, long timestep)
 {
   TaskGraph t(graph);
@@ -86,6 +98,24 @@ long task_graph_dependence_set_at_timestep(task_graph_t graph, long timestep)
   return t.dependence_set_at_timestep(timestep);
 }
 
+double task_graph_release_time(task_graph_t graph, long timestep)
+{
+  TaskGraph t(graph);
+  return t.release_time(timestep);
+}
+
+void task_graph_wait_for_release(task_graph_t graph, long timestep)
+{
+  TaskGraph t(graph);
+  t.wait_for_release(timestep);
+}
+
+task_graph_t task_graph_child_instance(task_graph_t graph, long timestep, long point)
+{
+  TaskGraph t(graph);
+  return t.child_instance(timestep, point);
+}
+
 interval_list_t task_graph_reverse_dependencies(task_graph_t graph, long dset, long point)
 {
   TaskGraph t(graph);
@@ -98,6 +128,96 @@ interval_list_t task_graph_dependencies(task_graph_t graph, long dset, long poin
   return wrap_consume(t.dependencies(dset, point));
 }
 
+void task_graph_for_each_reverse_dependency(task_graph_t graph, long dset, long point,
+                                            interval_visitor_t visit, void *data)
+{
+  TaskGraph t(graph);
+  t.for_each_reverse_dependency(dset, point, [=](long first, long last) { visit(first, last, data); });
+}
+
+void task_graph_for_each_dependency(task_graph_t graph, long dset, long point,
+                                    interval_visitor_t visit, void *data)
+{
+  TaskGraph t(graph);
+  t.for_each_dependency(dset, point, [=](long first, long last) { visit(first, last, data); });
+}
+
+static_assert(sizeof(interval_t) == sizeof(std::pair<long, long>),
+              "interval_t must match the layout of std::pair<long, long>");
+
+long task_graph_table_reverse_dependencies(task_graph_t graph, long dset, long point,
+                                           const interval_t **intervals)
+{
+  TaskGraph t(graph);
+  const DependencyTable *table = t.dependency_table();
+  if (!table) {
+    return -1;
+  }
+  size_t count;
+  *intervals = reinterpret_cast<const interval_t *>(table->reverse_dependencies(dset, point, count));
+  return count;
+}
+
+long task_graph_table_dependencies(task_graph_t graph, long dset, long point,
+                                   const interval_t **intervals)
+{
+  TaskGraph t(graph);
+  const DependencyTable *table = t.dependency_table();
+  if (!table) {
+    return -1;
+  }
+  size_t count;
+  *intervals = reinterpret_cast<const interval_t *>(table->dependencies(dset, point, count));
+  return count;
+}
+
+typedef size_t (TaskGraph::*CountMethod)(long, long) const;
+typedef size_t (TaskGraph::*FillMethod)(long, long, std::pair<long, long> *) const;
+
+static long dependencies_row(const TaskGraph &t, CountMethod count, FillMethod fill,
+                             long dset, long first_point, long n_points,
+                             interval_t *intervals, long max_intervals,
+                             long *offsets)
+{
+  long total = 0;
+  for (long i = 0; i < n_points; ++i) {
+    total += (t.*count)(dset, first_point + i);
+  }
+  if (total > max_intervals || !intervals) {
+    return total;
+  }
+
+  // Counts may over-approximate, so pack by the number actually written.
+  std::pair<long, long> *deps = reinterpret_cast<std::pair<long, long> *>(intervals);
+  long written = 0;
+  for (long i = 0; i < n_points; ++i) {
+    offsets[i] = written;
+    written += (t.*fill)(dset, first_point + i, deps + written);
+  }
+  offsets[n_points] = written;
+  return written;
+}
+
+long task_graph_reverse_dependencies_row(task_graph_t graph, long dset,
+                                         long first_point, long n_points,
+                                         interval_t *intervals, long max_intervals,
+                                         long *offsets)
+{
+  TaskGraph t(graph);
+  return dependencies_row(t, &TaskGraph::num_reverse_dependencies, &TaskGraph::reverse_dependencies,
+                          dset, first_point, n_points, intervals, max_intervals, offsets);
+}
+
+long task_graph_dependencies_row(task_graph_t graph, long dset,
+                                 long first_point, long n_points,
+                                 interval_t *intervals, long max_intervals,
+                                 long *offsets)
+{
+  TaskGraph t(graph);
+  return dependencies_row(t, &TaskGraph::num_dependencies, &TaskGraph::dependencies,
+                          dset, first_point, n_points, intervals, max_intervals, offsets);
+}
+
 void task_graph_execute_point_scratch(task_graph_t graph, long timestep, long point,
                                       char *output_ptr, size_t output_bytes,
                                       const char **input_ptr, const size_t *input_bytes,
@@ -110,6 +230,18 @@ void task_graph_execute_point_scratch(task_graph_t graph, long timestep, long po
                   scratch_ptr, scratch_bytes);
 }
 
+void task_graph_execute_point_scratch_ptr(const task_graph_t *graph, long timestep, long point,
+                                          char *output_ptr, size_t output_bytes,
+                                          const char **input_ptr, const size_t *input_bytes,
+                                          size_t n_inputs,
+                                          char *scratch_ptr, size_t scratch_bytes)
+{
+  TaskGraph t(*graph);
+  t.execute_point(timestep, point, output_ptr, output_bytes,
+                  input_ptr, input_bytes, n_inputs,
+                  scratch_ptr, scratch_bytes);
+}
+
 void task_graph_execute_point_scratch_auto(task_graph_t graph, long timestep, long point,
                                            char *output_ptr, size_t output_bytes,
                                            const char **input_ptr, const size_t *input_bytes,
@@ -149,11 +281,46 @@ void task_graph_execute_point_scratch_nonconst(task_graph_t graph, long timestep
                   scratch_ptr, scratch_bytes);
 }
 
+void task_graph_execute_points(task_graph_t graph, long timestep,
+                               long first_point, long n_points,
+                               char *output_data, size_t output_bytes,
+                               const char *input_data, const size_t *input_bytes,
+                               const size_t *n_inputs,
+                               char *scratch_data, size_t scratch_bytes)
+{
+  TaskGraph t(graph);
+  std::vector<const char *> input_ptr;
+  const char *input = input_data;
+  const size_t *point_input_bytes = input_bytes;
+  for (long i = 0; i < n_points; ++i) {
+    input_ptr.resize(n_inputs[i]);
+    for (size_t j = 0; j < n_inputs[i]; ++j) {
+      input_ptr[j] = input;
+      input += point_input_bytes[j];
+    }
+    t.execute_point(timestep, first_point + i,
+                    output_data + i * output_bytes, output_bytes,
+                    input_ptr.data(), point_input_bytes, n_inputs[i],
+                    scratch_data ? scratch_data + i * scratch_bytes : NULL, scratch_bytes);
+    point_input_bytes += n_inputs[i];
+  }
+}
+
 void task_graph_prepare_scratch(char *scratch_ptr, size_t scratch_bytes)
 {
   TaskGraph::prepare_scratch(scratch_ptr, scratch_bytes);
 }
 
+bool task_graph_measuring_transfer()
+{
+  return TaskGraph::measuring_transfer();
+}
+
+void task_graph_tag_remote_inputs(const char *remote, size_t n_inputs)
+{
+  TaskGraph::tag_remote_inputs(remote, n_inputs);
+}
+
 void interval_list_destroy(interval_list_t intervals)
 {
   std::vector<std::pair<long, long> > *i = unwrap(intervals);
@@ -226,6 +393,12 @@ void app_display(app_t app)
   a->display();
 }
 
+void app_start_arrivals(app_t app)
+{
+  App *a = unwrap(app);
+  a->start_arrivals();
+}
+
 void app_report_timing(app_t app, double elapsed_seconds)
 {
   App *a = unwrap(app);
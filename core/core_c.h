@@ -37,6 +37,14 @@ typedef enum dependence_type_t {
   SPREAD,
   RANDOM_NEAREST,
   RANDOM_SPREAD,
+  STENCIL_2D,
+  STENCIL_3D,
+  V_CYCLE,
+  W_CYCLE,
+  GRAPH_FILE,
+  ELASTIC_RAMP,
+  ELASTIC_SAWTOOTH,
+  ELASTIC_RANDOM,
 } dependence_type_t;
 
 typedef enum kernel_type_t {
@@ -51,8 +59,22 @@ typedef enum kernel_type_t {
   LOAD_IMBALANCE,
   COMPUTE_MEMORY,
   DIST_IMBALANCE,
+  MEMORY_STREAM,
+  MEMORY_STRIDED,
+  MEMORY_CHASE,
 } kernel_type_t;
 
+typedef enum io_mode_t {
+  IO_MODE_SYNC, // buffered pread/pwrite
+  IO_MODE_DIRECT, // pread/pwrite with O_DIRECT
+  IO_MODE_URING, // O_DIRECT through io_uring, io_depth requests in flight
+} io_mode_t;
+
+typedef enum arrival_type_t {
+  ARRIVAL_FIXED, // timestep t is released t / arrival_rate seconds in
+  ARRIVAL_POISSON, // exponentially distributed gaps of mean 1 / arrival_rate
+} arrival_type_t;
+
 typedef enum dist_type_t {
   UNIFORM,
   NORMAL,
@@ -69,6 +91,12 @@ typedef enum dist_param_type_t {
   LAMBDA,
 } dist_param_type_t;
 
+typedef enum validation_type_t {
+  FULL_VALIDATION, // check and generate every element of each buffer
+  SAMPLE_VALIDATION, // only a strided subset of elements
+  NO_VALIDATION, // only the first element of each output is generated
+} validation_type_t;
+
 typedef struct dist_t {
   dist_type_t type;
   long max; // for the uniform distribution
@@ -85,6 +113,12 @@ typedef struct kernel_t {
   double imbalance; // amount of imbalance as a fraction of the number of iterations
   double fraction_mem; // fraction of iterations that are memory accesses
   dist_t dist;
+  long stride; // bytes between loads in memory_strided (0 means one cache line)
+  io_mode_t io_mode;
+  int io_write; // io_bound writes its extent instead of reading it
+  long io_block; // bytes per io_bound request (0 means 4096)
+  int io_depth; // io_bound requests in flight with IO_MODE_URING (0 means 8)
+  int threads; // threads that share each task (0 means 1)
 } kernel_t;
 
 typedef struct interval_t {
@@ -113,27 +147,77 @@ typedef struct task_graph_t {
   size_t output_bytes_per_task;
   size_t scratch_bytes_per_task;
   int nb_fields;
-  size_t** output_bytes_size;
-  int output_case;
+  int output_case; // output sizes over points (-output-dist): 0 none, 1 normal, 2 normal_random, 3 gamma
   float onormal_mu;
   float onormal_std;
   float ogamma_alpha;
   float ogamma_beta;
+  validation_type_t validation;
+  long dims[3]; // grid of stencil_2d/3d points, x fastest (zeros: derived from max_width)
+  long child; // graph_index of the graph each task expands into (0: none)
+  long instance; // which expansion of its parent's tasks this graph is (0: top level)
+  int priority; // -priority: tasks of higher priority graphs run first where supported (0: default)
+  double weight; // -weight: relative rate at which interleaved graphs are issued (0: equal)
+  double arrival_rate; // -arrival-rate: timesteps released per second (0: all at once)
+  arrival_type_t arrival;
 } task_graph_t;
 
-long task_graph_allocate_bytes(task_graph_t graph, int output_case);
+size_t task_graph_output_bytes_at(task_graph_t graph, long timestep, long point);
+size_t task_graph_max_output_bytes(task_graph_t graph);
 long task_graph_offset_at_timestep(task_graph_t graph, long timestep);
 long task_graph_width_at_timestep(task_graph_t graph, long timestep);
 long task_graph_max_dependence_sets(task_graph_t graph);
 long task_graph_timestep_period(task_graph_t graph);
 long task_graph_dependence_set_at_timestep(task_graph_t graph, long timestep);
+// Open-loop arrivals; see TaskGraph::release_time.
+double task_graph_release_time(task_graph_t graph, long timestep);
+void task_graph_wait_for_release(task_graph_t graph, long timestep);
+// Child graph that task (timestep, point) of graph expands into; see
+// TaskGraph::child_instance.
+task_graph_t task_graph_child_instance(task_graph_t graph, long timestep, long point);
 interval_list_t task_graph_reverse_dependencies(task_graph_t graph, long dset, long point);
 interval_list_t task_graph_dependencies(task_graph_t graph, long dset, long point);
+// Allocation-free iteration: calls visit(first, last, data) for every
+// INCLUSIVE interval of dependencies of point in dset.
+typedef void (*interval_visitor_t)(long first, long last, void *data);
+void task_graph_for_each_reverse_dependency(task_graph_t graph, long dset, long point,
+                                            interval_visitor_t visit, void *data);
+void task_graph_for_each_dependency(task_graph_t graph, long dset, long point,
+                                    interval_visitor_t visit, void *data);
+// Precomputed dependencies: returns the number of intervals for point
+// in dset and stores a pointer into the table in *intervals (valid for
+// the lifetime of the app), or returns -1 if no table is available
+// for this graph in the current process.
+long task_graph_table_reverse_dependencies(task_graph_t graph, long dset, long point,
+                                           const interval_t **intervals);
+long task_graph_table_dependencies(task_graph_t graph, long dset, long point,
+                                   const interval_t **intervals);
+// Row variants: write the intervals of points [first_point, first_point
+// + n_points) in dset back to back into intervals, with point i's
+// intervals at [offsets[i], offsets[i+1]) (offsets has n_points + 1
+// entries). Return the number of intervals written. If the buffer may be
+// too small (or intervals is NULL), nothing is written and an upper bound
+// on the number of intervals is returned instead.
+long task_graph_reverse_dependencies_row(task_graph_t graph, long dset,
+                                         long first_point, long n_points,
+                                         interval_t *intervals, long max_intervals,
+                                         long *offsets);
+long task_graph_dependencies_row(task_graph_t graph, long dset,
+                                 long first_point, long n_points,
+                                 interval_t *intervals, long max_intervals,
+                                 long *offsets);
 void task_graph_execute_point_scratch(task_graph_t graph, long timestep, long point,
                                       char *output_ptr, size_t output_bytes,
                                       const char **input_ptr, const size_t *input_bytes,
                                       size_t n_inputs,
                                       char *scratch_ptr, size_t scratch_bytes);
+// Same, but takes the graph by pointer, so that FFI callers can keep one
+// decoded graph per process instead of passing the struct on every call.
+void task_graph_execute_point_scratch_ptr(const task_graph_t *graph, long timestep, long point,
+                                          char *output_ptr, size_t output_bytes,
+                                          const char **input_ptr, const size_t *input_bytes,
+                                          size_t n_inputs,
+                                          char *scratch_ptr, size_t scratch_bytes);
 // Hack: This version is here for Spark because allocating scratch_ptr
 // through the JVM seems to cause the GC to thrash.
 void task_graph_execute_point_scratch_auto(task_graph_t graph, long timestep, long point,
@@ -152,7 +236,21 @@ void task_graph_execute_point_scratch_nonconst(task_graph_t graph, long timestep
                                                int64_t **input_ptr, const size_t *input_bytes,
                                                size_t n_inputs,
                                                char *scratch_ptr, size_t scratch_bytes);
+// Executes points [first_point, first_point + n_points) of timestep in
+// one call. Buffers are packed: point i writes output_bytes at
+// output_data + i*output_bytes and uses scratch_bytes at scratch_data +
+// i*scratch_bytes. Inputs of all points are concatenated in input_data,
+// input_bytes gives the size of each, and n_inputs how many belong to
+// each point.
+void task_graph_execute_points(task_graph_t graph, long timestep,
+                               long first_point, long n_points,
+                               char *output_data, size_t output_bytes,
+                               const char *input_data, const size_t *input_bytes,
+                               const size_t *n_inputs,
+                               char *scratch_data, size_t scratch_bytes);
 void task_graph_prepare_scratch(char *scratch_ptr, size_t scratch_bytes);
+bool task_graph_measuring_transfer();
+void task_graph_tag_remote_inputs(const char *remote, size_t n_inputs);
 
 typedef struct task_graph_list_t {
   void *impl;
@@ -172,8 +270,20 @@ task_graph_list_t app_task_graphs(app_t app);
 bool app_verbose(app_t app);
 void app_check(app_t app);
 void app_display(app_t app);
+void app_start_arrivals(app_t app);
 void app_report_timing(app_t app, double elapsed_seconds);
 
+typedef enum timer_source_t {
+  TIMER_SOURCE_MONOTONIC,
+  TIMER_SOURCE_TSC,
+} timer_source_t;
+
+// Seconds on the core's monotonic clock (arbitrary origin). Thread-safe.
+double timer_get_cur_time(void);
+// Returns the source actually in use (TSC falls back to monotonic).
+timer_source_t timer_set_source(timer_source_t source);
+double timer_resolution(void);
+
 #ifdef __cplusplus
 }
 #endif
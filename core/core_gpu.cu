@@ -0,0 +1,270 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compiled by nvcc (USE_CUDA=1) or hipcc (USE_HIP=1, which defines
+// USE_HIP); the gpu* names below map to the respective runtime.
+
+#include "core_gpu.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "core_kernel.h"
+
+#ifdef USE_HIP
+#include <hip/hip_runtime.h>
+#include <hipblas/hipblas.h>
+typedef hipError_t gpuError_t;
+typedef hipStream_t gpuStream_t;
+typedef hipblasHandle_t gpublasHandle_t;
+#define gpuSuccess hipSuccess
+#define gpuGetErrorString hipGetErrorString
+#define gpuGetLastError hipGetLastError
+#define gpuMalloc hipMalloc
+#define gpuFree hipFree
+#define gpuMemcpyAsync hipMemcpyAsync
+#define gpuMemcpyDefault hipMemcpyDefault
+#define gpuStreamSynchronize hipStreamSynchronize
+#define GPUBLAS_SUCCESS HIPBLAS_STATUS_SUCCESS
+#define GPUBLAS_OP_N HIPBLAS_OP_N
+#define gpublasCreate hipblasCreate
+#define gpublasSetStream hipblasSetStream
+#define gpublasDgemm hipblasDgemm
+#else
+#include <cuda_runtime.h>
+#include <cublas_v2.h>
+typedef cudaError_t gpuError_t;
+typedef cudaStream_t gpuStream_t;
+typedef cublasHandle_t gpublasHandle_t;
+#define gpuSuccess cudaSuccess
+#define gpuGetErrorString cudaGetErrorString
+#define gpuGetLastError cudaGetLastError
+#define gpuMalloc cudaMalloc
+#define gpuFree cudaFree
+#define gpuMemcpyAsync cudaMemcpyAsync
+#define gpuMemcpyDefault cudaMemcpyDefault
+#define gpuStreamSynchronize cudaStreamSynchronize
+#define GPUBLAS_SUCCESS CUBLAS_STATUS_SUCCESS
+#define GPUBLAS_OP_N CUBLAS_OP_N
+#define gpublasCreate cublasCreate
+#define gpublasSetStream cublasSetStream
+#define gpublasDgemm cublasDgemm
+#endif
+
+#define CHECK_GPU(call)                                                  \
+  do {                                                                   \
+    gpuError_t err = (call);                                             \
+    if (err != gpuSuccess) {                                             \
+      fprintf(stderr, "error: %s failed: %s\n", #call, gpuGetErrorString(err)); \
+      abort();                                                           \
+    }                                                                    \
+  } while (0)
+
+#define CHECK_GPUBLAS(call)                                              \
+  do {                                                                   \
+    if ((call) != GPUBLAS_SUCCESS) {                                     \
+      fprintf(stderr, "error: %s failed\n", #call);                      \
+      abort();                                                           \
+    }                                                                    \
+  } while (0)
+
+#define MAGIC_VALUE UINT64_C(0x5C4A7C8B) // must match core.cc
+
+#define GPU_BLOCK_THREADS 256
+#define GPU_MAX_BLOCKS 1024
+
+static unsigned grid_size(size_t n)
+{
+  size_t blocks = (n + GPU_BLOCK_THREADS - 1) / GPU_BLOCK_THREADS;
+  return blocks < 1 ? 1 : (blocks > GPU_MAX_BLOCKS ? GPU_MAX_BLOCKS : blocks);
+}
+
+__global__ void fill_words(uint64_t *ptr, size_t n, uint64_t value)
+{
+  for (size_t i = blockIdx.x * (size_t)blockDim.x + threadIdx.x; i < n; i += (size_t)gridDim.x * blockDim.x) {
+    ptr[i] = value;
+  }
+}
+
+__global__ void fill_output(long2 *output, size_t n, long timestep, long point)
+{
+  for (size_t i = blockIdx.x * (size_t)blockDim.x + threadIdx.x; i < n; i += (size_t)gridDim.x * blockDim.x) {
+    output[i] = make_long2(timestep, point);
+  }
+}
+
+// Same as copy() in core_kernel.cc: first half of the range to the second.
+__global__ void copy_half(uint64_t *ptr, size_t n_words)
+{
+  size_t half = n_words / 2;
+  for (size_t i = blockIdx.x * (size_t)blockDim.x + threadIdx.x; i < half; i += (size_t)gridDim.x * blockDim.x) {
+    ptr[half + i] = ptr[i];
+  }
+}
+
+// Each of the 64 threads performs two FLOPs per iteration, matching the
+// 128 FLOPs per iteration that count_flops_per_task reports.
+__global__ void compute(long iterations, double *sink)
+{
+  double a = 1.2345;
+  for (long iter = 0; iter < iterations; iter++) {
+    a = a * a + a;
+  }
+  if (a == 0.0) {
+    *sink = a; // never true; keeps the loop alive
+  }
+}
+
+bool gpu_kernel_supported(const Kernel &kernel)
+{
+  switch (kernel.type) {
+  case KernelType::EMPTY:
+  case KernelType::COMPUTE_BOUND:
+  case KernelType::MEMORY_BOUND:
+  case KernelType::COMPUTE_DGEMM:
+    return true;
+  default:
+    return false;
+  }
+}
+
+char *gpu_allocate_scratch(size_t scratch_bytes)
+{
+  void *ptr = NULL;
+  if (scratch_bytes > 0) {
+    CHECK_GPU(gpuMalloc(&ptr, scratch_bytes));
+  }
+  return reinterpret_cast<char *>(ptr);
+}
+
+void gpu_prepare_scratch(char *scratch_ptr, size_t scratch_bytes, gpu_stream_t stream)
+{
+  assert(scratch_bytes % sizeof(uint64_t) == 0);
+  size_t n = scratch_bytes / sizeof(uint64_t);
+  if (n == 0) {
+    return;
+  }
+  fill_words<<<grid_size(n), GPU_BLOCK_THREADS, 0, (gpuStream_t)stream>>>(
+    reinterpret_cast<uint64_t *>(scratch_ptr), n, MAGIC_VALUE);
+  CHECK_GPU(gpuGetLastError());
+}
+
+void gpu_free_scratch(char *scratch_ptr)
+{
+  if (scratch_ptr) {
+    CHECK_GPU(gpuFree(scratch_ptr));
+  }
+}
+
+char *gpu_allocate_buffer(size_t bytes)
+{
+  return gpu_allocate_scratch(bytes);
+}
+
+void gpu_free_buffer(char *ptr)
+{
+  gpu_free_scratch(ptr);
+}
+
+void gpu_memcpy(void *dst, const void *src, size_t bytes, gpu_stream_t stream)
+{
+  if (bytes > 0) {
+    CHECK_GPU(gpuMemcpyAsync(dst, src, bytes, gpuMemcpyDefault, (gpuStream_t)stream));
+  }
+}
+
+void gpu_synchronize(gpu_stream_t stream)
+{
+  CHECK_GPU(gpuStreamSynchronize((gpuStream_t)stream));
+}
+
+static void gpu_dgemm(const Kernel &kernel, char *scratch_ptr, size_t scratch_bytes,
+                      gpuStream_t stream)
+{
+  static thread_local gpublasHandle_t handle = NULL;
+  if (!handle) {
+    CHECK_GPUBLAS(gpublasCreate(&handle));
+  }
+  CHECK_GPUBLAS(gpublasSetStream(handle, stream));
+
+  // Same layout as execute_kernel_dgemm: C += A * B, all N x N.
+  long long N = scratch_bytes / (3 * sizeof(double));
+  int n = sqrt(N);
+  double alpha = 1.0, beta = 1.0;
+  double *A = reinterpret_cast<double *>(scratch_ptr);
+  double *B = reinterpret_cast<double *>(scratch_ptr + N * sizeof(double));
+  double *C = reinterpret_cast<double *>(scratch_ptr + 2 * N * sizeof(double));
+  for (long iter = 0; iter < kernel.iterations; iter++) {
+    CHECK_GPUBLAS(gpublasDgemm(handle, GPUBLAS_OP_N, GPUBLAS_OP_N, n, n, n,
+                               &alpha, A, n, B, n, &beta, C, n));
+  }
+}
+
+static void gpu_execute_kernel(const Kernel &kernel, long timestep,
+                               char *scratch_ptr, size_t scratch_bytes,
+                               gpuStream_t stream)
+{
+  switch (kernel.type) {
+  case KernelType::EMPTY:
+    break;
+  case KernelType::COMPUTE_BOUND:
+    compute<<<1, 64, 0, stream>>>(kernel.iterations, NULL);
+    break;
+  case KernelType::MEMORY_BOUND:
+    assert(scratch_ptr != NULL);
+    assert(scratch_bytes > 0);
+    visit_samples(kernel.samples, kernel.iterations, scratch_ptr, scratch_bytes, timestep,
+                  [&](char *ptr, size_t bytes) {
+                    size_t n_words = bytes / sizeof(uint64_t);
+                    copy_half<<<grid_size(n_words / 2), GPU_BLOCK_THREADS, 0, stream>>>(
+                      reinterpret_cast<uint64_t *>(ptr), n_words);
+                  });
+    break;
+  case KernelType::COMPUTE_DGEMM:
+    assert(scratch_ptr != NULL);
+    assert(scratch_bytes > 0);
+    gpu_dgemm(kernel, scratch_ptr, scratch_bytes, stream);
+    break;
+  default:
+    fprintf(stderr, "error: Kernel type %d is not supported on the GPU\n", (int)kernel.type);
+    abort();
+  }
+  CHECK_GPU(gpuGetLastError());
+}
+
+void gpu_execute_point(const TaskGraph &graph, long timestep, long point,
+                       char *output_ptr, size_t output_bytes,
+                       char *scratch_ptr, size_t scratch_bytes,
+                       gpu_stream_t stream)
+{
+  assert(0 <= timestep && timestep < graph.timesteps);
+  assert(graph.offset_at_timestep(timestep) <= point &&
+         point < graph.offset_at_timestep(timestep) + graph.width_at_timestep(timestep));
+  assert(output_bytes >= sizeof(std::pair<long, long>));
+  assert(scratch_bytes == graph.scratch_bytes_per_task);
+
+  gpuStream_t s = (gpuStream_t)stream;
+  size_t n_elements = output_bytes / sizeof(std::pair<long, long>);
+  if (graph.validation == ValidationType::NO_VALIDATION) {
+    n_elements = 1;
+  }
+  fill_output<<<grid_size(n_elements), GPU_BLOCK_THREADS, 0, s>>>(
+    reinterpret_cast<long2 *>(output_ptr), n_elements, timestep, point);
+
+  gpu_execute_kernel(graph.kernel, timestep, scratch_ptr, scratch_bytes, s);
+}
@@ -0,0 +1,59 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CORE_GPU_H
+#define CORE_GPU_H
+
+#include "core.h"
+
+// GPU (CUDA or HIP) versions of the kernels. Only available when the core
+// library is built with USE_CUDA=1 or USE_HIP=1, in which case
+// make_gpu.mk defines USE_GPU_KERNEL for the backends.
+//
+// All pointers passed to these functions are device pointers, and all
+// work is enqueued asynchronously on the given stream (a cudaStream_t or
+// hipStream_t; NULL is the default stream).
+
+typedef void *gpu_stream_t;
+
+// Supported on the GPU: empty, compute_bound, memory_bound and
+// compute_dgemm (cuBLAS/hipBLAS).
+bool gpu_kernel_supported(const Kernel &kernel);
+
+// Device scratch. gpu_prepare_scratch is the device equivalent of
+// TaskGraph::prepare_scratch.
+char *gpu_allocate_scratch(size_t scratch_bytes);
+void gpu_prepare_scratch(char *scratch_ptr, size_t scratch_bytes, gpu_stream_t stream);
+void gpu_free_scratch(char *scratch_ptr);
+
+// Device buffers for task outputs and inputs, and copies between any
+// two buffers (host or device, by unified addressing). gpu_memcpy is
+// asynchronous on stream; gpu_synchronize waits for the stream.
+char *gpu_allocate_buffer(size_t bytes);
+void gpu_free_buffer(char *ptr);
+void gpu_memcpy(void *dst, const void *src, size_t bytes, gpu_stream_t stream);
+void gpu_synchronize(gpu_stream_t stream);
+
+// Device equivalent of TaskGraph::execute_point: writes the output of
+// (timestep, point) to output_ptr and runs the kernel on scratch_ptr.
+// Inputs are not validated on the device; backends that keep inputs on
+// the device copy them back to validate.
+void gpu_execute_point(const TaskGraph &graph, long timestep, long point,
+                       char *output_ptr, size_t output_bytes,
+                       char *scratch_ptr, size_t scratch_bytes,
+                       gpu_stream_t stream);
+
+#endif // CORE_GPU_H
@@ -13,14 +13,31 @@
  * limitations under the License.
  */
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <climits>
 #include <cmath>
+#include <cstdint>
+#include <memory>
 #include <random>
+#include <thread>
+#include <vector>
 
-#if (__AVX2__ == 1) || (__AVX__ == 1)
+#if defined(__x86_64__) || defined(__i386__)
+#define CORE_KERNEL_X86 1
 #include <immintrin.h>
 #endif
 
+#ifdef __aarch64__
+#include <arm_neon.h>
+#endif
+
+#ifdef __ARM_FEATURE_SVE
+#include <arm_sve.h>
+#include <sys/auxv.h>
+#endif
+
 #include <string.h>
 
 #include "core.h"
@@ -28,7 +45,13 @@
 #include "core_random.h"
 
 #ifdef USE_BLAS_KERNEL
+#if defined(USE_BLAS_MKL)
 #include <mkl.h>
+#elif defined(USE_BLAS_ARMPL)
+#include <armpl.h>
+#else
+#include <cblas.h>
+#endif
 #endif
 
 #define DEBUG(...) { fprintf(stderr, __VA_ARGS__); fprintf(stderr, "\n"); }
@@ -110,70 +133,293 @@ void copy(char *scratch_ptr, size_t scratch_bytes)
   }
 }
 
+// Copies the first half of [ptr, ptr + bytes) to the second half with
+// non-temporal stores, so the destination does not displace the cache.
+static void copy_stream(char *ptr, size_t bytes)
+{
+  size_t half = bytes / 2;
+  const char *src = ptr;
+  char *dst = ptr + half;
+#ifdef __SSE2__
+  size_t head = std::min(half, (16 - reinterpret_cast<uintptr_t>(dst) % 16) % 16);
+  memcpy(dst, src, head);
+  size_t n = (half - head) / 16;
+  for (size_t i = 0; i < n; i++) {
+    __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + head + 16*i));
+    _mm_stream_si128(reinterpret_cast<__m128i *>(dst + head + 16*i), value);
+  }
+  size_t done = head + 16*n;
+  memcpy(dst + done, src + done, half - done);
+  _mm_sfence();
+#else
+  memcpy(dst, src, half);
+#endif
+}
+
+// Loads one word every stride bytes.
+static uint64_t touch_strided(const char *ptr, size_t bytes, size_t stride)
+{
+  uint64_t sum = 0;
+  for (size_t offset = 0; offset + sizeof(uint64_t) <= bytes; offset += stride) {
+    uint64_t value;
+    memcpy(&value, ptr + offset, sizeof(value));
+    sum += value;
+  }
+  return sum;
+}
+
 void execute_kernel_memory(const Kernel &kernel,
                            char *scratch_ptr, size_t scratch_bytes,
                            long timestep)
 {
-#if 1
-  long iter = 0;
+  visit_samples(kernel.samples, kernel.iterations, scratch_ptr, scratch_bytes, timestep, copy);
+}
 
-  size_t sample_bytes = scratch_bytes / kernel.samples;
+void execute_kernel_memory_stream(const Kernel &kernel,
+                                  char *scratch_ptr, size_t scratch_bytes,
+                                  long timestep)
+{
+  visit_samples(kernel.samples, kernel.iterations, scratch_ptr, scratch_bytes, timestep, copy_stream);
+}
 
-  // Prologue
-  {
-    long start_idx = (timestep * kernel.iterations + iter) % kernel.samples;
-    long stop_idx = std::min((long)kernel.samples, start_idx + kernel.iterations);
-    long num_iter = stop_idx - start_idx;
+size_t kernel_stride(const Kernel &kernel)
+{
+  return kernel.stride > 0 ? kernel.stride : CACHE_LINE_BYTES;
+}
 
-    if (num_iter > 0) {
-      char *sample_ptr = scratch_ptr + start_idx * sample_bytes;
+uint64_t execute_kernel_memory_strided(const Kernel &kernel,
+                                       char *scratch_ptr, size_t scratch_bytes,
+                                       long timestep)
+{
+  size_t stride = kernel_stride(kernel);
+  uint64_t sum = 0;
+  visit_samples(kernel.samples, kernel.iterations, scratch_ptr, scratch_bytes, timestep,
+                [&](char *ptr, size_t bytes) { sum += touch_strided(ptr, bytes, stride); });
+  return sum;
+}
 
-      copy(sample_ptr, num_iter * sample_bytes);
+// Scratch is viewed as cache lines of 8 words. Word 0 of every line keeps
+// the scratch magic value; word 1 holds the index of the next line in a
+// single random cycle through all lines (Sattolo's algorithm, fixed seed).
+#define CHASE_NEXT_WORD 1
 
-      iter += num_iter;
-    }
+void prepare_pointer_chase(char *scratch_ptr, size_t scratch_bytes)
+{
+  uint64_t *words = reinterpret_cast<uint64_t *>(scratch_ptr);
+  size_t lines = scratch_bytes / CACHE_LINE_BYTES;
+  const size_t words_per_line = CACHE_LINE_BYTES / sizeof(uint64_t);
+  if (lines < 2) {
+    return;
   }
 
-  // Body
-  for ( ; iter + kernel.samples <= kernel.iterations; iter += kernel.samples) {
-    long start_idx = (timestep * kernel.iterations + iter) % kernel.samples;
-    long num_iter = kernel.samples;
+  for (size_t i = 0; i < lines; i++) {
+    words[i * words_per_line + CHASE_NEXT_WORD] = i;
+  }
+  std::minstd_rand generator(lines);
+  for (size_t i = lines - 1; i > 0; i--) {
+    size_t j = generator() % i;
+    std::swap(words[i * words_per_line + CHASE_NEXT_WORD],
+              words[j * words_per_line + CHASE_NEXT_WORD]);
+  }
+}
 
-    char *sample_ptr = scratch_ptr + start_idx * sample_bytes;
+long long chase_hops(const Kernel &kernel, size_t scratch_bytes)
+{
+  return (long long)(scratch_bytes / CACHE_LINE_BYTES) * kernel.iterations / kernel.samples;
+}
 
-    copy(sample_ptr, num_iter * sample_bytes);
+uint64_t execute_kernel_memory_chase(const Kernel &kernel,
+                                     char *scratch_ptr, size_t scratch_bytes,
+                                     long timestep)
+{
+  const uint64_t *words = reinterpret_cast<const uint64_t *>(scratch_ptr);
+  size_t lines = scratch_bytes / CACHE_LINE_BYTES;
+  const size_t words_per_line = CACHE_LINE_BYTES / sizeof(uint64_t);
+  assert(lines >= 2);
+
+  long long hops = chase_hops(kernel, scratch_bytes);
+  uint64_t line = (timestep * hops) % lines;
+  for (long long hop = 0; hop < hops; hop++) {
+    line = words[line * words_per_line + CHASE_NEXT_WORD];
   }
+  return line;
+}
 
-  // Epilogue
-  {
-    long start_idx = (timestep * kernel.iterations + iter) % kernel.samples;
-    long stop_idx = start_idx + (kernel.iterations - iter);
-    long num_iter = stop_idx - start_idx;
+// Builtin DGEMM, used when no BLAS library is linked. Computes C += A * B
+// for column-major N x N matrices. Blocks of A and B are packed into
+// MR x KC and KC x NR slivers and multiplied by a register-blocked
+// MR x NR micro-kernel (the usual Goto/BLIS decomposition).
 
-    if (num_iter > 0) {
-      char *sample_ptr = scratch_ptr + start_idx * sample_bytes;
+#define DGEMM_MR 8
+#define DGEMM_NR 4
+#define DGEMM_MC 96
+#define DGEMM_KC 256
+#define DGEMM_NC 2048
 
-      copy(sample_ptr, num_iter * sample_bytes);
+// Computes the MR x NR product of packed slivers a and b into tile.
+static void dgemm_micro_scalar(long kc, const double *a, const double *b, double *tile)
+{
+  double acc[DGEMM_NR][DGEMM_MR] = {{0}};
+  for (long k = 0; k < kc; k++) {
+    for (int j = 0; j < DGEMM_NR; j++) {
+      for (int i = 0; i < DGEMM_MR; i++) {
+        acc[j][i] += a[k * DGEMM_MR + i] * b[k * DGEMM_NR + j];
+      }
+    }
+  }
+  memcpy(tile, acc, sizeof(acc));
+}
 
-      iter += num_iter;
+#ifdef CORE_KERNEL_X86
+__attribute__((target("avx2,fma")))
+static void dgemm_micro_avx2(long kc, const double *a, const double *b, double *tile)
+{
+  __m256d acc[DGEMM_NR][2];
+  for (int j = 0; j < DGEMM_NR; j++) {
+    acc[j][0] = _mm256_setzero_pd();
+    acc[j][1] = _mm256_setzero_pd();
+  }
+  for (long k = 0; k < kc; k++) {
+    __m256d a0 = _mm256_loadu_pd(a + k * DGEMM_MR);
+    __m256d a1 = _mm256_loadu_pd(a + k * DGEMM_MR + 4);
+    for (int j = 0; j < DGEMM_NR; j++) {
+      __m256d bj = _mm256_broadcast_sd(b + k * DGEMM_NR + j);
+      acc[j][0] = _mm256_fmadd_pd(a0, bj, acc[j][0]);
+      acc[j][1] = _mm256_fmadd_pd(a1, bj, acc[j][1]);
     }
   }
+  for (int j = 0; j < DGEMM_NR; j++) {
+    _mm256_storeu_pd(tile + j * DGEMM_MR, acc[j][0]);
+    _mm256_storeu_pd(tile + j * DGEMM_MR + 4, acc[j][1]);
+  }
+}
+#endif
 
-  assert(iter == kernel.iterations);
-#else
-  long long N = scratch_bytes / 2;
-  char *src = reinterpret_cast<char *>(scratch_ptr);
-  char *dst = reinterpret_cast<char *>(scratch_ptr + N);
-  for (long iter = 0; iter < kernel.iterations; iter++) {
-    memcpy(dst, src, N);
+#ifdef __aarch64__
+static void dgemm_micro_neon(long kc, const double *a, const double *b, double *tile)
+{
+  float64x2_t acc[DGEMM_NR][4];
+  for (int j = 0; j < DGEMM_NR; j++) {
+    for (int i = 0; i < 4; i++) {
+      acc[j][i] = vdupq_n_f64(0.0);
+    }
+  }
+  for (long k = 0; k < kc; k++) {
+    float64x2_t ak[4];
+    for (int i = 0; i < 4; i++) {
+      ak[i] = vld1q_f64(a + k * DGEMM_MR + 2 * i);
+    }
+    for (int j = 0; j < DGEMM_NR; j++) {
+      float64x2_t bj = vdupq_n_f64(b[k * DGEMM_NR + j]);
+      for (int i = 0; i < 4; i++) {
+        acc[j][i] = vfmaq_f64(acc[j][i], ak[i], bj);
+      }
+    }
+  }
+  for (int j = 0; j < DGEMM_NR; j++) {
+    for (int i = 0; i < 4; i++) {
+      vst1q_f64(tile + j * DGEMM_MR + 2 * i, acc[j][i]);
+    }
+  }
+}
+#endif
+
+typedef void (*DgemmMicroKernel)(long kc, const double *a, const double *b, double *tile);
+
+static DgemmMicroKernel select_dgemm_micro_kernel()
+{
+#ifdef CORE_KERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return dgemm_micro_avx2;
+  }
+#endif
+#ifdef __aarch64__
+  return dgemm_micro_neon;
+#endif
+  return dgemm_micro_scalar;
+}
+
+// Packs rows [0, mc) x columns [0, kc) of A into MR-row slivers, zero padded.
+static void dgemm_pack_a(long mc, long kc, const double *A, long lda, double *packed)
+{
+  for (long ir = 0; ir < mc; ir += DGEMM_MR) {
+    double *sliver = packed + ir * kc;
+    for (long k = 0; k < kc; k++) {
+      for (long i = 0; i < DGEMM_MR; i++) {
+        sliver[k * DGEMM_MR + i] = ir + i < mc ? A[(ir + i) + k * lda] : 0.0;
+      }
+    }
   }
+}
+
+// Packs rows [0, kc) x columns [0, nc) of B into NR-column slivers, zero padded.
+static void dgemm_pack_b(long kc, long nc, const double *B, long ldb, double *packed)
+{
+  for (long jr = 0; jr < nc; jr += DGEMM_NR) {
+    double *sliver = packed + jr * kc;
+    for (long k = 0; k < kc; k++) {
+      for (long j = 0; j < DGEMM_NR; j++) {
+        sliver[k * DGEMM_NR + j] = jr + j < nc ? B[k + (jr + j) * ldb] : 0.0;
+      }
+    }
+  }
+}
+
+// C += A * B where A is n x n and B, C are n x cols, all with leading
+// dimension n.
+static void dgemm_builtin(long n, long cols, const double *A, const double *B, double *C)
+{
+  static const DgemmMicroKernel micro_kernel = select_dgemm_micro_kernel();
+  static thread_local std::vector<double> packed_a;
+  static thread_local std::vector<double> packed_b;
+  packed_a.resize(DGEMM_MC * DGEMM_KC);
+  packed_b.resize(DGEMM_KC * DGEMM_NC);
+
+  double tile[DGEMM_MR * DGEMM_NR];
+  for (long jc = 0; jc < cols; jc += DGEMM_NC) {
+    long nc = std::min((long)DGEMM_NC, cols - jc);
+    for (long pc = 0; pc < n; pc += DGEMM_KC) {
+      long kc = std::min((long)DGEMM_KC, n - pc);
+      dgemm_pack_b(kc, nc, B + pc + jc * n, n, packed_b.data());
+      for (long ic = 0; ic < n; ic += DGEMM_MC) {
+        long mc = std::min((long)DGEMM_MC, n - ic);
+        dgemm_pack_a(mc, kc, A + ic + pc * n, n, packed_a.data());
+        for (long jr = 0; jr < nc; jr += DGEMM_NR) {
+          long nr = std::min((long)DGEMM_NR, nc - jr);
+          for (long ir = 0; ir < mc; ir += DGEMM_MR) {
+            long mr = std::min((long)DGEMM_MR, mc - ir);
+            micro_kernel(kc, packed_a.data() + ir * kc, packed_b.data() + jr * kc, tile);
+            double *c = C + (ic + ir) + (jc + jr) * n;
+            for (long j = 0; j < nr; j++) {
+              for (long i = 0; i < mr; i++) {
+                c[i + j * n] += tile[i + j * DGEMM_MR];
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+const char *dgemm_kernel_name()
+{
+#if defined(USE_BLAS_MKL)
+  return "mkl";
+#elif defined(USE_BLAS_ARMPL)
+  return "armpl";
+#elif defined(USE_BLAS_KERNEL)
+  return "cblas";
+#else
+  return "builtin";
 #endif
 }
 
 void execute_kernel_dgemm(const Kernel &kernel,
-                           char *scratch_ptr, size_t scratch_bytes)
+                          char *scratch_ptr, size_t scratch_bytes,
+                          int part, int parts)
 {
-#ifdef USE_BLAS_KERNEL
   long long N = scratch_bytes / (3 * sizeof(double));
   int m, n, p;
   double alpha, beta;
@@ -185,15 +431,20 @@ void execute_kernel_dgemm(const Kernel &kernel,
   double *B = reinterpret_cast<double *>(scratch_ptr + N * sizeof(double));
   double *C = reinterpret_cast<double *>(scratch_ptr + 2 * N * sizeof(double));
 
+  long first_col = (long)n * part / parts;
+  int cols = (long)n * (part + 1) / parts - first_col;
+  B += first_col * n;
+  C += first_col * n;
+
   for (long iter = 0; iter < kernel.iterations; iter++) {
+#ifdef USE_BLAS_KERNEL
     cblas_dgemm(CblasColMajor, CblasNoTrans, CblasNoTrans, 
-                m, n, p, alpha, A, p, B, n, beta, C, n);
-  }
+                m, cols, p, alpha, A, p, B, n, beta, C, n);
 #else
-  fprintf(stderr, "No BLAS is detected\n");
-  fflush(stderr);
-  abort();
+    (void)alpha; (void)beta; (void)p;
+    dgemm_builtin(m, cols, A, B, C);
 #endif
+  }
 }
 
 void execute_kernel_daxpy(const Kernel &kernel,
@@ -223,52 +474,224 @@ void execute_kernel_daxpy(const Kernel &kernel,
 #endif
 }
 
-double execute_kernel_compute(const Kernel &kernel)
+// Compute kernel variants. Each keeps 64 doubles live and performs two
+// FLOPs per double per iteration, so task granularity is the same
+// whichever variant runs; the result is the product of the 64 values.
+// Variants are compiled with target attributes independent of the
+// global -m flags and chosen at startup from CPUID / hwcaps.
+
+static double product64(const double *C)
+{
+  double dot = 1.0;
+  for (int i = 0; i < 64; i++) {
+    dot *= C[i];
+  }
+  return dot;
+}
+
+static double compute_scalar(long iterations)
+{
+  double A[64];
+
+  for (int i = 0; i < 64; i++) {
+    A[i] = 1.2345;
+  }
+
+  for (long iter = 0; iter < iterations; iter++) {
+    for (int i = 0; i < 64; i++) {
+        A[i] = A[i] * A[i] + A[i];
+    }
+  }
+  return product64(A);
+}
+
+#ifdef CORE_KERNEL_X86
+__attribute__((target("avx")))
+static double compute_avx(long iterations)
 {
-#if __AVX2__ == 1
   __m256d A[16];
-  
+
   for (int i = 0; i < 16; i++) {
     A[i] = _mm256_set_pd(1.0f, 2.0f, 3.0f, 4.0f);
   }
-  
-  for (long iter = 0; iter < kernel.iterations; iter++) {
+
+  for (long iter = 0; iter < iterations; iter++) {
     for (int i = 0; i < 16; i++) {
-      A[i] = _mm256_fmadd_pd(A[i], A[i], A[i]);
+      A[i] = _mm256_mul_pd(A[i], A[i]);
+      A[i] = _mm256_add_pd(A[i], A[i]);
     }
   }
-#elif __AVX__ == 1
+  double C[64];
+  for (int i = 0; i < 16; i++) {
+    _mm256_storeu_pd(C + 4*i, A[i]);
+  }
+  return product64(C);
+}
+
+__attribute__((target("avx2,fma")))
+static double compute_avx2(long iterations)
+{
   __m256d A[16];
-  
+
   for (int i = 0; i < 16; i++) {
     A[i] = _mm256_set_pd(1.0f, 2.0f, 3.0f, 4.0f);
   }
-  
-  for (long iter = 0; iter < kernel.iterations; iter++) {
+
+  for (long iter = 0; iter < iterations; iter++) {
     for (int i = 0; i < 16; i++) {
-      A[i] = _mm256_mul_pd(A[i], A[i]);
-      A[i] = _mm256_add_pd(A[i], A[i]);
+      A[i] = _mm256_fmadd_pd(A[i], A[i], A[i]);
     }
   }
-#else
-  double A[64];
-  
-  for (int i = 0; i < 64; i++) {
-    A[i] = 1.2345;
+  double C[64];
+  for (int i = 0; i < 16; i++) {
+    _mm256_storeu_pd(C + 4*i, A[i]);
   }
-  
-  for (long iter = 0; iter < kernel.iterations; iter++) {
-    for (int i = 0; i < 64; i++) {
-        A[i] = A[i] * A[i] + A[i];
+  return product64(C);
+}
+
+__attribute__((target("avx512f")))
+static double compute_avx512(long iterations)
+{
+  __m512d A[8];
+
+  for (int i = 0; i < 8; i++) {
+    A[i] = _mm512_set_pd(1.0f, 2.0f, 3.0f, 4.0f, 1.0f, 2.0f, 3.0f, 4.0f);
+  }
+
+  for (long iter = 0; iter < iterations; iter++) {
+    for (int i = 0; i < 8; i++) {
+      A[i] = _mm512_fmadd_pd(A[i], A[i], A[i]);
     }
-  } 
+  }
+  double C[64];
+  for (int i = 0; i < 8; i++) {
+    _mm512_storeu_pd(C + 8*i, A[i]);
+  }
+  return product64(C);
+}
 #endif
-  double *C = (double *)A;
-  double dot = 1.0;
+
+#ifdef __aarch64__
+static double compute_neon(long iterations)
+{
+  float64x2_t A[32];
+
+  for (int i = 0; i < 32; i++) {
+    const double init[2] = {1.0, 2.0};
+    A[i] = vld1q_f64(init);
+  }
+
+  for (long iter = 0; iter < iterations; iter++) {
+    for (int i = 0; i < 32; i++) {
+      A[i] = vfmaq_f64(A[i], A[i], A[i]);
+    }
+  }
+  double C[64];
+  for (int i = 0; i < 32; i++) {
+    vst1q_f64(C + 2*i, A[i]);
+  }
+  return product64(C);
+}
+#endif
+
+#ifdef __ARM_FEATURE_SVE
+#define SVE_CHAINS 8
+
+static double compute_sve(long iterations)
+{
+  double C[64];
   for (int i = 0; i < 64; i++) {
-    dot *= C[i];
+    C[i] = 1.0 + (i % 4);
   }
-  return dot;  
+
+  // Vector-length agnostic: eight independent accumulators of svcntd()
+  // lanes (sizeless SVE types cannot form an array like A above), which
+  // is enough to cover FMA latency. They hold all 64 values from 512-bit
+  // vectors up, with the iteration loop outermost as in compute_neon;
+  // shorter vectors process the values in groups of eight vectors, each
+  // group running every iteration, for the same FLOPs.
+  long lanes = svcntd();
+  for (long base = 0; base < 64; base += SVE_CHAINS * lanes) {
+#define SVE_CHAIN_LOAD(k)                                               \
+    svbool_t p##k = svwhilelt_b64(base + k * lanes, 64L);               \
+    double *c##k = C + std::min(base + k * lanes, 64L);                 \
+    svfloat64_t a##k = svld1_f64(p##k, c##k);
+    SVE_CHAIN_LOAD(0) SVE_CHAIN_LOAD(1) SVE_CHAIN_LOAD(2) SVE_CHAIN_LOAD(3)
+    SVE_CHAIN_LOAD(4) SVE_CHAIN_LOAD(5) SVE_CHAIN_LOAD(6) SVE_CHAIN_LOAD(7)
+#undef SVE_CHAIN_LOAD
+    for (long iter = 0; iter < iterations; iter++) {
+      a0 = svmla_f64_x(p0, a0, a0, a0);
+      a1 = svmla_f64_x(p1, a1, a1, a1);
+      a2 = svmla_f64_x(p2, a2, a2, a2);
+      a3 = svmla_f64_x(p3, a3, a3, a3);
+      a4 = svmla_f64_x(p4, a4, a4, a4);
+      a5 = svmla_f64_x(p5, a5, a5, a5);
+      a6 = svmla_f64_x(p6, a6, a6, a6);
+      a7 = svmla_f64_x(p7, a7, a7, a7);
+    }
+    svst1_f64(p0, c0, a0);
+    svst1_f64(p1, c1, a1);
+    svst1_f64(p2, c2, a2);
+    svst1_f64(p3, c3, a3);
+    svst1_f64(p4, c4, a4);
+    svst1_f64(p5, c5, a5);
+    svst1_f64(p6, c6, a6);
+    svst1_f64(p7, c7, a7);
+  }
+  return product64(C);
+}
+#endif
+
+struct ComputeVariant {
+  const char *name;
+  double (*execute)(long iterations);
+  long long flops_per_iteration;
+};
+
+static ComputeVariant select_compute_variant()
+{
+#ifdef CORE_KERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return ComputeVariant{"avx512", compute_avx512, 2 * 64};
+  }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    return ComputeVariant{"avx2", compute_avx2, 2 * 64};
+  }
+  if (__builtin_cpu_supports("avx")) {
+    return ComputeVariant{"avx", compute_avx, 2 * 64};
+  }
+#endif
+#ifdef __ARM_FEATURE_SVE
+  if (getauxval(AT_HWCAP) & HWCAP_SVE) {
+    return ComputeVariant{"sve", compute_sve, 2 * 64};
+  }
+#endif
+#ifdef __aarch64__
+  return ComputeVariant{"neon", compute_neon, 2 * 64};
+#endif
+  return ComputeVariant{"scalar", compute_scalar, 2 * 64};
+}
+
+static const ComputeVariant &compute_variant()
+{
+  static const ComputeVariant variant = select_compute_variant();
+  return variant;
+}
+
+const char *compute_kernel_isa()
+{
+  return compute_variant().name;
+}
+
+long long compute_kernel_flops_per_iteration()
+{
+  return compute_variant().flops_per_iteration;
+}
+
+double execute_kernel_compute(const Kernel &kernel)
+{
+  return compute_variant().execute(kernel.iterations);
 }
 
 double execute_kernel_compute2(const Kernel &kernel)
@@ -296,11 +719,6 @@ double execute_kernel_compute2(const Kernel &kernel)
   return sum;
 }
 
-void execute_kernel_io(const Kernel &kernel)
-{
-  assert(false);
-}
-
 long select_imbalance_iterations(const Kernel &kernel,
                                  long graph_index, long timestep, long point)
 {
@@ -322,65 +740,106 @@ double execute_kernel_imbalance(const Kernel &kernel,
   return execute_kernel_compute(k);
 }
 
+// Uniform doubles for one task: Philox keyed by the graph, with the task
+// and the draw index as the counter. Any process computes the same
+// values for a task, and no generator state is built per task.
+struct TaskRandom {
+  uint32_t key[2];
+  uint32_t counter[4];
+  uint32_t block[4];
+  int used;
+
+  TaskRandom(long graph_index, long timestep, long point)
+    : key{(uint32_t)graph_index, (uint32_t)((uint64_t)graph_index >> 32)}
+    , counter{(uint32_t)timestep, (uint32_t)point, 0, 0x44495354 /* "DIST" */}
+    , used(4)
+  {
+  }
+
+  // Uniform in (0, 1).
+  double uniform()
+  {
+    if (used + 2 > 4) {
+      philox4x32(key, counter, block);
+      counter[2]++;
+      used = 0;
+    }
+    uint64_t bits = ((uint64_t)block[used] << 32) | block[used + 1];
+    used += 2;
+    return ((bits >> 11) + 0.5) * (1.0 / (UINT64_C(1) << 53));
+  }
+
+  // Standard normal (Box-Muller).
+  double normal()
+  {
+    double r = sqrt(-2.0 * log(uniform()));
+    return r * cos(2.0 * M_PI * uniform());
+  }
+
+  // Gamma(alpha, 1) (Marsaglia and Tsang).
+  double gamma(double alpha)
+  {
+    if (alpha < 1.0) {
+      return gamma(alpha + 1.0) * pow(uniform(), 1.0 / alpha);
+    }
+    double d = alpha - 1.0 / 3.0;
+    double c = 1.0 / sqrt(9.0 * d);
+    while (true) {
+      double x = normal();
+      double v = 1.0 + c * x;
+      if (v <= 0.0) {
+        continue;
+      }
+      v = v * v * v;
+      if (log(uniform()) < 0.5 * x * x + d - d * v + d * log(v)) {
+        return d * v;
+      }
+    }
+  }
+};
+
 long select_dist_iterations(const Kernel &kernel,
                                  long graph_index, long timestep, long point)
 {
-  long seed[3] = {graph_index, timestep, point};
-  double value = random_uniform(&seed[0], sizeof(seed));
-  uint64_t bits;
-  gen_bits(&seed[0], sizeof(seed), &bits);
-  int ratio = sizeof(uint64_t)/sizeof(unsigned);
-  unsigned seed_u = bits/ratio; // TODO: make this a valid conversion
-  std::default_random_engine generator(seed_u);
+  TaskRandom random(graph_index, timestep, point);
 
-  long iterations;
+  double iterations;
 
   switch(kernel.dist.type) {
     case DistType::UNIFORM:
       {
-      std::uniform_int_distribution<long> distribution(kernel.iterations, kernel.dist.max);
-      iterations = distribution(generator);
+      long range = std::max(kernel.dist.max - kernel.iterations + 1, 1L);
+      iterations = kernel.iterations + floor(random.uniform() * range);
       break;
       }
     case DistType::NORMAL:
       {
-      // std::normal_distribution<long> distribution(kernel.iterations, kernel.dist.std);
-      std::normal_distribution<double> distribution(0.0, 1.0);
-      double val = distribution(generator);
-      iterations = val*kernel.dist.std + kernel.iterations;
+      iterations = random.normal() * kernel.dist.std + kernel.iterations;
       break;
       }
     case DistType::GAMMA:
       {
         // Treat iterations as beta
-      std::gamma_distribution<double> distribution(kernel.dist.a, 1);
-      // std::gamma_distribution<long> distribution(kernel.dist.a, kernel.dist.b);
-      double val = distribution(generator);
-      iterations = kernel.iterations*val;
+      assert(kernel.dist.a > 0);
+      iterations = kernel.iterations * random.gamma(kernel.dist.a);
       break;
       }
     case DistType::CAUCHY:
       {
-      // std::cauchy_distribution<long> distribution(kernel.dist.a, kernel.dist.b);
-      std::cauchy_distribution<double> distribution(0.0, kernel.dist.b);
-      // TODO: make b a double
-      iterations = distribution(generator)+kernel.iterations;
-      iterations = distribution(generator);
+      iterations = kernel.iterations + kernel.dist.b * tan(M_PI * (random.uniform() - 0.5));
       break;
       }
     default:
       assert(false && "unimplemented kernel type");
   };
 
-  if(iterations < 0) iterations = 0; // protects from bad values from user or long tails
-  assert(iterations >= 0);
-  return iterations;
+  // protects from bad values from user or long tails
+  iterations = std::min(std::max(iterations, 0.0), (double)(LONG_MAX / 2));
+  return (long)iterations;
 }
 
-double execute_kernel_distribution(const Kernel &kernel,
-                                long graph_index, long timestep, long point)
+double execute_kernel_distribution(const Kernel &kernel, long iterations)
 {
-  long iterations = select_dist_iterations(kernel, graph_index, timestep, point);
   Kernel k(kernel);
   k.iterations = iterations;
   return execute_kernel_compute(k);
@@ -395,97 +854,102 @@ int mem_iter = kernel.iterations*kernel.fraction_mem;
 int compute_iter = kernel.iterations - mem_iter;  
 
 // Compute portion
-#if __AVX2__ == 1
-  __m256d A[16];
-  
-  for (int i = 0; i < 16; i++) {
-    A[i] = _mm256_set_pd(1.0f, 2.0f, 3.0f, 4.0f);
-  }
-  
-  for (long iter = 0; iter < compute_iter; iter++) {
-    for (int i = 0; i < 16; i++) {
-      A[i] = _mm256_fmadd_pd(A[i], A[i], A[i]);
-    }
-  }
-#elif __AVX__ == 1
-  __m256d A[16];
-  
-  for (int i = 0; i < 16; i++) {
-    A[i] = _mm256_set_pd(1.0f, 2.0f, 3.0f, 4.0f);
-  }
-  
-  for (long iter = 0; iter < compute_iter; iter++) {
-    for (int i = 0; i < 16; i++) {
-      A[i] = _mm256_mul_pd(A[i], A[i]);
-      A[i] = _mm256_add_pd(A[i], A[i]);
-    }
-  }
-#else
-  double A[64];
-  
-  for (int i = 0; i < 64; i++) {
-    A[i] = 1.2345;
-  }
-  
-  for (long iter = 0; iter < compute_iter; iter++) {
-    for (int i = 0; i < 64; i++) {
-        A[i] = A[i] * A[i] + A[i];
-    }
-  } 
-#endif
+  double dot = compute_variant().execute(compute_iter);
 
   // Memory portion
-  long iter = 0;
-
-  size_t sample_bytes = scratch_bytes / kernel.samples;
+  visit_samples(kernel.samples, mem_iter, scratch_ptr, scratch_bytes, timestep, copy);
 
-  // Prologue
-  {
-    long start_idx = (timestep * mem_iter + iter) % kernel.samples;
-    long stop_idx = std::min((long)kernel.samples, start_idx + mem_iter);
-    long num_iter = stop_idx - start_idx;
+  return dot;
+}
 
-    if (num_iter > 0) {
-      char *sample_ptr = scratch_ptr + start_idx * sample_bytes;
+int kernel_threads(const Kernel &kernel)
+{
+  return std::max(kernel.threads, 1);
+}
 
-      copy(sample_ptr, num_iter * sample_bytes);
+// Spins before yielding, so that an idle team does not starve the cores
+// it shares with other workers.
+#define TEAM_SPINS_BEFORE_YIELD (1 << 14)
 
-      iter += num_iter;
+template <typename F>
+static void spin_until(F done)
+{
+  for (long spins = 0; !done(); spins++) {
+    if (spins < TEAM_SPINS_BEFORE_YIELD) {
+#ifdef CORE_KERNEL_X86
+      _mm_pause();
+#endif
+    } else {
+      std::this_thread::yield();
     }
   }
+}
 
-  // Body
-  for ( ; iter + kernel.samples <= mem_iter; iter += kernel.samples) {
-    long start_idx = (timestep * mem_iter + iter) % kernel.samples;
-    long num_iter = kernel.samples;
-
-    char *sample_ptr = scratch_ptr + start_idx * sample_bytes;
-
-    copy(sample_ptr, num_iter * sample_bytes);
+// Helper threads of one worker. Each run bumps generation; every helper
+// runs its share (if any) and decrements pending, which the caller waits
+// on, so consecutive runs never overlap.
+struct TaskTeam {
+  std::vector<std::thread> helpers;
+  std::atomic<unsigned long> generation;
+  std::atomic<long> pending;
+  std::atomic<bool> stop;
+  const std::function<void(int, int)> *work;
+  int size;
+
+  explicit TaskTeam(int threads)
+    : generation(0), pending(0), stop(false), work(NULL), size(0)
+  {
+    for (int thread = 1; thread < threads; thread++) {
+      helpers.emplace_back(&TaskTeam::help, this, thread);
+    }
   }
 
-  // Epilogue
+  ~TaskTeam()
   {
-    long start_idx = (timestep * mem_iter + iter) % kernel.samples;
-    long stop_idx = start_idx + (mem_iter - iter);
-    long num_iter = stop_idx - start_idx;
-
-    if (num_iter > 0) {
-      char *sample_ptr = scratch_ptr + start_idx * sample_bytes;
-
-      copy(sample_ptr, num_iter * sample_bytes);
-
-      iter += num_iter;
+    stop.store(true, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+    for (auto &helper : helpers) {
+      helper.join();
     }
   }
 
-  assert(iter == mem_iter);
+  void help(int thread)
+  {
+    unsigned long seen = 0;
+    while (true) {
+      spin_until([&] { return generation.load(std::memory_order_acquire) != seen; });
+      seen++;
+      if (stop.load(std::memory_order_relaxed)) {
+        return;
+      }
+      if (thread < size) {
+        (*work)(thread, size);
+      }
+      pending.fetch_sub(1, std::memory_order_release);
+    }
+  }
 
-  double *C = (double *)A;
-  double dot = 1.0;
-  for (int i = 0; i < 64; i++) {
-    dot *= C[i];
+  void run(int threads, const std::function<void(int, int)> &f)
+  {
+    work = &f;
+    size = threads;
+    pending.store(helpers.size(), std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+    f(0, threads);
+    spin_until([&] { return pending.load(std::memory_order_acquire) == 0; });
   }
-  return dot; 
+};
 
+void run_task_team(int threads, const std::function<void(int, int)> &f)
+{
+  if (threads <= 1) {
+    f(0, 1);
+    return;
+  }
+  static thread_local std::unique_ptr<TaskTeam> team;
+  if (!team || (int)team->helpers.size() + 1 < threads) {
+    team.reset();
+    team.reset(new TaskTeam(threads));
+  }
+  team->run(threads, f);
 }
@@ -16,20 +16,118 @@
 #ifndef CORE_KERNEL_H
 #define CORE_KERNEL_H
 
+#include <cassert>
 #include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#define CACHE_LINE_BYTES 64
 
 struct Kernel;
 
+// Threads that share one task of this kernel (kernel.threads, at least 1).
+int kernel_threads(const Kernel &kernel);
+
+// Calls f(thread, threads) for thread in [0, threads) and returns when all
+// calls have finished. The caller runs thread 0; the others belong to a
+// team owned by the calling thread, started on first use and spinning at
+// a barrier between tasks.
+void run_task_team(int threads, const std::function<void(int, int)> &f);
+
 void execute_kernel_empty(const Kernel &kernel);
 
 long long execute_kernel_busy_wait(const Kernel &kernel);
 
+// Applies op(ptr, bytes) to the slices of scratch (divided into samples)
+// covered by the given number of iterations, starting where this timestep left off and
+// grouping contiguous slices into one call.
+template <typename F>
+void visit_samples(long samples, long iterations,
+                   char *scratch_ptr, size_t scratch_bytes,
+                   long timestep, F op)
+{
+  long iter = 0;
+
+  size_t sample_bytes = scratch_bytes / samples;
+
+  // Prologue
+  {
+    long start_idx = (timestep * iterations + iter) % samples;
+    long stop_idx = std::min((long)samples, start_idx + iterations);
+    long num_iter = stop_idx - start_idx;
+
+    if (num_iter > 0) {
+      char *sample_ptr = scratch_ptr + start_idx * sample_bytes;
+
+      op(sample_ptr, num_iter * sample_bytes);
+
+      iter += num_iter;
+    }
+  }
+
+  // Body
+  for ( ; iter + samples <= iterations; iter += samples) {
+    long start_idx = (timestep * iterations + iter) % samples;
+    long num_iter = samples;
+
+    char *sample_ptr = scratch_ptr + start_idx * sample_bytes;
+
+    op(sample_ptr, num_iter * sample_bytes);
+  }
+
+  // Epilogue
+  {
+    long start_idx = (timestep * iterations + iter) % samples;
+    long stop_idx = start_idx + (iterations - iter);
+    long num_iter = stop_idx - start_idx;
+
+    if (num_iter > 0) {
+      char *sample_ptr = scratch_ptr + start_idx * sample_bytes;
+
+      op(sample_ptr, num_iter * sample_bytes);
+
+      iter += num_iter;
+    }
+  }
+
+  assert(iter == iterations);
+}
+
 void execute_kernel_memory(const Kernel &kernel,
                            char *scratch_large_ptr, size_t scratch_large_bytes, 
                            long timestep);
 
+void execute_kernel_memory_stream(const Kernel &kernel,
+                                  char *scratch_ptr, size_t scratch_bytes,
+                                  long timestep);
+
+// Stride used by memory_strided (kernel.stride, or a cache line if 0).
+size_t kernel_stride(const Kernel &kernel);
+
+uint64_t execute_kernel_memory_strided(const Kernel &kernel,
+                                       char *scratch_ptr, size_t scratch_bytes,
+                                       long timestep);
+
+// Links the cache lines of a scratch buffer into the random cycle followed
+// by memory_chase. Called from TaskGraph::prepare_scratch when some graph
+// runs memory_chase.
+void prepare_pointer_chase(char *scratch_ptr, size_t scratch_bytes);
+
+// Dependent loads performed by one memory_chase task.
+long long chase_hops(const Kernel &kernel, size_t scratch_bytes);
+
+uint64_t execute_kernel_memory_chase(const Kernel &kernel,
+                                     char *scratch_ptr, size_t scratch_bytes,
+                                     long timestep);
+
+// Name of the DGEMM implementation linked in ("builtin" without a BLAS).
+const char *dgemm_kernel_name();
+
+// C += A * B on N x N matrices. Computes the columns of C in
+// [N * part / parts, N * (part + 1) / parts), so parts can run in parallel.
 void execute_kernel_dgemm(const Kernel &kernel,
-                          char *scratch_ptr, size_t scratch_bytes);
+                          char *scratch_ptr, size_t scratch_bytes,
+                          int part = 0, int parts = 1);
 
 void execute_kernel_daxpy(const Kernel &kernel,
                           char *scratch_large_ptr, size_t scratch_large_bytes, 
@@ -37,9 +135,15 @@ void execute_kernel_daxpy(const Kernel &kernel,
 
 double execute_kernel_compute(const Kernel &kernel);
 
+// Compute kernel variant selected for this CPU at startup (e.g. "avx512",
+// "avx2", "neon", "scalar") and the FLOPs it performs per iteration.
+const char *compute_kernel_isa();
+long long compute_kernel_flops_per_iteration();
+
 double execute_kernel_compute2(const Kernel &kernel);
 
-void execute_kernel_io(const Kernel &kernel);
+// Implemented in io_kernel.cc.
+void execute_kernel_io(const Kernel &kernel, long graph_index, long timestep, long point);
 
 long select_imbalance_iterations(const Kernel &kernel,
                                  long graph_index, long timestep, long point);
@@ -50,8 +154,9 @@ double execute_kernel_imbalance(const Kernel &kernel,
 long select_dist_iterations(const Kernel &kernel,
                             long graph_index, long timestep, long point);
 
-double execute_kernel_distribution(const Kernel &kernel,
-                                   long graph_index, long timestep, long point);
+// Runs the compute kernel for the given number of iterations, normally
+// select_dist_iterations of the task.
+double execute_kernel_distribution(const Kernel &kernel, long iterations);
 
 double execute_kernel_compute_and_mem(const Kernel &kernel,
                            char *scratch_large_ptr, size_t scratch_large_bytes, 
@@ -17,6 +17,12 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CORE_RANDOM_X86 1
+#include <immintrin.h>
+#endif
 
 #include "core_random.h"
 
@@ -29,12 +35,135 @@
 #include <stdio.h>
 #endif
 
+static const uint8_t gen_bits_key[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
+
 void gen_bits(const void *input, size_t input_bytes, void *output)
 {
   // To generate deterministic uniformly distributed bits, run a hash
   // function on the seed and use the hash value as the output.
-  const uint8_t k[16] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
-  siphash(input, input_bytes, k, output, sizeof(uint64_t));
+  siphash(input, input_bytes, gen_bits_key, output, sizeof(uint64_t));
+}
+
+#if defined(CORE_RANDOM_X86) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+// SipHash-2-4 with 64-bit output (as in siphash.c) on four inputs, one per
+// 64-bit AVX2 lane.
+
+#define ROTL4(x, b) _mm256_or_si256(_mm256_slli_epi64((x), (b)), _mm256_srli_epi64((x), 64 - (b)))
+#define ROTL4_32(x) _mm256_shuffle_epi32((x), _MM_SHUFFLE(2, 3, 0, 1))
+
+#define SIPROUND4                                                              \
+    do {                                                                       \
+        v0 = _mm256_add_epi64(v0, v1);                                         \
+        v1 = ROTL4(v1, 13);                                                    \
+        v1 = _mm256_xor_si256(v1, v0);                                         \
+        v0 = ROTL4_32(v0);                                                     \
+        v2 = _mm256_add_epi64(v2, v3);                                         \
+        v3 = ROTL4(v3, 16);                                                    \
+        v3 = _mm256_xor_si256(v3, v2);                                         \
+        v0 = _mm256_add_epi64(v0, v3);                                         \
+        v3 = ROTL4(v3, 21);                                                    \
+        v3 = _mm256_xor_si256(v3, v0);                                         \
+        v2 = _mm256_add_epi64(v2, v1);                                         \
+        v1 = ROTL4(v1, 17);                                                    \
+        v1 = _mm256_xor_si256(v1, v2);                                         \
+        v2 = ROTL4_32(v2);                                                     \
+    } while (0)
+
+static inline uint64_t load_word(const uint8_t *p)
+{
+  uint64_t word;
+  memcpy(&word, p, sizeof(word));
+  return word;
+}
+
+// Final block: remaining bytes plus the length in the top byte.
+static inline uint64_t last_block(const uint8_t *in, size_t inlen)
+{
+  uint64_t b = ((uint64_t)inlen) << 56;
+  size_t end = inlen - (inlen % sizeof(uint64_t));
+  for (size_t i = end; i < inlen; i++) {
+    b |= ((uint64_t)in[i]) << (8 * (i - end));
+  }
+  return b;
+}
+
+__attribute__((target("avx2")))
+static void siphash4_avx2(const uint8_t *in, size_t inlen, uint64_t *out)
+{
+  const uint8_t *in0 = in, *in1 = in + inlen, *in2 = in + 2 * inlen, *in3 = in + 3 * inlen;
+  uint64_t k0 = load_word(gen_bits_key);
+  uint64_t k1 = load_word(gen_bits_key + 8);
+  __m256i v0 = _mm256_set1_epi64x(0x736f6d6570736575ULL ^ k0);
+  __m256i v1 = _mm256_set1_epi64x(0x646f72616e646f6dULL ^ k1);
+  __m256i v2 = _mm256_set1_epi64x(0x6c7967656e657261ULL ^ k0);
+  __m256i v3 = _mm256_set1_epi64x(0x7465646279746573ULL ^ k1);
+
+  size_t end = inlen - (inlen % sizeof(uint64_t));
+  for (size_t offset = 0; offset < end; offset += sizeof(uint64_t)) {
+    __m256i m = _mm256_set_epi64x(load_word(in3 + offset), load_word(in2 + offset),
+                                  load_word(in1 + offset), load_word(in0 + offset));
+    v3 = _mm256_xor_si256(v3, m);
+    SIPROUND4;
+    SIPROUND4;
+    v0 = _mm256_xor_si256(v0, m);
+  }
+
+  __m256i b = _mm256_set_epi64x(last_block(in3, inlen), last_block(in2, inlen),
+                                last_block(in1, inlen), last_block(in0, inlen));
+  v3 = _mm256_xor_si256(v3, b);
+  SIPROUND4;
+  SIPROUND4;
+  v0 = _mm256_xor_si256(v0, b);
+
+  v2 = _mm256_xor_si256(v2, _mm256_set1_epi64x(0xff));
+  SIPROUND4;
+  SIPROUND4;
+  SIPROUND4;
+  SIPROUND4;
+
+  __m256i result = _mm256_xor_si256(_mm256_xor_si256(v0, v1), _mm256_xor_si256(v2, v3));
+  _mm256_storeu_si256((__m256i *)out, result);
+}
+
+static int have_avx2(void)
+{
+  static int cached = -1;
+  if (cached < 0) {
+    __builtin_cpu_init();
+    cached = __builtin_cpu_supports("avx2") ? 1 : 0;
+  }
+  return cached;
+}
+#define HAVE_SIPHASH4 1
+#endif
+
+void gen_bits_batch(const void *inputs, size_t input_bytes, size_t count, uint64_t *outputs)
+{
+  const uint8_t *in = (const uint8_t *)inputs;
+  size_t i = 0;
+#ifdef HAVE_SIPHASH4
+  if (have_avx2()) {
+    for ( ; i + 4 <= count; i += 4) {
+      siphash4_avx2(in + i * input_bytes, input_bytes, outputs + i);
+    }
+  }
+#endif
+  for ( ; i < count; i++) {
+    gen_bits(in + i * input_bytes, input_bytes, outputs + i);
+  }
+}
+
+void random_uniform_batch(const void *inputs, size_t input_bytes, size_t count, double *outputs)
+{
+  const uint8_t *in = (const uint8_t *)inputs;
+  uint64_t bits[64];
+  for (size_t first = 0; first < count; first += 64) {
+    size_t n = count - first < 64 ? count - first : 64;
+    gen_bits_batch(in + first * input_bytes, input_bytes, n, bits);
+    for (size_t i = 0; i < n; i++) {
+      outputs[first + i] = ((double)bits[i]) * 0x1.p-64;
+    }
+  }
 }
 
 double random_uniform(const void *input, size_t input_bytes)
@@ -45,6 +174,34 @@ double random_uniform(const void *input, size_t input_bytes)
   return ((double)bits) * 0x1.p-64;
 }
 
+#define PHILOX_M0 UINT32_C(0xD2511F53)
+#define PHILOX_M1 UINT32_C(0xCD9E8D57)
+#define PHILOX_W0 UINT32_C(0x9E3779B9)
+#define PHILOX_W1 UINT32_C(0xBB67AE85)
+#define PHILOX_ROUNDS 10
+
+void philox4x32(const uint32_t key[2], const uint32_t counter[4], uint32_t output[4])
+{
+  uint32_t k0 = key[0], k1 = key[1];
+  uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+  for (int round = 0; round < PHILOX_ROUNDS; round++) {
+    uint64_t p0 = (uint64_t)PHILOX_M0 * c0;
+    uint64_t p1 = (uint64_t)PHILOX_M1 * c2;
+    uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+    uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+    c1 = (uint32_t)p1;
+    c3 = (uint32_t)p0;
+    c0 = n0;
+    c2 = n2;
+    k0 += PHILOX_W0;
+    k1 += PHILOX_W1;
+  }
+  output[0] = c0;
+  output[1] = c1;
+  output[2] = c2;
+  output[3] = c3;
+}
+
 #ifdef TEST_HARNESS
 int main() {
   constexpr size_t num_buckets = 1024;
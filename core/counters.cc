@@ -0,0 +1,171 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "counters.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+struct ThreadCounters {
+  int leader; // group fd, -1 if no event could be opened
+  int slot[NUM_COUNTER_EVENTS]; // position in a group read, -1 if unavailable
+  int n_slots;
+  uint64_t tasks;
+  uint64_t totals[NUM_COUNTER_EVENTS];
+};
+
+static bool enabled = false;
+
+// Threads' counters outlive their threads, like latency histograms.
+static std::mutex registry_mutex;
+static std::vector<ThreadCounters *> registry;
+
+static thread_local ThreadCounters *local_counters = NULL;
+
+void counters_enable()
+{
+  enabled = true;
+}
+
+bool counters_enabled()
+{
+  return enabled;
+}
+
+#ifdef __linux__
+static int open_event(uint64_t type, uint64_t config, int group)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = type;
+  attr.config = config;
+  attr.exclude_kernel = 1;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP;
+  return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+static ThreadCounters *open_counters()
+{
+  ThreadCounters *counters = new ThreadCounters;
+  counters->leader = -1;
+  counters->n_slots = 0;
+  counters->tasks = 0;
+  for (int e = 0; e < NUM_COUNTER_EVENTS; e++) {
+    counters->slot[e] = -1;
+    counters->totals[e] = 0;
+  }
+
+  int error = ENOSYS;
+#ifdef __linux__
+  const uint64_t configs[NUM_COUNTER_EVENTS] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+  };
+  for (int e = 0; e < NUM_COUNTER_EVENTS; e++) {
+    int fd = open_event(PERF_TYPE_HARDWARE, configs[e], counters->leader);
+    if (fd < 0) {
+      error = errno;
+      continue;
+    }
+    if (counters->leader < 0) {
+      counters->leader = fd;
+    }
+    counters->slot[e] = counters->n_slots++;
+  }
+#endif
+
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  if (counters->leader < 0 && registry.empty()) {
+    fprintf(stderr, "warning: perf_event_open failed (%s), no hardware counters\n", strerror(error));
+  }
+  registry.push_back(counters);
+  return counters;
+}
+
+void counters_read(CounterSample &sample)
+{
+  ThreadCounters *counters = local_counters;
+  if (!counters) {
+    counters = local_counters = open_counters();
+  }
+
+  memset(&sample, 0, sizeof(sample));
+  if (counters->leader < 0) {
+    return;
+  }
+  // PERF_FORMAT_GROUP: the number of events, then their values.
+  uint64_t buffer[1 + NUM_COUNTER_EVENTS];
+  ssize_t bytes = read(counters->leader, buffer, sizeof(buffer));
+  if (bytes < (ssize_t)((1 + counters->n_slots) * sizeof(uint64_t))) {
+    return;
+  }
+  for (int e = 0; e < NUM_COUNTER_EVENTS; e++) {
+    if (counters->slot[e] >= 0) {
+      sample.values[e] = buffer[1 + counters->slot[e]];
+    }
+  }
+}
+
+void counters_accumulate(const CounterSample &begin, const CounterSample &end)
+{
+  ThreadCounters *counters = local_counters;
+  if (!counters) {
+    return;
+  }
+  counters->tasks++;
+  for (int e = 0; e < NUM_COUNTER_EVENTS; e++) {
+    counters->totals[e] += end.values[e] - begin.values[e];
+  }
+}
+
+CounterTotals counters_collect()
+{
+  CounterTotals result;
+  memset(&result, 0, sizeof(result));
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto counters : registry) {
+    result.tasks += counters->tasks;
+    for (int e = 0; e < NUM_COUNTER_EVENTS; e++) {
+      result.values[e] += counters->totals[e];
+      result.available[e] = result.available[e] || counters->slot[e] >= 0;
+    }
+  }
+  return result;
+}
+
+void counters_reset()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto counters : registry) {
+    counters->tasks = 0;
+    for (int e = 0; e < NUM_COUNTER_EVENTS; e++) {
+      counters->totals[e] = 0;
+    }
+  }
+}
@@ -0,0 +1,59 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <cstdint>
+
+// Hardware counters around kernels (-counters), through perf_event_open
+// on Linux. Each thread opens one counter group (user space only) the
+// first time it runs a kernel; events the machine or kernel does not
+// provide are left out. Only the thread that runs a task is counted, not
+// the helper threads of -task-threads.
+
+enum CounterEvent {
+  COUNTER_CYCLES,
+  COUNTER_INSTRUCTIONS,
+  COUNTER_LLC_MISSES,
+  NUM_COUNTER_EVENTS,
+};
+
+struct CounterSample {
+  uint64_t values[NUM_COUNTER_EVENTS];
+};
+
+// Sums over the tasks of all threads (live or exited) of this process.
+struct CounterTotals {
+  uint64_t tasks;
+  uint64_t values[NUM_COUNTER_EVENTS];
+  bool available[NUM_COUNTER_EVENTS]; // opened on at least one thread
+};
+
+void counters_enable();
+
+bool counters_enabled();
+
+// Current counts of the calling thread (zero for unavailable events).
+void counters_read(CounterSample &sample);
+
+// Adds one task, end - begin, to the calling thread's totals.
+void counters_accumulate(const CounterSample &begin, const CounterSample &end);
+
+// Only call while no tasks are executing.
+CounterTotals counters_collect();
+void counters_reset();
+
+#endif //COUNTERS_H
@@ -0,0 +1,150 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "graph_file.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(std::pair<long, long>) == 2 * sizeof(int64_t),
+              "graph file intervals must match std::pair<long, long>");
+
+// Indexed by graph_index, read-only after App::App.
+static std::vector<std::unique_ptr<GraphFile> > graph_files;
+
+static void unmap(GraphFile *file)
+{
+  if (file) {
+    munmap(const_cast<GraphFileHeader *>(file->header), file->map_bytes);
+  }
+}
+
+const GraphFile &graph_file_open(long graph_index, const char *path)
+{
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "error: Unable to open graph file \"%s\": %s\n", path, strerror(errno));
+    abort();
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    fprintf(stderr, "error: Unable to stat graph file \"%s\": %s\n", path, strerror(errno));
+    abort();
+  }
+  size_t bytes = st.st_size;
+  if (bytes < sizeof(GraphFileHeader)) {
+    fprintf(stderr, "error: Graph file \"%s\" is truncated\n", path);
+    abort();
+  }
+  void *ptr = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    fprintf(stderr, "error: Unable to map graph file \"%s\": %s\n", path, strerror(errno));
+    abort();
+  }
+
+  std::unique_ptr<GraphFile> file(new GraphFile);
+  file->header = reinterpret_cast<const GraphFileHeader *>(ptr);
+  file->map_bytes = bytes;
+  const GraphFileHeader &h = *file->header;
+  if (memcmp(h.magic, GRAPH_FILE_MAGIC, sizeof(h.magic)) != 0) {
+    fprintf(stderr, "error: \"%s\" is not a graph file\n", path);
+    abort();
+  }
+  // Each array must fit in what is left of the file. Counts are checked
+  // one at a time, so that no sum of them can overflow.
+  uint64_t words = (bytes - sizeof(GraphFileHeader)) / sizeof(uint64_t);
+  bool fits = true;
+  auto take = [&](uint64_t count, uint64_t words_per) {
+    if (count > words / words_per) {
+      fits = false;
+    } else {
+      words -= count * words_per;
+    }
+  };
+  take(h.timesteps, 1);
+  take(1, 1);
+  take(h.num_tasks, 2);
+  take(2, 1);
+  take(h.num_tasks, 2);
+  take(h.num_in_intervals, 2);
+  take(h.num_out_intervals, 2);
+  if (!fits || h.timesteps == 0 || h.max_width == 0) {
+    fprintf(stderr, "error: Graph file \"%s\" is truncated\n", path);
+    abort();
+  }
+
+  const uint64_t *next = reinterpret_cast<const uint64_t *>(file->header + 1);
+  file->step_offsets = next;
+  next += h.timesteps + 1;
+  file->in_offsets = next;
+  next += h.num_tasks + 1;
+  file->out_offsets = next;
+  next += h.num_tasks + 1;
+  file->iterations = reinterpret_cast<const int64_t *>(next);
+  next += h.num_tasks;
+  file->output_bytes = next;
+  next += h.num_tasks;
+  file->in_intervals = reinterpret_cast<const std::pair<long, long> *>(next);
+  next += 2 * h.num_in_intervals;
+  file->out_intervals = reinterpret_cast<const std::pair<long, long> *>(next);
+
+  // Offsets start at 0, never decrease and end at the size of what they
+  // index; widths are at most max_width. Then every index derived from
+  // them stays within the mapping.
+  auto ascending = [](const uint64_t *offsets, uint64_t n, uint64_t total, uint64_t max_step) {
+    if (offsets[0] != 0 || offsets[n] != total) {
+      return false;
+    }
+    for (uint64_t i = 0; i < n; ++i) {
+      if (offsets[i + 1] < offsets[i] || offsets[i + 1] - offsets[i] > max_step) {
+        return false;
+      }
+    }
+    return true;
+  };
+  if (h.max_width > h.num_tasks ||
+      !ascending(file->step_offsets, h.timesteps, h.num_tasks, h.max_width) ||
+      !ascending(file->in_offsets, h.num_tasks, h.num_in_intervals, h.num_in_intervals) ||
+      !ascending(file->out_offsets, h.num_tasks, h.num_out_intervals, h.num_out_intervals)) {
+    fprintf(stderr, "error: Graph file \"%s\" has inconsistent offsets\n", path);
+    abort();
+  }
+
+  if (graph_index >= (long)graph_files.size()) {
+    graph_files.resize(graph_index + 1);
+  }
+  unmap(graph_files[graph_index].get());
+  graph_files[graph_index] = std::move(file);
+  return *graph_files[graph_index];
+}
+
+const GraphFile *graph_file(long graph_index)
+{
+  if (graph_index < 0 || graph_index >= (long)graph_files.size()) {
+    return NULL;
+  }
+  return graph_files[graph_index].get();
+}
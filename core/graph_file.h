@@ -0,0 +1,88 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GRAPH_FILE_H
+#define GRAPH_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+
+// Task graphs captured from applications (-graph-file). The file is a
+// levelized DAG: every edge goes from timestep t-1 to t, which
+// scripts/graph_import.py arranges by inserting forwarding tasks. Files
+// are mapped read-only and read in place, never parsed into memory.
+//
+// Layout: a GraphFileHeader followed by these arrays of 8-byte
+// little-endian integers, where tasks are numbered by timestep, then
+// point, and the points of timestep t are 0 .. width(t)-1:
+//
+//   step_offsets[timesteps + 1]     first task of each timestep
+//   in_offsets[num_tasks + 1]       in-edges of task i are in_intervals[in_offsets[i] ..
+//                                   in_offsets[i+1]), likewise for out-edges
+//   out_offsets[num_tasks + 1]
+//   iterations[num_tasks]           kernel iterations of each task
+//   output_bytes[num_tasks]
+//   in_intervals[num_in_intervals]  inclusive (first, last) points of timestep
+//                                   t-1, ascending and disjoint
+//   out_intervals[num_out_intervals] same for the consumers in timestep t+1
+//
+// Intervals have the layout of std::pair<long, long>, so dependencies
+// are returned as pointers into the mapping.
+
+#define GRAPH_FILE_MAGIC "TBGRAPH1"
+
+struct GraphFileHeader {
+  char magic[8];
+  uint64_t timesteps;
+  uint64_t max_width;
+  uint64_t num_tasks;
+  uint64_t num_in_intervals;
+  uint64_t num_out_intervals;
+  uint64_t max_output_bytes;
+};
+
+struct GraphFile {
+  const GraphFileHeader *header;
+  const uint64_t *step_offsets;
+  const uint64_t *in_offsets;
+  const uint64_t *out_offsets;
+  const int64_t *iterations;
+  const uint64_t *output_bytes;
+  const std::pair<long, long> *in_intervals;
+  const std::pair<long, long> *out_intervals;
+  size_t map_bytes;
+
+  long width(long timestep) const
+  {
+    return step_offsets[timestep + 1] - step_offsets[timestep];
+  }
+
+  long task(long timestep, long point) const
+  {
+    return step_offsets[timestep] + point;
+  }
+};
+
+// Maps path for graph_index, replacing any earlier file of that graph.
+// Aborts if the file is missing, truncated or not a graph file, or if its
+// offsets index outside the file. Edges are checked by App::check.
+const GraphFile &graph_file_open(long graph_index, const char *path);
+
+// The file of a graph, or NULL if it was not loaded from one.
+const GraphFile *graph_file(long graph_index);
+
+#endif // GRAPH_FILE_H
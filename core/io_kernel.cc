@@ -0,0 +1,432 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "io_kernel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core_kernel.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define IO_HAVE_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+// Alignment of buffers, offsets and sizes for direct I/O.
+#define IO_ALIGNMENT 4096
+
+static std::string io_prefix = "task_bench_io";
+
+void io_kernel_set_prefix(const char *prefix)
+{
+  io_prefix = prefix;
+}
+
+long io_kernel_block(const Kernel &kernel)
+{
+  return kernel.io_block > 0 ? kernel.io_block : IO_DEFAULT_BLOCK;
+}
+
+static long io_depth(const Kernel &kernel)
+{
+  return kernel.io_depth > 0 ? kernel.io_depth : IO_DEFAULT_DEPTH;
+}
+
+static bool is_direct(const Kernel &kernel)
+{
+  return kernel.io_mode == IO_MODE_DIRECT || kernel.io_mode == IO_MODE_URING;
+}
+
+// One open file per (graph, mode). Like the output size maps, files live
+// in a process-wide list that is never freed, so lookups are lock-free.
+// For reads, prepared holds per point the extent bytes its data was
+// written for, 0 if none, or -1 while a thread writes it.
+struct IoFile {
+  long graph_index;
+  io_mode_t mode;
+  int fd;
+  long max_width;
+  std::unique_ptr<std::atomic<off_t>[]> prepared;
+  IoFile *next;
+};
+
+static std::atomic<IoFile *> io_files(NULL);
+static std::mutex io_files_mutex;
+
+static int open_file(const Kernel &kernel, long graph_index)
+{
+  std::string path = io_prefix + "." + std::to_string(getpid()) + "." + std::to_string(graph_index);
+  int flags = O_RDWR | O_CREAT;
+  int fd = -1;
+#ifdef O_DIRECT
+  if (is_direct(kernel)) {
+    fd = open(path.c_str(), flags | O_DIRECT, 0600);
+    if (fd < 0 && errno == EINVAL) {
+      fprintf(stderr, "warning: O_DIRECT is not supported for \"%s\", using buffered I/O\n", path.c_str());
+    }
+  }
+#endif
+  if (fd < 0) {
+    fd = open(path.c_str(), flags, 0600);
+  }
+  if (fd < 0) {
+    fprintf(stderr, "error: Unable to open I/O kernel file \"%s\": %s\n", path.c_str(), strerror(errno));
+    abort();
+  }
+#if !defined(O_DIRECT) && defined(F_NOCACHE)
+  if (is_direct(kernel)) {
+    fcntl(fd, F_NOCACHE, 1);
+  }
+#endif
+  unlink(path.c_str());
+  return fd;
+}
+
+static IoFile *find_file(const Kernel &kernel, long graph_index)
+{
+  for (IoFile *file = io_files.load(std::memory_order_acquire); file; file = file->next) {
+    if (file->graph_index == graph_index && file->mode == kernel.io_mode) {
+      return file;
+    }
+  }
+  return NULL;
+}
+
+static IoFile *io_file(const Kernel &kernel, long graph_index, long max_width)
+{
+  IoFile *file = find_file(kernel, graph_index);
+  if (file) {
+    return file;
+  }
+
+  std::lock_guard<std::mutex> lock(io_files_mutex);
+  file = find_file(kernel, graph_index);
+  if (file) {
+    return file;
+  }
+  file = new IoFile{graph_index, kernel.io_mode, open_file(kernel, graph_index), max_width,
+                    std::unique_ptr<std::atomic<off_t>[]>(new std::atomic<off_t>[max_width]), NULL};
+  for (long point = 0; point < max_width; ++point) {
+    file->prepared[point].store(0, std::memory_order_relaxed);
+  }
+  file->next = io_files.load(std::memory_order_relaxed);
+  io_files.store(file, std::memory_order_release);
+  return file;
+}
+
+// Per-thread aligned buffer holding depth blocks.
+static char *io_buffer(size_t bytes)
+{
+  static thread_local char *buffer = NULL;
+  static thread_local size_t buffer_bytes = 0;
+  if (bytes > buffer_bytes) {
+    free(buffer);
+    void *ptr = NULL;
+    int ret = posix_memalign(&ptr, IO_ALIGNMENT, bytes);
+    assert(ret == 0);
+    memset(ptr, 0x5C, bytes);
+    buffer = reinterpret_cast<char *>(ptr);
+    buffer_bytes = bytes;
+  }
+  return buffer;
+}
+
+static void check_io(ssize_t ret, const char *op)
+{
+  if (ret < 0) {
+    fprintf(stderr, "error: I/O kernel %s failed: %s\n", op, strerror(errno));
+    abort();
+  }
+}
+
+static void transfer_sync(int fd, bool write, char *buffer, size_t bytes, off_t offset)
+{
+  size_t done = 0;
+  while (done < bytes) {
+    ssize_t ret = write ? pwrite(fd, buffer + done, bytes - done, offset + done)
+                        : pread(fd, buffer + done, bytes - done, offset + done);
+    if (ret < 0 && errno == EINTR) {
+      continue;
+    }
+    check_io(ret, write ? "pwrite" : "pread");
+    if (ret == 0) {
+      fprintf(stderr, "error: I/O kernel %s reached the end of the file at offset %lld\n",
+              write ? "pwrite" : "pread", (long long)(offset + done));
+      abort();
+    }
+    done += ret;
+  }
+}
+
+#ifdef IO_HAVE_URING
+// Minimal io_uring driven directly through the system calls, so that the
+// library has no liburing dependency. One ring per thread.
+struct IoRing {
+  int fd;
+  unsigned entries;
+  unsigned *sq_tail, *sq_mask, *sq_array;
+  unsigned *cq_head, *cq_tail, *cq_mask;
+  struct io_uring_sqe *sqes;
+  struct io_uring_cqe *cqes;
+  void *sq_ptr, *cq_ptr;
+  size_t sq_bytes, cq_bytes, sqe_bytes;
+
+  IoRing() : fd(-1), entries(0) {}
+  ~IoRing() { close_ring(); }
+
+  bool open_ring(unsigned depth)
+  {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    fd = syscall(__NR_io_uring_setup, depth, &params);
+    if (fd < 0) {
+      return false;
+    }
+    entries = params.sq_entries;
+    sq_bytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_bytes = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    sqe_bytes = params.sq_entries * sizeof(struct io_uring_sqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+      sq_bytes = cq_bytes = std::max(sq_bytes, cq_bytes);
+    }
+
+    sq_ptr = mmap(NULL, sq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    cq_ptr = single_mmap ? sq_ptr : mmap(NULL, cq_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+    void *sqe_ptr = mmap(NULL, sqe_bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    assert(sq_ptr != MAP_FAILED && cq_ptr != MAP_FAILED && sqe_ptr != MAP_FAILED);
+
+    char *sq = reinterpret_cast<char *>(sq_ptr);
+    char *cq = reinterpret_cast<char *>(cq_ptr);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+    sqes = reinterpret_cast<struct io_uring_sqe *>(sqe_ptr);
+    return true;
+  }
+
+  void close_ring()
+  {
+    if (fd < 0) {
+      return;
+    }
+    munmap(sqes, sqe_bytes);
+    if (cq_ptr != sq_ptr) {
+      munmap(cq_ptr, cq_bytes);
+    }
+    munmap(sq_ptr, sq_bytes);
+    close(fd);
+    fd = -1;
+  }
+
+  void push(int file_fd, bool write, char *buffer, size_t bytes, off_t offset, uint64_t user_data)
+  {
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    struct io_uring_sqe *sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe->fd = file_fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer);
+    sqe->len = bytes;
+    sqe->off = offset;
+    sqe->user_data = user_data;
+    sq_array[index] = index;
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+  }
+
+  // Submits pushed requests and waits for at least one completion.
+  // Appends the user_data of every completed request to completed.
+  // Every request must transfer all of its bytes.
+  void submit_and_wait(unsigned to_submit, size_t bytes, std::vector<uint64_t> &completed)
+  {
+    int ret;
+    do {
+      ret = syscall(__NR_io_uring_enter, fd, to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    check_io(ret, "io_uring_enter");
+
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    for ( ; head != tail; head++) {
+      const struct io_uring_cqe &cqe = cqes[head & *cq_mask];
+      if (cqe.res < 0) {
+        errno = -cqe.res;
+        check_io(-1, "io_uring request");
+      }
+      if ((size_t)cqe.res != bytes) {
+        fprintf(stderr, "error: I/O kernel io_uring request transferred %d of %zu bytes\n",
+                cqe.res, bytes);
+        abort();
+      }
+      completed.push_back(cqe.user_data);
+    }
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+  }
+};
+
+// Returns the calling thread's ring with room for depth requests, or NULL
+// if io_uring is unavailable.
+static IoRing *io_ring(unsigned depth)
+{
+  static thread_local IoRing ring;
+  static thread_local bool unavailable = false;
+  if (unavailable) {
+    return NULL;
+  }
+  if (ring.fd >= 0 && ring.entries >= depth) {
+    return &ring;
+  }
+  ring.close_ring();
+  if (!ring.open_ring(depth)) {
+    static std::atomic<bool> warned(false);
+    if (!warned.exchange(true)) {
+      fprintf(stderr, "warning: io_uring is not available (%s), using pread/pwrite\n", strerror(errno));
+    }
+    unavailable = true;
+    return NULL;
+  }
+  return &ring;
+}
+
+// Keeps up to depth requests in flight until all blocks are transferred.
+// Requests may complete in any order, so each carries its buffer slot in
+// user_data and a slot is only reused once its request has completed.
+static bool transfer_uring(int fd, bool write, char *buffer, long blocks, size_t block,
+                           off_t offset, long depth)
+{
+  IoRing *ring = io_ring(depth);
+  if (!ring) {
+    return false;
+  }
+
+  static thread_local std::vector<uint64_t> free_slots;
+  free_slots.clear();
+  for (long slot = depth - 1; slot >= 0; slot--) {
+    free_slots.push_back(slot);
+  }
+  long submitted = 0;
+  while ((long)free_slots.size() < depth || submitted < blocks) {
+    unsigned to_submit = 0;
+    while (submitted < blocks && !free_slots.empty()) {
+      uint64_t slot = free_slots.back();
+      free_slots.pop_back();
+      ring->push(fd, write, buffer + slot * block, block, offset + submitted * block, slot);
+      submitted++;
+      to_submit++;
+    }
+    ring->submit_and_wait(to_submit, block, free_slots);
+  }
+  return true;
+}
+#endif
+
+static void transfer_extent(const Kernel &kernel, int fd, bool write, off_t offset)
+{
+  size_t block = io_kernel_block(kernel);
+  long blocks = kernel.iterations;
+
+#ifdef IO_HAVE_URING
+  if (kernel.io_mode == IO_MODE_URING) {
+    long depth = std::min(io_depth(kernel), std::max(blocks, 1L));
+    char *buffer = io_buffer(depth * block);
+    if (transfer_uring(fd, write, buffer, blocks, block, offset, depth)) {
+      return;
+    }
+  }
+#endif
+
+  char *buffer = io_buffer(block);
+  for (long i = 0; i < blocks; i++) {
+    transfer_sync(fd, write, buffer, block, offset + i * block);
+  }
+}
+
+void io_kernel_prepare(const Kernel &kernel, long graph_index, long max_width)
+{
+  size_t block = io_kernel_block(kernel);
+  if (is_direct(kernel) && block % IO_ALIGNMENT != 0) {
+    fprintf(stderr, "error: I/O block size %zu must be a multiple of %d for direct I/O\n",
+            block, IO_ALIGNMENT);
+    abort();
+  }
+  io_file(kernel, graph_index, max_width);
+}
+
+bool io_kernel_prepares_on_read(const Kernel &kernel)
+{
+  return kernel.type == KernelType::IO_BOUND && !kernel.io_write && kernel.iterations > 0;
+}
+
+// Writes the extent of point before its first read, and again if the
+// extent size changed (e.g. as -metg scales iterations).
+static void prepare_extent(const Kernel &kernel, IoFile *file, long point, off_t extent)
+{
+  std::atomic<off_t> &prepared = file->prepared[point];
+  off_t state = prepared.load(std::memory_order_acquire);
+  while (state != extent) {
+    if (state < 0 || !prepared.compare_exchange_weak(state, -1, std::memory_order_acquire)) {
+      std::this_thread::yield();
+      state = prepared.load(std::memory_order_acquire);
+      continue;
+    }
+    size_t block = io_kernel_block(kernel);
+    char *buffer = io_buffer(block);
+    for (long i = 0; i < kernel.iterations; i++) {
+      transfer_sync(file->fd, true, buffer, block, point * extent + i * block);
+    }
+    fsync(file->fd);
+    prepared.store(extent, std::memory_order_release);
+    return;
+  }
+}
+
+void execute_kernel_io(const Kernel &kernel, long graph_index, long timestep, long point)
+{
+  IoFile *file = find_file(kernel, graph_index);
+  if (!file || point >= file->max_width) {
+    fprintf(stderr, "error: I/O kernel file of graph %ld was not prepared\n", graph_index);
+    abort();
+  }
+  off_t extent = (off_t)kernel.iterations * io_kernel_block(kernel);
+  if (!kernel.io_write) {
+    prepare_extent(kernel, file, point, extent);
+  }
+  transfer_extent(kernel, file->fd, kernel.io_write != 0, point * extent);
+}
@@ -0,0 +1,47 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef IO_KERNEL_H
+#define IO_KERNEL_H
+
+#include "core.h"
+
+// The io_bound kernel gives every point of a graph its own extent of
+// iterations * io_block bytes in a per-process file; each task reads or
+// writes its whole extent, one io_block per request. Files are named
+// "<prefix>.<pid>.<graph_index>" and unlinked as soon as they are opened.
+//
+// For reads, the process that executes a point writes its extent before
+// the first read of it, so that tasks read real data rather than holes
+// whatever the placement. execute_timed and search_metg give such graphs
+// a warm-up run to keep this out of the timings; implementations timing
+// a single run of their own include it. Reads that come up short abort.
+
+#define IO_DEFAULT_BLOCK 4096
+#define IO_DEFAULT_DEPTH 8
+
+// Sets the file prefix (default "task_bench_io"). Call before any task runs.
+void io_kernel_set_prefix(const char *prefix);
+
+// Opens the file of a graph. Call before any task runs.
+void io_kernel_prepare(const Kernel &kernel, long graph_index, long max_width);
+
+// Whether tasks of the kernel write their extents on first read.
+bool io_kernel_prepares_on_read(const Kernel &kernel);
+
+long io_kernel_block(const Kernel &kernel);
+
+#endif // IO_KERNEL_H
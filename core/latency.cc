@@ -0,0 +1,124 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "latency.h"
+
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include <vector>
+
+// Per-thread histograms are never freed, so counts from threads that have
+// already exited (e.g. joined pthreads) are still visible at report time.
+typedef std::vector<LatencyHistogram *> ThreadHistograms;
+
+static std::mutex registry_mutex;
+static std::vector<ThreadHistograms *> registry;
+
+static thread_local ThreadHistograms *local_histograms = NULL;
+
+LatencyHistogram::LatencyHistogram()
+  : counts()
+  , total(0)
+  , min_ns(UINT64_MAX)
+  , max_ns(0)
+  , sum_ns(0)
+{
+}
+
+uint64_t LatencyHistogram::bucket_value(int index)
+{
+  if (index < SUB_BUCKETS) {
+    return index;
+  }
+  int exponent = index / SUB_BUCKETS + SUB_BUCKET_BITS - 1;
+  int mantissa = index % SUB_BUCKETS;
+  uint64_t width = 1ULL << (exponent - SUB_BUCKET_BITS);
+  return (SUB_BUCKETS + mantissa) * width + width / 2;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram &other)
+{
+  for (int i = 0; i < NUM_BUCKETS; i++) {
+    counts[i] += other.counts[i];
+  }
+  total += other.total;
+  sum_ns += other.sum_ns;
+  min_ns = std::min(min_ns, other.min_ns);
+  max_ns = std::max(max_ns, other.max_ns);
+}
+
+uint64_t LatencyHistogram::quantile(double q) const
+{
+  if (total == 0) {
+    return 0;
+  }
+  uint64_t rank = std::max((uint64_t)1, (uint64_t)std::ceil(q * total));
+  uint64_t seen = 0;
+  for (int i = 0; i < NUM_BUCKETS; i++) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return std::min(std::max(bucket_value(i), min_ns), max_ns);
+    }
+  }
+  return max_ns;
+}
+
+// Histograms of a thread are indexed by graph and then kind.
+static size_t histogram_index(long graph_index, LatencyKind kind)
+{
+  return graph_index * 2 + (kind == LatencyKind::RESPONSE ? 1 : 0);
+}
+
+void latency_record(long graph_index, uint64_t ns, LatencyKind kind)
+{
+  size_t index = histogram_index(graph_index, kind);
+  ThreadHistograms *histograms = local_histograms;
+  if (!histograms || index >= histograms->size()) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    if (!histograms) {
+      histograms = local_histograms = new ThreadHistograms;
+      registry.push_back(histograms);
+    }
+    while (index >= histograms->size()) {
+      histograms->push_back(new LatencyHistogram);
+    }
+  }
+  (*histograms)[index]->record(ns);
+}
+
+LatencyHistogram latency_collect(long graph_index, LatencyKind kind)
+{
+  size_t index = histogram_index(graph_index, kind);
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  LatencyHistogram result;
+  for (auto histograms : registry) {
+    if (index < histograms->size()) {
+      result.merge(*(*histograms)[index]);
+    }
+  }
+  return result;
+}
+
+void latency_reset()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto histograms : registry) {
+    for (auto histogram : *histograms) {
+      *histogram = LatencyHistogram();
+    }
+  }
+}
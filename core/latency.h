@@ -0,0 +1,86 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef LATENCY_H
+#define LATENCY_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Log-linear histogram of task durations in nanoseconds (HDR-style): each
+// power of two is split into 2^SUB_BUCKET_BITS linear buckets, so any
+// recorded value is known to within 1/16 of its magnitude.
+struct LatencyHistogram {
+  static const int SUB_BUCKET_BITS = 4;
+  static const int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+  static const int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  uint64_t counts[NUM_BUCKETS];
+  uint64_t total;
+  uint64_t min_ns;
+  uint64_t max_ns;
+  double sum_ns;
+
+  LatencyHistogram();
+
+  static inline int bucket_index(uint64_t ns)
+  {
+    if (ns < SUB_BUCKETS) {
+      return (int)ns;
+    }
+    int exponent = 63 - __builtin_clzll(ns);
+    int mantissa = (int)(ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+    return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + mantissa;
+  }
+
+  // Midpoint of the values that map to the given bucket.
+  static uint64_t bucket_value(int index);
+
+  inline void record(uint64_t ns)
+  {
+    counts[bucket_index(ns)]++;
+    total++;
+    sum_ns += ns;
+    if (ns < min_ns) min_ns = ns;
+    if (ns > max_ns) max_ns = ns;
+  }
+
+  void merge(const LatencyHistogram &other);
+
+  // Value at the given quantile (0 < q <= 1), in nanoseconds.
+  uint64_t quantile(double q) const;
+};
+
+// What a histogram measures: task durations (-latency), or the time from
+// the release of a task's timestep to its end (-arrival-rate).
+enum class LatencyKind {
+  SERVICE,
+  RESPONSE,
+};
+
+// Records one task of the given graph into the calling thread's histogram.
+// Lock-free after the thread's first call.
+void latency_record(long graph_index, uint64_t ns, LatencyKind kind = LatencyKind::SERVICE);
+
+// Merges the histograms of all threads (live or exited) for one graph.
+// Only call while no tasks are executing.
+LatencyHistogram latency_collect(long graph_index, LatencyKind kind = LatencyKind::SERVICE);
+
+// Clears the histograms of all threads, e.g. after warm-up runs. Only
+// call while no tasks are executing.
+void latency_reset();
+
+#endif //LATENCY_H
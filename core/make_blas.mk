@@ -1,12 +1,43 @@
 ENABLE_BLAS ?= 0
+# BLAS library used by compute_dgemm and memory_daxpy when ENABLE_BLAS=1:
+# mkl, openblas, blis or armpl. Without BLAS, compute_dgemm uses a builtin
+# blocked DGEMM and memory_daxpy is unavailable.
+BLAS ?= mkl
 
 ifeq ($(strip $(ENABLE_BLAS)),1)
+ifeq ($(strip $(BLAS)),mkl)
 ifndef MKLROOT
 $(error MKLROOT variable is not defined, aborting build)
 endif
-CFLAGS		+= -DMKL_ILP64 -m64 -I${MKLROOT}/include -DUSE_BLAS_KERNEL
-LDFLAGS		+= -L${MKLROOT}/lib/intel64 -Wl,--no-as-needed -lmkl_intel_ilp64 -lmkl_sequential -lmkl_core -lpthread -lm -ldl
-CXXFLAGS	+= -DMKL_ILP64 -m64 -I${MKLROOT}/include -DUSE_BLAS_KERNEL
-CC_FLAGS	+= -DMKL_ILP64 -m64 -I${MKLROOT}/include -DUSE_BLAS_KERNEL
-LD_FLAGS	+= -L${MKLROOT}/lib/intel64 -Wl,--no-as-needed -lmkl_intel_ilp64 -lmkl_sequential -lmkl_core -lpthread -lm -ldl
+BLAS_CFLAGS	= -DMKL_ILP64 -m64 -I${MKLROOT}/include -DUSE_BLAS_KERNEL -DUSE_BLAS_MKL
+BLAS_LDFLAGS	= -L${MKLROOT}/lib/intel64 -Wl,--no-as-needed -lmkl_intel_ilp64 -lmkl_sequential -lmkl_core -lpthread -lm -ldl
+else ifeq ($(strip $(BLAS)),openblas)
+# OpenBLAS must be the single-threaded (or OPENBLAS_NUM_THREADS=1) build.
+ifdef OPENBLAS_ROOT
+BLAS_CFLAGS	= -I$(OPENBLAS_ROOT)/include -DUSE_BLAS_KERNEL
+BLAS_LDFLAGS	= -L$(OPENBLAS_ROOT)/lib -Wl,-rpath,$(OPENBLAS_ROOT)/lib -lopenblas -lpthread -lm
+else
+BLAS_CFLAGS	= -DUSE_BLAS_KERNEL
+BLAS_LDFLAGS	= -lopenblas -lpthread -lm
+endif
+else ifeq ($(strip $(BLAS)),blis)
+ifndef BLIS_ROOT
+$(error BLIS_ROOT variable is not defined, aborting build)
+endif
+BLAS_CFLAGS	= -I$(BLIS_ROOT)/include/blis -DUSE_BLAS_KERNEL
+BLAS_LDFLAGS	= -L$(BLIS_ROOT)/lib -Wl,-rpath,$(BLIS_ROOT)/lib -lblis -lpthread -lm
+else ifeq ($(strip $(BLAS)),armpl)
+ifndef ARMPL_DIR
+$(error ARMPL_DIR variable is not defined, aborting build)
+endif
+BLAS_CFLAGS	= -I$(ARMPL_DIR)/include -DUSE_BLAS_KERNEL -DUSE_BLAS_ARMPL
+BLAS_LDFLAGS	= -L$(ARMPL_DIR)/lib -Wl,-rpath,$(ARMPL_DIR)/lib -larmpl_lp64 -lm
+else
+$(error Unknown BLAS "$(BLAS)", must be one of mkl, openblas, blis or armpl)
+endif
+CFLAGS		+= $(BLAS_CFLAGS)
+LDFLAGS		+= $(BLAS_LDFLAGS)
+CXXFLAGS	+= $(BLAS_CFLAGS)
+CC_FLAGS	+= $(BLAS_CFLAGS)
+LD_FLAGS	+= $(BLAS_LDFLAGS)
 endif
@@ -0,0 +1,23 @@
+USE_CUDA ?= 0
+USE_HIP ?= 0
+# GPU kernels (core_gpu.h): USE_CUDA=1 builds them with nvcc and cuBLAS,
+# USE_HIP=1 with hipcc and hipBLAS. Backends include this file to link
+# the runtime and test USE_GPU_KERNEL.
+
+ifeq ($(strip $(USE_CUDA)),1)
+CUDA_HOME ?= /usr/local/cuda
+GPU_CFLAGS	= -I$(CUDA_HOME)/include -DUSE_GPU_KERNEL
+GPU_LDFLAGS	= -L$(CUDA_HOME)/lib64 -Wl,-rpath,$(CUDA_HOME)/lib64 -lcublas -lcudart
+else ifeq ($(strip $(USE_HIP)),1)
+ROCM_PATH ?= /opt/rocm
+GPU_CFLAGS	= -I$(ROCM_PATH)/include -DUSE_GPU_KERNEL -DUSE_HIP -D__HIP_PLATFORM_AMD__
+GPU_LDFLAGS	= -L$(ROCM_PATH)/lib -Wl,-rpath,$(ROCM_PATH)/lib -lhipblas -lamdhip64
+endif
+
+ifneq ($(strip $(GPU_LDFLAGS)),)
+CFLAGS		+= $(GPU_CFLAGS)
+LDFLAGS		+= $(GPU_LDFLAGS)
+CXXFLAGS	+= $(GPU_CFLAGS)
+CC_FLAGS	+= $(GPU_CFLAGS)
+LD_FLAGS	+= $(GPU_LDFLAGS)
+endif
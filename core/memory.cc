@@ -0,0 +1,183 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "memory.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "timer.h"
+
+#define MEMORY_NUMA_EVERY 10
+
+static bool enabled = false;
+
+static std::mutex state_mutex;
+static size_t baseline = 0;
+static std::vector<std::pair<double, size_t> > samples; // (time, resident bytes)
+static std::vector<size_t> node_peaks;
+
+// 0 where /proc is not available.
+static size_t resident_bytes()
+{
+  FILE *file = fopen("/proc/self/statm", "r");
+  if (!file) {
+    return 0;
+  }
+  unsigned long long size = 0, resident = 0;
+  int n = fscanf(file, "%llu %llu", &size, &resident);
+  fclose(file);
+  return n == 2 ? resident * sysconf(_SC_PAGESIZE) : 0;
+}
+
+static size_t peak_resident_bytes()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0) {
+    return 0;
+  }
+#ifdef __APPLE__
+  return usage.ru_maxrss;
+#else
+  return usage.ru_maxrss * 1024;
+#endif
+}
+
+// Bytes on each node: numa_maps lists "N<node>=<pages>" and the page size
+// "kernelpagesize_kB=<kB>" of every mapping.
+static std::vector<size_t> node_resident_bytes()
+{
+  std::vector<size_t> nodes;
+  FILE *file = fopen("/proc/self/numa_maps", "r");
+  if (!file) {
+    return nodes;
+  }
+  char line[4096];
+  while (fgets(line, sizeof(line), file)) {
+    size_t page_bytes = 4096;
+    const char *page_field = strstr(line, "kernelpagesize_kB=");
+    if (page_field) {
+      page_bytes = strtoul(page_field + strlen("kernelpagesize_kB="), NULL, 10) * 1024;
+    }
+    char *saved;
+    for (char *token = strtok_r(line, " \n", &saved); token; token = strtok_r(NULL, " \n", &saved)) {
+      char *end;
+      if (token[0] != 'N') {
+        continue;
+      }
+      long node = strtol(token + 1, &end, 10);
+      if (end == token + 1 || *end != '=' || node < 0) {
+        continue;
+      }
+      if ((size_t)node >= nodes.size()) {
+        nodes.resize(node + 1);
+      }
+      nodes[node] += strtoull(end + 1, NULL, 10) * page_bytes;
+    }
+  }
+  fclose(file);
+  return nodes;
+}
+
+static void sample_loop(double period_seconds)
+{
+  auto period = std::chrono::duration<double>(period_seconds);
+  for (size_t i = 1; ; i++) {
+    std::this_thread::sleep_for(period);
+    size_t resident = resident_bytes();
+    std::vector<size_t> nodes;
+    if (i % MEMORY_NUMA_EVERY == 0) {
+      nodes = node_resident_bytes();
+    }
+    std::lock_guard<std::mutex> lock(state_mutex);
+    samples.emplace_back(Timer::get_cur_time(), resident);
+    if (nodes.size() > node_peaks.size()) {
+      node_peaks.resize(nodes.size());
+    }
+    for (size_t node = 0; node < nodes.size(); node++) {
+      node_peaks[node] = std::max(node_peaks[node], nodes[node]);
+    }
+  }
+}
+
+void memory_start(double period_seconds)
+{
+  if (enabled) {
+    return;
+  }
+  enabled = true;
+  std::vector<size_t> nodes = node_resident_bytes();
+  {
+    std::lock_guard<std::mutex> lock(state_mutex);
+    baseline = resident_bytes();
+    node_peaks = nodes;
+  }
+#ifdef __linux__
+  // Never joined: it samples until the process exits.
+  std::thread(sample_loop, period_seconds).detach();
+#endif
+}
+
+bool memory_enabled()
+{
+  return enabled;
+}
+
+MemoryStats memory_collect()
+{
+  MemoryStats stats;
+  // getrusage and statm do not count quite the same pages, so the peak is
+  // also at least every sample.
+  stats.peak_bytes = std::max(peak_resident_bytes(), resident_bytes());
+  std::vector<size_t> nodes = node_resident_bytes();
+
+  std::lock_guard<std::mutex> lock(state_mutex);
+  stats.baseline_bytes = baseline;
+  stats.peak_bytes = std::max(stats.peak_bytes, baseline);
+  for (auto &sample : samples) {
+    stats.peak_bytes = std::max(stats.peak_bytes, sample.second);
+  }
+  stats.samples = samples.size();
+  stats.steady_bytes = 0;
+  if (!samples.empty()) {
+    double middle = (samples.front().first + samples.back().first) / 2;
+    double sum = 0;
+    size_t count = 0;
+    for (auto &sample : samples) {
+      if (sample.first >= middle) {
+        sum += sample.second;
+        count++;
+      }
+    }
+    stats.steady_bytes = sum / count;
+  }
+  stats.node_peak_bytes = node_peaks;
+  if (nodes.size() > stats.node_peak_bytes.size()) {
+    stats.node_peak_bytes.resize(nodes.size());
+  }
+  for (size_t node = 0; node < nodes.size(); node++) {
+    stats.node_peak_bytes[node] = std::max(stats.node_peak_bytes[node], nodes[node]);
+  }
+  return stats;
+}
@@ -0,0 +1,43 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <cstddef>
+#include <vector>
+
+// Memory footprint of the process (-memory). A background thread samples
+// the resident set size every period, and how much of it is on each NUMA
+// node (/proc/self/numa_maps, which walks the page tables) every
+// MEMORY_NUMA_EVERY samples. Sampling is Linux only; elsewhere only the
+// peak (getrusage) is known.
+
+struct MemoryStats {
+  size_t baseline_bytes; // resident when sampling started
+  size_t peak_bytes; // high-water mark of the process
+  size_t steady_bytes; // mean of the samples in the second half so far
+  size_t samples;
+  std::vector<size_t> node_peak_bytes; // by NUMA node, empty if unknown
+};
+
+// Starts sampling, once per process; later calls do nothing.
+void memory_start(double period_seconds);
+
+bool memory_enabled();
+
+MemoryStats memory_collect();
+
+#endif //MEMORY_H
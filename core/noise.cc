@@ -0,0 +1,174 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "noise.h"
+
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+#include "alloc.h"
+#include "core_random.h"
+#include "placement.h"
+#include "timer.h"
+
+struct ThreadNoise {
+  bool slow;
+  double phase; // kernel time of the first interruption
+  double kernel_seconds; // since the last reset, slowdown included
+  double next; // kernel time of the next interruption
+  uint64_t interruptions;
+  double interruption_seconds;
+  double slow_seconds;
+};
+
+static bool enabled = false;
+static NoiseConfig config;
+static long process = 0;
+static bool slow_process = false;
+static std::atomic<long> next_thread(0);
+
+// States outlive their threads, like utilization.cc.
+static std::mutex registry_mutex;
+static std::vector<ThreadNoise *> registry;
+
+static thread_local ThreadNoise *local_noise = NULL;
+static thread_local long local_worker = -1;
+
+// Kinds of thread numbers, kept apart in the draws.
+enum ThreadKey {
+  KEY_WORKER,
+  KEY_CPU,
+  KEY_ORDER,
+};
+
+static void clear(ThreadNoise &state)
+{
+  state.kernel_seconds = 0;
+  state.next = state.phase;
+  state.interruptions = 0;
+  state.interruption_seconds = 0;
+  state.slow_seconds = 0;
+}
+
+void noise_configure(const NoiseConfig &c)
+{
+  assert(c.frequency >= 0 && c.duration >= 0 && c.slow_factor >= 1);
+  config = c;
+  enabled = (c.frequency > 0 && c.duration > 0) ||
+    ((c.slow_threads > 0 || c.slow_processes > 0) && c.slow_factor > 1);
+
+  process = launcher_rank();
+  long seed[2] = {c.seed, process};
+  slow_process = random_uniform(&seed[0], sizeof(seed)) < c.slow_processes;
+}
+
+bool noise_enabled()
+{
+  return enabled;
+}
+
+static void draw(ThreadNoise &state, long key, long thread)
+{
+  long seed[5] = {config.seed, process, key, thread, 0};
+  state.slow = slow_process || random_uniform(&seed[0], sizeof(seed)) < config.slow_threads;
+  seed[4] = 1;
+  state.phase = config.frequency > 0 ? random_uniform(&seed[0], sizeof(seed)) / config.frequency : 0;
+  clear(state);
+}
+
+static ThreadNoise *thread_noise()
+{
+  ThreadNoise *state = local_noise;
+  if (state) {
+    return state;
+  }
+
+  state = local_noise = new ThreadNoise;
+  std::vector<int> cpus = allowed_cpus();
+  if (local_worker >= 0) {
+    draw(*state, KEY_WORKER, local_worker);
+  } else if (cpus.size() == 1) {
+    draw(*state, KEY_CPU, cpus[0]);
+  } else {
+    draw(*state, KEY_ORDER, next_thread.fetch_add(1, std::memory_order_relaxed));
+  }
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  registry.push_back(state);
+  return state;
+}
+
+void noise_set_worker(long worker)
+{
+  assert(worker >= 0);
+  local_worker = worker;
+  if (local_noise) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    draw(*local_noise, KEY_WORKER, worker);
+  }
+}
+
+void noise_apply(double start_time)
+{
+  ThreadNoise &state = *thread_noise();
+  double now = Timer::get_cur_time();
+  double elapsed = now - start_time;
+
+  double delay = 0;
+  if (state.slow) {
+    double slowdown = (config.slow_factor - 1) * elapsed;
+    state.slow_seconds += slowdown;
+    delay += slowdown;
+  }
+  state.kernel_seconds += elapsed + delay;
+  if (config.frequency > 0 && config.duration > 0) {
+    double period = 1 / config.frequency;
+    while (state.next < state.kernel_seconds) {
+      state.interruptions++;
+      state.interruption_seconds += config.duration;
+      delay += config.duration;
+      state.next += period;
+    }
+  }
+
+  // Busy wait, like a preempted (or slower) core would not be available.
+  double until = now + delay;
+  while (delay > 0 && Timer::get_cur_time() < until) {
+  }
+}
+
+NoiseTotals noise_collect()
+{
+  NoiseTotals totals = NoiseTotals();
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto state : registry) {
+    totals.threads++;
+    totals.slow_threads += state->slow;
+    totals.interruptions += state->interruptions;
+    totals.interruption_seconds += state->interruption_seconds;
+    totals.slow_seconds += state->slow_seconds;
+  }
+  return totals;
+}
+
+void noise_reset()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto state : registry) {
+    clear(*state);
+  }
+}
@@ -0,0 +1,76 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef NOISE_H
+#define NOISE_H
+
+#include <cstdint>
+
+// Injected perturbation of the threads that execute kernels, applied by
+// busy waiting after each kernel:
+//
+//   interruptions  every thread is interrupted for duration seconds once
+//                  per 1/frequency seconds of kernel time, at a seeded
+//                  phase of its own. Kernel time is measured, so the
+//                  count varies between runs as much as kernel times do;
+//                  idle time and scheduling do not add to it
+//   slow threads   a fraction of the threads, or every thread of a
+//                  fraction of the processes, take factor times as long
+//                  for every kernel
+//
+// Draws use random_uniform on (seed, process, thread), where the process
+// is launcher_rank() (placement.h) and the thread is, in order of
+// preference, the worker number its implementation passed to
+// noise_set_worker, the CPU it is bound to, or its position in the order
+// of first kernels. The first two give the same threads and ranks the
+// same slowness and phase in every run; the last depends on which threads
+// race to their first task, so under dynamic schedulers only the number
+// of slow threads is reproducible.
+
+struct NoiseConfig {
+  double frequency; // interruptions per second and thread, 0 for none
+  double duration; // seconds per interruption
+  double slow_threads; // fraction of threads
+  double slow_processes; // fraction of processes
+  double slow_factor;
+  long seed;
+};
+
+void noise_configure(const NoiseConfig &config);
+
+// Called by implementations with stable worker numbers on each worker
+// thread, before it runs tasks.
+void noise_set_worker(long worker);
+
+bool noise_enabled();
+
+// Delays the calling thread after a kernel that ran from start_time
+// (Timer::get_cur_time) until now.
+void noise_apply(double start_time);
+
+struct NoiseTotals {
+  uint64_t threads;
+  uint64_t slow_threads;
+  uint64_t interruptions;
+  double interruption_seconds;
+  double slow_seconds; // added by the slowdown of slow threads
+};
+
+// Sums of all threads (live or exited) of this process. Only call while
+// no tasks are executing.
+NoiseTotals noise_collect();
+void noise_reset();
+
+#endif //NOISE_H
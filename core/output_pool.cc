@@ -0,0 +1,158 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "output_pool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include "alloc.h"
+
+#define SLOT_ALIGNMENT 64
+
+static std::vector<long> point_range(long first_point, long last_point)
+{
+  std::vector<long> points;
+  for (long point = first_point; point <= last_point; ++point) {
+    points.push_back(point);
+  }
+  return points;
+}
+
+OutputPool::OutputPool(const TaskGraph &g, const std::vector<long> &pool_points,
+                       long n_rows, size_t header_bytes, int node)
+  : graph(g)
+  , points(pool_points)
+  , index(g.max_width, -1)
+  , n_points(pool_points.size())
+  , rows(n_rows)
+  , uses(new std::atomic<long>[n_rows])
+  , row_timestep(new std::atomic<long>[n_rows])
+{
+  if (rows < 2) {
+    fprintf(stderr, "error: an output pool needs at least 2 rows, not %ld\n", rows);
+    abort();
+  }
+  for (long i = 0; i < n_points; ++i) {
+    assert(points[i] >= 0 && points[i] < graph.max_width);
+    assert(i == 0 || points[i] > points[i - 1]);
+    index[points[i]] = i;
+  }
+
+  slot_bytes = header_bytes + graph.max_output_bytes();
+  slot_bytes = (slot_bytes + SLOT_ALIGNMENT - 1) / SLOT_ALIGNMENT * SLOT_ALIGNMENT;
+  buffer = alloc_buffer(rows * n_points * slot_bytes, node);
+
+  for (long row = 0; row < rows; ++row) {
+    row_timestep[row].store(row, std::memory_order_relaxed);
+    uses[row].store(count_uses(row), std::memory_order_relaxed);
+    if (uses[row].load(std::memory_order_relaxed) == 0) {
+      retire(row);
+    }
+  }
+}
+
+OutputPool::OutputPool(const TaskGraph &g, long first_point, long last_point,
+                       long n_rows, size_t header_bytes, int node)
+  : OutputPool(g, point_range(first_point, last_point), n_rows, header_bytes, node)
+{
+}
+
+OutputPool::~OutputPool()
+{
+  free_buffer(buffer);
+}
+
+// Inputs of (timestep, point) that come from the pool's points.
+long OutputPool::inputs_in_pool(long timestep, long point) const
+{
+  if (timestep <= 0) {
+    return 0;
+  }
+  long last_offset = graph.offset_at_timestep(timestep - 1);
+  long last_width = graph.width_at_timestep(timestep - 1);
+  long inputs = 0;
+  graph.for_each_dependency_point(graph.dependence_set_at_timestep(timestep), point, [&](long dep) {
+    if (dep >= last_offset && dep < last_offset + last_width && index[dep] >= 0) {
+      inputs++;
+    }
+  });
+  return inputs;
+}
+
+// Releases due to the row of timestep: one per task, one per read.
+long OutputPool::count_uses(long timestep) const
+{
+  if (timestep >= graph.timesteps) {
+    return 0;
+  }
+  long result = 0;
+  long offset = graph.offset_at_timestep(timestep);
+  long width = graph.width_at_timestep(timestep);
+  long next_offset = graph.offset_at_timestep(timestep + 1);
+  long next_width = timestep + 1 < graph.timesteps ? graph.width_at_timestep(timestep + 1) : 0;
+  for (long point : points) {
+    if (point >= offset && point < offset + width) {
+      result++;
+    }
+    if (point >= next_offset && point < next_offset + next_width) {
+      result += inputs_in_pool(timestep + 1, point);
+    }
+  }
+  return result;
+}
+
+// Hands the row, whose uses have all been released, to its next
+// timestep (and past timesteps that do not use it at all).
+void OutputPool::retire(long row)
+{
+  long timestep = row_timestep[row].load(std::memory_order_relaxed);
+  long count;
+  do {
+    timestep += rows;
+    count = count_uses(timestep);
+  } while (count == 0 && timestep < graph.timesteps);
+  uses[row].store(count, std::memory_order_relaxed);
+  row_timestep[row].store(timestep, std::memory_order_release);
+}
+
+bool OutputPool::ready(long timestep) const
+{
+  return row_timestep[timestep % rows].load(std::memory_order_acquire) >= timestep;
+}
+
+bool OutputPool::release(long timestep, long point)
+{
+  assert(index[point] >= 0);
+  assert(row_timestep[timestep % rows].load(std::memory_order_relaxed) == timestep);
+
+  bool retired = false;
+  long inputs = inputs_in_pool(timestep, point);
+  if (inputs > 0) {
+    long row = (timestep - 1) % rows;
+    if (uses[row].fetch_sub(inputs, std::memory_order_acq_rel) == inputs) {
+      retire(row);
+      retired = true;
+    }
+  }
+  long row = timestep % rows;
+  if (uses[row].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    retire(row);
+    retired = true;
+  }
+  return retired;
+}
@@ -0,0 +1,88 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OUTPUT_POOL_H
+#define OUTPUT_POOL_H
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "core.h"
+
+// Preallocated output slots for some points of a graph (e.g. those of a
+// rank, see placement.h), for rows consecutive timesteps: timestep t
+// uses row t % rows, so with two rows (double buffering) a timestep's
+// tasks read the previous row and write their own. Slots hold
+// header_bytes (e.g. for message tags) followed by max_output_bytes(),
+// rounded up to a cache line so that workers writing neighbouring slots
+// do not share lines. The memory comes from alloc_buffer (alloc.h) once,
+// so executing tasks allocates nothing.
+//
+// Implementations whose timesteps run one after the other can reuse rows
+// directly. Others track recycling through release: a row is handed to
+// timestep t + rows once every task of t has released its output and
+// every task of t + 1 in the pool that reads the row has released its
+// inputs. Consumers outside the pool (e.g. sends to other ranks) are not
+// tracked and must be finished by then.
+
+struct OutputPool {
+  OutputPool(const TaskGraph &graph, const std::vector<long> &points,
+             long rows = 2, size_t header_bytes = 0, int node = -1);
+  // For the points first_point..last_point.
+  OutputPool(const TaskGraph &graph, long first_point, long last_point,
+             long rows = 2, size_t header_bytes = 0, int node = -1);
+  ~OutputPool();
+
+  OutputPool(const OutputPool &) = delete;
+  OutputPool &operator=(const OutputPool &) = delete;
+
+  // The slot of (timestep, point), header first. The output itself is
+  // output_bytes_at(timestep, point) bytes after the header.
+  char *slot(long timestep, long point) const
+  {
+    return buffer + ((timestep % rows) * n_points + index[point]) * slot_bytes;
+  }
+  size_t slot_size() const { return slot_bytes; }
+
+  // Whether the slots of timestep may be written, i.e. its row is no
+  // longer needed by timestep - rows.
+  bool ready(long timestep) const;
+
+  // Called once per executed task of the pool, after it has written its
+  // output: releases the output and the inputs it read from the pool.
+  // Thread safe. Returns true when this made a row ready for a later
+  // timestep.
+  bool release(long timestep, long point);
+
+private:
+  long count_uses(long timestep) const;
+  long inputs_in_pool(long timestep, long point) const;
+  void retire(long row);
+
+  TaskGraph graph;
+  std::vector<long> points; // in increasing order
+  std::vector<long> index; // of each point in points, -1 if not in the pool
+  long n_points;
+  long rows;
+  size_t slot_bytes;
+  char *buffer;
+  // Per row: uses not yet released, and the timestep it belongs to.
+  std::unique_ptr<std::atomic<long>[]> uses;
+  std::unique_ptr<std::atomic<long>[]> row_timestep;
+};
+
+#endif //OUTPUT_POOL_H
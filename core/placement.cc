@@ -0,0 +1,297 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "placement.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <set>
+
+// Beyond this many edges (e.g. all_to_all on wide graphs) the greedy
+// placement falls back to block.
+#define GREEDY_MAX_EDGES (1L << 26)
+
+static PlacementType placement = PlacementType::BLOCK;
+static long placement_block = PLACEMENT_DEFAULT_BLOCK;
+
+bool placement_by_name(const char *name, PlacementType &type)
+{
+  if (!strcmp(name, "block")) {
+    type = PlacementType::BLOCK;
+  } else if (!strcmp(name, "cyclic")) {
+    type = PlacementType::CYCLIC;
+  } else if (!strcmp(name, "block_cyclic")) {
+    type = PlacementType::BLOCK_CYCLIC;
+  } else if (!strcmp(name, "greedy")) {
+    type = PlacementType::GREEDY;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+const char *placement_name(PlacementType type)
+{
+  switch (type) {
+  case PlacementType::BLOCK: return "block";
+  case PlacementType::CYCLIC: return "cyclic";
+  case PlacementType::BLOCK_CYCLIC: return "block_cyclic";
+  case PlacementType::GREEDY: return "greedy";
+  default: assert(false && "unexpected placement");
+  }
+  abort();
+}
+
+void placement_set(PlacementType type, long block_size)
+{
+  assert(block_size > 0);
+  placement = type;
+  placement_block = block_size;
+}
+
+PlacementType placement_type()
+{
+  return placement;
+}
+
+long placement_block_size()
+{
+  return placement_block;
+}
+
+void placement_require_block(const char *implementation)
+{
+  if (placement != PlacementType::BLOCK) {
+    fprintf(stderr, "error: %s only supports -placement block\n", implementation);
+    abort();
+  }
+}
+
+// Points of rank r under block placement start at r * max_width / n_ranks.
+static long block_owner(long point, long max_width, long n_ranks)
+{
+  return ((point + 1) * n_ranks - 1) / max_width;
+}
+
+static std::vector<int> block_owners(const TaskGraph &g, long n_ranks)
+{
+  std::vector<int> owners(g.max_width);
+  for (long point = 0; point < g.max_width; ++point) {
+    owners[point] = block_owner(point, g.max_width, n_ranks);
+  }
+  return owners;
+}
+
+static std::vector<int> greedy_owners(const TaskGraph &g, long n_ranks)
+{
+  long width = g.max_width;
+  long last_timestep = std::min(g.timesteps - 1, g.timestep_period());
+
+  // Neighbours of every point, once per dependency (so repeated
+  // dependencies weigh more), in both directions.
+  auto for_each_edge = [&](std::function<void(long, long)> f) {
+    for (long t = 1; t <= last_timestep; ++t) {
+      long dset = g.dependence_set_at_timestep(t);
+      long offset = g.offset_at_timestep(t);
+      long last_offset = g.offset_at_timestep(t-1);
+      long last_width = g.width_at_timestep(t-1);
+      for (long point = offset; point < offset + g.width_at_timestep(t); ++point) {
+        g.for_each_dependency_point(dset, point, [&](long dep) {
+          if (dep != point && dep >= last_offset && dep < last_offset + last_width) {
+            f(point, dep);
+          }
+        });
+      }
+    }
+  };
+  std::vector<long> first_edge(width + 1, 0);
+  long n_edges = 0;
+  for_each_edge([&](long a, long b) {
+    first_edge[a + 1]++;
+    first_edge[b + 1]++;
+    n_edges += 2;
+  });
+  if (n_edges > GREEDY_MAX_EDGES) {
+    fprintf(stderr, "warning: %ld dependencies are too many for -placement greedy, using block\n",
+            n_edges / 2);
+    return block_owners(g, n_ranks);
+  }
+  for (long point = 0; point < width; ++point) {
+    first_edge[point + 1] += first_edge[point];
+  }
+  std::vector<long> neighbours(n_edges);
+  std::vector<long> fill(first_edge.begin(), first_edge.end() - 1);
+  for_each_edge([&](long a, long b) {
+    neighbours[fill[a]++] = b;
+    neighbours[fill[b]++] = a;
+  });
+
+  // Ranks get as many points as under block placement.
+  std::vector<long> capacity(n_ranks), load(n_ranks, 0);
+  std::set<std::pair<long, long> > open; // (load, rank) of ranks with room
+  for (long r = 0; r < n_ranks; ++r) {
+    capacity[r] = (r + 1) * width / n_ranks - r * width / n_ranks;
+    if (capacity[r] > 0) {
+      open.insert(std::make_pair(0L, r));
+    }
+  }
+
+  std::vector<int> owners(width, -1);
+  std::vector<long> score(n_ranks, 0);
+  std::vector<long> touched;
+  for (long point = 0; point < width; ++point) {
+    touched.clear();
+    for (long e = first_edge[point]; e < first_edge[point + 1]; ++e) {
+      int owner = owners[neighbours[e]];
+      if (owner >= 0 && load[owner] < capacity[owner]) {
+        if (score[owner]++ == 0) {
+          touched.push_back(owner);
+        }
+      }
+    }
+
+    // Least loaded rank with room first, then the best scoring one.
+    long best = open.begin()->second;
+    double best_value = 0;
+    for (long r : touched) {
+      double value = score[r] * (1.0 - (double)load[r] / capacity[r]);
+      if (value > best_value ||
+          (value == best_value && value > 0 && std::make_pair(load[r], r) < std::make_pair(load[best], best))) {
+        best = r;
+        best_value = value;
+      }
+      score[r] = 0;
+    }
+
+    owners[point] = best;
+    open.erase(std::make_pair(load[best], best));
+    if (++load[best] < capacity[best]) {
+      open.insert(std::make_pair(load[best], best));
+    }
+  }
+  return owners;
+}
+
+struct PlacementTable {
+  TaskGraph graph;
+  long n_ranks;
+  PlacementType type;
+  long block_size;
+  std::vector<int> owners;
+
+  bool matches(const TaskGraph &g, long n) const
+  {
+    return n_ranks == n && type == placement && block_size == placement_block &&
+      graph.graph_index == g.graph_index &&
+      graph.instance == g.instance &&
+      graph.timesteps == g.timesteps &&
+      graph.max_width == g.max_width &&
+      graph.dependence == g.dependence &&
+      graph.radix == g.radix &&
+      graph.period == g.period &&
+      graph.fraction_connected == g.fraction_connected &&
+      std::equal(graph.dims, graph.dims + 3, g.dims);
+  }
+};
+
+// Tables are kept for the life of the process; references stay valid.
+static std::mutex tables_mutex;
+static std::list<PlacementTable> tables;
+
+const std::vector<int> &point_owners(const TaskGraph &graph, long n_ranks)
+{
+  assert(n_ranks > 0);
+  std::lock_guard<std::mutex> lock(tables_mutex);
+  for (auto &table : tables) {
+    if (table.matches(graph, n_ranks)) {
+      return table.owners;
+    }
+  }
+
+  PlacementTable table;
+  table.graph = graph;
+  table.n_ranks = n_ranks;
+  table.type = placement;
+  table.block_size = placement_block;
+  if (placement == PlacementType::GREEDY) {
+    table.owners = greedy_owners(graph, n_ranks);
+  } else {
+    table.owners.resize(graph.max_width);
+    for (long point = 0; point < graph.max_width; ++point) {
+      table.owners[point] = point_owner(graph, point, n_ranks);
+    }
+  }
+  tables.push_back(std::move(table));
+  return tables.back().owners;
+}
+
+long point_owner(const TaskGraph &graph, long point, long n_ranks)
+{
+  assert(point >= 0 && point < graph.max_width && n_ranks > 0);
+  switch (placement) {
+  case PlacementType::BLOCK:
+    return block_owner(point, graph.max_width, n_ranks);
+  case PlacementType::CYCLIC:
+    return point % n_ranks;
+  case PlacementType::BLOCK_CYCLIC:
+    return point / placement_block % n_ranks;
+  case PlacementType::GREEDY:
+    return point_owners(graph, n_ranks)[point];
+  default:
+    assert(false && "unexpected placement");
+  }
+  abort();
+}
+
+static long launcher_value(const char *const *names, size_t n_names, long otherwise)
+{
+  for (size_t i = 0; i < n_names; ++i) {
+    const char *value = getenv(names[i]);
+    if (value) {
+      return atol(value);
+    }
+  }
+  return otherwise;
+}
+
+long launcher_rank()
+{
+  static const char *const names[] = {"OMPI_COMM_WORLD_RANK", "PMI_RANK", "PMIX_RANK", "SLURM_PROCID"};
+  return launcher_value(names, sizeof(names) / sizeof(names[0]), 0);
+}
+
+std::vector<long> owned_points(const TaskGraph &graph, long rank, long n_ranks)
+{
+  std::vector<long> points;
+  if (placement == PlacementType::BLOCK) {
+    for (long point = rank * graph.max_width / n_ranks; point < (rank + 1) * graph.max_width / n_ranks; ++point) {
+      points.push_back(point);
+    }
+    return points;
+  }
+  const std::vector<int> &owners = point_owners(graph, n_ranks);
+  for (long point = 0; point < graph.max_width; ++point) {
+    if (owners[point] == rank) {
+      points.push_back(point);
+    }
+  }
+  return points;
+}
@@ -0,0 +1,69 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <vector>
+
+#include "core.h"
+
+// Placement of the points of a graph on ranks (or nodes), -placement:
+//
+//   block         contiguous ranges, rank r owns points from
+//                 r * max_width / n_ranks (the default)
+//   cyclic        point p on rank p % n_ranks
+//   block_cyclic  blocks of -placement-block points dealt out cyclically
+//   greedy        communication-minimizing: points in order go to the
+//                 rank holding most of their neighbours in one period of
+//                 dependence sets (timestep_period()), weighted by that
+//                 rank's free capacity (linear deterministic greedy), with
+//                 the same number of points per rank as block
+//
+// Every rank computes the same placement. The local/nonlocal estimate of
+// report_timing uses it with -nodes.
+
+#define PLACEMENT_DEFAULT_BLOCK 4
+
+enum class PlacementType {
+  BLOCK,
+  CYCLIC,
+  BLOCK_CYCLIC,
+  GREEDY,
+};
+
+bool placement_by_name(const char *name, PlacementType &type);
+const char *placement_name(PlacementType type);
+
+void placement_set(PlacementType type, long block_size);
+PlacementType placement_type();
+long placement_block_size();
+
+// For implementations that only support contiguous ranges of points.
+void placement_require_block(const char *implementation);
+
+long point_owner(const TaskGraph &graph, long point, long n_ranks);
+
+// Owner of every point, and the points of one rank in increasing order.
+// The greedy placement is computed once per graph and number of ranks.
+const std::vector<int> &point_owners(const TaskGraph &graph, long n_ranks);
+std::vector<long> owned_points(const TaskGraph &graph, long rank, long n_ranks);
+
+// Rank of the process from the environment of the common MPI launchers
+// (Open MPI, MPICH/PMI, PMIx, Slurm), or 0 without one. For core code
+// that must tell processes apart before (or without) MPI.
+long launcher_rank();
+
+#endif //PLACEMENT_H
@@ -0,0 +1,164 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "report.h"
+
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Columns of every record, in output order. "record" is "run" for the
+// totals of a run and "graph" for each graph (children included).
+static const char *const columns[] = {
+  "record", "graph", "ngraphs", "nodes", "placement", "workers",
+  "type", "kernel", "steps", "width", "iterations", "output_bytes", "scratch_bytes",
+  "radix", "period", "child", "samples", "imbalance",
+  "tasks", "dependencies", "local_dependencies", "nonlocal_dependencies",
+  "flops", "bytes", "local_transfer_bytes", "nonlocal_transfer_bytes",
+  "elapsed_seconds", "flops_per_second", "bytes_per_second", "completion_seconds",
+  "reps", "elapsed_min", "elapsed_median", "elapsed_mean", "elapsed_stddev", "elapsed_ci95",
+  "work_tasks", "work_iterations", "span_tasks", "span_iterations",
+  "max_parallelism",
+  "latency_tasks", "latency_min", "latency_mean", "latency_p50", "latency_p99",
+  "latency_p999", "latency_max",
+  "response_tasks", "response_min", "response_mean", "response_p50", "response_p99",
+  "response_p999", "response_max",
+  "counter_tasks", "cycles", "instructions", "llc_misses",
+  "utilization_threads", "busy_seconds", "utilization", "overhead_per_task", "mean_gap",
+  "slow_threads", "slow_seconds", "noise_interruptions", "noise_seconds",
+  "measured_dependencies", "measured_input_bytes", "measured_nonlocal_dependencies",
+  "measured_nonlocal_bytes", "measured_untagged_bytes",
+  "rss_baseline", "rss_peak", "rss_steady", "benchmark_data_bytes", "runtime_memory_bytes",
+  "runtime_memory_per_task",
+  "trace_events", "trace_dropped",
+};
+static const size_t num_columns = sizeof(columns) / sizeof(columns[0]);
+
+static bool enabled = false;
+static ReportFormat report_format;
+static std::string report_filename;
+
+bool report_format_by_name(const char *name, ReportFormat &format)
+{
+  if (!strcmp(name, "json")) {
+    format = ReportFormat::JSON;
+  } else if (!strcmp(name, "csv")) {
+    format = ReportFormat::CSV;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+void report_open(ReportFormat format, const char *filename)
+{
+  assert(filename);
+  report_format = format;
+  report_filename = filename;
+  enabled = true;
+}
+
+bool report_enabled()
+{
+  return enabled;
+}
+
+static size_t column_index(const char *column)
+{
+  for (size_t i = 0; i < num_columns; i++) {
+    if (!strcmp(columns[i], column)) {
+      return i;
+    }
+  }
+  assert(false && "unknown report column");
+  abort();
+}
+
+ReportRecord::ReportRecord()
+  : values(num_columns)
+  , is_string(num_columns, false)
+{
+}
+
+void ReportRecord::set(const char *column, long long value)
+{
+  values[column_index(column)] = std::to_string(value);
+}
+
+void ReportRecord::set(const char *column, double value)
+{
+  if (!std::isfinite(value)) {
+    return;
+  }
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.9e", value);
+  values[column_index(column)] = buffer;
+}
+
+void ReportRecord::set(const char *column, const char *value)
+{
+  size_t i = column_index(column);
+  values[i] = value;
+  is_string[i] = true;
+}
+
+void report_write(const std::vector<ReportRecord> &records)
+{
+  if (!enabled) {
+    return;
+  }
+
+  FILE *file = fopen(report_filename.c_str(), "a");
+  if (!file) {
+    fprintf(stderr, "error: Unable to open report file \"%s\"\n", report_filename.c_str());
+    abort();
+  }
+
+  // Names and values contain no quotes, commas or newlines.
+  if (report_format == ReportFormat::CSV) {
+    fseek(file, 0, SEEK_END);
+    if (ftell(file) == 0) {
+      for (size_t i = 0; i < num_columns; i++) {
+        fprintf(file, "%s%s", i ? "," : "", columns[i]);
+      }
+      fprintf(file, "\n");
+    }
+    for (auto &record : records) {
+      for (size_t i = 0; i < num_columns; i++) {
+        fprintf(file, "%s%s", i ? "," : "", record.values[i].c_str());
+      }
+      fprintf(file, "\n");
+    }
+  } else {
+    for (auto &record : records) {
+      bool first = true;
+      fprintf(file, "{");
+      for (size_t i = 0; i < num_columns; i++) {
+        if (record.values[i].empty()) {
+          continue;
+        }
+        const char *quote = record.is_string[i] ? "\"" : "";
+        fprintf(file, "%s\"%s\":%s%s%s", first ? "" : ",", columns[i],
+                quote, record.values[i].c_str(), quote);
+        first = false;
+      }
+      fprintf(file, "}\n");
+    }
+  }
+
+  fclose(file);
+}
@@ -0,0 +1,54 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef REPORT_H
+#define REPORT_H
+
+#include <string>
+#include <vector>
+
+// Machine-readable results (-report json|csv FILE). Every report_timing
+// appends records to the file: JSON as one object per line, CSV with a
+// header when the file is new. All records have the same columns (see
+// report.cc); columns that were not set are left out of JSON objects and
+// empty in CSV rows.
+
+enum class ReportFormat {
+  JSON,
+  CSV,
+};
+
+bool report_format_by_name(const char *name, ReportFormat &format);
+
+void report_open(ReportFormat format, const char *filename);
+
+bool report_enabled();
+
+struct ReportRecord {
+  ReportRecord();
+
+  void set(const char *column, long long value);
+  void set(const char *column, double value);
+  void set(const char *column, const char *value);
+
+  // Formatted values by column index; strings are quoted for JSON.
+  std::vector<std::string> values;
+  std::vector<bool> is_string;
+};
+
+// Appends the records to the report file, if any.
+void report_write(const std::vector<ReportRecord> &records);
+
+#endif //REPORT_H
@@ -16,4 +16,75 @@
 
 #include "timer.h"
 
-double Timer::time_elapsed = 0;
+#ifdef TIMER_HAVE_TSC
+#include <cpuid.h>
+#endif
+
+// Length of the TSC calibration interval.
+#define TSC_CALIBRATION_SECONDS 0.01
+
+thread_local double Timer::time_elapsed = 0;
+
+timer_source_t Timer::source = TIMER_SOURCE_MONOTONIC;
+uint64_t Timer::tsc_base = 0;
+double Timer::tsc_base_time = 0;
+double Timer::tsc_seconds_per_tick = 0;
+
+#ifdef TIMER_HAVE_TSC
+static bool has_invariant_tsc()
+{
+  unsigned eax, ebx, ecx, edx;
+  if (!__get_cpuid(0x80000000, &eax, &ebx, &ecx, &edx) || eax < 0x80000007) {
+    return false;
+  }
+  __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+  return (edx & (1 << 8)) != 0;
+}
+#endif
+
+timer_source_t Timer::set_source(timer_source_t new_source)
+{
+  source = TIMER_SOURCE_MONOTONIC;
+#ifdef TIMER_HAVE_TSC
+  if (new_source == TIMER_SOURCE_TSC && has_invariant_tsc()) {
+    double start_time = get_monotonic_time();
+    uint64_t start_tsc = __rdtsc();
+    double stop_time;
+    do {
+      stop_time = get_monotonic_time();
+    } while (stop_time - start_time < TSC_CALIBRATION_SECONDS);
+    uint64_t stop_tsc = __rdtsc();
+
+    tsc_seconds_per_tick = (stop_time - start_time) / (stop_tsc - start_tsc);
+    tsc_base = stop_tsc;
+    tsc_base_time = stop_time;
+    source = TIMER_SOURCE_TSC;
+  }
+#endif
+  return source;
+}
+
+double Timer::resolution()
+{
+  if (source == TIMER_SOURCE_TSC) {
+    return tsc_seconds_per_tick;
+  }
+  struct timespec ts;
+  clock_getres(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+double timer_get_cur_time()
+{
+  return Timer::get_cur_time();
+}
+
+timer_source_t timer_set_source(timer_source_t source)
+{
+  return Timer::set_source(source);
+}
+
+double timer_resolution()
+{
+  return Timer::resolution();
+}
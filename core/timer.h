@@ -18,23 +18,61 @@
 #define TIMER_H
 
 #include <cstddef>
+#include <cstdint>
 
-#include <sys/time.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TIMER_HAVE_TSC 1
+#endif
+
+#include "core_c.h"
 
 struct Timer {
 public:
-  static double time_elapsed;
-  
-  static inline double get_cur_time()
+  // Per-thread, so concurrent time_start/time_end pairs do not interfere.
+  static thread_local double time_elapsed;
+
+  static timer_source_t source;
+  static uint64_t tsc_base;
+  static double tsc_base_time;
+  static double tsc_seconds_per_tick;
+
+  static inline double get_monotonic_time()
+  {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
+
+  // Seconds since the epoch (CLOCK_REALTIME). Unlike get_cur_time, whose
+  // origin differs between nodes, for timestamps compared across nodes.
+  static inline double get_wall_time()
   {
-    struct timeval tv;
-    double t;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+  }
 
-    gettimeofday(&tv,NULL);
-    t = tv.tv_sec + tv.tv_usec / 1e6;
-    return t;
+  // Seconds on a monotonic clock with an arbitrary origin.
+  static inline double get_cur_time()
+  {
+#ifdef TIMER_HAVE_TSC
+    if (source == TIMER_SOURCE_TSC) {
+      return tsc_base_time + (__rdtsc() - tsc_base) * tsc_seconds_per_tick;
+    }
+#endif
+    return get_monotonic_time();
   }
-  
+
+  // Selects the clock source. Calibrates the TSC against CLOCK_MONOTONIC;
+  // falls back to TIMER_SOURCE_MONOTONIC when no invariant TSC exists.
+  static timer_source_t set_source(timer_source_t new_source);
+
+  // Smallest observable tick of the current source, in seconds.
+  static double resolution();
+
   static inline double time_start()
   {
     time_elapsed = get_cur_time();
@@ -0,0 +1,168 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace.h"
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#define TRACE_BUFFER_EVENTS (1 << 16)
+
+struct TraceBuffer {
+  long thread;
+  size_t recorded; // total, may exceed TRACE_BUFFER_EVENTS
+  TraceEvent events[TRACE_BUFFER_EVENTS];
+};
+
+static bool enabled = false;
+static std::string trace_filename;
+
+// Buffers outlive their threads so that exited threads are still written.
+static std::mutex registry_mutex;
+static std::vector<TraceBuffer *> registry;
+
+static thread_local TraceBuffer *local_buffer = NULL;
+
+static std::string expand_filename(const std::string &pattern)
+{
+  std::string result;
+  for (size_t i = 0; i < pattern.size(); i++) {
+    if (pattern[i] == '%' && i + 1 < pattern.size() && pattern[i+1] == 'p') {
+      result += std::to_string(getpid());
+      i++;
+    } else {
+      result += pattern[i];
+    }
+  }
+  return result;
+}
+
+static bool ends_with(const std::string &s, const std::string &suffix)
+{
+  return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// Visits the retained events of one buffer in recording order.
+template <typename F>
+static void for_each_event(const TraceBuffer *buffer, F f)
+{
+  size_t first = buffer->recorded > TRACE_BUFFER_EVENTS ? buffer->recorded - TRACE_BUFFER_EVENTS : 0;
+  for (size_t i = first; i < buffer->recorded; i++) {
+    f(buffer->events[i % TRACE_BUFFER_EVENTS]);
+  }
+}
+
+// Caller holds registry_mutex.
+static void count_events(size_t &recorded, size_t &dropped)
+{
+  recorded = dropped = 0;
+  for (auto buffer : registry) {
+    recorded += buffer->recorded;
+    if (buffer->recorded > TRACE_BUFFER_EVENTS) {
+      dropped += buffer->recorded - TRACE_BUFFER_EVENTS;
+    }
+  }
+}
+
+static void trace_write()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+
+  std::string filename = expand_filename(trace_filename);
+  FILE *file = fopen(filename.c_str(), "wb");
+  if (!file) {
+    fprintf(stderr, "error: Unable to open trace file \"%s\"\n", filename.c_str());
+    return;
+  }
+
+  size_t dropped;
+  if (ends_with(filename, ".bin")) {
+    for (auto buffer : registry) {
+      for_each_event(buffer, [&](const TraceEvent &e) {
+        fwrite(&e, sizeof(e), 1, file);
+      });
+    }
+  } else {
+    long pid = getpid();
+    bool first = true;
+    fprintf(file, "{\"traceEvents\":[\n");
+    for (auto buffer : registry) {
+      for_each_event(buffer, [&](const TraceEvent &e) {
+        fprintf(file, "%s{\"name\":\"g%ld t%ld p%ld\",\"cat\":\"task\",\"ph\":\"X\","
+                "\"ts\":%.3f,\"dur\":%.3f,\"pid\":%ld,\"tid\":%ld,"
+                "\"args\":{\"graph\":%ld,\"timestep\":%ld,\"point\":%ld}}",
+                first ? "" : ",\n", e.graph_index, e.timestep, e.point,
+                e.start * 1e6, (e.end - e.start) * 1e6, pid, buffer->thread,
+                e.graph_index, e.timestep, e.point);
+        first = false;
+      });
+    }
+    fprintf(file, "\n],\"displayTimeUnit\":\"ns\"}\n");
+  }
+  fclose(file);
+
+  size_t recorded;
+  count_events(recorded, dropped);
+  if (dropped > 0) {
+    fprintf(stderr, "warning: Trace buffers overflowed, %zu oldest events dropped\n", dropped);
+  }
+}
+
+void trace_open(const char *filename)
+{
+  assert(filename);
+  if (!enabled) {
+    atexit(trace_write);
+  }
+  trace_filename = filename;
+  enabled = true;
+}
+
+void trace_counts(size_t &recorded, size_t &dropped)
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  count_events(recorded, dropped);
+}
+
+bool trace_enabled()
+{
+  return enabled;
+}
+
+void trace_record(long graph_index, long timestep, long point, double start, double end)
+{
+  TraceBuffer *buffer = local_buffer;
+  if (!buffer) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    buffer = local_buffer = new TraceBuffer;
+    buffer->thread = registry.size();
+    buffer->recorded = 0;
+    registry.push_back(buffer);
+  }
+  TraceEvent &e = buffer->events[buffer->recorded % TRACE_BUFFER_EVENTS];
+  e.graph_index = graph_index;
+  e.timestep = timestep;
+  e.point = point;
+  e.start = start;
+  e.end = end;
+  buffer->recorded++;
+}
@@ -0,0 +1,46 @@
+/* Copyright 2020 Stanford University
+ * Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+
+struct TraceEvent {
+  long graph_index;
+  long timestep;
+  long point;
+  double start; // seconds, Timer::get_cur_time
+  double end;
+};
+
+// Enables tracing. Events go to per-thread ring buffers of
+// TRACE_BUFFER_EVENTS entries (oldest overwritten) and are written to
+// filename at exit: Chrome trace JSON, or raw TraceEvents if the name ends
+// in ".bin". "%p" in filename is replaced by the process id.
+void trace_open(const char *filename);
+
+bool trace_enabled();
+
+// Events recorded on this process so far, and how many of them the ring
+// buffers no longer hold. Only call while no tasks are executing.
+void trace_counts(size_t &recorded, size_t &dropped);
+
+// Lock-free after the thread's first call.
+void trace_record(long graph_index, long timestep, long point, double start, double end);
+
+#endif //TRACE_H
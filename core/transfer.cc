@@ -0,0 +1,117 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "transfer.h"
+
+#include <mutex>
+#include <vector>
+
+struct ThreadTransfer {
+  std::vector<TransferCounts> graphs; // by graph_index
+  std::vector<char> remote; // tag for the next task
+  bool tagged;
+};
+
+static bool enabled = false;
+
+// Counts outlive their threads, like latency histograms.
+static std::mutex registry_mutex;
+static std::vector<ThreadTransfer *> registry;
+
+static thread_local ThreadTransfer *local_transfer = NULL;
+
+static ThreadTransfer *thread_transfer()
+{
+  ThreadTransfer *transfer = local_transfer;
+  if (!transfer) {
+    transfer = local_transfer = new ThreadTransfer;
+    transfer->tagged = false;
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.push_back(transfer);
+  }
+  return transfer;
+}
+
+void transfer_enable()
+{
+  enabled = true;
+}
+
+bool transfer_enabled()
+{
+  return enabled;
+}
+
+void transfer_tag_remote(const char *remote, size_t n_inputs)
+{
+  ThreadTransfer *transfer = thread_transfer();
+  transfer->remote.assign(remote, remote + n_inputs);
+  transfer->tagged = true;
+}
+
+void transfer_record(long graph_index, const size_t *input_bytes, size_t n_inputs)
+{
+  ThreadTransfer *transfer = thread_transfer();
+  if (graph_index >= (long)transfer->graphs.size()) {
+    // Only this thread reads its vector outside of collect and reset.
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    transfer->graphs.resize(graph_index + 1, TransferCounts());
+  }
+  TransferCounts &counts = transfer->graphs[graph_index];
+
+  bool tagged = transfer->tagged && transfer->remote.size() == n_inputs;
+  transfer->tagged = false;
+  counts.tasks++;
+  counts.inputs += n_inputs;
+  if (tagged) {
+    counts.tagged_tasks++;
+  }
+  for (size_t i = 0; i < n_inputs; ++i) {
+    counts.input_bytes += input_bytes[i];
+    if (!tagged) {
+      counts.untagged_bytes += input_bytes[i];
+    } else if (transfer->remote[i]) {
+      counts.remote_inputs++;
+      counts.remote_bytes += input_bytes[i];
+    }
+  }
+}
+
+TransferCounts transfer_collect(long graph_index)
+{
+  TransferCounts result = TransferCounts();
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto transfer : registry) {
+    if (graph_index < (long)transfer->graphs.size()) {
+      const TransferCounts &counts = transfer->graphs[graph_index];
+      result.tasks += counts.tasks;
+      result.inputs += counts.inputs;
+      result.input_bytes += counts.input_bytes;
+      result.tagged_tasks += counts.tagged_tasks;
+      result.remote_inputs += counts.remote_inputs;
+      result.remote_bytes += counts.remote_bytes;
+      result.untagged_bytes += counts.untagged_bytes;
+    }
+  }
+  return result;
+}
+
+void transfer_reset()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto transfer : registry) {
+    transfer->graphs.assign(transfer->graphs.size(), TransferCounts());
+  }
+}
@@ -0,0 +1,54 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TRANSFER_H
+#define TRANSFER_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Measured dependencies and input bytes of the tasks executed on this
+// process (-measure-transfer), as opposed to the estimates of
+// report_timing. An implementation that knows where its inputs come from
+// tags the inputs of a task as local or remote just before executing it
+// (TaskGraph::tag_remote_inputs); inputs of untagged tasks are counted
+// but not split.
+
+struct TransferCounts {
+  uint64_t tasks;
+  uint64_t inputs;
+  uint64_t input_bytes;
+  uint64_t tagged_tasks;
+  uint64_t remote_inputs; // of tagged tasks
+  uint64_t remote_bytes;
+  uint64_t untagged_bytes; // input bytes of untagged tasks
+};
+
+void transfer_enable();
+
+bool transfer_enabled();
+
+// Applies to the next transfer_record on the calling thread.
+void transfer_tag_remote(const char *remote, size_t n_inputs);
+
+// Counts one task of the given graph into the calling thread's totals.
+void transfer_record(long graph_index, const size_t *input_bytes, size_t n_inputs);
+
+// Sums of all threads (live or exited) for one graph. Only call while no
+// tasks are executing.
+TransferCounts transfer_collect(long graph_index);
+void transfer_reset();
+
+#endif //TRANSFER_H
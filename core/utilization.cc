@@ -0,0 +1,98 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "utilization.h"
+
+#include <atomic>
+#include <mutex>
+
+struct ThreadState {
+  ThreadUtilization totals;
+  long run; // of the last task
+  double last_end;
+};
+
+static bool enabled = false;
+static std::atomic<long> current_run(0);
+
+// States outlive their threads, like latency histograms.
+static std::mutex registry_mutex;
+static std::vector<ThreadState *> registry;
+
+static thread_local ThreadState *local_state = NULL;
+
+static void clear(ThreadState &state)
+{
+  state.totals = ThreadUtilization();
+  state.run = -1;
+  state.last_end = 0;
+}
+
+void utilization_enable()
+{
+  enabled = true;
+}
+
+bool utilization_enabled()
+{
+  return enabled;
+}
+
+void utilization_record(double start_time, double end_time)
+{
+  ThreadState *state = local_state;
+  if (!state) {
+    state = local_state = new ThreadState;
+    clear(*state);
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    registry.push_back(state);
+  }
+
+  long run = current_run.load(std::memory_order_relaxed);
+  ThreadUtilization &totals = state->totals;
+  if (state->run == run && start_time >= state->last_end) {
+    totals.gaps++;
+    totals.gap_seconds += start_time - state->last_end;
+  }
+  totals.tasks++;
+  totals.busy_seconds += end_time - start_time;
+  state->run = run;
+  state->last_end = end_time;
+}
+
+void utilization_new_run()
+{
+  current_run.fetch_add(1, std::memory_order_relaxed);
+}
+
+std::vector<ThreadUtilization> utilization_collect()
+{
+  std::vector<ThreadUtilization> result;
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto state : registry) {
+    if (state->totals.tasks > 0) {
+      result.push_back(state->totals);
+    }
+  }
+  return result;
+}
+
+void utilization_reset()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto state : registry) {
+    clear(*state);
+  }
+}
@@ -0,0 +1,51 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef UTILIZATION_H
+#define UTILIZATION_H
+
+#include <cstdint>
+#include <vector>
+
+// Busy/idle accounting of the threads that execute tasks (-utilization):
+// time spent inside execute_point, and the gaps between consecutive tasks
+// of a thread within a run. The gaps are where the runtime (scheduling,
+// dependency tracking, communication) and idleness show up.
+
+struct ThreadUtilization {
+  uint64_t tasks;
+  double busy_seconds;
+  uint64_t gaps; // consecutive pairs of tasks within a run
+  double gap_seconds;
+};
+
+void utilization_enable();
+
+bool utilization_enabled();
+
+// Records one task of the calling thread. Lock-free after the thread's
+// first call.
+void utilization_record(double start_time, double end_time);
+
+// Starts a new run: the time before a thread's first task in it is not
+// a gap.
+void utilization_new_run();
+
+// Threads that executed tasks since the last reset, in order of their
+// first task. Only call while no tasks are executing.
+std::vector<ThreadUtilization> utilization_collect();
+void utilization_reset();
+
+#endif //UTILIZATION_H
@@ -0,0 +1,430 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <atomic>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "core.h"
+#include "alloc.h"
+#include "noise.h"
+#include "output_pool.h"
+#include "timer.h"
+
+// Reference implementation with as little runtime as possible: pinned
+// std::thread workers with Chase-Lev work-stealing deques, and one atomic
+// dependency counter per task, decremented by its producers through
+// reverse_dependencies. Counters and output slots are preallocated, so
+// executing a task allocates nothing.
+//
+// Outputs are kept for OUTPUT_ROWS timesteps of each graph, so a task
+// overwrites the slot of the previous occupant, the last earlier task of
+// the same point on the same row. Besides its inputs, its counter waits
+// for that task and for the tasks that read its output, and for nothing
+// else: there is no barrier between timesteps.
+
+#define OUTPUT_ROWS 4
+
+#define EMPTY_TASK (-1L)
+
+// Chase-Lev deque (Le et al., PPoPP 2013) of fixed capacity. Only the
+// owner pushes and pops, at the bottom; other workers steal from the top.
+// The padding keeps top, bottom and neighbouring deques on separate
+// cache lines (alignas would need C++17 aligned new for arrays).
+struct TaskDeque {
+  std::atomic<long> top;
+  char pad0[64];
+  std::atomic<long> bottom;
+  char pad1[64];
+  std::unique_ptr<std::atomic<long>[]> buffer;
+  long mask;
+  char pad2[64];
+
+  void init(long capacity)
+  {
+    long size = 1;
+    while (size < capacity) size <<= 1;
+    buffer.reset(new std::atomic<long>[size]);
+    mask = size - 1;
+    top.store(0, std::memory_order_relaxed);
+    bottom.store(0, std::memory_order_relaxed);
+  }
+
+  void push(long task)
+  {
+    long b = bottom.load(std::memory_order_relaxed);
+    assert(b - top.load(std::memory_order_acquire) <= mask);
+    buffer[b & mask].store(task, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  long pop()
+  {
+    long b = bottom.load(std::memory_order_relaxed) - 1;
+    bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long t = top.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom.store(b + 1, std::memory_order_relaxed);
+      return EMPTY_TASK;
+    }
+    long task = buffer[b & mask].load(std::memory_order_relaxed);
+    if (t == b) {
+      // Last task: race the thieves for it.
+      if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        task = EMPTY_TASK;
+      }
+      bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return task;
+  }
+
+  long steal()
+  {
+    long t = top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long b = bottom.load(std::memory_order_acquire);
+    if (t >= b) {
+      return EMPTY_TASK;
+    }
+    long task = buffer[t & mask].load(std::memory_order_relaxed);
+    if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+      return EMPTY_TASK;
+    }
+    return task;
+  }
+};
+
+struct GraphState {
+  long first_task; // id of (timestep 0, point 0); ids are dense per graph
+  std::unique_ptr<OutputPool> outputs; // OUTPUT_ROWS rows
+  std::unique_ptr<std::atomic<long>[]> pending; // [timesteps][max_width]
+  std::atomic<long> remaining; // unfinished tasks
+};
+
+struct CppThreadsApp : public App {
+  CppThreadsApp(int argc, char **argv);
+  void execute_main_loop();
+private:
+  long next_occupant(size_t idx, long timestep, long point) const;
+  void init_graph(size_t idx);
+  void release(size_t idx, long timestep, long point, TaskDeque &deque);
+  void execute_task(long task, int worker);
+  void run_worker(int worker);
+  void worker_loop(int worker);
+private:
+  int nb_workers;
+  std::vector<int> cpus;
+  std::vector<std::unique_ptr<GraphState> > states;
+  std::unique_ptr<TaskDeque[]> deques;
+  std::vector<char *> scratch;
+  size_t max_scratch_bytes;
+  std::atomic<int> workers_ready;
+  std::atomic<bool> go;
+  std::atomic<long> graphs_done;
+};
+
+CppThreadsApp::CppThreadsApp(int argc, char **argv)
+  : App(argc, argv)
+{
+  cpus = allowed_cpus();
+  nb_workers = cpus.size();
+
+  for (int k = 1; k < argc; k++) {
+    if (!strcmp(argv[k], "-worker")) {
+      nb_workers = atol(argv[++k]);
+    }
+  }
+  if (nb_workers < 1) {
+    fprintf(stderr, "error: -worker must be at least 1\n");
+    abort();
+  }
+
+  long capacity = 0;
+  long first_task = 0;
+  max_scratch_bytes = 0;
+  for (unsigned i = 0; i < graphs.size(); i++) {
+    TaskGraph &graph = graphs[i];
+    if (graph.arrival_rate > 0) {
+      fprintf(stderr, "error: cpp_threads does not support -arrival-rate\n");
+      abort();
+    }
+
+    std::unique_ptr<GraphState> state(new GraphState);
+    state->first_task = first_task;
+    first_task += graph.timesteps * graph.max_width;
+    state->outputs.reset(new OutputPool(graph, 0, graph.max_width - 1, OUTPUT_ROWS));
+    state->pending.reset(new std::atomic<long>[graph.timesteps * graph.max_width]);
+    states.push_back(std::move(state));
+
+    capacity += OUTPUT_ROWS * graph.max_width;
+    max_scratch_bytes = std::max(max_scratch_bytes, graph.scratch_bytes_per_task);
+  }
+
+  deques.reset(new TaskDeque[nb_workers]);
+  for (int w = 0; w < nb_workers; w++) {
+    deques[w].init(capacity);
+  }
+  scratch.resize(nb_workers);
+}
+
+// The next task after (timestep, point) to write its slot, or -1.
+long CppThreadsApp::next_occupant(size_t idx, long timestep, long point) const
+{
+  const TaskGraph &g = graphs[idx];
+  for (long t = timestep + OUTPUT_ROWS; t < g.timesteps; t += OUTPUT_ROWS) {
+    long offset = g.offset_at_timestep(t);
+    if (point >= offset && point < offset + g.width_at_timestep(t)) {
+      return t;
+    }
+  }
+  return -1;
+}
+
+// Counts, for every task, the releases execute_task will make: one per
+// input, plus one from the previous occupant of its slot and one per
+// input that the tasks reading that occupant take from it.
+void CppThreadsApp::init_graph(size_t idx)
+{
+  const TaskGraph &g = graphs[idx];
+  GraphState &state = *states[idx];
+
+  long tasks = 0;
+  for (long t = 0; t < g.timesteps; ++t) {
+    long offset = g.offset_at_timestep(t);
+    long width = g.width_at_timestep(t);
+    for (long x = offset; x < offset + width; ++x) {
+      state.pending[t * g.max_width + x].store(0, std::memory_order_relaxed);
+    }
+    tasks += width;
+  }
+  state.remaining.store(tasks, std::memory_order_relaxed);
+
+  auto count = [&](long timestep, long point) {
+    long next = next_occupant(idx, timestep, point);
+    if (next >= 0) {
+      state.pending[next * g.max_width + point].fetch_add(1, std::memory_order_relaxed);
+    }
+  };
+  for (long t = 0; t < g.timesteps; ++t) {
+    long offset = g.offset_at_timestep(t);
+    long width = g.width_at_timestep(t);
+    long last_offset = g.offset_at_timestep(t-1);
+    long last_width = g.width_at_timestep(t-1);
+    long dset = g.dependence_set_at_timestep(t);
+    for (long x = offset; x < offset + width; ++x) {
+      count(t, x);
+      if (t == 0) continue;
+      g.for_each_dependency_point(dset, x, [&](long i) {
+        if (i >= last_offset && i < last_offset + last_width) {
+          state.pending[t * g.max_width + x].fetch_add(1, std::memory_order_relaxed);
+          count(t-1, i);
+        }
+      });
+    }
+  }
+}
+
+void CppThreadsApp::release(size_t idx, long timestep, long point, TaskDeque &deque)
+{
+  const TaskGraph &g = graphs[idx];
+  GraphState &state = *states[idx];
+  if (state.pending[timestep * g.max_width + point].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    deque.push(state.first_task + timestep * g.max_width + point);
+  }
+}
+
+void CppThreadsApp::execute_task(long task, int worker)
+{
+  size_t idx = 0;
+  while (idx + 1 < states.size() && task >= states[idx + 1]->first_task) {
+    idx++;
+  }
+  const TaskGraph &g = graphs[idx];
+  GraphState &state = *states[idx];
+  TaskDeque &deque = deques[worker];
+
+  long t = (task - state.first_task) / g.max_width;
+  long x = (task - state.first_task) % g.max_width;
+  long last_offset = g.offset_at_timestep(t-1);
+  long last_width = g.width_at_timestep(t-1);
+
+  thread_local std::vector<long> input_points;
+  thread_local std::vector<const char *> input_ptrs;
+  thread_local std::vector<size_t> input_bytes;
+  input_points.clear();
+  input_ptrs.clear();
+  input_bytes.clear();
+  if (t > 0) {
+    g.for_each_dependency_point(g.dependence_set_at_timestep(t), x, [&](long i) {
+      if (i >= last_offset && i < last_offset + last_width) {
+        input_points.push_back(i);
+        input_ptrs.push_back(state.outputs->slot(t-1, i));
+        input_bytes.push_back(g.output_bytes_at(t-1, i));
+      }
+    });
+  }
+
+  g.execute_point(t, x,
+                  state.outputs->slot(t, x), g.output_bytes_at(t, x),
+                  input_ptrs.data(), input_bytes.data(), input_ptrs.size(),
+                  scratch[worker], g.scratch_bytes_per_task);
+
+  if (t + 1 < g.timesteps) {
+    long next_offset = g.offset_at_timestep(t+1);
+    long next_width = g.width_at_timestep(t+1);
+    size_t n_rev_deps;
+    const std::pair<long, long> *rev_deps =
+      g.dependency_table()->reverse_dependencies(g.dependence_set_at_timestep(t+1), x, n_rev_deps);
+    for (size_t span = 0; span < n_rev_deps; ++span) {
+      long first = std::max(rev_deps[span].first, next_offset);
+      long last = std::min(rev_deps[span].second, next_offset + next_width - 1);
+      for (long y = first; y <= last; ++y) {
+        release(idx, t + 1, y, deque);
+      }
+    }
+  }
+
+  // This slot is written, and the inputs are read.
+  long next = next_occupant(idx, t, x);
+  if (next >= 0) {
+    release(idx, next, x, deque);
+  }
+  for (long i : input_points) {
+    next = next_occupant(idx, t - 1, i);
+    if (next >= 0) {
+      release(idx, next, i, deque);
+    }
+  }
+
+  if (state.remaining.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    graphs_done.fetch_add(1, std::memory_order_release);
+  }
+}
+
+void CppThreadsApp::run_worker(int worker)
+{
+  bind_thread(cpus[worker % cpus.size()]);
+  // Each worker first-touches its own scratch, on its own node.
+  scratch[worker] = TaskGraph::allocate_scratch(max_scratch_bytes, 1, numa_current_node());
+  noise_set_worker(worker);
+
+  workers_ready.fetch_add(1, std::memory_order_release);
+  while (!go.load(std::memory_order_acquire)) {
+    std::this_thread::yield();
+  }
+
+  worker_loop(worker);
+}
+
+void CppThreadsApp::worker_loop(int worker)
+{
+  unsigned long seed = worker + 1;
+  long n_graphs = graphs.size();
+  while (graphs_done.load(std::memory_order_acquire) < n_graphs) {
+    long task = deques[worker].pop();
+    for (int attempt = 0; task == EMPTY_TASK && attempt < nb_workers; ++attempt) {
+      // xorshift
+      seed ^= seed << 13;
+      seed ^= seed >> 7;
+      seed ^= seed << 17;
+      int victim = seed % nb_workers;
+      if (victim != worker) {
+        task = deques[victim].steal();
+      }
+    }
+    if (task == EMPTY_TASK) {
+      std::this_thread::yield();
+      continue;
+    }
+    execute_task(task, worker);
+  }
+}
+
+void CppThreadsApp::execute_main_loop()
+{
+  display();
+
+  // Each run starts the workers afresh; only worker_loop is timed.
+  auto run = [&] {
+    // Tasks waiting on nothing start on worker 0.
+    graphs_done.store(0, std::memory_order_relaxed);
+    for (size_t idx = 0; idx < graphs.size(); idx++) {
+      const TaskGraph &g = graphs[idx];
+      GraphState &state = *states[idx];
+      init_graph(idx);
+      for (long t = 0; t < g.timesteps; ++t) {
+        long offset = g.offset_at_timestep(t);
+        for (long x = offset; x < offset + g.width_at_timestep(t); ++x) {
+          if (state.pending[t * g.max_width + x].load(std::memory_order_relaxed) == 0) {
+            deques[0].push(state.first_task + t * g.max_width + x);
+          }
+        }
+      }
+      if (state.remaining.load(std::memory_order_relaxed) == 0) {
+        graphs_done.fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+
+    workers_ready.store(0, std::memory_order_relaxed);
+    go.store(false, std::memory_order_relaxed);
+    std::vector<std::thread> threads;
+    for (int w = 1; w < nb_workers; w++) {
+      threads.emplace_back(&CppThreadsApp::run_worker, this, w);
+    }
+
+    // Worker 0 is this thread.
+    bind_thread(cpus[0]);
+    scratch[0] = TaskGraph::allocate_scratch(max_scratch_bytes, 1, numa_current_node());
+    noise_set_worker(0);
+    while (workers_ready.load(std::memory_order_acquire) < nb_workers - 1) {
+      std::this_thread::yield();
+    }
+
+    Timer::time_start();
+    go.store(true, std::memory_order_release);
+    worker_loop(0);
+    double elapsed = Timer::time_end();
+
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    for (auto scratch_ptr : scratch) {
+      TaskGraph::free_scratch(scratch_ptr);
+    }
+
+    return elapsed;
+  };
+
+  if (metg) {
+    search_metg(run, nb_workers);
+  } else {
+    execute_timed(run);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  CppThreadsApp app(argc, argv);
+  app.execute_main_loop();
+
+  return 0;
+}
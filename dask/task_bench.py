@@ -24,8 +24,8 @@ import time
 import task_bench_core as core
 
 
-def execute_task_graph(graph):
-    graph_array = core.encode_task_graph(graph)
+def execute_task_graph(graph, shared):
+    graph_bytes = core.encode_task_graph(graph)
 
     if graph.scratch_bytes_per_task > 0:
         scratch = [
@@ -48,7 +48,7 @@ def execute_task_graph(graph):
             for dep in core.task_graph_dependencies(graph, timestep, point):
                 inputs.append(last_row[dep])
             output, scratch[point] = core.execute_point_delayed(
-                graph_array, timestep, point, scratch[point], *inputs)
+                graph_bytes, timestep, point, scratch[point], shared, *inputs)
             row.append(output)
             outputs.append(output)
         for point in range(offset + width, graph.max_width):
@@ -58,18 +58,21 @@ def execute_task_graph(graph):
     return outputs
 
 
-def execute_task_bench():
+def execute_task_bench(client):
+    shared = core.use_shared_memory(sys.argv)
     app = core.app_create(sys.argv)
     task_graphs = core.app_task_graphs(app)
     start_time = time.perf_counter()
     results = []
     for task_graph in task_graphs:
-        results.extend(execute_task_graph(task_graph))
+        results.extend(execute_task_graph(task_graph, shared))
     core.join(*results).compute()
     total_time = time.perf_counter() - start_time
     core.c.app_report_timing(app, total_time)
+    if shared:
+        core.reset_shared_arenas(client)
 
 
 if __name__ == "__main__":
     client = core.init_client()
-    execute_task_bench()
+    execute_task_bench(client)
@@ -21,7 +21,11 @@ import cffi
 import dask
 import numpy as np
 import os
+import socket
 import subprocess
+import sys
+import threading
+from multiprocessing import resource_tracker, shared_memory
 
 # Hack: This is in its own module to avoid having this get pickled, as
 # the CFFI handles are (obviously) unpickleable. By default Dask uses
@@ -69,12 +73,119 @@ def init_client():
 
 
 def encode_task_graph(graph):
-    return np.frombuffer(
-        ffi.buffer(ffi.addressof(graph), ffi.sizeof(graph)), dtype=np.ubyte)
+    return bytes(ffi.buffer(ffi.addressof(graph), ffi.sizeof(graph)))
 
 
-def decode_task_graph(graph_array):
-    return ffi.cast("task_graph_t *", graph_array.ctypes.data)[0]
+# Decoded graphs, per worker process: tasks carry the encoded bytes, and
+# each process decodes a graph only the first time it sees it.
+_task_graphs = {}
+
+
+def decode_task_graph(graph_bytes):
+    graph = _task_graphs.get(graph_bytes)
+    if graph is None:
+        graph = ffi.new("task_graph_t *")
+        ffi.memmove(graph, graph_bytes, ffi.sizeof("task_graph_t"))
+        _task_graphs[graph_bytes] = graph
+    return graph
+
+
+def use_shared_memory(args):
+    return '-shm' in args
+
+
+# With -shm, outputs are written into a per-process arena of shared
+# memory segments and passed around as SharedBuffer handles, which
+# pickle as (host, segment, offset, bytes) and are mapped, not copied,
+# by the consumer. This only works between processes on one node.
+#
+# Outputs are bump allocated and not reused within a run;
+# reset_shared_arena (run on every worker) releases them.
+
+SHARED_SEGMENT_BYTES = 64 << 20
+SHARED_ALIGNMENT = 64
+
+_hostname = socket.gethostname()
+_own_segments = []  # segments created by this process, last is current
+_own_offset = 0
+_segments = {}  # name -> (SharedMemory, base pointer), own and attached
+_arena_lock = threading.Lock()  # workers may run several task threads
+
+
+class SharedBuffer(object):
+    __slots__ = ('host', 'name', 'offset', 'nbytes')
+
+    def __init__(self, host, name, offset, nbytes):
+        self.host = host
+        self.name = name
+        self.offset = offset
+        self.nbytes = nbytes
+
+    def __reduce__(self):
+        return (SharedBuffer, (self.host, self.name, self.offset, self.nbytes))
+
+    def pointer(self):
+        if self.host != _hostname:
+            raise RuntimeError(
+                '-shm buffers cannot be read on another node (%s, %s)' %
+                (self.host, _hostname))
+        segment = _segments.get(self.name)
+        if segment is None:
+            with _arena_lock:
+                segment = _segments.get(self.name) or _attach_segment(self.name)
+        return segment[1] + self.offset
+
+
+def _attach_segment(name):
+    # Readers must not unlink the segment when they exit, so it is kept
+    # away from the resource tracker (which before Python 3.13 cannot be
+    # told at attach time).
+    if sys.version_info >= (3, 13):
+        shm = shared_memory.SharedMemory(name=name, track=False)
+    else:
+        shm = shared_memory.SharedMemory(name=name)
+        resource_tracker.unregister(shm._name, 'shared_memory')
+    segment = (shm, ffi.cast("char *", ffi.from_buffer(shm.buf)))
+    _segments[name] = segment
+    return segment
+
+
+def allocate_shared(nbytes):
+    with _arena_lock:
+        return _allocate_shared_locked(nbytes)
+
+
+def _allocate_shared_locked(nbytes):
+    global _own_offset
+    offset = (_own_offset + SHARED_ALIGNMENT - 1) & ~(SHARED_ALIGNMENT - 1)
+    if not _own_segments or offset + nbytes > _own_segments[-1].size:
+        shm = shared_memory.SharedMemory(
+            create=True, size=max(SHARED_SEGMENT_BYTES, nbytes))
+        _own_segments.append(shm)
+        _segments[shm.name] = (shm, ffi.cast("char *", ffi.from_buffer(shm.buf)))
+        offset = 0
+    _own_offset = offset + nbytes
+    shm = _own_segments[-1]
+    return SharedBuffer(_hostname, shm.name, offset, nbytes)
+
+
+def reset_shared_arena():
+    with _arena_lock:
+        _reset_shared_arena_locked()
+
+
+def _reset_shared_arena_locked():
+    global _own_offset
+    own = set(shm.name for shm in _own_segments)
+    # Base pointers are plain casts that do not hold the mapping's
+    # buffer, so it can be closed here.
+    for name, (shm, base) in _segments.items():
+        shm.close()
+        if name in own:
+            shm.unlink()
+    _segments.clear()
+    del _own_segments[:]
+    _own_offset = 0
 
 
 def app_create(args):
@@ -115,15 +226,38 @@ def task_graph_dependencies(graph, timestep, point):
                 yield dep
 
 
-def execute_point_impl(graph_array, timestep, point, scratch, *inputs):
-    graph = decode_task_graph(graph_array)
+def reset_shared_arenas(client):
+    if client:
+        client.run(reset_shared_arena)
+    reset_shared_arena()
 
-    input_ptrs = ffi.new(
-        "char *[]", [ffi.cast("char *", i.ctypes.data) for i in inputs])
-    input_sizes = ffi.new("size_t []", [i.shape[0] for i in inputs])
 
-    output = np.empty(graph.output_bytes_per_task, dtype=np.ubyte)
-    output_ptr = ffi.cast("char *", output.ctypes.data)
+# Argument buffers, per task thread, grown as needed.
+_args = threading.local()
+
+
+def buffer_pointer(buf):
+    if isinstance(buf, SharedBuffer):
+        return buf.pointer(), buf.nbytes
+    return ffi.cast("char *", buf.ctypes.data), buf.shape[0]
+
+
+def execute_point_impl(graph_bytes, timestep, point, scratch, shared, *inputs):
+    graph = decode_task_graph(graph_bytes)
+
+    if getattr(_args, 'capacity', 0) < len(inputs):
+        _args.capacity = max(16, len(inputs))
+        _args.input_ptrs = ffi.new("const char *[]", _args.capacity)
+        _args.input_sizes = ffi.new("size_t []", _args.capacity)
+    input_ptrs, input_sizes = _args.input_ptrs, _args.input_sizes
+    for i, buf in enumerate(inputs):
+        input_ptrs[i], input_sizes[i] = buffer_pointer(buf)
+
+    if shared:
+        output = allocate_shared(graph.output_bytes_per_task)
+    else:
+        output = np.empty(graph.output_bytes_per_task, dtype=np.ubyte)
+    output_ptr, output_size = buffer_pointer(output)
 
     if scratch is not None:
         scratch_ptr = ffi.cast("char *", scratch.ctypes.data)
@@ -132,22 +266,22 @@ def execute_point_impl(graph_array, timestep, point, scratch, *inputs):
         scratch_ptr = ffi.NULL
         scratch_size = 0
 
-    c.task_graph_execute_point_scratch(
-        graph, timestep, point, output_ptr, output.shape[0], input_ptrs,
+    c.task_graph_execute_point_scratch_ptr(
+        graph, timestep, point, output_ptr, output_size, input_ptrs,
         input_sizes, len(inputs), scratch_ptr, scratch_size)
 
     return output
 
 
 @dask.delayed(nout=2)
-def execute_point_scratch(graph_array, timestep, point, scratch, *inputs):
+def execute_point_scratch(graph_bytes, timestep, point, scratch, shared, *inputs):
     return execute_point_impl(
-        graph_array, timestep, point, scratch, *inputs), scratch
+        graph_bytes, timestep, point, scratch, shared, *inputs), scratch
 
 
 @dask.delayed
-def execute_point_no_scratch(graph_array, timestep, point, *inputs):
-    return execute_point_impl(graph_array, timestep, point, None, *inputs)
+def execute_point_no_scratch(graph_bytes, timestep, point, shared, *inputs):
+    return execute_point_impl(graph_bytes, timestep, point, None, shared, *inputs)
 
 
 def init_scratch_direct(scratch_bytes):
@@ -172,19 +306,19 @@ def splitter(value, idx):
 
 
 # Entry point for direct graph construction
-def execute_point_direct(graph_array, timestep, point, scratch, *inputs):
+def execute_point_direct(graph_bytes, timestep, point, scratch, shared, *inputs):
     if scratch is not None:
         return execute_point_impl(
-            graph_array, timestep, point, scratch, *inputs), scratch
+            graph_bytes, timestep, point, scratch, shared, *inputs), scratch
     else:
-        return execute_point_impl(graph_array, timestep, point, None, *inputs)
+        return execute_point_impl(graph_bytes, timestep, point, None, shared, *inputs)
 
 
 # Entry points for dask.delayed
-def execute_point_delayed(graph_array, timestep, point, scratch, *inputs):
+def execute_point_delayed(graph_bytes, timestep, point, scratch, shared, *inputs):
     if scratch is not None:
         return execute_point_scratch(
-            graph_array, timestep, point, scratch, *inputs)
+            graph_bytes, timestep, point, scratch, shared, *inputs)
     else:
         return execute_point_no_scratch(
-            graph_array, timestep, point, *inputs), None
+            graph_bytes, timestep, point, shared, *inputs), None
@@ -24,8 +24,8 @@ import time
 import task_bench_core as core
 
 
-def execute_task_graph(graph, computations, next_tid):
-    graph_array = core.encode_task_graph(graph)
+def execute_task_graph(graph, shared, computations, next_tid):
+    graph_bytes = core.encode_task_graph(graph)
 
     scratch = [None for _ in range(graph.max_width)]
     if graph.scratch_bytes_per_task > 0:
@@ -52,8 +52,8 @@ def execute_task_graph(graph, computations, next_tid):
             next_tid += 1
 
             computations[result] = (
-                core.execute_point_direct, graph_array, timestep, point,
-                scratch[point], *inputs)
+                core.execute_point_direct, graph_bytes, timestep, point,
+                scratch[point], shared, *inputs)
 
             if scratch[point] is not None:
                 output = 'task_%s' % next_tid
@@ -76,6 +76,7 @@ def execute_task_graph(graph, computations, next_tid):
 
 
 def execute_task_bench(client):
+    shared = core.use_shared_memory(sys.argv)
     app = core.app_create(sys.argv)
     task_graphs = core.app_task_graphs(app)
     start_time = time.perf_counter()
@@ -84,7 +85,7 @@ def execute_task_bench(client):
     results = []
     for task_graph in task_graphs:
         result, next_tid = execute_task_graph(
-            task_graph, computations, next_tid)
+            task_graph, shared, computations, next_tid)
         results.extend(result)
     if client:
         from dask.distributed import wait
@@ -94,6 +95,8 @@ def execute_task_bench(client):
         dask.get(computations, results)
     total_time = time.perf_counter() - start_time
     core.c.app_report_timing(app, total_time)
+    if shared:
+        core.reset_shared_arenas(client)
 
 
 if __name__ == "__main__":
@@ -59,6 +59,7 @@ fi
 cat >>deps/env.sh <<EOF
 export TASKBENCH_USE_MPI=${TASKBENCH_USE_MPI:-$DEFAULT_FEATURES}
 export USE_MPI_OPENMP=${USE_MPI_OPENMP:-$DEFAULT_FEATURES}
+export USE_SHMEM=${USE_SHMEM:-0}
 export USE_GASNET=${USE_GASNET:-0}
 export TASKBENCH_USE_HWLOC=${TASKBENCH_USE_HWLOC:-$DEFAULT_FEATURES}
 export USE_LEGION=${USE_LEGION:-$DEFAULT_FEATURES}
@@ -71,6 +72,11 @@ export USE_CHARM=${USE_CHARM:-$DEFAULT_FEATURES}
 export USE_CHAPEL=${USE_CHAPEL:-$DEFAULT_FEATURES}
 export USE_X10=${USE_X10:-$DEFAULT_FEATURES}
 export USE_OPENMP=${USE_OPENMP:-$DEFAULT_FEATURES}
+export USE_CPP_THREADS=${USE_CPP_THREADS:-$DEFAULT_FEATURES}
+export USE_SIMULATOR=${USE_SIMULATOR:-$DEFAULT_FEATURES}
+export USE_TBB=${USE_TBB:-0}
+export USE_TASKFLOW=${USE_TASKFLOW:-$DEFAULT_FEATURES}
+export USE_HPX=${USE_HPX:-0}
 export USE_OMPSS=${USE_OMPSS:-$DEFAULT_FEATURES}
 export USE_OMPSS2=${USE_OMPSS2:-$DEFAULT_FEATURES}
 export USE_SPARK=${USE_SPARK:-$DEFAULT_FEATURES}
@@ -291,6 +297,27 @@ EOF
     git clone -b task-bench https://github.com/elliottslaughter/x10.git "$X10_DIR"/x10
 fi
 
+if [[ $USE_TASKFLOW -eq 1 ]]; then
+    export TASKFLOW_DIR="$TASKBENCH_DEPS_DIR"/taskflow
+    cat >>deps/env.sh <<EOF
+export TASKFLOW_DIR="\$TASKBENCH_DEPS_DIR"/taskflow
+
+EOF
+    git clone -b v3.6.0 --depth 1 https://github.com/taskflow/taskflow.git "$TASKFLOW_DIR"
+fi
+
+if [[ $USE_HPX -eq 1 ]]; then
+    export HPX_DL_DIR="$TASKBENCH_DEPS_DIR"/hpx
+    cat >>deps/env.sh <<EOF
+export HPX_DL_DIR="\$TASKBENCH_DEPS_DIR"/hpx
+export HPX_SRC_DIR="\$HPX_DL_DIR"/hpx
+export HPX_DIR="\$HPX_DL_DIR"/install
+
+EOF
+    mkdir -p "$HPX_DL_DIR"
+    git clone -b v1.9.1 --depth 1 https://github.com/STEllAR-GROUP/hpx.git "$HPX_DL_DIR"/hpx
+fi
+
 if [[ $USE_OMPSS -eq 1 ]]; then
     export OMPSS_DL_DIR="$TASKBENCH_DEPS_DIR"/ompss
     cat >>deps/env.sh <<EOF
@@ -0,0 +1,378 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#ifdef HPX_LOCAL_ONLY
+#include <hpx/local/future.hpp>
+#include <hpx/local/init.hpp>
+#include <hpx/local/latch.hpp>
+#include <hpx/local/runtime.hpp>
+#else
+#include <hpx/hpx.hpp>
+#include <hpx/hpx_init.hpp>
+#include <hpx/include/lcos.hpp>
+#endif
+
+#include "core.h"
+#include "alloc.h"
+#include "placement.h"
+#include "timer.h"
+
+// HPX implementation. Every task is an hpx::dataflow over the futures of
+// its inputs, and its own output is a shared_future, so the runtime sees
+// the whole graph as futures and never waits on a timestep.
+//
+// Points are laid out in blocks over localities as in the MPI
+// implementations. Outputs cross localities through channels (AGAS
+// components): one per remote producer point and consuming locality,
+// registered by the consumer and written by the producer with the
+// timestep as the generation.
+//
+// main_local is the same code built against the local-only runtime
+// (hpx::local::init): one locality, and no AGAS or channels at all.
+
+typedef std::vector<char> Output;
+
+#ifndef HPX_LOCAL_ONLY
+HPX_REGISTER_CHANNEL(Output);
+typedef hpx::distributed::channel<Output> OutputChannel;
+#endif
+
+struct GraphState {
+  long first_point, last_point;
+#ifndef HPX_LOCAL_ONLY
+  std::vector<int> locality_by_point;
+  // Remote inputs, by producer point.
+  std::map<long, OutputChannel> recv;
+  // Local outputs, by (producer point, consuming locality).
+  std::map<std::pair<long, int>, OutputChannel> send;
+#endif
+};
+
+struct HPXApp : public App {
+  HPXApp(int argc, char **argv);
+  ~HPXApp();
+  void execute_main_loop();
+private:
+  Output execute_task(size_t idx, long t, long x, const std::vector<hpx::shared_future<Output> > &inputs);
+#ifndef HPX_LOCAL_ONLY
+  void create_channels(size_t idx);
+  void send_output(size_t idx, long t, long x, const hpx::shared_future<Output> &output);
+#endif
+  static void barrier();
+private:
+  int n_localities, locality;
+  std::vector<GraphState> states;
+  std::vector<char *> scratch; // per worker thread
+  hpx::latch *done;
+};
+
+static bool active_at(const TaskGraph &g, long t, long x)
+{
+  long offset = g.offset_at_timestep(t);
+  return t >= 0 && t < g.timesteps && x >= offset && x < offset + g.width_at_timestep(t);
+}
+
+HPXApp::HPXApp(int argc, char **argv)
+  : App(argc, argv)
+{
+  placement_require_block("hpx");
+#ifdef HPX_LOCAL_ONLY
+  n_localities = 1;
+  locality = 0;
+#else
+  n_localities = hpx::get_num_localities(hpx::launch::sync);
+  locality = hpx::get_locality_id();
+#endif
+
+  long n_tasks = 0;
+  size_t max_scratch_bytes = 0;
+  states.resize(graphs.size());
+  for (size_t idx = 0; idx < graphs.size(); idx++) {
+    const TaskGraph &g = graphs[idx];
+    if (g.arrival_rate > 0) {
+      fprintf(stderr, "error: hpx does not support -arrival-rate\n");
+      abort();
+    }
+
+    GraphState &state = states[idx];
+    state.first_point = locality * g.max_width / n_localities;
+    state.last_point = (locality + 1) * g.max_width / n_localities - 1;
+    for (long t = 0; t < g.timesteps; ++t) {
+      long offset = g.offset_at_timestep(t);
+      long width = g.width_at_timestep(t);
+      n_tasks += std::max(0L, std::min(state.last_point, offset + width - 1) -
+                              std::max(state.first_point, offset) + 1);
+    }
+    max_scratch_bytes = std::max(max_scratch_bytes, g.scratch_bytes_per_task);
+
+#ifndef HPX_LOCAL_ONLY
+    state.locality_by_point.resize(g.max_width);
+    for (int r = 0; r < n_localities; ++r) {
+      for (long p = r * g.max_width / n_localities; p < (r + 1) * g.max_width / n_localities; ++p) {
+        state.locality_by_point[p] = r;
+      }
+    }
+    create_channels(idx);
+#endif
+  }
+
+  for (size_t w = 0; w < hpx::get_os_thread_count(); w++) {
+    scratch.push_back(TaskGraph::allocate_scratch(max_scratch_bytes, 1, -1));
+  }
+  done = new hpx::latch(n_tasks);
+}
+
+HPXApp::~HPXApp()
+{
+  delete done;
+  for (auto scratch_ptr : scratch) {
+    TaskGraph::free_scratch(scratch_ptr);
+  }
+}
+
+void HPXApp::barrier()
+{
+#ifndef HPX_LOCAL_ONLY
+  hpx::distributed::barrier::synchronize();
+#endif
+}
+
+#ifndef HPX_LOCAL_ONLY
+static std::string channel_name(size_t idx, long point, int locality)
+{
+  return "/task_bench/" + std::to_string(idx) + "/" + std::to_string(point) + "/" + std::to_string(locality);
+}
+
+void HPXApp::create_channels(size_t idx)
+{
+  const TaskGraph &g = graphs[idx];
+  GraphState &state = states[idx];
+
+  // Register a channel for every remote producer first, so that the
+  // lookups below (on every locality) find them.
+  for (long dset = 0; dset < g.max_dependence_sets(); ++dset) {
+    for (long x = state.first_point; x <= state.last_point; ++x) {
+      g.for_each_dependency_point(dset, x, [&](long d) {
+        if ((d < state.first_point || d > state.last_point) && !state.recv.count(d)) {
+          OutputChannel channel(hpx::find_here());
+          hpx::register_with_basename(channel_name(idx, d, locality), channel, 0).get();
+          state.recv.emplace(d, channel);
+        }
+      });
+    }
+  }
+
+  for (long dset = 0; dset < g.max_dependence_sets(); ++dset) {
+    for (long x = state.first_point; x <= state.last_point; ++x) {
+      size_t n_rev_deps;
+      const std::pair<long, long> *rev_deps = g.dependency_table()->reverse_dependencies(dset, x, n_rev_deps);
+      for (size_t span = 0; span < n_rev_deps; ++span) {
+        for (long y = rev_deps[span].first; y <= rev_deps[span].second; ++y) {
+          int r = state.locality_by_point[y];
+          if (r != locality && !state.send.count(std::make_pair(x, r))) {
+            state.send.emplace(std::make_pair(x, r),
+                               hpx::find_from_basename<OutputChannel>(channel_name(idx, x, r), 0));
+          }
+        }
+      }
+    }
+  }
+}
+
+// Sends the output of (t, x) to every other locality with a consumer of
+// it at t + 1, once per locality.
+void HPXApp::send_output(size_t idx, long t, long x, const hpx::shared_future<Output> &output)
+{
+  const TaskGraph &g = graphs[idx];
+  GraphState &state = states[idx];
+  if (t + 1 >= g.timesteps) {
+    return;
+  }
+
+  std::vector<int> targets;
+  long offset = g.offset_at_timestep(t+1);
+  long width = g.width_at_timestep(t+1);
+  size_t n_rev_deps;
+  const std::pair<long, long> *rev_deps =
+    g.dependency_table()->reverse_dependencies(g.dependence_set_at_timestep(t+1), x, n_rev_deps);
+  for (size_t span = 0; span < n_rev_deps; ++span) {
+    long first = std::max(rev_deps[span].first, offset);
+    long last = std::min(rev_deps[span].second, offset + width - 1);
+    for (long y = first; y <= last; ++y) {
+      int r = state.locality_by_point[y];
+      if (r != locality && std::find(targets.begin(), targets.end(), r) == targets.end()) {
+        targets.push_back(r);
+      }
+    }
+  }
+
+  for (int r : targets) {
+    OutputChannel channel = state.send.at(std::make_pair(x, r));
+    output.then([channel, t](const hpx::shared_future<Output> &f) mutable {
+      channel.set(hpx::launch::apply, Output(f.get()), t);
+    });
+  }
+}
+#endif
+
+Output HPXApp::execute_task(size_t idx, long t, long x, const std::vector<hpx::shared_future<Output> > &inputs)
+{
+  const TaskGraph &g = graphs[idx];
+
+  std::vector<const char *> input_ptrs;
+  std::vector<size_t> input_bytes;
+  for (auto &input : inputs) {
+    const Output &data = input.get();
+    input_ptrs.push_back(data.data());
+    input_bytes.push_back(data.size());
+  }
+
+  Output output(g.output_bytes_at(t, x));
+  g.execute_point(t, x, output.data(), output.size(),
+                  input_ptrs.data(), input_bytes.data(), input_ptrs.size(),
+                  scratch[hpx::get_worker_thread_num()], g.scratch_bytes_per_task);
+  done->count_down(1);
+  return output;
+}
+
+void HPXApp::execute_main_loop()
+{
+  if (locality == 0) {
+    display();
+  }
+
+  long max_timesteps = 0;
+  for (auto &g : graphs) {
+    max_timesteps = std::max(max_timesteps, g.timesteps);
+  }
+
+  // Futures of the outputs of the last two timesteps of each graph (all
+  // points, remote ones only where a local task reads them). Older
+  // outputs are released as soon as their consumers have run.
+  std::vector<std::vector<hpx::shared_future<Output> > > rows(graphs.size()), last_rows(graphs.size());
+  for (size_t idx = 0; idx < graphs.size(); idx++) {
+    rows[idx].resize(graphs[idx].max_width);
+    last_rows[idx].resize(graphs[idx].max_width);
+  }
+
+  barrier();
+  Timer::time_start();
+
+  for (long t = 0; t < max_timesteps; ++t) {
+    for (size_t idx = 0; idx < graphs.size(); idx++) {
+      const TaskGraph &g = graphs[idx];
+      GraphState &state = states[idx];
+      if (t >= g.timesteps) {
+        continue;
+      }
+
+      std::swap(rows[idx], last_rows[idx]);
+      auto &row = rows[idx];
+      auto &last_row = last_rows[idx];
+      for (auto &output : row) {
+        output = hpx::shared_future<Output>();
+      }
+
+      long offset = g.offset_at_timestep(t);
+      long width = g.width_at_timestep(t);
+      long dset = g.dependence_set_at_timestep(t);
+      for (long x = std::max(state.first_point, offset);
+           x <= std::min(state.last_point, offset + width - 1); ++x) {
+        std::vector<hpx::shared_future<Output> > inputs;
+        if (t > 0) {
+          g.for_each_dependency_point(dset, x, [&](long d) {
+            if (!active_at(g, t-1, d)) {
+              return;
+            }
+#ifndef HPX_LOCAL_ONLY
+            // Remote inputs are received once per timestep and locality.
+            if (!last_row[d].valid()) {
+              last_row[d] = state.recv.at(d).get(hpx::launch::async, t-1);
+            }
+#endif
+            inputs.push_back(last_row[d]);
+          });
+        }
+
+        row[x] = hpx::dataflow(
+          [this, idx, t, x](std::vector<hpx::shared_future<Output> > ready) {
+            return execute_task(idx, t, x, ready);
+          },
+          std::move(inputs));
+#ifndef HPX_LOCAL_ONLY
+        send_output(idx, t, x, row[x]);
+#endif
+      }
+
+      // Received inputs only live for one timestep.
+      for (long d = 0; d < g.max_width; ++d) {
+        if (d < state.first_point || d > state.last_point) {
+          last_row[d] = hpx::shared_future<Output>();
+        }
+      }
+    }
+  }
+
+  done->wait();
+  barrier();
+  double elapsed = Timer::time_end();
+
+  if (locality == 0) {
+    report_timing(elapsed);
+  }
+}
+
+int hpx_main(int argc, char *argv[])
+{
+  {
+    HPXApp app(argc, argv);
+    app.execute_main_loop();
+  }
+
+#ifdef HPX_LOCAL_ONLY
+  return hpx::local::finalize();
+#else
+  return hpx::finalize();
+#endif
+}
+
+int main(int argc, char *argv[])
+{
+  // Task Bench flags are passed through to hpx_main; without aliasing,
+  // -t (and so -type) is not taken for --hpx:threads.
+  std::vector<std::string> cfg = {
+    "hpx.commandline.allow_unknown!=1",
+    "hpx.commandline.aliasing!=0",
+  };
+
+#ifdef HPX_LOCAL_ONLY
+  hpx::local::init_params params;
+  params.cfg = cfg;
+  return hpx::local::init(hpx_main, argc, argv, params);
+#else
+  hpx::init_params params;
+  params.cfg = cfg;
+  return hpx::init(argc, argv, params);
+#endif
+}
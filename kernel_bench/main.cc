@@ -1,8 +1,12 @@
+#include <pthread.h>
 #include <stdarg.h>
 #include <assert.h>
 #include <string.h>
 #include <algorithm> 
+#include <vector>
 #include "core.h"
+#include "alloc.h"
+#include "core_kernel.h"
 #include "timer.h"
 
 #define VERBOSE_LEVEL 0
@@ -21,36 +25,6 @@ typedef struct task_args_s {
   TaskGraph graph;
 }task_args_t;
 
-static void bind_thread(int core_id)
-{
-  cpu_set_t cpuset;
-  CPU_ZERO(&cpuset);
-  CPU_SET(core_id, &cpuset);
-  
-  pthread_t thread = pthread_self();
-  
-  int s = pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset);
-  if (s != 0) {
-     printf("pthread_setaffinity_np error %d\n", s);
-  }
-  
-  cpu_set_t cpuset_valid;
-  CPU_ZERO(&cpuset_valid);
-  s = pthread_getaffinity_np(thread, sizeof(cpu_set_t), &cpuset_valid);
-  if (s != 0) {
-    printf("pthread_getaffinity_np error %d\n", s);
-  }
-  for (int i = 0; i < CPU_SETSIZE; i++) {
-    if (i == core_id) {
-      assert(CPU_ISSET(i, &cpuset_valid) == 1);
-    } else {
-      assert(CPU_ISSET(i, &cpuset_valid) == 0);
-    }
-  }
-  
- // printf("thread %d set to %d\n", core_id-1, core_id);
-}
-
 void *execute_task(void *tr)
 {
   task_args_t *task_arg = (task_args_t *)tr;
@@ -99,21 +73,191 @@ void *execute_task(void *tr)
   return NULL;
 }
 
+typedef struct peak_args_s {
+  int tid;
+  long size;
+  long loops;
+  double flops; // FLOP/s achieved by this thread
+}peak_args_t;
+
+// Calibration: every worker runs back-to-back N x N DGEMMs outside of any
+// task, giving the peak FLOP rate that compute_dgemm tasks can approach.
+void *execute_peak(void *pr)
+{
+  peak_args_t *peak_arg = (peak_args_t *)pr;
+
+  bind_thread(peak_arg->tid);
+
+  long N = peak_arg->size;
+  std::vector<double> scratch(3 * N * N);
+  for (long i = 0; i < N * N; i++) {
+    scratch[i] = (double)(i+1);
+    scratch[N*N + i] = (double)(-i-1);
+    scratch[2*N*N + i] = 0.0;
+  }
+
+  Kernel k;
+  memset(&k, 0, sizeof(k));
+  k.type = COMPUTE_DGEMM;
+  k.iterations = 10;
+  char *scratch_ptr = reinterpret_cast<char *>(scratch.data());
+  size_t scratch_bytes = scratch.size() * sizeof(double);
+
+  // warm up
+  execute_kernel_dgemm(k, scratch_ptr, scratch_bytes);
+
+  pthread_barrier_wait(&mybarrier);
+
+  k.iterations = peak_arg->loops;
+  double start = Timer::get_cur_time();
+  execute_kernel_dgemm(k, scratch_ptr, scratch_bytes);
+  double elapsed = Timer::get_cur_time() - start;
+
+  peak_arg->flops = 2.0 * N * N * N * peak_arg->loops / elapsed;
+  printf("thread #%d, dgemm N=%ld, time %.5f milliseconds, GFLOPS=%.3f\n",
+         peak_arg->tid, N, elapsed / peak_arg->loops * 1e3, peak_arg->flops * 1e-9);
+  return NULL;
+}
+
+// Roofline sweep: one persistent pinned thread per core, reused for every
+// (kernel, iterations, scratch, workers) cell. Threads at or above the
+// cell's worker count sit the cell out.
+typedef struct sweep_state_s {
+  pthread_barrier_t start; // cell published (or quit)
+  pthread_barrier_t ready; // scratch prepared and warmed up
+  pthread_barrier_t done;  // timed tasks finished
+  bool quit;
+  TaskGraph graph;
+  int nb_workers;
+  long nb_tasks;
+  std::vector<std::vector<char> > *output_buff;
+  std::vector<char *> *scratch_buff;
+  std::vector<double> time_start, time_end;
+  std::vector<long long> flops, bytes;
+}sweep_state_t;
+
+typedef struct sweep_args_s {
+  int tid;
+  sweep_state_t *state;
+}sweep_args_t;
+
+void *execute_sweep(void *sr)
+{
+  sweep_args_t *sweep_arg = (sweep_args_t *)sr;
+  sweep_state_t *state = sweep_arg->state;
+  int tid = sweep_arg->tid;
+
+  bind_thread(tid);
+
+  while (true) {
+    pthread_barrier_wait(&state->start);
+    if (state->quit) {
+      break;
+    }
+
+    bool active = tid < state->nb_workers;
+    TaskGraph g(state->graph);
+    char *output_ptr = (*state->output_buff)[tid].data();
+    size_t output_bytes = (*state->output_buff)[tid].size();
+    char *scratch_ptr = (*state->scratch_buff)[tid];
+    size_t scratch_bytes = g.scratch_bytes_per_task;
+
+    if (active) {
+      TaskGraph::prepare_scratch(scratch_ptr, scratch_bytes);
+      // warm up
+      for (int i = 0; i < 10; i++) {
+        g.execute_point(0, tid, output_ptr, output_bytes, NULL, NULL, 0, scratch_ptr, scratch_bytes);
+      }
+    }
+
+    pthread_barrier_wait(&state->ready);
+
+    if (active) {
+      state->time_start[tid] = Timer::get_cur_time();
+      for (long i = 0; i < state->nb_tasks; i++) {
+        g.execute_point(i%g.timesteps, tid, output_ptr, output_bytes, NULL, NULL, 0, scratch_ptr, scratch_bytes);
+      }
+      state->time_end[tid] = Timer::get_cur_time();
+
+      long long flops = 0, bytes = 0;
+      for (long i = 0; i < state->nb_tasks; i++) {
+        flops += count_flops_per_task(g, i%g.timesteps, tid);
+        bytes += count_bytes_per_task(g, i%g.timesteps, tid);
+      }
+      state->flops[tid] = flops;
+      state->bytes[tid] = bytes;
+    }
+
+    pthread_barrier_wait(&state->done);
+  }
+  return NULL;
+}
+
+// Kernels that read or write their scratch, so a sweep cell without
+// scratch is skipped for them.
+static bool kernel_needs_scratch(KernelType type)
+{
+  switch (type) {
+  case KernelType::MEMORY_BOUND:
+  case KernelType::MEMORY_STREAM:
+  case KernelType::MEMORY_STRIDED:
+  case KernelType::MEMORY_CHASE:
+  case KernelType::COMPUTE_DGEMM:
+  case KernelType::MEMORY_DAXPY:
+  case KernelType::COMPUTE_MEMORY:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Parses a comma-separated list of non-negative integers.
+static std::vector<long> parse_sweep_list(const char *flag, const char *arg)
+{
+  std::vector<long> values;
+  const char *p = arg;
+  while (*p) {
+    char *end;
+    long value = strtol(p, &end, 10);
+    if (end == p || value < 0 || (*end != ',' && *end != '\0')) {
+      fprintf(stderr, "error: invalid %s list \"%s\"\n", flag, arg);
+      abort();
+    }
+    values.push_back(value);
+    p = *end == ',' ? end + 1 : end;
+  }
+  if (values.empty()) {
+    fprintf(stderr, "error: empty %s list\n", flag);
+    abort();
+  }
+  return values;
+}
+
 struct KernelBenchApp : public App {
   KernelBenchApp(int argc, char **argv);
   ~KernelBenchApp();
   void execute_main_loop();
 private:
+  double execute_peak_loop();
+  void execute_sweep_loop();
   void debug_printf(int verbose_level, const char *format, ...);
 private:
   size_t nb_tasks;
   std::vector<std::vector<char> > output_buff;
-  std::vector<std::vector<char> > scratch_buff;
+  std::vector<char *> scratch_buff;
   char **local_buff;
   double *time_start;
   double *time_end;
   pthread_t *threads;
   int nb_workers;
+  long peak_size;
+  long peak_loops;
+  // Sweep lists, empty unless -sweep-* was given.
+  bool sweep;
+  std::vector<KernelType> sweep_kernels;
+  std::vector<long> sweep_iterations;
+  std::vector<long> sweep_scratch;
+  std::vector<long> sweep_workers;
 };
 
 KernelBenchApp::KernelBenchApp(int argc, char **argv)
@@ -125,26 +269,96 @@ KernelBenchApp::KernelBenchApp(int argc, char **argv)
   assert(graph.dependence == TRIVIAL);
   
   nb_workers = 1;
+  peak_size = 0;
+  peak_loops = 50;
+  sweep = false;
   
   int i;
   for (i = 1; i < argc; i++) {
     if (!strcmp(argv[i], "-worker")) {
       nb_workers = atol(argv[++i]);
     }
+    if (!strcmp(argv[i], "-peak")) {
+      peak_size = atol(argv[++i]);
+      assert(peak_size > 0);
+    }
+    if (!strcmp(argv[i], "-peak-loops")) {
+      peak_loops = atol(argv[++i]);
+      assert(peak_loops > 0);
+    }
+    if (!strcmp(argv[i], "-sweep-kernel")) {
+      const char *arg = argv[++i];
+      std::vector<char> names(arg, arg + strlen(arg) + 1);
+      for (char *name = strtok(names.data(), ","); name; name = strtok(NULL, ",")) {
+        KernelType type;
+        if (!kernel_type_by_name(name, type)) {
+          fprintf(stderr, "error: unknown kernel type \"%s\" in -sweep-kernel\n", name);
+          abort();
+        }
+        if (type == KernelType::IO_BOUND) {
+          fprintf(stderr, "error: -sweep-kernel does not support io_bound\n");
+          abort();
+        }
+        sweep_kernels.push_back(type);
+      }
+      sweep = true;
+    }
+    if (!strcmp(argv[i], "-sweep-iter")) {
+      sweep_iterations = parse_sweep_list("-sweep-iter", argv[++i]);
+      sweep = true;
+    }
+    if (!strcmp(argv[i], "-sweep-scratch")) {
+      sweep_scratch = parse_sweep_list("-sweep-scratch", argv[++i]);
+      for (long bytes : sweep_scratch) {
+        if (bytes % sizeof(uint64_t) != 0) {
+          fprintf(stderr, "error: -sweep-scratch sizes must be multiples of %zu\n", sizeof(uint64_t));
+          abort();
+        }
+      }
+      sweep = true;
+    }
+    if (!strcmp(argv[i], "-sweep-worker")) {
+      sweep_workers = parse_sweep_list("-sweep-worker", argv[++i]);
+      for (long workers : sweep_workers) {
+        if (workers < 1) {
+          fprintf(stderr, "error: -sweep-worker counts must be positive\n");
+          abort();
+        }
+      }
+      sweep = true;
+    }
+  }
+
+  // Lists not given sweep the single value of the graph (or -worker).
+  if (sweep) {
+    if (peak_size > 0) {
+      fprintf(stderr, "error: -peak cannot be combined with -sweep-*\n");
+      abort();
+    }
+    if (sweep_kernels.empty()) sweep_kernels.push_back(graph.kernel.type);
+    if (sweep_iterations.empty()) sweep_iterations.push_back(graph.kernel.iterations);
+    if (sweep_scratch.empty()) sweep_scratch.push_back(graph.scratch_bytes_per_task);
+    if (sweep_workers.empty()) sweep_workers.push_back(nb_workers);
+    nb_workers = *std::max_element(sweep_workers.begin(), sweep_workers.end());
+  }
+
+  size_t scratch_bytes = graph.scratch_bytes_per_task;
+  if (sweep) {
+    scratch_bytes = *std::max_element(sweep_scratch.begin(), sweep_scratch.end());
   }
 
   nb_tasks = graph.max_width * graph.timesteps;
-  assert(nb_tasks % nb_workers == 0);
+  assert(sweep || nb_tasks % nb_workers == 0);
 
   output_buff.reserve(nb_workers);
   for (i = 0; i < nb_workers; i++) {
     output_buff.emplace_back(graph.output_bytes_per_task, 0);
   }
 
+  // Worker i runs on core i (bind_thread), so its scratch belongs there.
   scratch_buff.reserve(nb_workers);
   for (i = 0; i < nb_workers; i++) {
-    scratch_buff.emplace_back(graph.scratch_bytes_per_task, 0);
-    TaskGraph::prepare_scratch(scratch_buff[i].data(), graph.scratch_bytes_per_task);
+    scratch_buff.push_back(TaskGraph::allocate_scratch(scratch_bytes, 1, numa_node_of_cpu(i)));
   }
 
   // init timer array
@@ -159,7 +373,9 @@ KernelBenchApp::KernelBenchApp(int argc, char **argv)
   threads = (pthread_t*)malloc(sizeof(pthread_t) * nb_workers);
   assert(threads != nullptr);
   
-  pthread_barrier_init(&mybarrier, NULL, nb_workers);
+  if (!sweep) {
+    pthread_barrier_init(&mybarrier, NULL, nb_workers);
+  }
   
   // map main thread to 0
   bind_thread(0);
@@ -176,14 +392,140 @@ KernelBenchApp::~KernelBenchApp()
     free(time_end);
     time_end = nullptr;
   }
+
+  for (auto scratch_ptr : scratch_buff) {
+    TaskGraph::free_scratch(scratch_ptr);
+  }
+}
+
+// Returns the aggregate DGEMM FLOP/s of all workers.
+double KernelBenchApp::execute_peak_loop()
+{
+  int i, rc;
+
+  std::vector<peak_args_t> peak_args(nb_workers);
+  for (i = 0; i < nb_workers; i++) {
+    peak_args[i].tid = i;
+    peak_args[i].size = peak_size;
+    peak_args[i].loops = peak_loops;
+    peak_args[i].flops = 0;
+    rc = pthread_create(&threads[i], NULL, execute_peak, (void *)&(peak_args[i]));
+    assert(rc == 0);
+  }
+
+  double flops = 0;
+  for (i = 0; i < nb_workers; i++) {
+    rc = pthread_join(threads[i], NULL);
+    assert(rc == 0);
+    flops += peak_args[i].flops;
+  }
+
+  printf("DGEMM Peak (%s, N=%ld, %d workers) FLOP/s %e\n",
+         dgemm_kernel_name(), peak_size, nb_workers, flops);
+  return flops;
+}
+
+// Prints one CSV row per sweep cell on stdout. Every worker runs -steps
+// tasks per cell, and rates are per core, from each worker's own time.
+void KernelBenchApp::execute_sweep_loop()
+{
+  int i, rc;
+
+  sweep_state_t state;
+  state.quit = false;
+  state.nb_workers = 0;
+  state.nb_tasks = graphs[0].timesteps;
+  state.output_buff = &output_buff;
+  state.scratch_buff = &scratch_buff;
+  state.time_start.resize(nb_workers);
+  state.time_end.resize(nb_workers);
+  state.flops.resize(nb_workers);
+  state.bytes.resize(nb_workers);
+  pthread_barrier_init(&state.start, NULL, nb_workers + 1);
+  pthread_barrier_init(&state.ready, NULL, nb_workers + 1);
+  pthread_barrier_init(&state.done, NULL, nb_workers + 1);
+
+  std::vector<sweep_args_t> sweep_args(nb_workers);
+  for (i = 0; i < nb_workers; i++) {
+    sweep_args[i].tid = i;
+    sweep_args[i].state = &state;
+    rc = pthread_create(&threads[i], NULL, execute_sweep, (void *)&(sweep_args[i]));
+    assert(rc == 0);
+  }
+
+  printf("kernel,iterations,scratch_bytes,workers,tasks_per_worker,"
+         "elapsed_seconds,task_seconds,flops_per_core,bytes_per_core\n");
+
+  for (KernelType type : sweep_kernels) {
+    for (long iterations : sweep_iterations) {
+      for (long scratch_bytes : sweep_scratch) {
+        if (kernel_needs_scratch(type) ? scratch_bytes == 0 :
+            scratch_bytes != sweep_scratch.front()) {
+          continue;
+        }
+        if (type == KernelType::MEMORY_CHASE && scratch_bytes < 2 * CACHE_LINE_BYTES) {
+          continue;
+        }
+        for (long workers : sweep_workers) {
+          state.graph = graphs[0];
+          state.graph.kernel.type = type;
+          state.graph.kernel.iterations = iterations;
+          state.graph.scratch_bytes_per_task = kernel_needs_scratch(type) ? scratch_bytes : 0;
+          state.graph.max_width = nb_workers;
+          state.nb_workers = workers;
+
+          pthread_barrier_wait(&state.start);
+          pthread_barrier_wait(&state.ready);
+          pthread_barrier_wait(&state.done);
+
+          double min_time_start = *std::min_element(state.time_start.begin(), state.time_start.begin() + workers);
+          double max_time_end = *std::max_element(state.time_end.begin(), state.time_end.begin() + workers);
+          double task_seconds = 0, flops_per_core = 0, bytes_per_core = 0;
+          for (i = 0; i < workers; i++) {
+            double elapsed = state.time_end[i] - state.time_start[i];
+            task_seconds += elapsed / state.nb_tasks / workers;
+            flops_per_core += state.flops[i] / elapsed / workers;
+            bytes_per_core += state.bytes[i] / elapsed / workers;
+          }
+
+          printf("%s,%ld,%zu,%ld,%ld,%e,%e,%e,%e\n",
+                 kernel_type_name(type), iterations, state.graph.scratch_bytes_per_task,
+                 workers, state.nb_tasks, max_time_end - min_time_start, task_seconds,
+                 flops_per_core, bytes_per_core);
+          fflush(stdout);
+        }
+      }
+    }
+  }
+
+  state.quit = true;
+  pthread_barrier_wait(&state.start);
+  for (i = 0; i < nb_workers; i++) {
+    rc = pthread_join(threads[i], NULL);
+    assert(rc == 0);
+  }
+
+  pthread_barrier_destroy(&state.start);
+  pthread_barrier_destroy(&state.ready);
+  pthread_barrier_destroy(&state.done);
 }
 
 void KernelBenchApp::execute_main_loop()
 {
   int i, rc;
-  
+
+  if (sweep) {
+    execute_sweep_loop();
+    return;
+  }
+
   display();
 
+  double peak_flops = 0;
+  if (peak_size > 0) {
+    peak_flops = execute_peak_loop();
+  }
+
   task_args_t *task_args = (task_args_t*)malloc(sizeof(task_args_t) * nb_workers);
   assert(task_args != nullptr);
 
@@ -194,8 +536,8 @@ void KernelBenchApp::execute_main_loop()
     task_args[i].time_end = &(time_end[i]);
     task_args[i].output_ptr = output_buff[i].data();
     task_args[i].output_bytes = output_buff[i].size();
-    task_args[i].scratch_ptr = scratch_buff[i].data();
-    task_args[i].scratch_bytes = scratch_buff[i].size();
+    task_args[i].scratch_ptr = scratch_buff[i];
+    task_args[i].scratch_bytes = graphs[0].scratch_bytes_per_task;
     task_args[i].graph = graphs[0];
     task_args[i].nb_tasks = nb_tasks/nb_workers;
     rc = pthread_create(&threads[i], NULL, execute_task, (void *)&(task_args[i]));
@@ -225,6 +567,11 @@ void KernelBenchApp::execute_main_loop()
   
   report_timing(time_elapsed);
   debug_printf(0, "total time (%f, %f) %f ms\n", min_time_start*1e3, max_time_end*1e3, time_elapsed * 1e3);
+
+  if (peak_flops > 0) {
+    long long flops = count_flops_per_task(graphs[0], 0, 0) * (long long)nb_tasks;
+    printf("Fraction of DGEMM Peak %f\n", flops / time_elapsed / peak_flops);
+  }
 }
 
 void KernelBenchApp::debug_printf(int verbose_level, const char *format, ...)
@@ -15,6 +15,7 @@
 
 #include <algorithm>
 #include <climits>
+#include <mutex>
 #include <numeric>
 #include <utility>
 
@@ -22,6 +23,7 @@
 #include "mappers/default_mapper.h"
 
 #include "core.h"
+#include "placement.h"
 
 using namespace Legion;
 using namespace Legion::Mapping;
@@ -30,10 +32,12 @@ enum TaskIDs {
   TID_TOP,
   TID_INIT,
   TID_LEAF,
+  TID_DEPS,
 };
 
 enum ShardingFunctorIDs {
   SID_LINEAR = 1,
+  SID_PLACEMENT, // + graph_index
 };
 
 // In order to avoid spurious WAR dependencies, we round-robin the
@@ -61,6 +65,7 @@ static Logger log_taskbench("taskbench");
 struct Payload {
   TaskGraph graph;
   long timestep;
+  long dset; // for TID_DEPS
 };
 
 class LinearShardingFunctor : public ShardingFunctor {
@@ -160,6 +165,24 @@ ShardID LinearShardingFunctor::shard(const DomainPoint &point,
   return 0;
 }
 
+// Shards the points of a graph's launches by their owner under
+// -placement (placement.h). There is one functor per graph, registered
+// by LegionApp, so that greedy placement sees its graph.
+class PlacementShardingFunctor : public ShardingFunctor {
+public:
+  PlacementShardingFunctor(const TaskGraph &graph) : graph(graph) {}
+public:
+  virtual ShardID shard(const DomainPoint &point,
+                        const Domain &full_space,
+                        const size_t total_shards)
+  {
+    assert(point.get_dim() == 1);
+    return point_owner(graph, point[0], total_shards);
+  }
+private:
+  TaskGraph graph;
+};
+
 class TaskBenchMapper : public DefaultMapper
 {
 public:
@@ -183,6 +206,8 @@ public:
   virtual void default_policy_select_target_processors(MapperContext ctx,
                                                        const Task &task,
                                                        std::vector<Processor> &target_procs);
+  virtual TaskPriority default_policy_select_task_priority(MapperContext ctx,
+                                                           const Task &task);
   virtual void slice_task(const MapperContext      ctx,
                           const Task&              task,
                           const SliceTaskInput&    input,
@@ -207,6 +232,10 @@ void TaskBenchMapper::select_sharding_functor(
                                  const SelectShardingFunctorInput&  input,
                                        SelectShardingFunctorOutput& output)
 {
+  if (task.arglen == sizeof(Payload) && task.is_index_space && task.index_domain.get_dim() == 1) {
+    output.chosen_functor = SID_PLACEMENT + reinterpret_cast<const Payload *>(task.args)->graph.graph_index;
+    return;
+  }
   output.chosen_functor = SID_LINEAR;
 }
 
@@ -235,6 +264,16 @@ void TaskBenchMapper::default_policy_select_target_processors(MapperContext ctx,
   target_procs.push_back(task.target_proc);
 }
 
+// Leaf tasks run at the -priority of their graph.
+TaskPriority TaskBenchMapper::default_policy_select_task_priority(MapperContext ctx,
+                                                                  const Task &task)
+{
+  if (task.task_id == TID_LEAF && task.arglen >= sizeof(Payload)) {
+    return reinterpret_cast<const Payload *>(task.args)->graph.priority;
+  }
+  return DefaultMapper::default_policy_select_task_priority(ctx, task);
+}
+
 //--------------------------------------------------------------------------
 void TaskBenchMapper::slice_task(const MapperContext      ctx,
                                  const Task&              task,
@@ -340,6 +379,34 @@ void TaskBenchMapper::task_bench_slice_task(const Task &task,
     return;
   }
 
+  // Task bench launches place each point on its owner under -placement
+  // (one shard per address space, as PlacementShardingFunctor does), and
+  // on the processor of that shard given by its position among the
+  // shard's points, so that a point stays on the same processor every
+  // timestep whatever the width of the launch.
+  if (task.arglen == sizeof(Payload) && input.domain.get_dim() == 1) {
+    const TaskGraph &graph = reinterpret_cast<const Payload *>(task.args)->graph;
+    const std::vector<int> &owners = point_owners(graph, remote.size());
+    std::vector<long> position(graph.max_width), count(remote.size(), 0);
+    for (long point = 0; point < graph.max_width; ++point) {
+      position[point] = count[owners[point]]++;
+    }
+    Rect<1> rect = input.domain;
+    for (PointInRectIterator<1> pir(rect); pir(); pir++) {
+      long point = (*pir)[0];
+      Processor proc = local[position[point] * local.size() / count[owners[point]]];
+      if (!output.slices.empty() && output.slices.back().proc == proc) {
+        Rect<1> last = output.slices.back().domain;
+        output.slices.back().domain = Rect<1>(last.lo, *pir);
+      } else {
+        output.slices.push_back(TaskSlice(Rect<1>(*pir, *pir), proc,
+                                          false/*recurse*/, false/*stealable*/));
+      }
+    }
+    cached_slices[input.domain] = output.slices;
+    return;
+  }
+
   // The two-level decomposition doesn't work so for now do a
   // simple one-level decomposition across all the processors.
   Machine::ProcessorQuery all_procs(machine);
@@ -399,6 +466,34 @@ void init(const Task *task,
   TaskGraph::prepare_scratch(scratch_ptr, scratch_bytes);
 }
 
+// Writes the byte range of the k-th dependency of each point to field
+// k, for the image partitions of LegionApp.
+void deps(const Task *task,
+          const std::vector<PhysicalRegion> &regions,
+          Context ctx, Runtime *runtime)
+{
+  assert(task->arglen == sizeof(Payload));
+  const Payload &payload = *reinterpret_cast<const Payload *>(task->args);
+  const TaskGraph &graph = payload.graph;
+  size_t bytes = graph.max_output_bytes();
+
+  Point<1> point = task->index_point;
+
+  const std::vector<FieldID> &fields = task->regions[0].instance_fields;
+  std::vector<Rect<1> > ranges(fields.size(), Rect<1>(1, 0));
+  size_t ndep = 0;
+  graph.for_each_dependency_point(payload.dset, point, [&](long dep) {
+    assert(ndep < ranges.size());
+    ranges[ndep++] = Rect<1>(dep * bytes, (dep + 1) * bytes - 1);
+  });
+
+  for (size_t i = 0; i < fields.size(); ++i) {
+    const FieldAccessor<WRITE_DISCARD, Rect<1>, 1, coord_t, Realm::AffineAccessor<Rect<1>, 1, coord_t> > acc(
+      regions[0], fields[i]);
+    acc[point] = ranges[i];
+  }
+}
+
 void leaf(const Task *task,
           const std::vector<PhysicalRegion> &regions,
           Context ctx, Runtime *runtime)
@@ -417,30 +512,31 @@ void leaf(const Task *task,
   char *output_ptr;
   size_t output_bytes;
   get_base_and_size(runtime, regions[0], task->regions[0], output_rect, output_ptr, output_bytes);
+  // Pieces hold the largest output of the graph; the task sees its own.
+  assert(graph.output_bytes_at(timestep, point) <= output_bytes);
+  output_bytes = graph.output_bytes_at(timestep, point);
 
   long last_offset = graph.offset_at_timestep(timestep-1);
   long last_width = graph.width_at_timestep(timestep-1);
 
   long dset = graph.dependence_set_at_timestep(timestep);
-  std::vector<std::pair<long, long> > deps = graph.dependencies(dset, point);
 
   std::vector<const char *> input_ptrs;
   std::vector<size_t> input_bytes;
   long ninput = 1;
-  for (auto span : deps) {
-    for (long dep = span.first; dep <= span.second; dep++) {
-      if (dep >= last_offset && dep < last_offset + last_width) {
-        Rect<1> rect = runtime->get_index_space_domain(
-          regions[ninput].get_logical_region().get_index_space());
-        char *ptr;
-        size_t bytes;
-        get_base_and_size(runtime, regions[ninput], task->regions[ninput], rect, ptr, bytes);
-        input_ptrs.push_back(ptr);
-        input_bytes.push_back(bytes);
-      }
-      ninput++;
+  graph.for_each_dependency_point(dset, point, [&](long dep) {
+    if (dep >= last_offset && dep < last_offset + last_width) {
+      Rect<1> rect = runtime->get_index_space_domain(
+        regions[ninput].get_logical_region().get_index_space());
+      char *ptr;
+      size_t bytes;
+      get_base_and_size(runtime, regions[ninput], task->regions[ninput], rect, ptr, bytes);
+      assert(graph.output_bytes_at(timestep-1, dep) <= bytes);
+      input_ptrs.push_back(ptr);
+      input_bytes.push_back(graph.output_bytes_at(timestep-1, dep));
     }
-  }
+    ninput++;
+  });
 
   char *scratch_ptr = NULL;
   size_t scratch_bytes = 0;
@@ -473,6 +569,7 @@ private:
   Context ctx;
   long num_fields;
   bool exact_instance;
+  std::vector<IndexSpaceT<1> > task_spaces;
   std::vector<LogicalRegionT<1> > regions;
   std::vector<LogicalPartitionT<1> > primary_partitions;
   std::vector<std::vector<std::vector<LogicalPartitionT<1> > > > secondary_partitions;
@@ -505,23 +602,30 @@ LegionApp::LegionApp(Runtime *runtime, Context ctx)
     }
   }
 
+  // Every shard parses the same flags; the first one in a process
+  // registers the sharding functors of all graphs.
+  static std::once_flag registered;
+  std::call_once(registered, [&] {
+    for (auto g : graphs) {
+      runtime->register_sharding_functor(SID_PLACEMENT + g.graph_index,
+                                         new PlacementShardingFunctor(g));
+    }
+  });
+
   for (auto g : graphs) {
     // Space of tasks
-    vector<FieldID>* fid_array;
-    std::vector<int> dest(std::begin(g.output_bytes_size[0]), std::end(g.output_bytes_size[0]));
     IndexSpaceT<1> ts = runtime->create_index_space(ctx, Rect<1>(0, g.max_width - 1));
 
-    // Space of task output
+    // Space of task output, sized by the largest output of any task
     IndexSpaceT<1> is = runtime->create_index_space(
-      ctx, Rect<1>(0, g.max_width * g.output_bytes_per_task - 1));
+      ctx, Rect<1>(0, g.max_width * g.max_output_bytes() - 1));
     FieldSpace fs = runtime->create_field_space(ctx);
     {
       FieldAllocator allocator =
         runtime->create_field_allocator(ctx, fs);
-      //for (long i = 0; i < num_fields; ++i) {
-      allocator.allocate_fields(g.output_bytes_size[0],fid_array);
-        //allocator.allocate_field(sizeof(char), FID_FIRST+i);
-      //}
+      for (long i = 0; i < num_fields; ++i) {
+        allocator.allocate_field(sizeof(char), FID_FIRST+i);
+      }
     }
     LogicalRegionT<1> result_lr = runtime->create_logical_region(ctx, is, fs);
 
@@ -537,39 +641,59 @@ LegionApp::LegionApp(Runtime *runtime, Context ctx)
       for (long point = 0; point < g.max_width; ++point) {
         long deps = 0;
 
-        for (auto dep : g.dependencies(dset, point)) {
-          deps += dep.second - dep.first + 1;
-        }
+        g.for_each_dependency(dset, point, [&](long first, long last) {
+          deps += last - first + 1;
+        });
 
         max_deps = std::max(max_deps, deps);
       }
     }
 
+    if (max_deps > LEGION_MAX_FIELDS) {
+      fprintf(stderr, "error: %ld dependencies per task exceed LEGION_MAX_FIELDS (%d)\n",
+              max_deps, LEGION_MAX_FIELDS);
+      abort();
+    }
+
+    // Each shard fills in the dependencies of its own points (field k
+    // holds the byte range of the k-th dependency), and the secondary
+    // partitions are images of that, so no shard walks the whole graph.
     std::vector<std::vector<LogicalPartitionT<1> > > secondary_lps(ndsets);
-    for (long dset = 0; dset < ndsets; ++dset) {
-      for (long ndep = 0; ndep < max_deps; ++ndep) {
-        IndexPartitionT<1> secondary_ip = runtime->create_pending_partition(ctx, is, ts);
-
-        for (long point = 0; point < g.max_width; ++point) {
-          std::vector<IndexSpace> subspaces;
-          long ninput = 0;
-          bool done = false;
-          for (auto dep : g.dependencies(dset, point)) {
-            for (long i = dep.first; i <= dep.second; ++i) {
-              if (ninput == ndep) {
-                subspaces.push_back(runtime->get_index_subspace(ctx, primary_ip, i));
-                done = true;
-                break;
-              }
-              ++ninput;
-            }
-            if (done) break;
-          }
-          runtime->create_index_space_union(ctx, secondary_ip, point, subspaces);
+    if (max_deps > 0) {
+      FieldSpace deps_fs = runtime->create_field_space(ctx);
+      {
+        FieldAllocator allocator =
+          runtime->create_field_allocator(ctx, deps_fs);
+        for (long ndep = 0; ndep < max_deps; ++ndep) {
+          allocator.allocate_field(sizeof(Rect<1>), FID_FIRST+ndep);
+        }
+      }
+      IndexPartitionT<1> deps_ip = runtime->create_equal_partition(ctx, ts, ts);
+
+      for (long dset = 0; dset < ndsets; ++dset) {
+        LogicalRegionT<1> deps_lr = runtime->create_logical_region(ctx, ts, deps_fs);
+        LogicalPartitionT<1> deps_lp = runtime->get_logical_partition(deps_lr, deps_ip);
+
+        Payload payload;
+        payload.graph = g;
+        payload.timestep = 0;
+        payload.dset = dset;
+        IndexLauncher launcher(TID_DEPS, ts,
+                               TaskArgument(&payload, sizeof(payload)), ArgumentMap());
+        RegionRequirement req(deps_lp, 0 /* default projection */,
+                              WRITE_DISCARD, EXCLUSIVE, deps_lr);
+        for (long ndep = 0; ndep < max_deps; ++ndep) {
+          req.add_field(FID_FIRST+ndep);
+        }
+        launcher.add_region_requirement(req);
+        runtime->execute_index_space(ctx, launcher);
+
+        for (long ndep = 0; ndep < max_deps; ++ndep) {
+          IndexPartitionT<1> secondary_ip = runtime->create_partition_by_image_range(
+            ctx, is, deps_lp, deps_lr, FID_FIRST+ndep, ts);
+          LogicalPartitionT<1> secondary_lp = runtime->get_logical_partition(result_lr, secondary_ip);
+          secondary_lps[dset].push_back(secondary_lp);
         }
-
-        LogicalPartitionT<1> secondary_lp = runtime->get_logical_partition(result_lr, secondary_ip);
-        secondary_lps[dset].push_back(secondary_lp);
       }
     }
 
@@ -579,13 +703,13 @@ LegionApp::LegionApp(Runtime *runtime, Context ctx)
       IndexFillLauncher launcher(ts, primary_lp, result_lr,
                                  TaskArgument(&zero, sizeof(zero)),
                                  0 /* default projection */);
-      launcher.add_fields(fid_array);
-      //for (long i = 0; i < num_fields; ++i) {
-      //  launcher.add_field(FID_FIRST+i);
-      //}
+      for (long i = 0; i < num_fields; ++i) {
+        launcher.add_field(FID_FIRST+i);
+      }
       runtime->fill_fields(ctx, launcher);
     }
 
+    task_spaces.push_back(ts);
     regions.push_back(result_lr);
     primary_partitions.push_back(primary_lp);
     secondary_partitions.push_back(secondary_lps);
@@ -607,8 +731,9 @@ LegionApp::LegionApp(Runtime *runtime, Context ctx)
 
 void LegionApp::run()
 {
-  // FIXME (Elliott): Do this correctly for control replication
-  if (runtime->get_executing_processor(ctx).address_space() == 0) {
+  // The top-level task is replicated, one shard per address space.
+  bool first_shard = runtime->get_shard_id(ctx, true) == 0;
+  if (first_shard) {
     display();
   }
 
@@ -627,7 +752,7 @@ void LegionApp::run()
   unsigned long long stop = Realm::Clock::current_time_in_nanoseconds();
 
   double elapsed = (stop - start) / 1e9;
-  if (runtime->get_executing_processor(ctx).address_space() == 0) {
+  if (first_shard) {
     report_timing(elapsed);
   }
 }
@@ -682,10 +807,16 @@ void LegionApp::init(size_t idx)
 
   Rect<1> bounds(0, g.max_width-1);
 
+  Payload payload;
+  payload.graph = g;
+  payload.timestep = 0;
+  payload.dset = 0;
+
   if (g.scratch_bytes_per_task != 0) {
     for (long i = 0; i < num_fields; ++i) {
       FieldID fout(FID_FIRST + i);
-      IndexLauncher launcher(TID_INIT, bounds, TaskArgument(), ArgumentMap());
+      IndexLauncher launcher(TID_INIT, bounds,
+                             TaskArgument(&payload, sizeof(payload)), ArgumentMap());
       MappingTagID tag = exact_instance ? Legion::Mapping::DefaultMapper::EXACT_REGION : 0;
       const LogicalRegionT<1> &sratch_region = scratch_regions[idx];
       const LogicalPartitionT<1> &scratch = scratch_partitions[idx];
@@ -718,8 +849,12 @@ void LegionApp::execute_timestep(size_t idx, long t)
   Payload payload;
   payload.graph = g;
   payload.timestep = t;
+  payload.dset = dset;
   IndexLauncher launcher(TID_LEAF, bounds,
                          TaskArgument(&payload, sizeof(payload)), ArgumentMap());
+  // Shard points over the whole graph rather than this timestep's
+  // points, so that a point's shard does not depend on the width.
+  launcher.sharding_space = task_spaces[idx];
   MappingTagID tag = exact_instance ? Legion::Mapping::DefaultMapper::EXACT_REGION : 0;
   // This needs to be write-discard so that we don't catch a
   // dependence on the same point in the previous timestep, unless
@@ -794,6 +929,13 @@ int main(int argc, char **argv)
     Runtime::preregister_task_variant<init>(registrar, "init");
   }
 
+  {
+    TaskVariantRegistrar registrar(TID_DEPS, "deps");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    Runtime::preregister_task_variant<deps>(registrar, "deps");
+  }
+
   {
     TaskVariantRegistrar registrar(TID_LEAF, "leaf");
     registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
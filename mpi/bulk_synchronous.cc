@@ -18,8 +18,11 @@
 #include <cstdlib>
 
 #include "core.h"
+#include "alloc.h"
+#include "placement.h"
 
 #include "mpi.h"
+#include "message_tags.h"
 
 int main(int argc, char *argv[])
 {
@@ -31,53 +34,53 @@ int main(int argc, char *argv[])
   App app(argc, argv);
   if (rank == 0) app.display();
 
-  std::vector<std::vector<char> > scratch;
+  std::vector<char *> scratch;
+  std::vector<std::vector<long> > local_points;
   for (auto graph : app.graphs) {
-    long first_point = rank * graph.max_width / n_ranks;
-    long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
-    long n_points = last_point - first_point + 1;
+    local_points.push_back(owned_points(graph, rank, n_ranks));
+    long n_points = local_points.back().size();
 
     size_t scratch_bytes = graph.scratch_bytes_per_task;
-    scratch.emplace_back(scratch_bytes * n_points);
-    TaskGraph::prepare_scratch(scratch.back().data(), scratch.back().size());
+    scratch.push_back(TaskGraph::allocate_scratch(scratch_bytes, n_points, numa_current_node()));
   }
 
-  double elapsed_time = 0.0;
-  for (int iter = 0; iter < 2; ++iter) {
+  std::vector<MessageTags> tags;
+  for (auto graph : app.graphs) {
+    tags.push_back(make_message_tags(graph, n_ranks));
+  }
+
+  // One timed run of every graph. Ranks use the elapsed time of rank 0,
+  // so that -metg makes the same decisions everywhere.
+  auto run = [&] {
     MPI_Barrier(MPI_COMM_WORLD);
 
     double start_time = MPI_Wtime();
+    app.start_arrivals();
 
     std::vector<MPI_Request> requests;
 
     for (auto graph : app.graphs) {
-      long first_point = rank * graph.max_width / n_ranks;
-      long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
-      long n_points = last_point - first_point + 1;
+      const std::vector<long> &points = local_points[graph.graph_index];
+      long n_points = points.size();
 
       size_t scratch_bytes = graph.scratch_bytes_per_task;
-      char *scratch_ptr = scratch[graph.graph_index].data();
-
-      std::vector<int> rank_by_point(graph.max_width);
-      std::vector<int> tag_bits_by_point(graph.max_width);
-      for (int r = 0; r < n_ranks; ++r) {
-        long r_first_point = r * graph.max_width / n_ranks;
-        long r_last_point = (r + 1) * graph.max_width / n_ranks - 1;
-        for (long p = r_first_point; p <= r_last_point; ++p) {
-          rank_by_point[p] = r;
-          tag_bits_by_point[p] = p - r_first_point;
-          // Has to fit in 7 bits because MPI only guarrantees that
-          // tags can use 15 bits.
-          assert((tag_bits_by_point[p] & ~0x7F) == 0);
-        }
-      }
+      char *scratch_ptr = scratch[graph.graph_index];
+
+      const MessageTags &graph_tags = tags[graph.graph_index];
+      const std::vector<int> &rank_by_point = graph_tags.rank_by_point;
+      size_t header_bytes = graph_tags.header_bytes;
+
+      const DependencyTable *table = graph.dependency_table();
+      assert(table != NULL);
 
       long max_deps = 0;
       for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
-        for (long point = first_point; point <= last_point; ++point) {
+        for (long point : points) {
           long deps = 0;
-          for (auto interval : graph.dependencies(dset, point)) {
-            deps += interval.second - interval.first + 1;
+          size_t n_intervals;
+          const std::pair<long, long> *intervals = table->dependencies(dset, point, n_intervals);
+          for (size_t span = 0; span < n_intervals; ++span) {
+            deps += intervals[span].second - intervals[span].first + 1;
           }
           max_deps = std::max(max_deps, deps);
         }
@@ -86,11 +89,13 @@ int main(int argc, char *argv[])
       // Create input and output buffers.
       std::vector<std::vector<std::vector<char> > > inputs(n_points);
       std::vector<std::vector<const char *> > input_ptr(n_points);
+      std::vector<std::vector<long> > input_points(n_points);
       std::vector<std::vector<size_t> > input_bytes(n_points);
       std::vector<long> n_inputs(n_points);
       std::vector<std::vector<char> > outputs(n_points);
-      for (long point = first_point; point <= last_point; ++point) {
-        long point_index = point - first_point;
+      std::vector<char> remote(max_deps); // for -measure-transfer
+      for (long point_index = 0; point_index < n_points; ++point_index) {
+        long point = points[point_index];
 
         auto &point_inputs = inputs[point_index];
         auto &point_input_ptr = input_ptr[point_index];
@@ -99,33 +104,21 @@ int main(int argc, char *argv[])
         point_inputs.resize(max_deps);
         point_input_ptr.resize(max_deps);
         point_input_bytes.resize(max_deps);
+        input_points[point_index].resize(max_deps);
 
         for (long dep = 0; dep < max_deps; ++dep) {
-          point_inputs[dep].resize(graph.output_bytes_size[0][point]);
-          point_input_ptr[dep] = point_inputs[dep].data();
-          point_input_bytes[dep] = point_inputs[dep].size();
+          point_inputs[dep].resize(header_bytes + graph.output_bytes_at(0, point));
+          point_input_ptr[dep] = point_inputs[dep].data() + header_bytes;
+          point_input_bytes[dep] = point_inputs[dep].size() - header_bytes;
         }
 
         auto &point_outputs = outputs[point_index];
-        point_outputs.resize(graph.output_bytes_size[0][point]);
-      }
-
-      // Cache dependencies.
-      std::vector<std::vector<std::vector<std::pair<long, long> > > > dependencies(graph.max_dependence_sets());
-      std::vector<std::vector<std::vector<std::pair<long, long> > > > reverse_dependencies(graph.max_dependence_sets());
-      for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
-        dependencies[dset].resize(n_points);
-        reverse_dependencies[dset].resize(n_points);
-
-        for (long point = first_point; point <= last_point; ++point) {
-          long point_index = point - first_point;
-
-          dependencies[dset][point_index] = graph.dependencies(dset, point);
-          reverse_dependencies[dset][point_index] = graph.reverse_dependencies(dset, point);
-        }
+        point_outputs.resize(header_bytes + graph.output_bytes_at(0, point));
       }
 
       for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+        graph.wait_for_release(timestep);
+
         long offset = graph.offset_at_timestep(timestep);
         long width = graph.width_at_timestep(timestep);
 
@@ -133,13 +126,11 @@ int main(int argc, char *argv[])
         long last_width = graph.width_at_timestep(timestep-1);
 
         long dset = graph.dependence_set_at_timestep(timestep);
-        auto &deps = dependencies[dset];
-        auto &rev_deps = reverse_dependencies[dset];
 
         requests.clear();
 
-        for (long point = first_point; point <= last_point; ++point) {
-          long point_index = point - first_point;
+        for (long point_index = 0; point_index < n_points; ++point_index) {
+          long point = points[point_index];
 
           auto &point_inputs = inputs[point_index];
           auto &point_n_inputs = n_inputs[point_index];
@@ -147,35 +138,39 @@ int main(int argc, char *argv[])
           auto &point_input_ptr = input_ptr[point_index];
           auto &point_input_bytes = input_bytes[point_index];
 
-          auto &point_deps = deps[point_index];
-          auto &point_rev_deps = rev_deps[point_index];
+          size_t n_point_deps, n_point_rev_deps;
+          const std::pair<long, long> *point_deps = table->dependencies(dset, point, n_point_deps);
+          const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
 
           /* Receive */
           point_n_inputs = 0;
           if (point >= offset && point < offset + width) {
-            for (auto interval : point_deps) {
-              for (long dep = interval.first; dep <= interval.second; ++dep) {
+            for (size_t span = 0; span < n_point_deps; ++span) {
+              for (long dep = point_deps[span].first; dep <= point_deps[span].second; ++dep) {
                 if (dep < last_offset || dep >= last_offset + last_width) {
                   continue;
                 }
 
                 // Use shared memory for on-node data.
-                if (first_point <= dep && dep <= last_point) {
-                  auto &output = outputs[dep - first_point];
+                if (rank_by_point[dep] == rank) {
+                  auto &output = outputs[graph_tags.index_by_point[dep]];
                   point_inputs[point_n_inputs].assign(output.begin(), output.end());
-                  point_inputs[point_n_inputs].resize(graph.output_bytes_size[timestep-1][dep]);
-                  point_input_ptr[point_n_inputs] = point_inputs[point_n_inputs].data();
-                  point_input_bytes[point_n_inputs] = point_inputs[point_n_inputs].size();
+                  point_inputs[point_n_inputs].resize(header_bytes + graph.output_bytes_at(timestep-1, dep));
+                  point_input_ptr[point_n_inputs] = point_inputs[point_n_inputs].data() + header_bytes;
+                  point_input_bytes[point_n_inputs] = point_inputs[point_n_inputs].size() - header_bytes;
                 } else {
-                  int from = tag_bits_by_point[dep];
-                  int to = tag_bits_by_point[point];
-                  int tag = (from << 8) | to;
+                  int tag = graph_tags.tag(dep, point);
+                  // Output sizes can vary by timestep.
+                  point_inputs[point_n_inputs].resize(header_bytes + graph.output_bytes_at(timestep-1, dep));
+                  point_input_ptr[point_n_inputs] = point_inputs[point_n_inputs].data() + header_bytes;
+                  point_input_bytes[point_n_inputs] = point_inputs[point_n_inputs].size() - header_bytes;
                   MPI_Request req;
                   MPI_Irecv(point_inputs[point_n_inputs].data(),
                             point_inputs[point_n_inputs].size(), MPI_BYTE,
-                            rank_by_point[dep], tag, MPI_COMM_WORLD, &req);
+                            rank_by_point[dep], tag, graph_tags.comm, &req);
                   requests.push_back(req);
                 }
+                input_points[point_index][point_n_inputs] = dep;
                 point_n_inputs++;
               }
             }
@@ -183,18 +178,16 @@ int main(int argc, char *argv[])
 
           /* Send */
           if (point >= last_offset && point < last_offset + last_width) {
-            for (auto interval : point_rev_deps) {
-              for (long dep = interval.first; dep <= interval.second; dep++) {
-                if (dep < offset || dep >= offset + width || (first_point <= dep && dep <= last_point)) {
+            for (size_t span = 0; span < n_point_rev_deps; ++span) {
+              for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+                if (dep < offset || dep >= offset + width || rank_by_point[dep] == rank) {
                   continue;
                 }
 
-                int from = tag_bits_by_point[point];
-                int to = tag_bits_by_point[dep];
-                int tag = (from << 8) | to;
+                int tag = graph_tags.tag(point, dep);
                 MPI_Request req;
                 MPI_Isend(point_output.data(), point_output.size(), MPI_BYTE,
-                          rank_by_point[dep], tag, MPI_COMM_WORLD, &req);
+                          rank_by_point[dep], tag, graph_tags.comm, &req);
                 requests.push_back(req);
               }
             }
@@ -205,18 +198,35 @@ int main(int argc, char *argv[])
 
         MPI_Barrier(MPI_COMM_WORLD);
 
-        for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
-          long point_index = point - first_point;
+        for (long point_index = 0; point_index < n_points; ++point_index) {
+          long point = points[point_index];
+          if (point < offset || point >= offset + width) {
+            continue;
+          }
 
           auto &point_input_ptr = input_ptr[point_index];
           auto &point_input_bytes = input_bytes[point_index];
           auto &point_n_inputs = n_inputs[point_index];
           auto &point_output = outputs[point_index];
-          size_t output_point_bytes = graph.output_bytes_size[timestep][point];
-          point_output.resize(output_point_bytes);
+          size_t output_point_bytes = graph.output_bytes_at(timestep, point);
+          point_output.resize(header_bytes + output_point_bytes);
+
+          if (header_bytes > 0) {
+            for (long input = 0; input < point_n_inputs; ++input) {
+              graph_tags.check_header(point_input_ptr[input] - header_bytes, input_points[point_index][input]);
+            }
+            graph_tags.write_header(point_output.data(), point);
+          }
+
+          if (TaskGraph::measuring_transfer()) {
+            for (long input = 0; input < point_n_inputs; ++input) {
+              remote[input] = rank_by_point[input_points[point_index][input]] != rank;
+            }
+            TaskGraph::tag_remote_inputs(remote.data(), point_n_inputs);
+          }
 
           graph.execute_point(timestep, point,
-                              point_output.data(), point_output.size(),
+                              point_output.data() + header_bytes, point_output.size() - header_bytes,
                               point_input_ptr.data(), point_input_bytes.data(), point_n_inputs,
                               scratch_ptr + scratch_bytes * point_index, scratch_bytes);
         }
@@ -226,11 +236,24 @@ int main(int argc, char *argv[])
     MPI_Barrier(MPI_COMM_WORLD);
 
     double stop_time = MPI_Wtime();
-    elapsed_time = stop_time - start_time;
+    double elapsed_time = stop_time - start_time;
+    MPI_Bcast(&elapsed_time, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    return elapsed_time;
+  };
+
+  if (app.metg) {
+    app.search_metg(run, n_ranks, rank == 0);
+  } else {
+    // One untimed warm-up run by default.
+    app.execute_timed(run, rank == 0, 1);
+  }
+
+  for (auto scratch_ptr : scratch) {
+    TaskGraph::free_scratch(scratch_ptr);
   }
 
-  if (rank == 0) {
-    app.report_timing(elapsed_time);
+  for (auto &graph_tags : tags) {
+    free_message_tags(graph_tags);
   }
 
   MPI_Finalize();
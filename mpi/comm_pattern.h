@@ -0,0 +1,86 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef COMM_PATTERN_H
+#define COMM_PATTERN_H
+
+#include <algorithm>
+#include <cassert>
+#include <tuple>
+#include <vector>
+
+#include "core.h"
+
+// Communication patterns, for the implementations that set up the
+// exchanges of a timestep once before the timed loop (persistent, rma,
+// neighbor, shmem and openmp -replay). A pattern is fixed by the
+// dependence set and the points active in a timestep and its
+// predecessor, so periodic graphs have a handful of them. No MPI here.
+
+// (dependence set, offset, width, last offset, last width)
+typedef std::tuple<long, long, long, long, long> PatternKey;
+
+static inline PatternKey pattern_key(const TaskGraph &graph, long timestep)
+{
+  return PatternKey(graph.dependence_set_at_timestep(timestep),
+                    graph.offset_at_timestep(timestep), graph.width_at_timestep(timestep),
+                    graph.offset_at_timestep(timestep-1), graph.width_at_timestep(timestep-1));
+}
+
+// Per local point of first_point..last_point, the producer of each
+// input, in input order: the dependencies active in the last timestep.
+static inline std::vector<std::vector<long> > pattern_input_points(
+    const TaskGraph &graph, const PatternKey &key, long first_point, long last_point)
+{
+  long dset, offset, width, last_offset, last_width;
+  std::tie(dset, offset, width, last_offset, last_width) = key;
+
+  std::vector<std::vector<long> > input_points(last_point - first_point + 1);
+  for (long point = std::max(first_point, offset);
+       point <= std::min(last_point, offset + width - 1); ++point) {
+    graph.for_each_dependency_point(dset, point, [&](long dep) {
+      if (dep >= last_offset && dep < last_offset + last_width) {
+        input_points[point - first_point].push_back(dep);
+      }
+    });
+  }
+  return input_points;
+}
+
+// The slot of producer among the inputs of consumer, i.e. its position
+// in pattern_input_points.
+static inline long pattern_input_slot(const TaskGraph &graph, const PatternKey &key,
+                                      long consumer, long producer)
+{
+  long dset, offset, width, last_offset, last_width;
+  std::tie(dset, offset, width, last_offset, last_width) = key;
+
+  long slot = 0;
+  bool found = false;
+  graph.for_each_dependency_point(dset, consumer, [&](long input) {
+    if (found || input < last_offset || input >= last_offset + last_width) {
+      return;
+    }
+    if (input == producer) {
+      found = true;
+    } else {
+      slot++;
+    }
+  });
+  assert(found);
+  return slot;
+}
+
+#endif // COMM_PATTERN_H
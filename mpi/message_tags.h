@@ -0,0 +1,116 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MESSAGE_TAGS_H
+#define MESSAGE_TAGS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "mpi.h"
+#include "placement.h"
+
+// Message matching for the point-to-point exchanges of one graph, whose
+// points are placed on the ranks by point_owner (-placement).
+//
+// Every graph gets its own communicator, so graphs never match each
+// other's messages. Tags pack the local indices of the sending and the
+// receiving point when both fit under MPI_TAG_UB. Otherwise the tag is
+// the receiving point alone: messages with one tag between two ranks
+// match in the order they are posted, and both sides post them in
+// ascending order of the sending point. The sending point then travels
+// in a header before the payload (header_bytes) and is checked on
+// arrival.
+struct MessageTags {
+  MPI_Comm comm;
+  std::vector<int> rank_by_point;
+  std::vector<long> index_by_point; // among the points of the rank, in order
+  int index_bits;
+  size_t header_bytes;
+
+  int tag(long from_point, long to_point) const
+  {
+    if (header_bytes > 0) {
+      return index_by_point[to_point];
+    }
+    return (index_by_point[from_point] << index_bits) | index_by_point[to_point];
+  }
+
+  // For header_bytes > 0: stamps and checks the sending point of a
+  // message.
+  void write_header(char *message, long point) const
+  {
+    int64_t value = point;
+    memcpy(message, &value, sizeof(value));
+  }
+
+  void check_header(const char *message, long point) const
+  {
+    int64_t value;
+    memcpy(&value, message, sizeof(value));
+    if (value != point) {
+      fprintf(stderr, "error: Message from point %ld matched the receive for point %ld\n",
+              (long)value, point);
+      abort();
+    }
+  }
+};
+
+static MessageTags make_message_tags(const TaskGraph &graph, int n_ranks)
+{
+  MessageTags tags;
+  MPI_Comm_dup(MPI_COMM_WORLD, &tags.comm);
+
+  int *tag_ub;
+  int found;
+  MPI_Comm_get_attr(tags.comm, MPI_TAG_UB, &tag_ub, &found);
+  // MPI guarantees at least 15 bits.
+  long max_tag = found ? *tag_ub : 32767;
+
+  tags.rank_by_point.resize(graph.max_width);
+  tags.index_by_point.resize(graph.max_width);
+  std::vector<long> n_points(n_ranks, 0);
+  for (long p = 0; p < graph.max_width; ++p) {
+    int r = point_owner(graph, p, n_ranks);
+    tags.rank_by_point[p] = r;
+    tags.index_by_point[p] = n_points[r]++;
+  }
+  long max_points = *std::max_element(n_points.begin(), n_points.end());
+
+  tags.index_bits = 0;
+  while ((1L << tags.index_bits) < max_points) {
+    tags.index_bits++;
+  }
+  tags.header_bytes = 0;
+  if (2 * tags.index_bits >= 63 || ((1L << (2 * tags.index_bits)) - 1) > max_tag) {
+    if (max_points - 1 > max_tag) {
+      fprintf(stderr, "error: %ld points per rank exceed MPI_TAG_UB %ld\n", max_points, max_tag);
+      abort();
+    }
+    tags.header_bytes = sizeof(int64_t);
+  }
+  return tags;
+}
+
+static void free_message_tags(MessageTags &tags)
+{
+  MPI_Comm_free(&tags.comm);
+}
+
+#endif // MESSAGE_TAGS_H
@@ -0,0 +1,355 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <tuple>
+
+#include "core.h"
+#include "alloc.h"
+#include "placement.h"
+
+#include "mpi.h"
+#include "comm_pattern.h"
+
+// Exchanges each timestep with one MPI_Ineighbor_alltoallv on a
+// distributed graph topology, built once per dependence set from the
+// dependencies of every point (MPI_Dist_graph_create_adjacent with
+// reorder, so the library may optimize the schedule and placement).
+// Neighbors without messages in a timestep get zero counts.
+//
+// Every output is sent once per consumer rank rather than once per
+// consumer, and is read in place from the receive buffer. As in
+// persistent, the messages of a timestep are computed once per pattern
+// (the dependence set and the points active in the timestep and its
+// predecessor) before the timed loop.
+
+struct Topology {
+  MPI_Comm comm;
+  std::vector<int> sources, destinations;
+};
+
+struct Pattern {
+  // Local producers sent to each destination, and remote producers
+  // received from each source, ascending.
+  std::vector<std::vector<long> > sends;
+  std::vector<std::vector<long> > recvs;
+  // Per local point, the producer of each input, in input order.
+  std::vector<std::vector<long> > input_points;
+};
+
+struct GraphState {
+  long first_point, last_point;
+  std::vector<int> rank_by_point;
+  std::vector<Topology> topologies; // by dependence set
+  std::map<PatternKey, Pattern> patterns;
+
+  std::vector<std::vector<std::vector<char> > > inputs; // copies of on-node outputs
+  std::vector<std::vector<const char *> > input_ptr;
+  std::vector<std::vector<size_t> > input_bytes;
+  std::vector<std::vector<char> > outputs;
+  std::vector<char> send_buffer, recv_buffer;
+  std::vector<int> send_counts, send_displs, recv_counts, recv_displs;
+  std::vector<const char *> remote_ptr; // by point, into recv_buffer
+};
+
+static long neighbor_index(const std::vector<int> &neighbors, int rank)
+{
+  auto it = std::lower_bound(neighbors.begin(), neighbors.end(), rank);
+  assert(it != neighbors.end() && *it == rank);
+  return it - neighbors.begin();
+}
+
+static Topology create_topology(const TaskGraph &graph, const GraphState &state, long dset, int rank)
+{
+  const DependencyTable *table = graph.dependency_table();
+  std::set<int> sources, destinations;
+  for (long point = state.first_point; point <= state.last_point; ++point) {
+    graph.for_each_dependency_point(dset, point, [&](long dep) {
+      if (state.rank_by_point[dep] != rank) {
+        sources.insert(state.rank_by_point[dep]);
+      }
+    });
+    size_t n_point_rev_deps;
+    const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
+    for (size_t span = 0; span < n_point_rev_deps; ++span) {
+      for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+        if (state.rank_by_point[dep] != rank) {
+          destinations.insert(state.rank_by_point[dep]);
+        }
+      }
+    }
+  }
+
+  Topology topology;
+  topology.sources.assign(sources.begin(), sources.end());
+  topology.destinations.assign(destinations.begin(), destinations.end());
+  MPI_Dist_graph_create_adjacent(MPI_COMM_WORLD,
+                                 topology.sources.size(), topology.sources.data(), MPI_UNWEIGHTED,
+                                 topology.destinations.size(), topology.destinations.data(), MPI_UNWEIGHTED,
+                                 MPI_INFO_NULL, 1, &topology.comm);
+  return topology;
+}
+
+static void create_pattern(const TaskGraph &graph, const GraphState &state,
+                           const PatternKey &key, Pattern &pattern)
+{
+  long dset, offset, width, last_offset, last_width;
+  std::tie(dset, offset, width, last_offset, last_width) = key;
+
+  const DependencyTable *table = graph.dependency_table();
+  const Topology &topology = state.topologies[dset];
+  std::vector<std::set<long> > recvs(topology.sources.size());
+
+  pattern.sends.resize(topology.destinations.size());
+  pattern.input_points = pattern_input_points(graph, key, state.first_point, state.last_point);
+  for (long point = state.first_point; point <= state.last_point; ++point) {
+    long point_index = point - state.first_point;
+
+    /* Receive */
+    for (long dep : pattern.input_points[point_index]) {
+      if (dep < state.first_point || dep > state.last_point) {
+        recvs[neighbor_index(topology.sources, state.rank_by_point[dep])].insert(dep);
+      }
+    }
+
+    /* Send */
+    if (point >= last_offset && point < last_offset + last_width) {
+      size_t n_point_rev_deps;
+      const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
+      for (size_t span = 0; span < n_point_rev_deps; ++span) {
+        for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+          if (dep < offset || dep >= offset + width ||
+              (state.first_point <= dep && dep <= state.last_point)) {
+            continue;
+          }
+          auto &sends = pattern.sends[neighbor_index(topology.destinations, state.rank_by_point[dep])];
+          if (sends.empty() || sends.back() != point) {
+            sends.push_back(point);
+          }
+        }
+      }
+    }
+  }
+
+  for (auto &producers : recvs) {
+    pattern.recvs.emplace_back(producers.begin(), producers.end());
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int n_ranks, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  App app(argc, argv);
+  placement_require_block("mpi/neighbor");
+  if (rank == 0) app.display();
+
+  std::vector<char *> scratch;
+  std::vector<GraphState> states(app.graphs.size());
+  for (auto graph : app.graphs) {
+    long first_point = rank * graph.max_width / n_ranks;
+    long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
+    long n_points = last_point - first_point + 1;
+
+    size_t scratch_bytes = graph.scratch_bytes_per_task;
+    scratch.push_back(TaskGraph::allocate_scratch(scratch_bytes, n_points, numa_current_node()));
+
+    GraphState &state = states[graph.graph_index];
+    state.first_point = first_point;
+    state.last_point = last_point;
+    state.rank_by_point.resize(graph.max_width);
+    for (int r = 0; r < n_ranks; ++r) {
+      long r_first_point = r * graph.max_width / n_ranks;
+      long r_last_point = (r + 1) * graph.max_width / n_ranks - 1;
+      for (long p = r_first_point; p <= r_last_point; ++p) {
+        state.rank_by_point[p] = r;
+      }
+    }
+
+    const DependencyTable *table = graph.dependency_table();
+    assert(table != NULL);
+
+    long max_deps = 0;
+    for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
+      state.topologies.push_back(create_topology(graph, state, dset, rank));
+      for (long point = first_point; point <= last_point; ++point) {
+        long deps = 0;
+        size_t n_intervals;
+        const std::pair<long, long> *intervals = table->dependencies(dset, point, n_intervals);
+        for (size_t span = 0; span < n_intervals; ++span) {
+          deps += intervals[span].second - intervals[span].first + 1;
+        }
+        max_deps = std::max(max_deps, deps);
+      }
+    }
+
+    for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+      PatternKey key = pattern_key(graph, timestep);
+      if (!state.patterns.count(key)) {
+        create_pattern(graph, state, key, state.patterns[key]);
+      }
+    }
+
+    // Create input and output buffers.
+    state.inputs.resize(n_points);
+    state.input_ptr.resize(n_points);
+    state.input_bytes.resize(n_points);
+    state.outputs.resize(n_points);
+    for (long point_index = 0; point_index < n_points; ++point_index) {
+      state.inputs[point_index].resize(max_deps);
+      for (auto &input : state.inputs[point_index]) {
+        input.resize(graph.max_output_bytes());
+      }
+      state.input_ptr[point_index].resize(max_deps);
+      state.input_bytes[point_index].resize(max_deps);
+      state.outputs[point_index].resize(graph.max_output_bytes());
+    }
+    state.remote_ptr.resize(graph.max_width);
+  }
+
+  auto run = [&] {
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double start_time = MPI_Wtime();
+    app.start_arrivals();
+
+    for (auto graph : app.graphs) {
+      GraphState &state = states[graph.graph_index];
+
+      long first_point = state.first_point;
+      long last_point = state.last_point;
+
+      size_t scratch_bytes = graph.scratch_bytes_per_task;
+      char *scratch_ptr = scratch[graph.graph_index];
+
+      for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+        graph.wait_for_release(timestep);
+
+        long offset = graph.offset_at_timestep(timestep);
+        long width = graph.width_at_timestep(timestep);
+
+        const Pattern &pattern = state.patterns.at(pattern_key(graph, timestep));
+        const Topology &topology = state.topologies[graph.dependence_set_at_timestep(timestep)];
+
+        // Output sizes can vary by timestep, so counts are recomputed.
+        auto layout = [&](const std::vector<std::vector<long> > &producers,
+                          std::vector<int> &counts, std::vector<int> &displs) {
+          counts.assign(producers.size(), 0);
+          displs.assign(producers.size(), 0);
+          long total = 0;
+          for (size_t neighbor = 0; neighbor < producers.size(); ++neighbor) {
+            displs[neighbor] = total;
+            for (long point : producers[neighbor]) {
+              counts[neighbor] += graph.output_bytes_at(timestep-1, point);
+            }
+            total += counts[neighbor];
+          }
+          return total;
+        };
+        state.send_buffer.resize(layout(pattern.sends, state.send_counts, state.send_displs));
+        state.recv_buffer.resize(layout(pattern.recvs, state.recv_counts, state.recv_displs));
+
+        char *send = state.send_buffer.data();
+        for (auto &producers : pattern.sends) {
+          for (long point : producers) {
+            size_t bytes = graph.output_bytes_at(timestep-1, point);
+            memcpy(send, state.outputs[point - first_point].data(), bytes);
+            send += bytes;
+          }
+        }
+
+        MPI_Request req;
+        MPI_Ineighbor_alltoallv(state.send_buffer.data(), state.send_counts.data(), state.send_displs.data(), MPI_BYTE,
+                                state.recv_buffer.data(), state.recv_counts.data(), state.recv_displs.data(), MPI_BYTE,
+                                topology.comm, &req);
+
+        // Use shared memory for on-node data.
+        for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
+          long point_index = point - first_point;
+          auto &point_input_points = pattern.input_points[point_index];
+          for (size_t input = 0; input < point_input_points.size(); ++input) {
+            long dep = point_input_points[input];
+            if (first_point <= dep && dep <= last_point) {
+              memcpy(state.inputs[point_index][input].data(), state.outputs[dep - first_point].data(),
+                     graph.output_bytes_at(timestep-1, dep));
+              state.input_ptr[point_index][input] = state.inputs[point_index][input].data();
+            }
+          }
+        }
+
+        MPI_Wait(&req, MPI_STATUS_IGNORE);
+
+        const char *recv = state.recv_buffer.data();
+        for (auto &producers : pattern.recvs) {
+          for (long point : producers) {
+            state.remote_ptr[point] = recv;
+            recv += graph.output_bytes_at(timestep-1, point);
+          }
+        }
+
+        for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
+          long point_index = point - first_point;
+
+          auto &point_input_ptr = state.input_ptr[point_index];
+          auto &point_input_bytes = state.input_bytes[point_index];
+          auto &point_input_points = pattern.input_points[point_index];
+          auto &point_output = state.outputs[point_index];
+          long point_n_inputs = point_input_points.size();
+
+          for (long input = 0; input < point_n_inputs; ++input) {
+            long dep = point_input_points[input];
+            if (dep < first_point || dep > last_point) {
+              point_input_ptr[input] = state.remote_ptr[dep];
+            }
+            point_input_bytes[input] = graph.output_bytes_at(timestep-1, dep);
+          }
+
+          graph.execute_point(timestep, point,
+                              point_output.data(), graph.output_bytes_at(timestep, point),
+                              point_input_ptr.data(), point_input_bytes.data(), point_n_inputs,
+                              scratch_ptr + scratch_bytes * point_index, scratch_bytes);
+        }
+      }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double stop_time = MPI_Wtime();
+    return stop_time - start_time;
+  };
+
+  // One untimed warm-up run by default.
+  app.execute_timed(run, rank == 0, 1);
+
+  for (auto &state : states) {
+    for (auto &topology : state.topologies) {
+      MPI_Comm_free(&topology.comm);
+    }
+  }
+
+  for (auto scratch_ptr : scratch) {
+    TaskGraph::free_scratch(scratch_ptr);
+  }
+
+  MPI_Finalize();
+}
@@ -16,10 +16,258 @@
 #include <cassert>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 
 #include "core.h"
+#include "alloc.h"
+#include "output_pool.h"
+#include "placement.h"
+#ifdef USE_GPU_KERNEL
+#include "core_gpu.h"
+#endif
 
 #include "mpi.h"
+#include "message_tags.h"
+
+// -gpu direct|staged keeps task outputs and inputs on the device and runs
+// the kernels there. With direct, device buffers are handed straight to
+// MPI (which must be GPU-aware); with staged, outputs are copied to the
+// host before sending and inputs back to the device after receiving.
+// Both print the time spent exchanging dependencies, so that the two
+// can be compared.
+#define GPU_FLAG "-gpu"
+
+#ifdef USE_GPU_KERNEL
+struct GPUState {
+  long first_point, last_point;
+  long max_deps;
+  size_t slot_bytes;
+  char *scratch;
+  // Device buffers: one output slot per local point and max_deps input
+  // slots per local point.
+  char *outputs, *inputs;
+  // Host mirrors, for staging and for validating inputs.
+  std::vector<char> host_outputs, host_inputs;
+};
+
+struct GPUTransfers {
+  long messages;
+  long bytes;
+  double time;
+};
+
+static void create_gpu_state(const TaskGraph &graph, int rank, int n_ranks, GPUState &state)
+{
+  if (!gpu_kernel_supported(graph.kernel)) {
+    fprintf(stderr, "error: " GPU_FLAG " does not support this kernel type\n");
+    abort();
+  }
+
+  state.first_point = rank * graph.max_width / n_ranks;
+  state.last_point = (rank + 1) * graph.max_width / n_ranks - 1;
+  long n_points = state.last_point - state.first_point + 1;
+
+  const DependencyTable *table = graph.dependency_table();
+  assert(table != NULL);
+
+  state.max_deps = 0;
+  for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
+    for (long point = state.first_point; point <= state.last_point; ++point) {
+      long deps = 0;
+      size_t n_intervals;
+      const std::pair<long, long> *intervals = table->dependencies(dset, point, n_intervals);
+      for (size_t span = 0; span < n_intervals; ++span) {
+        deps += intervals[span].second - intervals[span].first + 1;
+      }
+      state.max_deps = std::max(state.max_deps, deps);
+    }
+  }
+  state.slot_bytes = graph.max_output_bytes();
+
+  size_t scratch_bytes = graph.scratch_bytes_per_task;
+  state.scratch = gpu_allocate_scratch(scratch_bytes * n_points);
+  for (long point_index = 0; point_index < n_points; ++point_index) {
+    gpu_prepare_scratch(state.scratch + scratch_bytes * point_index, scratch_bytes, NULL);
+  }
+  state.outputs = gpu_allocate_buffer(n_points * state.slot_bytes);
+  state.inputs = gpu_allocate_buffer(n_points * state.max_deps * state.slot_bytes);
+  state.host_outputs.resize(n_points * state.slot_bytes);
+  state.host_inputs.resize(n_points * state.max_deps * state.slot_bytes);
+  gpu_synchronize(NULL);
+}
+
+static void free_gpu_state(GPUState &state)
+{
+  gpu_free_scratch(state.scratch);
+  gpu_free_buffer(state.outputs);
+  gpu_free_buffer(state.inputs);
+}
+
+// One graph of nonblock with device-resident data. The exchange of a
+// timestep (staging copies included) is timed into transfers.
+static void execute_graph_gpu(const TaskGraph &graph, const MessageTags &graph_tags,
+                              GPUState &state, bool direct, GPUTransfers &transfers)
+{
+  long first_point = state.first_point;
+  long last_point = state.last_point;
+  long n_points = last_point - first_point + 1;
+  long max_deps = state.max_deps;
+  size_t slot_bytes = state.slot_bytes;
+  size_t scratch_bytes = graph.scratch_bytes_per_task;
+  const std::vector<int> &rank_by_point = graph_tags.rank_by_point;
+
+  const DependencyTable *table = graph.dependency_table();
+
+  auto output_slot = [&](char *base, long point_index) {
+    return base + point_index * slot_bytes;
+  };
+  auto input_slot = [&](char *base, long point_index, long input) {
+    return base + (point_index * max_deps + input) * slot_bytes;
+  };
+
+  std::vector<MPI_Request> requests;
+  std::vector<std::pair<long, long> > sends; // (point, consumer)
+  std::vector<std::pair<long, long> > recvs; // (point index, input)
+  std::vector<char> staged(n_points);
+  std::vector<std::vector<long> > input_points(n_points);
+  std::vector<const char *> input_ptr(max_deps);
+  std::vector<size_t> input_bytes(max_deps);
+
+  for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+    graph.wait_for_release(timestep);
+
+    long offset = graph.offset_at_timestep(timestep);
+    long width = graph.width_at_timestep(timestep);
+
+    long last_offset = graph.offset_at_timestep(timestep-1);
+    long last_width = graph.width_at_timestep(timestep-1);
+
+    long dset = graph.dependence_set_at_timestep(timestep);
+
+    requests.clear();
+    sends.clear();
+    recvs.clear();
+
+    double exchange_start = MPI_Wtime();
+
+    for (long point = first_point; point <= last_point; ++point) {
+      long point_index = point - first_point;
+      auto &point_input_points = input_points[point_index];
+      point_input_points.clear();
+
+      /* Receive */
+      if (point >= offset && point < offset + width) {
+        graph.for_each_dependency_point(dset, point, [&](long dep) {
+          if (dep < last_offset || dep >= last_offset + last_width) {
+            return;
+          }
+          long input = point_input_points.size();
+          point_input_points.push_back(dep);
+
+          size_t bytes = graph.output_bytes_at(timestep-1, dep);
+          if (first_point <= dep && dep <= last_point) {
+            gpu_memcpy(input_slot(state.inputs, point_index, input),
+                       output_slot(state.outputs, dep - first_point), bytes, NULL);
+          } else {
+            char *buffer = direct ? input_slot(state.inputs, point_index, input)
+                                  : input_slot(state.host_inputs.data(), point_index, input);
+            MPI_Request req;
+            MPI_Irecv(buffer, bytes, MPI_BYTE,
+                      rank_by_point[dep], graph_tags.tag(dep, point), graph_tags.comm, &req);
+            requests.push_back(req);
+            recvs.push_back(std::make_pair(point_index, input));
+          }
+        });
+      }
+
+      /* Send */
+      if (point >= last_offset && point < last_offset + last_width) {
+        size_t n_point_rev_deps;
+        const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
+        for (size_t span = 0; span < n_point_rev_deps; ++span) {
+          for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+            if (dep < offset || dep >= offset + width || (first_point <= dep && dep <= last_point)) {
+              continue;
+            }
+            sends.push_back(std::make_pair(point, dep));
+          }
+        }
+      }
+    }
+
+    // Each output with a remote consumer is staged once.
+    if (!direct && !sends.empty()) {
+      std::fill(staged.begin(), staged.end(), 0);
+      for (auto &send : sends) {
+        long point_index = send.first - first_point;
+        if (!staged[point_index]) {
+          gpu_memcpy(output_slot(state.host_outputs.data(), point_index),
+                     output_slot(state.outputs, point_index),
+                     graph.output_bytes_at(timestep-1, send.first), NULL);
+          staged[point_index] = 1;
+        }
+      }
+      gpu_synchronize(NULL);
+    }
+
+    for (auto &send : sends) {
+      long point_index = send.first - first_point;
+      size_t bytes = graph.output_bytes_at(timestep-1, send.first);
+      char *buffer = direct ? output_slot(state.outputs, point_index)
+                            : output_slot(state.host_outputs.data(), point_index);
+      MPI_Request req;
+      MPI_Isend(buffer, bytes, MPI_BYTE,
+                rank_by_point[send.second], graph_tags.tag(send.first, send.second), graph_tags.comm, &req);
+      requests.push_back(req);
+      transfers.messages++;
+      transfers.bytes += bytes;
+    }
+
+    MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+    if (!direct) {
+      for (auto &recv : recvs) {
+        long dep = input_points[recv.first][recv.second];
+        gpu_memcpy(input_slot(state.inputs, recv.first, recv.second),
+                   input_slot(state.host_inputs.data(), recv.first, recv.second),
+                   graph.output_bytes_at(timestep-1, dep), NULL);
+      }
+    }
+    gpu_synchronize(NULL);
+
+    transfers.time += MPI_Wtime() - exchange_start;
+
+    // Inputs are validated on the host, outside the timed exchange.
+    for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
+      long point_index = point - first_point;
+      for (size_t input = 0; input < input_points[point_index].size(); ++input) {
+        gpu_memcpy(input_slot(state.host_inputs.data(), point_index, input),
+                   input_slot(state.inputs, point_index, input),
+                   graph.output_bytes_at(timestep-1, input_points[point_index][input]), NULL);
+      }
+    }
+    gpu_synchronize(NULL);
+
+    for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
+      long point_index = point - first_point;
+      auto &point_input_points = input_points[point_index];
+      long point_n_inputs = point_input_points.size();
+
+      for (long input = 0; input < point_n_inputs; ++input) {
+        input_ptr[input] = input_slot(state.host_inputs.data(), point_index, input);
+        input_bytes[input] = graph.output_bytes_at(timestep-1, point_input_points[input]);
+      }
+      graph.validate_inputs(timestep, point, input_ptr.data(), input_bytes.data(), point_n_inputs);
+
+      gpu_execute_point(graph, timestep, point,
+                        output_slot(state.outputs, point_index), graph.output_bytes_at(timestep, point),
+                        state.scratch + scratch_bytes * point_index, scratch_bytes, NULL);
+    }
+    // Outputs are sent (or staged) from the device next timestep.
+    gpu_synchronize(NULL);
+  }
+}
+#endif
 
 int main(int argc, char *argv[])
 {
@@ -28,56 +276,104 @@ int main(int argc, char *argv[])
   MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
+  bool use_gpu = false, gpu_direct = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], GPU_FLAG)) {
+      if (i + 1 >= argc || (strcmp(argv[i+1], "direct") && strcmp(argv[i+1], "staged"))) {
+        fprintf(stderr, "error: " GPU_FLAG " must be followed by direct or staged\n");
+        abort();
+      }
+      use_gpu = true;
+      gpu_direct = !strcmp(argv[i+1], "direct");
+    }
+  }
+#ifndef USE_GPU_KERNEL
+  if (use_gpu) {
+    fprintf(stderr, "error: " GPU_FLAG " requires building with USE_CUDA=1 or USE_HIP=1\n");
+    abort();
+  }
+#endif
+
   App app(argc, argv);
   if (rank == 0) app.display();
 
-  std::vector<std::vector<char> > scratch;
+  if (use_gpu) {
+    placement_require_block("mpi/nonblock -gpu");
+  }
+
+  std::vector<char *> scratch;
+  std::vector<std::vector<long> > local_points;
   for (auto graph : app.graphs) {
-    long first_point = rank * graph.max_width / n_ranks;
-    long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
-    long n_points = last_point - first_point + 1;
+    local_points.push_back(owned_points(graph, rank, n_ranks));
+    long n_points = local_points.back().size();
 
     size_t scratch_bytes = graph.scratch_bytes_per_task;
-    scratch.emplace_back(scratch_bytes * n_points);
-    TaskGraph::prepare_scratch(scratch.back().data(), scratch.back().size());
+    scratch.push_back(TaskGraph::allocate_scratch(use_gpu ? 0 : scratch_bytes, n_points, numa_current_node()));
+  }
+
+  std::vector<MessageTags> tags;
+  for (auto graph : app.graphs) {
+    tags.push_back(make_message_tags(graph, n_ranks));
+    if (use_gpu && tags.back().header_bytes > 0) {
+      fprintf(stderr, "error: " GPU_FLAG " requires every pair of points to fit in an MPI tag\n");
+      abort();
+    }
   }
 
-  double elapsed_time = 0.0;
-  for (int iter = 0; iter < 2; ++iter) {
+#ifdef USE_GPU_KERNEL
+  std::vector<GPUState> gpu_states(use_gpu ? app.graphs.size() : 0);
+  GPUTransfers transfers;
+  if (use_gpu) {
+    for (auto graph : app.graphs) {
+      create_gpu_state(graph, rank, n_ranks, gpu_states[graph.graph_index]);
+    }
+  }
+#endif
+
+  auto run = [&] {
     MPI_Barrier(MPI_COMM_WORLD);
 
     double start_time = MPI_Wtime();
+    app.start_arrivals();
 
     std::vector<MPI_Request> requests;
 
+#ifdef USE_GPU_KERNEL
+    transfers.messages = 0;
+    transfers.bytes = 0;
+    transfers.time = 0.0;
+#endif
+
     for (auto graph : app.graphs) {
-      long first_point = rank * graph.max_width / n_ranks;
-      long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
-      long n_points = last_point - first_point + 1;
+#ifdef USE_GPU_KERNEL
+      if (use_gpu) {
+        execute_graph_gpu(graph, tags[graph.graph_index], gpu_states[graph.graph_index],
+                          gpu_direct, transfers);
+        continue;
+      }
+#endif
+
+      const std::vector<long> &points = local_points[graph.graph_index];
+      long n_points = points.size();
 
       size_t scratch_bytes = graph.scratch_bytes_per_task;
-      char *scratch_ptr = scratch[graph.graph_index].data();
-
-      std::vector<int> rank_by_point(graph.max_width);
-      std::vector<int> tag_bits_by_point(graph.max_width);
-      for (int r = 0; r < n_ranks; ++r) {
-        long r_first_point = r * graph.max_width / n_ranks;
-        long r_last_point = (r + 1) * graph.max_width / n_ranks - 1;
-        for (long p = r_first_point; p <= r_last_point; ++p) {
-          rank_by_point[p] = r;
-          tag_bits_by_point[p] = p - r_first_point;
-          // Has to fit in 7 bits because MPI only guarrantees that
-          // tags can use 15 bits.
-          assert((tag_bits_by_point[p] & ~0x7F) == 0);
-        }
-      }
+      char *scratch_ptr = scratch[graph.graph_index];
+
+      const MessageTags &graph_tags = tags[graph.graph_index];
+      const std::vector<int> &rank_by_point = graph_tags.rank_by_point;
+      size_t header_bytes = graph_tags.header_bytes;
+
+      const DependencyTable *table = graph.dependency_table();
+      assert(table != NULL);
 
       long max_deps = 0;
       for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
-        for (long point = first_point; point <= last_point; ++point) {
+        for (long point : points) {
           long deps = 0;
-          for (auto interval : graph.dependencies(dset, point)) {
-            deps += interval.second - interval.first + 1;
+          size_t n_intervals;
+          const std::pair<long, long> *intervals = table->dependencies(dset, point, n_intervals);
+          for (size_t span = 0; span < n_intervals; ++span) {
+            deps += intervals[span].second - intervals[span].first + 1;
           }
           max_deps = std::max(max_deps, deps);
         }
@@ -86,12 +382,14 @@ int main(int argc, char *argv[])
       // Create input and output buffers.
       std::vector<std::vector<std::vector<char> > > inputs(n_points);
       std::vector<std::vector<const char *> > input_ptr(n_points);
+      std::vector<std::vector<long> > input_points(n_points);
       std::vector<std::vector<size_t> > input_bytes(n_points);
       std::vector<long> n_inputs(n_points);
-      std::vector<std::vector<char> > outputs(n_points);
-      for (long point = first_point; point <= last_point; ++point) {
-        long point_index = point - first_point;
-
+      // Each timestep only reads the outputs of the previous one, whose
+      // sends complete before the next timestep writes its own.
+      OutputPool outputs(graph, points, 2, header_bytes);
+      std::vector<char> remote(max_deps); // for -measure-transfer
+      for (long point_index = 0; point_index < n_points; ++point_index) {
         auto &point_inputs = inputs[point_index];
         auto &point_input_ptr = input_ptr[point_index];
         auto &point_input_bytes = input_bytes[point_index];
@@ -99,33 +397,18 @@ int main(int argc, char *argv[])
         point_inputs.resize(max_deps);
         point_input_ptr.resize(max_deps);
         point_input_bytes.resize(max_deps);
+        input_points[point_index].resize(max_deps);
 
         for (long dep = 0; dep < max_deps; ++dep) {
-          point_inputs[dep].resize(graph.output_bytes_per_task);
-          point_input_ptr[dep] = point_inputs[dep].data();
-          point_input_bytes[dep] = point_inputs[dep].size();
-        }
-
-        auto &point_outputs = outputs[point_index];
-        point_outputs.resize(graph.output_bytes_per_task);
-      }
-
-      // Cache dependencies.
-      std::vector<std::vector<std::vector<std::pair<long, long> > > > dependencies(graph.max_dependence_sets());
-      std::vector<std::vector<std::vector<std::pair<long, long> > > > reverse_dependencies(graph.max_dependence_sets());
-      for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
-        dependencies[dset].resize(n_points);
-        reverse_dependencies[dset].resize(n_points);
-
-        for (long point = first_point; point <= last_point; ++point) {
-          long point_index = point - first_point;
-
-          dependencies[dset][point_index] = graph.dependencies(dset, point);
-          reverse_dependencies[dset][point_index] = graph.reverse_dependencies(dset, point);
+          point_inputs[dep].resize(header_bytes + graph.output_bytes_per_task);
+          point_input_ptr[dep] = point_inputs[dep].data() + header_bytes;
+          point_input_bytes[dep] = point_inputs[dep].size() - header_bytes;
         }
       }
 
       for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+        graph.wait_for_release(timestep);
+
         long offset = graph.offset_at_timestep(timestep);
         long width = graph.width_at_timestep(timestep);
 
@@ -133,44 +416,48 @@ int main(int argc, char *argv[])
         long last_width = graph.width_at_timestep(timestep-1);
 
         long dset = graph.dependence_set_at_timestep(timestep);
-        auto &deps = dependencies[dset];
-        auto &rev_deps = reverse_dependencies[dset];
 
         requests.clear();
 
-        for (long point = first_point; point <= last_point; ++point) {
-          long point_index = point - first_point;
+        for (long point_index = 0; point_index < n_points; ++point_index) {
+          long point = points[point_index];
 
           auto &point_inputs = inputs[point_index];
           auto &point_n_inputs = n_inputs[point_index];
-          auto &point_output = outputs[point_index];
+          auto &point_input_ptr = input_ptr[point_index];
+          auto &point_input_bytes = input_bytes[point_index];
 
-          auto &point_deps = deps[point_index];
-          auto &point_rev_deps = rev_deps[point_index];
+          size_t n_point_deps, n_point_rev_deps;
+          const std::pair<long, long> *point_deps = table->dependencies(dset, point, n_point_deps);
+          const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
 
           /* Receive */
           point_n_inputs = 0;
           if (point >= offset && point < offset + width) {
-            for (auto interval : point_deps) {
-              for (long dep = interval.first; dep <= interval.second; ++dep) {
+            for (size_t span = 0; span < n_point_deps; ++span) {
+              for (long dep = point_deps[span].first; dep <= point_deps[span].second; ++dep) {
                 if (dep < last_offset || dep >= last_offset + last_width) {
                   continue;
                 }
 
-                // Use shared memory for on-node data.
-                if (first_point <= dep && dep <= last_point) {
-                  auto &output = outputs[dep - first_point];
-                  point_inputs[point_n_inputs].assign(output.begin(), output.end());
+                // Use shared memory for on-node data: read the
+                // previous timestep's slot in place.
+                size_t bytes = graph.output_bytes_at(timestep-1, dep);
+                if (rank_by_point[dep] == rank) {
+                  point_input_ptr[point_n_inputs] = outputs.slot(timestep-1, dep) + header_bytes;
                 } else {
-                  int from = tag_bits_by_point[dep];
-                  int to = tag_bits_by_point[point];
-                  int tag = (from << 8) | to;
+                  int tag = graph_tags.tag(dep, point);
+                  // Output sizes can vary by timestep.
+                  point_inputs[point_n_inputs].resize(header_bytes + bytes);
                   MPI_Request req;
                   MPI_Irecv(point_inputs[point_n_inputs].data(),
                             point_inputs[point_n_inputs].size(), MPI_BYTE,
-                            rank_by_point[dep], tag, MPI_COMM_WORLD, &req);
+                            rank_by_point[dep], tag, graph_tags.comm, &req);
                   requests.push_back(req);
+                  point_input_ptr[point_n_inputs] = point_inputs[point_n_inputs].data() + header_bytes;
                 }
+                point_input_bytes[point_n_inputs] = bytes;
+                input_points[point_index][point_n_inputs] = dep;
                 point_n_inputs++;
               }
             }
@@ -178,18 +465,17 @@ int main(int argc, char *argv[])
 
           /* Send */
           if (point >= last_offset && point < last_offset + last_width) {
-            for (auto interval : point_rev_deps) {
-              for (long dep = interval.first; dep <= interval.second; dep++) {
-                if (dep < offset || dep >= offset + width || (first_point <= dep && dep <= last_point)) {
+            for (size_t span = 0; span < n_point_rev_deps; ++span) {
+              for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+                if (dep < offset || dep >= offset + width || rank_by_point[dep] == rank) {
                   continue;
                 }
 
-                int from = tag_bits_by_point[point];
-                int to = tag_bits_by_point[dep];
-                int tag = (from << 8) | to;
+                int tag = graph_tags.tag(point, dep);
                 MPI_Request req;
-                MPI_Isend(point_output.data(), point_output.size(), MPI_BYTE,
-                          rank_by_point[dep], tag, MPI_COMM_WORLD, &req);
+                MPI_Isend(outputs.slot(timestep-1, point),
+                          header_bytes + graph.output_bytes_at(timestep-1, point), MPI_BYTE,
+                          rank_by_point[dep], tag, graph_tags.comm, &req);
                 requests.push_back(req);
               }
             }
@@ -198,16 +484,33 @@ int main(int argc, char *argv[])
 
         MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
 
-        for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
-          long point_index = point - first_point;
+        for (long point_index = 0; point_index < n_points; ++point_index) {
+          long point = points[point_index];
+          if (point < offset || point >= offset + width) {
+            continue;
+          }
 
           auto &point_input_ptr = input_ptr[point_index];
           auto &point_input_bytes = input_bytes[point_index];
           auto &point_n_inputs = n_inputs[point_index];
-          auto &point_output = outputs[point_index];
+          char *point_output = outputs.slot(timestep, point);
+
+          if (header_bytes > 0) {
+            for (long input = 0; input < point_n_inputs; ++input) {
+              graph_tags.check_header(point_input_ptr[input] - header_bytes, input_points[point_index][input]);
+            }
+            graph_tags.write_header(point_output, point);
+          }
+
+          if (TaskGraph::measuring_transfer()) {
+            for (long input = 0; input < point_n_inputs; ++input) {
+              remote[input] = rank_by_point[input_points[point_index][input]] != rank;
+            }
+            TaskGraph::tag_remote_inputs(remote.data(), point_n_inputs);
+          }
 
           graph.execute_point(timestep, point,
-                              point_output.data(), point_output.size(),
+                              point_output + header_bytes, graph.output_bytes_at(timestep, point),
                               point_input_ptr.data(), point_input_bytes.data(), point_n_inputs,
                               scratch_ptr + scratch_bytes * point_index, scratch_bytes);
         }
@@ -217,11 +520,39 @@ int main(int argc, char *argv[])
     MPI_Barrier(MPI_COMM_WORLD);
 
     double stop_time = MPI_Wtime();
-    elapsed_time = stop_time - start_time;
+    return stop_time - start_time;
+  };
+
+  // One untimed warm-up run by default.
+  app.execute_timed(run, rank == 0, 1);
+
+#ifdef USE_GPU_KERNEL
+  if (use_gpu) {
+    // Messages and bytes are summed over ranks, and rank 0 reports the
+    // slowest rank's exchange time.
+    long counts[2] = {transfers.messages, transfers.bytes};
+    long total_counts[2];
+    double max_time;
+    MPI_Reduce(counts, total_counts, 2, MPI_LONG, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&transfers.time, &max_time, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    if (rank == 0) {
+      printf("GPU Transfers (%s): %ld dependencies, %ld bytes, %e s, %e B/s, %e s per dependency\n",
+             gpu_direct ? "direct" : "staged", total_counts[0], total_counts[1], max_time,
+             max_time > 0 ? total_counts[1] / max_time : 0.0,
+             total_counts[0] > 0 ? max_time / total_counts[0] : 0.0);
+    }
+    for (auto &state : gpu_states) {
+      free_gpu_state(state);
+    }
+  }
+#endif
+
+  for (auto scratch_ptr : scratch) {
+    TaskGraph::free_scratch(scratch_ptr);
   }
 
-  if (rank == 0) {
-    app.report_timing(elapsed_time);
+  for (auto &graph_tags : tags) {
+    free_message_tags(graph_tags);
   }
 
   MPI_Finalize();
@@ -0,0 +1,279 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+#include "core.h"
+#include "alloc.h"
+#include "placement.h"
+
+#include "mpi.h"
+#include "comm_pattern.h"
+#include "message_tags.h"
+
+// Like nonblock, but the sends and receives of a timestep are persistent
+// requests (MPI_Send_init/MPI_Recv_init), created once per communication
+// pattern before the timed loop and only started and waited on per
+// timestep.
+//
+// Requests are bound to fixed buffers (see comm_pattern.h for patterns),
+// so every message carries max_output_bytes() and tasks see only the
+// bytes of their producer.
+
+struct Pattern {
+  std::vector<MPI_Request> requests;
+  // Per local point, the producer of each input, in input order.
+  std::vector<std::vector<long> > input_points;
+};
+
+struct GraphState {
+  long first_point, last_point;
+  // Per local point, one receive buffer per input slot.
+  std::vector<std::vector<std::vector<char> > > inputs;
+  std::vector<std::vector<const char *> > input_ptr;
+  std::vector<std::vector<size_t> > input_bytes;
+  std::vector<std::vector<char> > outputs;
+  std::map<PatternKey, Pattern> patterns;
+};
+
+static void create_pattern(const TaskGraph &graph, const MessageTags &tags,
+                           GraphState &state, const PatternKey &key, Pattern &pattern)
+{
+  long dset, offset, width, last_offset, last_width;
+  std::tie(dset, offset, width, last_offset, last_width) = key;
+
+  const DependencyTable *table = graph.dependency_table();
+  size_t message_bytes = tags.header_bytes + graph.max_output_bytes();
+
+  pattern.input_points = pattern_input_points(graph, key, state.first_point, state.last_point);
+  for (long point = state.first_point; point <= state.last_point; ++point) {
+    long point_index = point - state.first_point;
+    auto &point_inputs = state.inputs[point_index];
+    auto &point_input_points = pattern.input_points[point_index];
+
+    size_t n_point_rev_deps;
+    const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
+
+    /* Receive */
+    for (size_t slot = 0; slot < point_input_points.size(); ++slot) {
+      long dep = point_input_points[slot];
+      // On-node data is copied at the start of the timestep.
+      if (dep < state.first_point || dep > state.last_point) {
+        MPI_Request req;
+        MPI_Recv_init(point_inputs[slot].data(), message_bytes, MPI_BYTE,
+                      tags.rank_by_point[dep], tags.tag(dep, point), tags.comm, &req);
+        pattern.requests.push_back(req);
+      }
+    }
+
+    /* Send */
+    if (point >= last_offset && point < last_offset + last_width) {
+      for (size_t span = 0; span < n_point_rev_deps; ++span) {
+        for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+          if (dep < offset || dep >= offset + width ||
+              (state.first_point <= dep && dep <= state.last_point)) {
+            continue;
+          }
+
+          MPI_Request req;
+          MPI_Send_init(state.outputs[point_index].data(), message_bytes, MPI_BYTE,
+                        tags.rank_by_point[dep], tags.tag(point, dep), tags.comm, &req);
+          pattern.requests.push_back(req);
+        }
+      }
+    }
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int n_ranks, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  App app(argc, argv);
+  placement_require_block("mpi/persistent");
+  if (rank == 0) app.display();
+
+  std::vector<char *> scratch;
+  std::vector<MessageTags> tags;
+  std::vector<GraphState> states(app.graphs.size());
+  for (auto graph : app.graphs) {
+    long first_point = rank * graph.max_width / n_ranks;
+    long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
+    long n_points = last_point - first_point + 1;
+
+    size_t scratch_bytes = graph.scratch_bytes_per_task;
+    scratch.push_back(TaskGraph::allocate_scratch(scratch_bytes, n_points, numa_current_node()));
+
+    tags.push_back(make_message_tags(graph, n_ranks));
+    const MessageTags &graph_tags = tags.back();
+    size_t message_bytes = graph_tags.header_bytes + graph.max_output_bytes();
+
+    const DependencyTable *table = graph.dependency_table();
+    assert(table != NULL);
+
+    long max_deps = 0;
+    for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
+      for (long point = first_point; point <= last_point; ++point) {
+        long deps = 0;
+        size_t n_intervals;
+        const std::pair<long, long> *intervals = table->dependencies(dset, point, n_intervals);
+        for (size_t span = 0; span < n_intervals; ++span) {
+          deps += intervals[span].second - intervals[span].first + 1;
+        }
+        max_deps = std::max(max_deps, deps);
+      }
+    }
+
+    // Create input and output buffers.
+    GraphState &state = states[graph.graph_index];
+    state.first_point = first_point;
+    state.last_point = last_point;
+    state.inputs.resize(n_points);
+    state.input_ptr.resize(n_points);
+    state.input_bytes.resize(n_points);
+    state.outputs.resize(n_points);
+    for (long point_index = 0; point_index < n_points; ++point_index) {
+      state.inputs[point_index].resize(max_deps);
+      for (auto &input : state.inputs[point_index]) {
+        input.resize(message_bytes);
+      }
+      state.input_ptr[point_index].resize(max_deps);
+      state.input_bytes[point_index].resize(max_deps);
+      state.outputs[point_index].resize(message_bytes);
+    }
+
+    for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+      PatternKey key = pattern_key(graph, timestep);
+      if (!state.patterns.count(key)) {
+        create_pattern(graph, graph_tags, state, key, state.patterns[key]);
+      }
+    }
+  }
+
+  auto run = [&] {
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double start_time = MPI_Wtime();
+    app.start_arrivals();
+
+    for (auto graph : app.graphs) {
+      GraphState &state = states[graph.graph_index];
+      const MessageTags &graph_tags = tags[graph.graph_index];
+      size_t header_bytes = graph_tags.header_bytes;
+
+      long first_point = state.first_point;
+      long last_point = state.last_point;
+
+      size_t scratch_bytes = graph.scratch_bytes_per_task;
+      char *scratch_ptr = scratch[graph.graph_index];
+
+      for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+        graph.wait_for_release(timestep);
+
+        long offset = graph.offset_at_timestep(timestep);
+        long width = graph.width_at_timestep(timestep);
+
+        Pattern &pattern = state.patterns.at(pattern_key(graph, timestep));
+
+        // MPI_Startall may start requests in any order, which only
+        // matters when tags do not identify the sending point.
+        if (header_bytes > 0) {
+          for (auto &req : pattern.requests) {
+            MPI_Start(&req);
+          }
+        } else if (!pattern.requests.empty()) {
+          MPI_Startall(pattern.requests.size(), pattern.requests.data());
+        }
+
+        for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
+          long point_index = point - first_point;
+          auto &point_input_points = pattern.input_points[point_index];
+          for (size_t input = 0; input < point_input_points.size(); ++input) {
+            long dep = point_input_points[input];
+            // Use shared memory for on-node data.
+            if (first_point <= dep && dep <= last_point) {
+              auto &output = state.outputs[dep - first_point];
+              memcpy(state.inputs[point_index][input].data(), output.data(), output.size());
+            }
+          }
+        }
+
+        MPI_Waitall(pattern.requests.size(), pattern.requests.data(), MPI_STATUSES_IGNORE);
+
+        for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
+          long point_index = point - first_point;
+
+          auto &point_inputs = state.inputs[point_index];
+          auto &point_input_ptr = state.input_ptr[point_index];
+          auto &point_input_bytes = state.input_bytes[point_index];
+          auto &point_input_points = pattern.input_points[point_index];
+          auto &point_output = state.outputs[point_index];
+          long point_n_inputs = point_input_points.size();
+
+          for (long input = 0; input < point_n_inputs; ++input) {
+            long dep = point_input_points[input];
+            if (header_bytes > 0) {
+              graph_tags.check_header(point_inputs[input].data(), dep);
+            }
+            point_input_ptr[input] = point_inputs[input].data() + header_bytes;
+            point_input_bytes[input] = graph.output_bytes_at(timestep-1, dep);
+          }
+          if (header_bytes > 0) {
+            graph_tags.write_header(point_output.data(), point);
+          }
+
+          graph.execute_point(timestep, point,
+                              point_output.data() + header_bytes, graph.output_bytes_at(timestep, point),
+                              point_input_ptr.data(), point_input_bytes.data(), point_n_inputs,
+                              scratch_ptr + scratch_bytes * point_index, scratch_bytes);
+        }
+      }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double stop_time = MPI_Wtime();
+    return stop_time - start_time;
+  };
+
+  // One untimed warm-up run by default.
+  app.execute_timed(run, rank == 0, 1);
+
+  for (auto &state : states) {
+    for (auto &pattern : state.patterns) {
+      for (auto &req : pattern.second.requests) {
+        MPI_Request_free(&req);
+      }
+    }
+  }
+
+  for (auto scratch_ptr : scratch) {
+    TaskGraph::free_scratch(scratch_ptr);
+  }
+
+  for (auto &graph_tags : tags) {
+    free_message_tags(graph_tags);
+  }
+
+  MPI_Finalize();
+}
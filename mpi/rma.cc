@@ -0,0 +1,312 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <tuple>
+
+#include "core.h"
+#include "alloc.h"
+#include "placement.h"
+
+#include "mpi.h"
+#include "comm_pattern.h"
+
+// One-sided variant of nonblock. Every rank exposes the input slots of
+// its points in a window, and producers MPI_Put their outputs straight
+// into the slots of their consumers. A timestep is one
+// post-start-complete-wait epoch, between the ranks that put into each
+// other in that timestep.
+//
+// Window layout: max_deps slots of max_output_bytes() per local point.
+// Which slot a producer writes depends on the points active in a
+// timestep and its predecessor, so, as in persistent, the puts and
+// groups are computed once per pattern (comm_pattern.h) before the timed
+// loop.
+
+struct Put {
+  long point_index; // local producer
+  int rank;
+  MPI_Aint displacement;
+};
+
+struct Pattern {
+  std::vector<Put> puts;
+  // Per local point, the producer of each input, in input order.
+  std::vector<std::vector<long> > input_points;
+  MPI_Group origins; // ranks putting into this one
+  MPI_Group targets; // ranks this one puts into
+};
+
+struct GraphState {
+  long first_point, last_point;
+  long max_deps;
+  size_t slot_bytes;
+  MPI_Win win;
+  char *slots;
+  std::vector<std::vector<const char *> > input_ptr;
+  std::vector<std::vector<size_t> > input_bytes;
+  std::vector<std::vector<char> > outputs;
+  std::vector<int> rank_by_point;
+  std::vector<long> first_point_by_rank;
+  std::map<PatternKey, Pattern> patterns;
+};
+
+static MPI_Group make_group(MPI_Group world, const std::set<int> &ranks)
+{
+  std::vector<int> members(ranks.begin(), ranks.end());
+  MPI_Group group;
+  MPI_Group_incl(world, members.size(), members.data(), &group);
+  return group;
+}
+
+static void create_pattern(const TaskGraph &graph, MPI_Group world,
+                           const GraphState &state, const PatternKey &key, Pattern &pattern)
+{
+  long dset, offset, width, last_offset, last_width;
+  std::tie(dset, offset, width, last_offset, last_width) = key;
+
+  const DependencyTable *table = graph.dependency_table();
+  std::set<int> origins, targets;
+
+  pattern.input_points = pattern_input_points(graph, key, state.first_point, state.last_point);
+  for (long point = state.first_point; point <= state.last_point; ++point) {
+    long point_index = point - state.first_point;
+
+    /* Inputs */
+    for (long dep : pattern.input_points[point_index]) {
+      if (dep < state.first_point || dep > state.last_point) {
+        origins.insert(state.rank_by_point[dep]);
+      }
+    }
+
+    /* Puts */
+    if (point >= last_offset && point < last_offset + last_width) {
+      size_t n_point_rev_deps;
+      const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
+      for (size_t span = 0; span < n_point_rev_deps; ++span) {
+        for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+          if (dep < offset || dep >= offset + width ||
+              (state.first_point <= dep && dep <= state.last_point)) {
+            continue;
+          }
+
+          long slot = pattern_input_slot(graph, key, dep, point);
+          int target = state.rank_by_point[dep];
+          long target_index = dep - state.first_point_by_rank[target];
+          Put put = {point_index, target,
+                     (MPI_Aint)((target_index * state.max_deps + slot) * state.slot_bytes)};
+          pattern.puts.push_back(put);
+          targets.insert(target);
+        }
+      }
+    }
+  }
+
+  pattern.origins = make_group(world, origins);
+  pattern.targets = make_group(world, targets);
+}
+
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int n_ranks, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  App app(argc, argv);
+  placement_require_block("mpi/rma");
+  if (rank == 0) app.display();
+
+  MPI_Group world;
+  MPI_Comm_group(MPI_COMM_WORLD, &world);
+
+  std::vector<char *> scratch;
+  std::vector<GraphState> states(app.graphs.size());
+  for (auto graph : app.graphs) {
+    long first_point = rank * graph.max_width / n_ranks;
+    long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
+    long n_points = last_point - first_point + 1;
+
+    size_t scratch_bytes = graph.scratch_bytes_per_task;
+    scratch.push_back(TaskGraph::allocate_scratch(scratch_bytes, n_points, numa_current_node()));
+
+    GraphState &state = states[graph.graph_index];
+    state.first_point = first_point;
+    state.last_point = last_point;
+    state.rank_by_point.resize(graph.max_width);
+    state.first_point_by_rank.resize(n_ranks);
+    for (int r = 0; r < n_ranks; ++r) {
+      long r_first_point = r * graph.max_width / n_ranks;
+      long r_last_point = (r + 1) * graph.max_width / n_ranks - 1;
+      state.first_point_by_rank[r] = r_first_point;
+      for (long p = r_first_point; p <= r_last_point; ++p) {
+        state.rank_by_point[p] = r;
+      }
+    }
+
+    const DependencyTable *table = graph.dependency_table();
+    assert(table != NULL);
+
+    // Producers compute slots on other ranks, so the layout uses the
+    // maximum over all points.
+    long max_deps = 0;
+    for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
+      for (long point = 0; point < graph.max_width; ++point) {
+        long deps = 0;
+        size_t n_intervals;
+        const std::pair<long, long> *intervals = table->dependencies(dset, point, n_intervals);
+        for (size_t span = 0; span < n_intervals; ++span) {
+          deps += intervals[span].second - intervals[span].first + 1;
+        }
+        max_deps = std::max(max_deps, deps);
+      }
+    }
+    state.max_deps = max_deps;
+    state.slot_bytes = graph.max_output_bytes();
+
+    MPI_Win_allocate(n_points * max_deps * state.slot_bytes, 1, MPI_INFO_NULL, MPI_COMM_WORLD,
+                     &state.slots, &state.win);
+
+    state.input_ptr.resize(n_points);
+    state.input_bytes.resize(n_points);
+    state.outputs.resize(n_points);
+    for (long point_index = 0; point_index < n_points; ++point_index) {
+      state.input_ptr[point_index].resize(max_deps);
+      state.input_bytes[point_index].resize(max_deps);
+      for (long slot = 0; slot < max_deps; ++slot) {
+        state.input_ptr[point_index][slot] = state.slots + (point_index * max_deps + slot) * state.slot_bytes;
+      }
+      state.outputs[point_index].resize(state.slot_bytes);
+    }
+
+    for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+      PatternKey key = pattern_key(graph, timestep);
+      if (!state.patterns.count(key)) {
+        create_pattern(graph, world, state, key, state.patterns[key]);
+      }
+    }
+  }
+
+  auto run = [&] {
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double start_time = MPI_Wtime();
+    app.start_arrivals();
+
+    for (auto graph : app.graphs) {
+      GraphState &state = states[graph.graph_index];
+
+      long first_point = state.first_point;
+      long last_point = state.last_point;
+
+      size_t scratch_bytes = graph.scratch_bytes_per_task;
+      char *scratch_ptr = scratch[graph.graph_index];
+
+      for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+        graph.wait_for_release(timestep);
+
+        long offset = graph.offset_at_timestep(timestep);
+        long width = graph.width_at_timestep(timestep);
+
+        Pattern &pattern = state.patterns.at(pattern_key(graph, timestep));
+
+        // Groups are empty when no rank puts into this one (or the
+        // other way around), and then there is no epoch to open.
+        if (pattern.origins != MPI_GROUP_EMPTY) {
+          MPI_Win_post(pattern.origins, 0, state.win);
+        }
+        if (pattern.targets != MPI_GROUP_EMPTY) {
+          MPI_Win_start(pattern.targets, 0, state.win);
+          for (auto &put : pattern.puts) {
+            long point = first_point + put.point_index;
+            MPI_Put(state.outputs[put.point_index].data(), graph.output_bytes_at(timestep-1, point), MPI_BYTE,
+                    put.rank, put.displacement, graph.output_bytes_at(timestep-1, point), MPI_BYTE,
+                    state.win);
+          }
+          MPI_Win_complete(state.win);
+        }
+
+        // Use shared memory for on-node data.
+        for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
+          long point_index = point - first_point;
+          auto &point_input_points = pattern.input_points[point_index];
+          for (size_t slot = 0; slot < point_input_points.size(); ++slot) {
+            long dep = point_input_points[slot];
+            if (first_point <= dep && dep <= last_point) {
+              memcpy(const_cast<char *>(state.input_ptr[point_index][slot]),
+                     state.outputs[dep - first_point].data(),
+                     graph.output_bytes_at(timestep-1, dep));
+            }
+          }
+        }
+
+        if (pattern.origins != MPI_GROUP_EMPTY) {
+          MPI_Win_wait(state.win);
+        }
+
+        for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
+          long point_index = point - first_point;
+
+          auto &point_input_ptr = state.input_ptr[point_index];
+          auto &point_input_bytes = state.input_bytes[point_index];
+          auto &point_input_points = pattern.input_points[point_index];
+          auto &point_output = state.outputs[point_index];
+          long point_n_inputs = point_input_points.size();
+
+          for (long slot = 0; slot < point_n_inputs; ++slot) {
+            point_input_bytes[slot] = graph.output_bytes_at(timestep-1, point_input_points[slot]);
+          }
+
+          graph.execute_point(timestep, point,
+                              point_output.data(), graph.output_bytes_at(timestep, point),
+                              point_input_ptr.data(), point_input_bytes.data(), point_n_inputs,
+                              scratch_ptr + scratch_bytes * point_index, scratch_bytes);
+        }
+      }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double stop_time = MPI_Wtime();
+    return stop_time - start_time;
+  };
+
+  // One untimed warm-up run by default.
+  app.execute_timed(run, rank == 0, 1);
+
+  for (auto &state : states) {
+    for (auto &pattern : state.patterns) {
+      if (pattern.second.origins != MPI_GROUP_EMPTY) {
+        MPI_Group_free(&pattern.second.origins);
+      }
+      if (pattern.second.targets != MPI_GROUP_EMPTY) {
+        MPI_Group_free(&pattern.second.targets);
+      }
+    }
+    MPI_Win_free(&state.win);
+  }
+  MPI_Group_free(&world);
+
+  for (auto scratch_ptr : scratch) {
+    TaskGraph::free_scratch(scratch_ptr);
+  }
+
+  MPI_Finalize();
+}
@@ -0,0 +1,363 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+
+#include <sched.h>
+
+#include "core.h"
+#include "alloc.h"
+#include "placement.h"
+
+#include "mpi.h"
+#include "message_tags.h"
+
+// Variant of nonblock where ranks on one node (MPI_COMM_TYPE_SHARED)
+// exchange nothing: outputs live in an MPI_Win_allocate_shared segment
+// and consumers on the node pass pointers into it to execute_point. Only
+// off-node dependencies use messages.
+//
+// Outputs are double buffered by timestep, and every point publishes the
+// number of steps it has completed in a shared flag. A consumer waits for
+// the flags of its producers, and a producer waits for the flags of the
+// consumers that read the buffer it is about to overwrite.
+
+struct SharedState {
+  MPI_Win output_win, flag_win;
+  size_t slot_bytes;
+  // By rank, or NULL for ranks on other nodes.
+  std::vector<char *> outputs;
+  std::vector<long *> flags;
+  std::vector<long> first_point_by_rank;
+};
+
+// Slot of point for timestep (two per point).
+static char *output_slot(const SharedState &state, const MessageTags &tags, long point, long timestep)
+{
+  int r = tags.rank_by_point[point];
+  long point_index = point - state.first_point_by_rank[r];
+  return state.outputs[r] + (2 * point_index + (timestep & 1)) * state.slot_bytes;
+}
+
+static long *point_flag(const SharedState &state, const MessageTags &tags, long point)
+{
+  int r = tags.rank_by_point[point];
+  return state.flags[r] + (point - state.first_point_by_rank[r]);
+}
+
+// Yields so that oversubscribed ranks let their producers run.
+static void wait_for_flag(const long *flag, long value)
+{
+  while (__atomic_load_n(flag, __ATOMIC_ACQUIRE) < value) {
+    sched_yield();
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  MPI_Init(&argc, &argv);
+  int n_ranks, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  MPI_Comm node_comm;
+  MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node_comm);
+
+  // Nodes are numbered by their first rank.
+  int node_leader = rank;
+  MPI_Bcast(&node_leader, 1, MPI_INT, 0, node_comm);
+  std::vector<int> leader_by_rank(n_ranks);
+  MPI_Allgather(&node_leader, 1, MPI_INT, leader_by_rank.data(), 1, MPI_INT, MPI_COMM_WORLD);
+  long n_nodes = 0;
+  for (int r = 0; r < n_ranks; ++r) {
+    n_nodes += leader_by_rank[r] == r;
+  }
+
+  App app(argc, argv);
+  placement_require_block("mpi/shared");
+  // Report the traffic of the nodes that actually ran.
+  if (app.nodes == 0) {
+    app.nodes = n_nodes;
+  }
+  if (rank == 0) app.display();
+
+  std::vector<char *> scratch;
+  std::vector<MessageTags> tags;
+  std::vector<SharedState> states(app.graphs.size());
+  for (auto graph : app.graphs) {
+    long first_point = rank * graph.max_width / n_ranks;
+    long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
+    long n_points = last_point - first_point + 1;
+
+    size_t scratch_bytes = graph.scratch_bytes_per_task;
+    scratch.push_back(TaskGraph::allocate_scratch(scratch_bytes, n_points, numa_current_node()));
+
+    tags.push_back(make_message_tags(graph, n_ranks));
+
+    SharedState &state = states[graph.graph_index];
+    state.slot_bytes = tags.back().header_bytes + graph.max_output_bytes();
+    // Keep slots aligned for the kernels.
+    state.slot_bytes = (state.slot_bytes + 63) / 64 * 64;
+    state.first_point_by_rank.resize(n_ranks);
+    for (int r = 0; r < n_ranks; ++r) {
+      state.first_point_by_rank[r] = r * graph.max_width / n_ranks;
+    }
+
+    char *output_base;
+    long *flag_base;
+    MPI_Win_allocate_shared(2 * n_points * state.slot_bytes, 1, MPI_INFO_NULL, node_comm,
+                            &output_base, &state.output_win);
+    MPI_Win_allocate_shared(n_points * sizeof(long), sizeof(long), MPI_INFO_NULL, node_comm,
+                            &flag_base, &state.flag_win);
+    for (long point_index = 0; point_index < n_points; ++point_index) {
+      flag_base[point_index] = 0;
+    }
+
+    state.outputs.assign(n_ranks, NULL);
+    state.flags.assign(n_ranks, NULL);
+    for (int r = 0; r < n_ranks; ++r) {
+      if (leader_by_rank[r] != node_leader) {
+        continue;
+      }
+      // Ranks of the node are ordered by world rank in node_comm.
+      int peer = 0;
+      for (int n = 0; n < r; ++n) {
+        peer += leader_by_rank[n] == node_leader;
+      }
+      MPI_Aint bytes;
+      int disp_unit;
+      MPI_Win_shared_query(state.output_win, peer, &bytes, &disp_unit, &state.outputs[r]);
+      MPI_Win_shared_query(state.flag_win, peer, &bytes, &disp_unit, &state.flags[r]);
+    }
+    // Shared memory is accessed with loads and stores in one passive
+    // epoch; flags are synchronized with atomics.
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, state.output_win);
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, state.flag_win);
+  }
+  MPI_Barrier(MPI_COMM_WORLD);
+
+  // Flags count steps over all runs, so they never go back.
+  std::vector<long> steps_done(app.graphs.size(), 0);
+
+  auto run = [&] {
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double start_time = MPI_Wtime();
+    app.start_arrivals();
+
+    std::vector<MPI_Request> requests;
+
+    for (auto graph : app.graphs) {
+      long first_point = rank * graph.max_width / n_ranks;
+      long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
+      long n_points = last_point - first_point + 1;
+
+      size_t scratch_bytes = graph.scratch_bytes_per_task;
+      char *scratch_ptr = scratch[graph.graph_index];
+
+      const SharedState &state = states[graph.graph_index];
+      const MessageTags &graph_tags = tags[graph.graph_index];
+      const std::vector<int> &rank_by_point = graph_tags.rank_by_point;
+      size_t header_bytes = graph_tags.header_bytes;
+
+      long base = steps_done[graph.graph_index];
+
+      const DependencyTable *table = graph.dependency_table();
+      assert(table != NULL);
+
+      long max_deps = 0;
+      for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
+        for (long point = first_point; point <= last_point; ++point) {
+          long deps = 0;
+          size_t n_intervals;
+          const std::pair<long, long> *intervals = table->dependencies(dset, point, n_intervals);
+          for (size_t span = 0; span < n_intervals; ++span) {
+            deps += intervals[span].second - intervals[span].first + 1;
+          }
+          max_deps = std::max(max_deps, deps);
+        }
+      }
+
+      // Receive buffers for off-node inputs.
+      std::vector<std::vector<std::vector<char> > > inputs(n_points);
+      std::vector<std::vector<const char *> > input_ptr(n_points);
+      std::vector<std::vector<size_t> > input_bytes(n_points);
+      std::vector<std::vector<long> > input_points(n_points);
+      std::vector<long> n_inputs(n_points);
+      for (long point_index = 0; point_index < n_points; ++point_index) {
+        inputs[point_index].resize(max_deps);
+        for (auto &input : inputs[point_index]) {
+          input.resize(state.slot_bytes);
+        }
+        input_ptr[point_index].resize(max_deps);
+        input_bytes[point_index].resize(max_deps);
+        input_points[point_index].resize(max_deps);
+      }
+
+      auto on_node = [&](long point) { return state.outputs[rank_by_point[point]] != NULL; };
+
+      for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+        graph.wait_for_release(timestep);
+
+        long offset = graph.offset_at_timestep(timestep);
+        long width = graph.width_at_timestep(timestep);
+
+        long last_offset = graph.offset_at_timestep(timestep-1);
+        long last_width = graph.width_at_timestep(timestep-1);
+
+        long dset = graph.dependence_set_at_timestep(timestep);
+
+        requests.clear();
+
+        for (long point = first_point; point <= last_point; ++point) {
+          long point_index = point - first_point;
+
+          auto &point_inputs = inputs[point_index];
+          auto &point_n_inputs = n_inputs[point_index];
+          auto &point_input_ptr = input_ptr[point_index];
+          auto &point_input_bytes = input_bytes[point_index];
+
+          size_t n_point_deps, n_point_rev_deps;
+          const std::pair<long, long> *point_deps = table->dependencies(dset, point, n_point_deps);
+          const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
+
+          /* Receive */
+          point_n_inputs = 0;
+          if (point >= offset && point < offset + width) {
+            for (size_t span = 0; span < n_point_deps; ++span) {
+              for (long dep = point_deps[span].first; dep <= point_deps[span].second; ++dep) {
+                if (dep < last_offset || dep >= last_offset + last_width) {
+                  continue;
+                }
+
+                if (on_node(dep)) {
+                  point_input_ptr[point_n_inputs] = output_slot(state, graph_tags, dep, timestep-1) + header_bytes;
+                } else {
+                  MPI_Request req;
+                  MPI_Irecv(point_inputs[point_n_inputs].data(),
+                            header_bytes + graph.output_bytes_at(timestep-1, dep), MPI_BYTE,
+                            rank_by_point[dep], graph_tags.tag(dep, point), graph_tags.comm, &req);
+                  requests.push_back(req);
+                  point_input_ptr[point_n_inputs] = point_inputs[point_n_inputs].data() + header_bytes;
+                }
+                point_input_bytes[point_n_inputs] = graph.output_bytes_at(timestep-1, dep);
+                input_points[point_index][point_n_inputs] = dep;
+                point_n_inputs++;
+              }
+            }
+          }
+
+          /* Send */
+          if (point >= last_offset && point < last_offset + last_width) {
+            for (size_t span = 0; span < n_point_rev_deps; ++span) {
+              for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+                if (dep < offset || dep >= offset + width || on_node(dep)) {
+                  continue;
+                }
+
+                MPI_Request req;
+                MPI_Isend(output_slot(state, graph_tags, point, timestep-1),
+                          header_bytes + graph.output_bytes_at(timestep-1, point), MPI_BYTE,
+                          rank_by_point[dep], graph_tags.tag(point, dep), graph_tags.comm, &req);
+                requests.push_back(req);
+              }
+            }
+          }
+        }
+
+        MPI_Waitall(requests.size(), requests.data(), MPI_STATUSES_IGNORE);
+
+        long last_dset = graph.dependence_set_at_timestep(timestep-1);
+        long last_last_offset = graph.offset_at_timestep(timestep-2);
+        long last_last_width = graph.width_at_timestep(timestep-2);
+
+        for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
+          long point_index = point - first_point;
+
+          // Producers on the node have finished the previous timestep.
+          for (long input = 0; input < n_inputs[point_index]; ++input) {
+            long dep = input_points[point_index][input];
+            if (on_node(dep)) {
+              wait_for_flag(point_flag(state, graph_tags, dep), base + timestep);
+            }
+          }
+
+          // Consumers on the node have read the output of two timesteps
+          // ago, which this one overwrites.
+          if (point >= last_last_offset && point < last_last_offset + last_last_width) {
+            size_t n_point_rev_deps;
+            const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(last_dset, point, n_point_rev_deps);
+            for (size_t span = 0; span < n_point_rev_deps; ++span) {
+              for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+                if (dep >= last_offset && dep < last_offset + last_width && on_node(dep)) {
+                  wait_for_flag(point_flag(state, graph_tags, dep), base + timestep);
+                }
+              }
+            }
+          }
+
+          char *point_output = output_slot(state, graph_tags, point, timestep);
+          if (header_bytes > 0) {
+            for (long input = 0; input < n_inputs[point_index]; ++input) {
+              long dep = input_points[point_index][input];
+              if (!on_node(dep)) {
+                graph_tags.check_header(input_ptr[point_index][input] - header_bytes, dep);
+              }
+            }
+            graph_tags.write_header(point_output, point);
+          }
+
+          graph.execute_point(timestep, point,
+                              point_output + header_bytes, graph.output_bytes_at(timestep, point),
+                              input_ptr[point_index].data(), input_bytes[point_index].data(), n_inputs[point_index],
+                              scratch_ptr + scratch_bytes * point_index, scratch_bytes);
+
+          __atomic_store_n(point_flag(state, graph_tags, point), base + timestep + 1, __ATOMIC_RELEASE);
+        }
+      }
+
+      steps_done[graph.graph_index] += graph.timesteps;
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double stop_time = MPI_Wtime();
+    return stop_time - start_time;
+  };
+
+  // One untimed warm-up run by default.
+  app.execute_timed(run, rank == 0, 1);
+
+  for (auto &state : states) {
+    MPI_Win_unlock_all(state.output_win);
+    MPI_Win_unlock_all(state.flag_win);
+    MPI_Win_free(&state.output_win);
+    MPI_Win_free(&state.flag_win);
+  }
+
+  for (auto scratch_ptr : scratch) {
+    TaskGraph::free_scratch(scratch_ptr);
+  }
+
+  for (auto &graph_tags : tags) {
+    free_message_tags(graph_tags);
+  }
+
+  MPI_Comm_free(&node_comm);
+
+  MPI_Finalize();
+}
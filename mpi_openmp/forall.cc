@@ -19,25 +19,11 @@
 #include <iostream>
 
 #include "core.h"
+#include "alloc.h"
+#include "placement.h"
 
 #include "mpi.h"
-
-size_t findmax(size_t** A, int n, int m)
-{
-    size_t max_value = A[0][0];
-    for (int i = 0; i < n; i++)
-    {
-         for (int j = 0; j < m; j++)
-         {
-             if (A[i][j] > max_value)
-             {
-                 max_value = A[i][j];
-             }
-         }
-     //printf("max value: %ld", max);
-    }
-    return max_value;
-}
+#include "message_tags.h"
 
 int main(int argc, char *argv[])
 {
@@ -47,18 +33,21 @@ int main(int argc, char *argv[])
   MPI_Comm_rank(MPI_COMM_WORLD, &rank);
 
   App app(argc, argv);
+  placement_require_block("mpi_openmp/forall");
   if (rank == 0) app.display();
 
-  std::vector<std::vector<char> > scratch;
+  std::vector<char *> scratch;
   for (auto graph : app.graphs) {
     long first_point = rank * graph.max_width / n_ranks;
     long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
     long n_points = last_point - first_point + 1;
 
     size_t scratch_bytes = graph.scratch_bytes_per_task;
-    scratch.emplace_back(scratch_bytes * n_points);
+    // Pages are first touched by the threads, and in the schedule, that
+    // execute the points.
+    scratch.push_back(alloc_buffer(scratch_bytes * n_points, -1));
 
-    char *scratch_ptr = scratch.back().data();
+    char *scratch_ptr = scratch.back();
 
     #pragma omp parallel for schedule(runtime)
     for (long point = first_point; point <= last_point; ++point) {
@@ -67,11 +56,16 @@ int main(int argc, char *argv[])
     }
   }
 
-  double elapsed_time = 0.0;
-  for (int iter = 0; iter < 2; ++iter) {
+  std::vector<MessageTags> tags;
+  for (auto graph : app.graphs) {
+    tags.push_back(make_message_tags(graph, n_ranks));
+  }
+
+  auto run = [&] {
     MPI_Barrier(MPI_COMM_WORLD);
 
     double start_time = MPI_Wtime();
+    app.start_arrivals();
 
     std::vector<MPI_Request> requests;
 
@@ -79,32 +73,27 @@ int main(int argc, char *argv[])
       long first_point = rank * graph.max_width / n_ranks;
       long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
       long n_points = last_point - first_point + 1;
-      size_t max_outputbytes = findmax(graph.output_bytes_size,graph.timesteps, graph.max_width);
+      size_t max_outputbytes = graph.max_output_bytes();
 
 
       size_t scratch_bytes = graph.scratch_bytes_per_task;
-      char *scratch_ptr = scratch[graph.graph_index].data();
-
-      std::vector<int> rank_by_point(graph.max_width);
-      std::vector<int> tag_bits_by_point(graph.max_width);
-      for (int r = 0; r < n_ranks; ++r) {
-        long r_first_point = r * graph.max_width / n_ranks;
-        long r_last_point = (r + 1) * graph.max_width / n_ranks - 1;
-        for (long p = r_first_point; p <= r_last_point; ++p) {
-          rank_by_point[p] = r;
-          tag_bits_by_point[p] = p - r_first_point;
-          // Has to fit in 7 bits because MPI only guarrantees that
-          // tags can use 15 bits.
-          assert((tag_bits_by_point[p] & ~0x7F) == 0);
-        }
-      }
+      char *scratch_ptr = scratch[graph.graph_index];
+
+      const MessageTags &graph_tags = tags[graph.graph_index];
+      const std::vector<int> &rank_by_point = graph_tags.rank_by_point;
+      size_t header_bytes = graph_tags.header_bytes;
+
+      const DependencyTable *table = graph.dependency_table();
+      assert(table != NULL);
 
       long max_deps = 0;
       for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
         for (long point = first_point; point <= last_point; ++point) {
           long deps = 0;
-          for (auto interval : graph.dependencies(dset, point)) {
-            deps += interval.second - interval.first + 1;
+          size_t n_intervals;
+          const std::pair<long, long> *intervals = table->dependencies(dset, point, n_intervals);
+          for (size_t span = 0; span < n_intervals; ++span) {
+            deps += intervals[span].second - intervals[span].first + 1;
           }
           max_deps = std::max(max_deps, deps);
         }
@@ -113,6 +102,7 @@ int main(int argc, char *argv[])
       // Create input and output buffers.
       std::vector<std::vector<std::vector<char> > > inputs(n_points);
       std::vector<std::vector<const char *> > input_ptr(n_points);
+      std::vector<std::vector<long> > input_points(n_points);
       std::vector<std::vector<size_t> > input_bytes(n_points);
       std::vector<long> n_inputs(n_points);
       std::vector<std::vector<char> > outputs(n_points);
@@ -126,33 +116,21 @@ int main(int argc, char *argv[])
         point_inputs.resize(max_deps);
         point_input_ptr.resize(max_deps);
         point_input_bytes.resize(max_deps);
+        input_points[point_index].resize(max_deps);
 
         for (long dep = 0; dep < max_deps; ++dep) {
-          point_inputs[dep].resize(max_outputbytes);
-          point_input_ptr[dep] = point_inputs[dep].data();
-          point_input_bytes[dep] = point_inputs[dep].size();
+          point_inputs[dep].resize(header_bytes + max_outputbytes);
+          point_input_ptr[dep] = point_inputs[dep].data() + header_bytes;
+          point_input_bytes[dep] = point_inputs[dep].size() - header_bytes;
         }
 
         auto &point_outputs = outputs[point_index];
-        point_outputs.resize(max_outputbytes);
-      }
-
-      // Cache dependencies.
-      std::vector<std::vector<std::vector<std::pair<long, long> > > > dependencies(graph.max_dependence_sets());
-      std::vector<std::vector<std::vector<std::pair<long, long> > > > reverse_dependencies(graph.max_dependence_sets());
-      for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
-        dependencies[dset].resize(n_points);
-        reverse_dependencies[dset].resize(n_points);
-
-        for (long point = first_point; point <= last_point; ++point) {
-          long point_index = point - first_point;
-
-          dependencies[dset][point_index] = graph.dependencies(dset, point);
-          reverse_dependencies[dset][point_index] = graph.reverse_dependencies(dset, point);
-        }
+        point_outputs.resize(header_bytes + max_outputbytes);
       }
 
       for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+        graph.wait_for_release(timestep);
+
         long offset = graph.offset_at_timestep(timestep);
         long width = graph.width_at_timestep(timestep);
 
@@ -160,8 +138,6 @@ int main(int argc, char *argv[])
         long last_width = graph.width_at_timestep(timestep-1);
 
         long dset = graph.dependence_set_at_timestep(timestep);
-        auto &deps = dependencies[dset];
-        auto &rev_deps = reverse_dependencies[dset];
 
         requests.clear();
 
@@ -174,14 +150,15 @@ int main(int argc, char *argv[])
           auto &point_input_ptr = input_ptr[point_index];
           auto &point_input_bytes = input_bytes[point_index];
 
-          auto &point_deps = deps[point_index];
-          auto &point_rev_deps = rev_deps[point_index];
+          size_t n_point_deps, n_point_rev_deps;
+          const std::pair<long, long> *point_deps = table->dependencies(dset, point, n_point_deps);
+          const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
 
           /* Receive */
           point_n_inputs = 0;
           if (point >= offset && point < offset + width) {
-            for (auto interval : point_deps) {
-              for (long dep = interval.first; dep <= interval.second; ++dep) {
+            for (size_t span = 0; span < n_point_deps; ++span) {
+              for (long dep = point_deps[span].first; dep <= point_deps[span].second; ++dep) {
                 if (dep < last_offset || dep >= last_offset + last_width) {
                   continue;
                 }
@@ -190,22 +167,25 @@ int main(int argc, char *argv[])
                 if (first_point <= dep && dep <= last_point) {
                   auto &output = outputs[dep - first_point];
                   point_inputs[point_n_inputs].assign(output.begin(), output.end());
-                  point_inputs[point_n_inputs].resize(graph.output_bytes_size[timestep-1][dep]);
-                  point_input_ptr[point_n_inputs] = point_inputs[point_n_inputs].data();
-                  point_input_bytes[point_n_inputs] = point_inputs[point_n_inputs].size();
+                  point_inputs[point_n_inputs].resize(header_bytes + graph.output_bytes_at(timestep-1, dep));
+                  point_input_ptr[point_n_inputs] = point_inputs[point_n_inputs].data() + header_bytes;
+                  point_input_bytes[point_n_inputs] = point_inputs[point_n_inputs].size() - header_bytes;
                   //printf("point_n_inputs %d size %ld", point_n_inputs, point_input_bytes[point_n_inputs]);
                   //std::cout<<"check share memory"<<output.begin()<<output.end()<<std::endl;
                 } else {
-                  int from = tag_bits_by_point[dep];
-                  int to = tag_bits_by_point[point];
-                  int tag = (from << 8) | to;
+                  int tag = graph_tags.tag(dep, point);
                   //printf("dep %d, MPIrecv %d size %ld, rank %d", dep, point_n_inputs, point_inputs[point_n_inputs].size(),rank_by_point[dep]);
+                  // Output sizes can vary by timestep.
+                  point_inputs[point_n_inputs].resize(header_bytes + graph.output_bytes_at(timestep-1, dep));
+                  point_input_ptr[point_n_inputs] = point_inputs[point_n_inputs].data() + header_bytes;
+                  point_input_bytes[point_n_inputs] = point_inputs[point_n_inputs].size() - header_bytes;
                   MPI_Request req;
                   MPI_Irecv(point_inputs[point_n_inputs].data(),
                             point_inputs[point_n_inputs].size(), MPI_BYTE,
-                            rank_by_point[dep], tag, MPI_COMM_WORLD, &req);
+                            rank_by_point[dep], tag, graph_tags.comm, &req);
                   requests.push_back(req);
                 }
+                input_points[point_index][point_n_inputs] = dep;
                 point_n_inputs++;
               }
             }
@@ -213,19 +193,17 @@ int main(int argc, char *argv[])
 
           /* Send */
           if (point >= last_offset && point < last_offset + last_width) {
-            for (auto interval : point_rev_deps) {
-              for (long dep = interval.first; dep <= interval.second; dep++) {
+            for (size_t span = 0; span < n_point_rev_deps; ++span) {
+              for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
                 if (dep < offset || dep >= offset + width || (first_point <= dep && dep <= last_point)) {
                   continue;
                 }
 
-                int from = tag_bits_by_point[point];
-                int to = tag_bits_by_point[dep];
-                int tag = (from << 8) | to;
+                int tag = graph_tags.tag(point, dep);
                 MPI_Request req;
                 //printf("dep %d, MPIsend size %ld, rank %d", point, point_output.size(),rank_by_point[dep]);
                 MPI_Isend(point_output.data(), point_output.size(), MPI_BYTE,
-                          rank_by_point[dep], tag, MPI_COMM_WORLD, &req);
+                          rank_by_point[dep], tag, graph_tags.comm, &req);
                 requests.push_back(req);
               }
             }
@@ -242,27 +220,26 @@ int main(int argc, char *argv[])
           auto &point_input_bytes = input_bytes[point_index];
           auto &point_n_inputs = n_inputs[point_index];
           auto &point_output = outputs[point_index];
-          auto &point_deps_execute = deps[point_index];
-          size_t output_point_bytes = graph.output_bytes_size[timestep][point];
+          size_t output_point_bytes = graph.output_bytes_at(timestep, point);
 
-          point_output.resize(output_point_bytes);
+          point_output.resize(header_bytes + output_point_bytes);
           //int point_i_dep = 0;
 
           /*printf("execute point: t %d, point %d, outputsize %ld\n",timestep, point,point_output.size());
           //std::cout<<point_input_bytes.data()<<std::endl;
           if(timestep == 0){
-            //point_input[point_n_dep].resize(graph.output_bytes_size[timestep][point]);
+            //point_input[point_n_dep].resize(graph.output_bytes_at(timestep, point));
             //point_input_ptr[point_n_dep] = point_input[point_n_dep].data();
             //point_input_bytes[point_n_dep] = point_input[point_n_dep].size();
-            //input_point_bytes[point_n_dep] = graph.output_bytes_size[timestep][dep];
-            printf("t=0: point_input_ptr: input size: %ld\n",graph.output_bytes_size[timestep][point]);
+            //input_point_bytes[point_n_dep] = graph.output_bytes_at(timestep, dep);
+            printf("t=0: point_input_ptr: input size: %ld\n",graph.output_bytes_at(timestep, point));
           }else{
             size_t* check_input = point_input_bytes.data();
           for (auto interval : point_deps_execute) {
               for (long dep = interval.first; dep <= interval.second; ++dep) {
 
-                  //point_input[point_i_dep].resize(graph.output_bytes_size[timestep][dep]);
-                  //input_point_bytes[point_i_dep] = graph.output_bytes_size[timestep][dep];
+                  //point_input[point_i_dep].resize(graph.output_bytes_at(timestep, dep));
+                  //input_point_bytes[point_i_dep] = graph.output_bytes_at(timestep, dep);
 
                   printf("t=%d/point_input_ptr: n: %d, dep: %ld, input size: %ld\n",timestep,point_i_dep,dep,check_input[point_i_dep]);
                 }
@@ -270,8 +247,15 @@ int main(int argc, char *argv[])
               }
 
           }*/
+          if (header_bytes > 0) {
+            for (long input = 0; input < point_n_inputs; ++input) {
+              graph_tags.check_header(point_input_ptr[input] - header_bytes, input_points[point_index][input]);
+            }
+            graph_tags.write_header(point_output.data(), point);
+          }
+
           graph.execute_point(timestep, point,
-                              point_output.data(), point_output.size(),
+                              point_output.data() + header_bytes, point_output.size() - header_bytes,
                               point_input_ptr.data(), point_input_bytes.data(), point_n_inputs,
                               scratch_ptr + scratch_bytes * point_index, scratch_bytes);
         }
@@ -281,11 +265,18 @@ int main(int argc, char *argv[])
     MPI_Barrier(MPI_COMM_WORLD);
 
     double stop_time = MPI_Wtime();
-    elapsed_time = stop_time - start_time;
+    return stop_time - start_time;
+  };
+
+  // One untimed warm-up run by default.
+  app.execute_timed(run, rank == 0, 1);
+
+  for (auto scratch_ptr : scratch) {
+    free_buffer(scratch_ptr);
   }
 
-  if (rank == 0) {
-    app.report_timing(elapsed_time);
+  for (auto &graph_tags : tags) {
+    free_message_tags(graph_tags);
   }
 
   MPI_Finalize();
@@ -0,0 +1,314 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "core.h"
+#include "alloc.h"
+#include "placement.h"
+
+#include "mpi.h"
+#include "message_tags.h"
+
+// Like forall, but interior points (those without remote dependencies)
+// run while the halo messages are in flight, and boundary points run
+// once their own receives finish.
+//
+// By default interior and boundary points are two parallel loops around
+// the MPI_Waitall of the receives. With -tasks every point is an OpenMP
+// task and each boundary task polls its own receives, which needs
+// MPI_THREAD_MULTIPLE.
+//
+// Outputs are double buffered by timestep, so that points can overwrite
+// their output while the previous one is still being sent, and on-node
+// inputs are read in place from the previous buffer.
+
+#define TASKS_FLAG "-tasks"
+
+int main(int argc, char *argv[])
+{
+  bool use_tasks = false;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], TASKS_FLAG)) {
+      use_tasks = true;
+    }
+  }
+
+  int provided;
+  MPI_Init_thread(&argc, &argv, use_tasks ? MPI_THREAD_MULTIPLE : MPI_THREAD_FUNNELED, &provided);
+  if (use_tasks && provided < MPI_THREAD_MULTIPLE) {
+    fprintf(stderr, "error: " TASKS_FLAG " requires MPI_THREAD_MULTIPLE\n");
+    abort();
+  }
+  int n_ranks, rank;
+  MPI_Comm_size(MPI_COMM_WORLD, &n_ranks);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+  App app(argc, argv);
+  placement_require_block("mpi_openmp/overlap");
+  if (rank == 0) app.display();
+
+  std::vector<char *> scratch;
+  for (auto graph : app.graphs) {
+    long first_point = rank * graph.max_width / n_ranks;
+    long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
+    long n_points = last_point - first_point + 1;
+
+    size_t scratch_bytes = graph.scratch_bytes_per_task;
+    // Pages are first touched by the threads, and in the schedule, that
+    // execute the points.
+    scratch.push_back(alloc_buffer(scratch_bytes * n_points, -1));
+
+    char *scratch_ptr = scratch.back();
+
+    #pragma omp parallel for schedule(runtime)
+    for (long point = first_point; point <= last_point; ++point) {
+      long point_index = point - first_point;
+      TaskGraph::prepare_scratch(scratch_ptr + scratch_bytes * point_index, scratch_bytes);
+    }
+  }
+
+  std::vector<MessageTags> tags;
+  for (auto graph : app.graphs) {
+    tags.push_back(make_message_tags(graph, n_ranks));
+  }
+
+  auto run = [&] {
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double start_time = MPI_Wtime();
+    app.start_arrivals();
+
+    std::vector<MPI_Request> recv_requests, send_requests;
+
+    for (auto graph : app.graphs) {
+      long first_point = rank * graph.max_width / n_ranks;
+      long last_point = (rank + 1) * graph.max_width / n_ranks - 1;
+      long n_points = last_point - first_point + 1;
+
+      size_t scratch_bytes = graph.scratch_bytes_per_task;
+      char *scratch_ptr = scratch[graph.graph_index];
+
+      const MessageTags &graph_tags = tags[graph.graph_index];
+      const std::vector<int> &rank_by_point = graph_tags.rank_by_point;
+      size_t header_bytes = graph_tags.header_bytes;
+      size_t message_bytes = header_bytes + graph.max_output_bytes();
+
+      const DependencyTable *table = graph.dependency_table();
+      assert(table != NULL);
+
+      long max_deps = 0;
+      for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
+        for (long point = first_point; point <= last_point; ++point) {
+          long deps = 0;
+          size_t n_intervals;
+          const std::pair<long, long> *intervals = table->dependencies(dset, point, n_intervals);
+          for (size_t span = 0; span < n_intervals; ++span) {
+            deps += intervals[span].second - intervals[span].first + 1;
+          }
+          max_deps = std::max(max_deps, deps);
+        }
+      }
+
+      // Create input and output buffers.
+      std::vector<std::vector<std::vector<char> > > inputs(n_points);
+      std::vector<std::vector<const char *> > input_ptr(n_points);
+      std::vector<std::vector<size_t> > input_bytes(n_points);
+      std::vector<std::vector<long> > input_points(n_points);
+      std::vector<long> n_inputs(n_points);
+      std::vector<std::vector<char> > outputs[2];
+      outputs[0].resize(n_points);
+      outputs[1].resize(n_points);
+      // Range of recv_requests for each point.
+      std::vector<long> first_request(n_points), last_request(n_points);
+      for (long point_index = 0; point_index < n_points; ++point_index) {
+        inputs[point_index].resize(max_deps);
+        for (auto &input : inputs[point_index]) {
+          input.resize(message_bytes);
+        }
+        input_ptr[point_index].resize(max_deps);
+        input_bytes[point_index].resize(max_deps);
+        input_points[point_index].resize(max_deps);
+        outputs[0][point_index].resize(message_bytes);
+        outputs[1][point_index].resize(message_bytes);
+      }
+      std::vector<long> interior, boundary;
+
+      for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+        graph.wait_for_release(timestep);
+
+        long offset = graph.offset_at_timestep(timestep);
+        long width = graph.width_at_timestep(timestep);
+
+        long last_offset = graph.offset_at_timestep(timestep-1);
+        long last_width = graph.width_at_timestep(timestep-1);
+
+        long dset = graph.dependence_set_at_timestep(timestep);
+
+        auto &last_outputs = outputs[(timestep + 1) % 2];
+
+        recv_requests.clear();
+        send_requests.clear();
+        interior.clear();
+        boundary.clear();
+
+        for (long point = first_point; point <= last_point; ++point) {
+          long point_index = point - first_point;
+
+          auto &point_inputs = inputs[point_index];
+          auto &point_n_inputs = n_inputs[point_index];
+          auto &point_input_ptr = input_ptr[point_index];
+          auto &point_input_bytes = input_bytes[point_index];
+
+          size_t n_point_deps, n_point_rev_deps;
+          const std::pair<long, long> *point_deps = table->dependencies(dset, point, n_point_deps);
+          const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
+
+          /* Receive */
+          point_n_inputs = 0;
+          first_request[point_index] = recv_requests.size();
+          if (point >= offset && point < offset + width) {
+            for (size_t span = 0; span < n_point_deps; ++span) {
+              for (long dep = point_deps[span].first; dep <= point_deps[span].second; ++dep) {
+                if (dep < last_offset || dep >= last_offset + last_width) {
+                  continue;
+                }
+
+                // Use shared memory for on-node data.
+                if (first_point <= dep && dep <= last_point) {
+                  point_input_ptr[point_n_inputs] = last_outputs[dep - first_point].data() + header_bytes;
+                } else {
+                  MPI_Request req;
+                  MPI_Irecv(point_inputs[point_n_inputs].data(),
+                            header_bytes + graph.output_bytes_at(timestep-1, dep), MPI_BYTE,
+                            rank_by_point[dep], graph_tags.tag(dep, point), graph_tags.comm, &req);
+                  recv_requests.push_back(req);
+                  point_input_ptr[point_n_inputs] = point_inputs[point_n_inputs].data() + header_bytes;
+                }
+                point_input_bytes[point_n_inputs] = graph.output_bytes_at(timestep-1, dep);
+                input_points[point_index][point_n_inputs] = dep;
+                point_n_inputs++;
+              }
+            }
+            if (first_request[point_index] == (long)recv_requests.size()) {
+              interior.push_back(point);
+            } else {
+              boundary.push_back(point);
+            }
+          }
+          last_request[point_index] = recv_requests.size();
+
+          /* Send */
+          if (point >= last_offset && point < last_offset + last_width) {
+            for (size_t span = 0; span < n_point_rev_deps; ++span) {
+              for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+                if (dep < offset || dep >= offset + width || (first_point <= dep && dep <= last_point)) {
+                  continue;
+                }
+
+                MPI_Request req;
+                MPI_Isend(last_outputs[point_index].data(),
+                          header_bytes + graph.output_bytes_at(timestep-1, point), MPI_BYTE,
+                          rank_by_point[dep], graph_tags.tag(point, dep), graph_tags.comm, &req);
+                send_requests.push_back(req);
+              }
+            }
+          }
+        }
+
+        auto &point_outputs = outputs[timestep % 2];
+        auto execute = [&](long point) {
+          long point_index = point - first_point;
+
+          auto &point_output = point_outputs[point_index];
+          if (header_bytes > 0) {
+            for (long input = 0; input < n_inputs[point_index]; ++input) {
+              graph_tags.check_header(input_ptr[point_index][input] - header_bytes, input_points[point_index][input]);
+            }
+            graph_tags.write_header(point_output.data(), point);
+          }
+
+          graph.execute_point(timestep, point,
+                              point_output.data() + header_bytes, graph.output_bytes_at(timestep, point),
+                              input_ptr[point_index].data(), input_bytes[point_index].data(), n_inputs[point_index],
+                              scratch_ptr + scratch_bytes * point_index, scratch_bytes);
+        };
+
+        if (use_tasks) {
+          #pragma omp parallel
+          #pragma omp single
+          {
+            for (long point : boundary) {
+              #pragma omp task firstprivate(point)
+              {
+                long point_index = point - first_point;
+                int done = 0;
+                while (!done) {
+                  MPI_Testall(last_request[point_index] - first_request[point_index],
+                              recv_requests.data() + first_request[point_index],
+                              &done, MPI_STATUSES_IGNORE);
+                  if (!done) {
+                    #pragma omp taskyield
+                  }
+                }
+                execute(point);
+              }
+            }
+            for (long point : interior) {
+              #pragma omp task firstprivate(point)
+              execute(point);
+            }
+          }
+        } else {
+          #pragma omp parallel for schedule(runtime)
+          for (size_t i = 0; i < interior.size(); ++i) {
+            execute(interior[i]);
+          }
+
+          MPI_Waitall(recv_requests.size(), recv_requests.data(), MPI_STATUSES_IGNORE);
+
+          #pragma omp parallel for schedule(runtime)
+          for (size_t i = 0; i < boundary.size(); ++i) {
+            execute(boundary[i]);
+          }
+        }
+
+        // The buffer being sent is written again next timestep.
+        MPI_Waitall(send_requests.size(), send_requests.data(), MPI_STATUSES_IGNORE);
+      }
+    }
+
+    MPI_Barrier(MPI_COMM_WORLD);
+
+    double stop_time = MPI_Wtime();
+    return stop_time - start_time;
+  };
+
+  // One untimed warm-up run by default.
+  app.execute_timed(run, rank == 0, 1);
+
+  for (auto scratch_ptr : scratch) {
+    free_buffer(scratch_ptr);
+  }
+
+  for (auto &graph_tags : tags) {
+    free_message_tags(graph_tags);
+  }
+
+  MPI_Finalize();
+}
@@ -378,8 +378,8 @@ OmpSsApp::OmpSsApp(int argc, char **argv)
 
     for (int t = 0; t < matrix[i].M; t++){
     	for (int w = 0; w < matrix[i].N; w++){
-	matrix[i].data[matrix[i].N*t+w].output_buff = (char*)malloc(sizeof(char)*graph.output_bytes_size[t][w]);
-	//printf("allocate output bytes ind %d t %d w %d size %ld\n", matrix[i].N*t+w,t, w, graph.output_bytes_size[t][w]);
+	matrix[i].data[matrix[i].N*t+w].output_buff = (char*)malloc(sizeof(char)*graph.output_bytes_at(t, w));
+	//printf("allocate output bytes ind %d t %d w %d size %ld\n", matrix[i].N*t+w,t, w, graph.output_bytes_at(t, w));
 	}
     }
 
@@ -481,7 +481,7 @@ void OmpSsApp::execute_timestep(size_t idx, long t)
       task_args.x = x;
       task_args.y = t % nb_fields;
       args.push_back(task_args);
-      payload.output_bytes_size[output_index++] = g.output_bytes_size[t % nb_fields][x];
+      payload.output_bytes_size[output_index++] = g.output_bytes_at(t % nb_fields, x);
     } else {
       if (t == 0) {
         num_args = 1;
@@ -489,13 +489,13 @@ void OmpSsApp::execute_timestep(size_t idx, long t)
         task_args.x = x;
         task_args.y = t % nb_fields;
         args.push_back(task_args);
-        payload.output_bytes_size[output_index++] = g.output_bytes_size[t % nb_fields][x];
+        payload.output_bytes_size[output_index++] = g.output_bytes_at(t % nb_fields, x);
       } else {
         num_args = 1;
         task_args.x = x;
         task_args.y = t % nb_fields;
         args.push_back(task_args);
-        payload.output_bytes_size[output_index++] = g.output_bytes_size[t][x];
+        payload.output_bytes_size[output_index++] = g.output_bytes_at(t, x);
         long last_offset = g.offset_at_timestep(t-1);
         long last_width = g.width_at_timestep(t-1);
         for (std::pair<long, long> dep : deps) {
@@ -506,7 +506,7 @@ void OmpSsApp::execute_timestep(size_t idx, long t)
               task_args.x = i;
               task_args.y = (t-1) % nb_fields;
               args.push_back(task_args);
-              payload.output_bytes_size[output_index++] = g.output_bytes_size[t][x];
+              payload.output_bytes_size[output_index++] = g.output_bytes_at(t, x);
             } else {
               num_args --;
             }
@@ -539,7 +539,7 @@ void OmpSsApp::insert_task(std::vector<task_args_t> args, payload_t payload, siz
   case 1:
   {
 OMPSS_TASK_DEPEND(inout: mat[y0 * matrix[graph_id].N + x0])
-      task1(&mat[y0 * matrix[graph_id].N + x0], payload,payload.graph.output_bytes_size[y0][x0]);
+      task1(&mat[y0 * matrix[graph_id].N + x0], payload,payload.graph.output_bytes_at(y0, x0));
     break;
   }
 
@@ -550,8 +550,8 @@ OMPSS_TASK_DEPEND(inout: mat[y0 * matrix[graph_id].N + x0])
 OMPSS_TASK_DEPEND(in: mat[y1 * matrix[graph_id].N + x1]) depend(inout: mat[y0 * matrix[graph_id].N + x0])
       task2(&mat[y0 * matrix[graph_id].N + x0],
             &mat[y1 * matrix[graph_id].N + x1], payload,
-            payload.graph.output_bytes_size[y0][x0],
-            payload.graph.output_bytes_size[y1][x1]);
+            payload.graph.output_bytes_at(y0, x0),
+            payload.graph.output_bytes_at(y1, x1));
     break;
   }
 
@@ -565,9 +565,9 @@ OMPSS_TASK_DEPEND(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * mat
       task3(&mat[y0 * matrix[graph_id].N + x0],
             &mat[y1 * matrix[graph_id].N + x1],
             &mat[y2 * matrix[graph_id].N + x2], payload,
-            payload.graph.output_bytes_size[y0][x0],
-            payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2]);
+            payload.graph.output_bytes_at(y0, x0),
+            payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2));
     break;
   }
 
@@ -584,10 +584,10 @@ OMPSS_TASK_DEPEND(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * mat
             &mat[y1 * matrix[graph_id].N + x1],
             &mat[y2 * matrix[graph_id].N + x2],
             &mat[y3 * matrix[graph_id].N + x3], payload,
-            payload.graph.output_bytes_size[y0][x0],
-            payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],
-            payload.graph.output_bytes_size[y3][x3]);
+            payload.graph.output_bytes_at(y0, x0),
+            payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),
+            payload.graph.output_bytes_at(y3, x3));
     break;
   }
 
@@ -607,11 +607,11 @@ OMPSS_TASK_DEPEND(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * mat
             &mat[y2 * matrix[graph_id].N + x2],
             &mat[y3 * matrix[graph_id].N + x3],
             &mat[y4 * matrix[graph_id].N + x4], payload,
-            payload.graph.output_bytes_size[y0][x0],
-            payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],
-            payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4]);
+            payload.graph.output_bytes_at(y0, x0),
+            payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),
+            payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4));
     break;
   }
 
@@ -634,12 +634,12 @@ OMPSS_TASK_DEPEND(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * mat
             &mat[y3 * matrix[graph_id].N + x3],
             &mat[y4 * matrix[graph_id].N + x4],
             &mat[y5 * matrix[graph_id].N + x5], payload,
-            payload.graph.output_bytes_size[y0][x0],
-            payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],
-            payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4],
-            payload.graph.output_bytes_size[y5][x5]);
+            payload.graph.output_bytes_at(y0, x0),
+            payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),
+            payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4),
+            payload.graph.output_bytes_at(y5, x5));
     break;
   }
 
@@ -665,13 +665,13 @@ OMPSS_TASK_DEPEND(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * mat
             &mat[y4 * matrix[graph_id].N + x4],
             &mat[y5 * matrix[graph_id].N + x5],
             &mat[y6 * matrix[graph_id].N + x6], payload,
-            payload.graph.output_bytes_size[y0][x0],
-            payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],
-            payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4],
-            payload.graph.output_bytes_size[y5][x5],
-            payload.graph.output_bytes_size[y6][x6]);
+            payload.graph.output_bytes_at(y0, x0),
+            payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),
+            payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4),
+            payload.graph.output_bytes_at(y5, x5),
+            payload.graph.output_bytes_at(y6, x6));
     break;
   }
 
@@ -700,14 +700,14 @@ OMPSS_TASK_DEPEND(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * mat
             &mat[y5 * matrix[graph_id].N + x5],
             &mat[y6 * matrix[graph_id].N + x6],
             &mat[y7 * matrix[graph_id].N + x7], payload,
-            payload.graph.output_bytes_size[y0][x0],
-            payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],
-            payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4],
-            payload.graph.output_bytes_size[y5][x5],
-            payload.graph.output_bytes_size[y6][x6],
-            payload.graph.output_bytes_size[y7][x7]);
+            payload.graph.output_bytes_at(y0, x0),
+            payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),
+            payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4),
+            payload.graph.output_bytes_at(y5, x5),
+            payload.graph.output_bytes_at(y6, x6),
+            payload.graph.output_bytes_at(y7, x7));
     break;
   }
 
@@ -739,15 +739,15 @@ OMPSS_TASK_DEPEND(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * mat
             &mat[y6 * matrix[graph_id].N + x6],
             &mat[y7 * matrix[graph_id].N + x7],
             &mat[y8 * matrix[graph_id].N + x8], payload,
-            payload.graph.output_bytes_size[y0][x0],
-            payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],
-            payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4],
-            payload.graph.output_bytes_size[y5][x5],
-            payload.graph.output_bytes_size[y6][x6],
-            payload.graph.output_bytes_size[y7][x7],
-            payload.graph.output_bytes_size[y8][x8]);
+            payload.graph.output_bytes_at(y0, x0),
+            payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),
+            payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4),
+            payload.graph.output_bytes_at(y5, x5),
+            payload.graph.output_bytes_at(y6, x6),
+            payload.graph.output_bytes_at(y7, x7),
+            payload.graph.output_bytes_at(y8, x8));
     break;
   }
 
@@ -782,16 +782,16 @@ OMPSS_TASK_DEPEND(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * mat
             &mat[y7 * matrix[graph_id].N + x7],
             &mat[y8 * matrix[graph_id].N + x8],
             &mat[y9 * matrix[graph_id].N + x9], payload,
-            payload.graph.output_bytes_size[y0][x0],
-            payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],
-            payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4],
-            payload.graph.output_bytes_size[y5][x5],
-            payload.graph.output_bytes_size[y6][x6],
-            payload.graph.output_bytes_size[y7][x7],
-            payload.graph.output_bytes_size[y8][x8],
-            payload.graph.output_bytes_size[y9][x9]);
+            payload.graph.output_bytes_at(y0, x0),
+            payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),
+            payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4),
+            payload.graph.output_bytes_at(y5, x5),
+            payload.graph.output_bytes_at(y6, x6),
+            payload.graph.output_bytes_at(y7, x7),
+            payload.graph.output_bytes_at(y8, x8),
+            payload.graph.output_bytes_at(y9, x9));
     break;
   }
 
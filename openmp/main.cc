@@ -20,10 +20,18 @@
 #include <unistd.h>
 #include <omp.h>
 #include "core.h"
+#include "alloc.h"
+#include "noise.h"
 #include "timer.h"
+#include "../mpi/comm_pattern.h"
 #include <iostream>
 #include <string>
 #include <random>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <thread>
+#include <tuple>
 
 #define VERBOSE_LEVEL 0
 
@@ -31,6 +39,10 @@
 
 #define MAX_NUM_ARGS 10
 
+// -replay windows span at least this many timesteps, so that short
+// periods are not one barrier per timestep.
+#define REPLAY_MIN_TIMESTEPS 8
+
 typedef struct tile_s {
   float dep;
   char *output_buff;
@@ -331,6 +343,60 @@ static inline void task10(tile_t *tile_out, tile_t *tile_in1, tile_t *tile_in2,
 #endif
 }
 
+// Any number of inputs, for insert_task's depend(iterator(...)) path.
+static inline void task_n(tile_t *tile_out, const tile_t *mat, int N, const std::vector<task_args_t> &inputs, payload_t payload, size_t task_bytes)
+{
+  int tid = omp_get_thread_num();
+  TaskGraph graph = payload.graph;
+  char *output_ptr = (char*)tile_out->output_buff;
+  std::vector<const char *> input_ptrs;
+  std::vector<size_t> input_bytes;
+  if (inputs.empty()) {
+    // As task1: the output's own tile stands in for the missing input.
+    input_ptrs.push_back((char*)tile_out->output_buff);
+    input_bytes.push_back(task_bytes);
+  }
+  for (auto &input : inputs) {
+    input_ptrs.push_back(mat[input.y * N + input.x].output_buff);
+    input_bytes.push_back(graph.output_bytes_at(input.y, input.x));
+  }
+
+  graph.execute_point(payload.y, payload.x, output_ptr, task_bytes,
+                      input_ptrs.data(), input_bytes.data(), input_ptrs.size(), extra_local_memory[tid], graph.scratch_bytes_per_task);
+}
+
+// -replay: the tasks of a window of timesteps, recorded once as a graph
+// of dependency counters and replayed by the thread team for every
+// window with the same pattern. Windows are separated by a barrier, so
+// only dependencies inside a window are counted. Windows are keyed by the
+// patterns (comm_pattern.h) of their timesteps.
+
+struct ReplayTask {
+  long step; // timestep within the window
+  long point;
+  std::vector<long> inputs; // producer points, in input order
+  std::vector<long> consumers; // tasks of the next step in the window
+  long predecessors;
+};
+
+struct ReplayWindow {
+  std::vector<ReplayTask> tasks;
+  std::vector<long> initial; // tasks without predecessors
+  std::unique_ptr<std::atomic<long>[]> pending;
+  std::unique_ptr<std::atomic<long>[]> ready; // task + 1, 0 while empty
+  std::atomic<long> head, tail;
+};
+
+struct ReplayGraph {
+  long window; // timesteps per window
+  size_t slot_bytes;
+  // Outputs of window + 1 consecutive timesteps, so a window never
+  // overwrites the outputs it reads.
+  std::vector<char> outputs;
+  std::map<std::vector<PatternKey>, ReplayWindow> recorded;
+  std::vector<ReplayWindow *> windows; // of each window of the graph
+};
+
 struct OpenMPApp : public App {
   OpenMPApp(int argc, char **argv);
   ~OpenMPApp();
@@ -338,9 +404,17 @@ struct OpenMPApp : public App {
   void execute_timestep(size_t idx, long t);
 private:
   void insert_task(task_args_t *args, int num_args, payload_t payload, size_t graph_id, size_t task_bytes);
+  void record_replay(size_t idx);
+  void execute_replay();
+  void replay_window(size_t idx, long window);
   void debug_printf(int verbose_level, const char *format, ...);
 private:
   int nb_workers;
+  // Use depend(iterator(...)) for every task, not just those with more
+  // inputs than task1..task10 take.
+  bool depend_iterator;
+  bool replay;
+  std::vector<ReplayGraph> replay_graphs;
 //  matrix_t *matrix;
 };
 
@@ -350,11 +424,32 @@ OpenMPApp::OpenMPApp(int argc, char **argv)
   : App(argc, argv)
 {
   nb_workers = 1;
+  depend_iterator = false;
+  replay = false;
 
   for (int k = 1; k < argc; k++) {
     if (!strcmp(argv[k], "-worker")) {
       nb_workers = atol(argv[++k]);
     }
+    if (!strcmp(argv[k], "-depend-iterator")) {
+      depend_iterator = true;
+    }
+    if (!strcmp(argv[k], "-replay")) {
+      replay = true;
+    }
+  }
+
+  if (replay) {
+    for (auto &graph : graphs) {
+      if (graph.arrival_rate > 0) {
+        fprintf(stderr, "error: -replay does not support -arrival-rate\n");
+        abort();
+      }
+    }
+    replay_graphs.resize(graphs.size());
+    for (unsigned i = 0; i < graphs.size(); i++) {
+      record_replay(i);
+    }
   }
 
   matrix = (matrix_t *)malloc(sizeof(matrix_t) * graphs.size());
@@ -370,8 +465,8 @@ OpenMPApp::OpenMPApp(int argc, char **argv)
 
     for (int t = 0; t < matrix[i].M; t++){
     	for (int w = 0; w < matrix[i].N; w++){
-	matrix[i].data[matrix[i].N*t+w].output_buff = (char*)malloc(sizeof(char)*graph.output_bytes_size[t][w]);
-	//printf("allocate output bytes ind %d t %d w %d size %ld\n", matrix[i].N*t+w,t, w, graph.output_bytes_size[t][w]);
+	matrix[i].data[matrix[i].N*t+w].output_buff = (char*)malloc(sizeof(char)*graph.output_bytes_at(t, w));
+	//printf("allocate output bytes ind %d t %d w %d size %ld\n", matrix[i].N*t+w,t, w, graph.output_bytes_at(t, w));
 	}
     }
     //for (int j = 0; j < matrix[i].M * matrix[i].N; j++) {
@@ -385,27 +480,19 @@ OpenMPApp::OpenMPApp(int argc, char **argv)
     //printf("graph id %d, M = %d, N = %d, data %p, nb_fields %d\n", i, matrix[i].M, matrix[i].N, matrix[i].data, graph.nb_fields);
   }
 
-  extra_local_memory = (char**)malloc(sizeof(char*) * nb_workers);
+  extra_local_memory = (char**)calloc(nb_workers, sizeof(char*));
   assert(extra_local_memory != NULL);
-  for (int k = 0; k < nb_workers; k++) {
-    if (max_scratch_bytes_per_task > 0) {
-      extra_local_memory[k] = (char*)malloc(sizeof(char)*max_scratch_bytes_per_task);
-      TaskGraph::prepare_scratch(extra_local_memory[k], sizeof(char)*max_scratch_bytes_per_task);
-    } else {
-      extra_local_memory[k] = NULL;
-    }
-  }
 
  // omp_set_dynamic(1);
   omp_set_num_threads(nb_workers);
 
-  if (max_scratch_bytes_per_task > 0) {
-    #pragma omp parallel
-    {
-      int tid = omp_get_thread_num();
-      //printf("im tid %d\n", tid);
-      TaskGraph::prepare_scratch(extra_local_memory[tid], sizeof(char)*max_scratch_bytes_per_task);
-    }
+  // Each worker allocates and first-touches its own scratch.
+  #pragma omp parallel
+  {
+    int tid = omp_get_thread_num();
+    //printf("im tid %d\n", tid);
+    extra_local_memory[tid] = TaskGraph::allocate_scratch(max_scratch_bytes_per_task, 1, numa_current_node());
+    noise_set_worker(tid);
   }
 
 }
@@ -426,7 +513,7 @@ OpenMPApp::~OpenMPApp()
 
   for (int j = 0; j < nb_workers; j++) {
     if (extra_local_memory[j] != NULL) {
-      free(extra_local_memory[j]);
+      TaskGraph::free_scratch(extra_local_memory[j]);
       extra_local_memory[j] = NULL;
     }
   }
@@ -435,25 +522,187 @@ OpenMPApp::~OpenMPApp()
 }
 
 void OpenMPApp::execute_main_loop()
+{
+  if (replay) {
+    execute_replay();
+    return;
+  }
+
+  display();
+
+  auto run = [&] {
+    Timer::time_start();
+
+    #pragma omp parallel
+    {
+      #pragma omp master
+      {
+        start_arrivals();
+        for (auto step : issue_order()) {
+          graphs[step.first].wait_for_release(step.second);
+          execute_timestep(step.first, step.second);
+        }
+//        #pragma omp taskwait
+      }
+      #pragma omp barrier
+    }
+
+    return Timer::time_end();
+  };
+
+  if (metg) {
+    search_metg(run, nb_workers);
+  } else {
+    execute_timed(run);
+  }
+}
+
+void OpenMPApp::record_replay(size_t idx)
+{
+  const TaskGraph &g = graphs[idx];
+  ReplayGraph &rg = replay_graphs[idx];
+
+  long period = g.timestep_period();
+  rg.window = period * ((REPLAY_MIN_TIMESTEPS + period - 1) / period);
+  rg.slot_bytes = g.max_output_bytes();
+  rg.outputs.resize((rg.window + 1) * g.max_width * rg.slot_bytes);
+
+  for (long first = 0; first < g.timesteps; first += rg.window) {
+    long steps = std::min(rg.window, g.timesteps - first);
+
+    // The first window differs from the rest in having no inputs, and
+    // the last may be shorter.
+    std::vector<PatternKey> key;
+    for (long t = first; t < first + steps; ++t) {
+      key.push_back(pattern_key(g, t));
+    }
+
+    auto it = rg.recorded.find(key);
+    if (it != rg.recorded.end()) {
+      rg.windows.push_back(&it->second);
+      continue;
+    }
+
+    ReplayWindow &w = rg.recorded[key];
+    // Index of the first task of each step, and of the point at offset.
+    std::vector<long> first_task(steps + 1);
+    for (long step = 0; step < steps; ++step) {
+      long dset, offset, width, last_offset, last_width;
+      std::tie(dset, offset, width, last_offset, last_width) = key[step];
+
+      first_task[step] = w.tasks.size();
+      std::vector<std::vector<long> > inputs;
+      if (first + step > 0) {
+        inputs = pattern_input_points(g, key[step], offset, offset + width - 1);
+      }
+      for (long x = offset; x < offset + width; ++x) {
+        ReplayTask task;
+        task.step = step;
+        task.point = x;
+        task.predecessors = 0;
+        if (first + step > 0) {
+          task.inputs = inputs[x - offset];
+        }
+        if (step > 0) {
+          long last_first_task = first_task[step - 1];
+          for (long i : task.inputs) {
+            w.tasks[last_first_task + i - last_offset].consumers.push_back(w.tasks.size());
+          }
+          task.predecessors = task.inputs.size();
+        }
+        if (task.predecessors == 0) {
+          w.initial.push_back(w.tasks.size());
+        }
+        w.tasks.push_back(task);
+      }
+    }
+
+    w.pending.reset(new std::atomic<long>[w.tasks.size()]);
+    w.ready.reset(new std::atomic<long>[w.tasks.size()]);
+    rg.windows.push_back(&w);
+  }
+}
+
+void OpenMPApp::replay_window(size_t idx, long window)
+{
+  const TaskGraph &g = graphs[idx];
+  ReplayGraph &rg = replay_graphs[idx];
+  ReplayWindow &w = *rg.windows[window];
+  long first = window * rg.window;
+  long n_tasks = w.tasks.size();
+  long rows = rg.window + 1;
+
+  #pragma omp single
+  {
+    for (long i = 0; i < n_tasks; ++i) {
+      w.pending[i].store(w.tasks[i].predecessors, std::memory_order_relaxed);
+      w.ready[i].store(0, std::memory_order_relaxed);
+    }
+    for (size_t i = 0; i < w.initial.size(); ++i) {
+      w.ready[i].store(w.initial[i] + 1, std::memory_order_relaxed);
+    }
+    w.head.store(0, std::memory_order_relaxed);
+    w.tail.store(w.initial.size(), std::memory_order_relaxed);
+  }
+
+  int tid = omp_get_thread_num();
+  std::vector<const char *> input_ptrs;
+  std::vector<size_t> input_bytes;
+
+  // Ready tasks are taken in the order they become ready.
+  long slot;
+  while ((slot = w.head.fetch_add(1, std::memory_order_relaxed)) < n_tasks) {
+    long task_index;
+    while ((task_index = w.ready[slot].load(std::memory_order_acquire)) == 0) {
+      std::this_thread::yield();
+    }
+    const ReplayTask &task = w.tasks[task_index - 1];
+    long t = first + task.step;
+
+    char *output_ptr = &rg.outputs[((t % rows) * g.max_width + task.point) * rg.slot_bytes];
+    size_t output_bytes = g.output_bytes_at(t, task.point);
+    input_ptrs.clear();
+    input_bytes.clear();
+    for (long i : task.inputs) {
+      input_ptrs.push_back(&rg.outputs[(((t - 1) % rows) * g.max_width + i) * rg.slot_bytes]);
+      input_bytes.push_back(g.output_bytes_at(t - 1, i));
+    }
+    g.execute_point(t, task.point, output_ptr, output_bytes,
+                    input_ptrs.data(), input_bytes.data(), input_ptrs.size(),
+                    extra_local_memory[tid], g.scratch_bytes_per_task);
+
+    for (long consumer : task.consumers) {
+      if (w.pending[consumer].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        long next = w.tail.fetch_add(1, std::memory_order_relaxed);
+        w.ready[next].store(consumer + 1, std::memory_order_release);
+      }
+    }
+  }
+
+  #pragma omp barrier
+}
+
+void OpenMPApp::execute_replay()
 {
   display();
 
+  long max_windows = 0;
+  for (auto &rg : replay_graphs) {
+    max_windows = std::max(max_windows, (long)rg.windows.size());
+  }
+
   Timer::time_start();
 
   #pragma omp parallel
   {
-    #pragma omp master
-    {
-      for (unsigned i = 0; i < graphs.size(); i++) {
-        const TaskGraph &g = graphs[i];
-        for (int y = 0; y < g.timesteps; y++) {
-          execute_timestep(i, y);
+    // Windows of the graphs take turns.
+    for (long window = 0; window < max_windows; ++window) {
+      for (size_t idx = 0; idx < graphs.size(); ++idx) {
+        if (window < (long)replay_graphs[idx].windows.size()) {
+          replay_window(idx, window);
         }
-
       }
-//      #pragma omp taskwait
     }
-    #pragma omp barrier
   }
 
   double elapsed = Timer::time_end();
@@ -468,7 +717,7 @@ void OpenMPApp::execute_timestep(size_t idx, long t)
   long dset = g.dependence_set_at_timestep(t);
   int nb_fields = g.nb_fields;
 
-  task_args_t args[MAX_NUM_ARGS];
+  std::vector<task_args_t> args;
   payload_t payload;
   int num_args = 0;
   int ct = 0;
@@ -478,47 +727,23 @@ void OpenMPApp::execute_timestep(size_t idx, long t)
   //allocate_bytes(g.output_bytes_per_task, width, task_bytes);
 
   for (int x = offset; x <= offset+width-1; x++) {
-    std::vector<std::pair<long, long> > deps = g.dependencies(dset, x);
-    num_args = 0;
+    num_args = 1;
     ct = 0;
-    task_size = g.output_bytes_size[t][x];
-
-    if (deps.size() == 0) {
-      num_args = 1;
-      //printf("2:%d[%d]\n", x, num_args);
-      args[ct].x = x;
-      args[ct].y = t % nb_fields;
-      ct ++;
-    } else {
-      if (t == 0) {
-        num_args = 1;
-        //printf("%d[%d] \n", x, num_args);
-        args[ct].x = x;
-        args[ct].y = t % nb_fields;
-        ct ++;
-      } else {
-        num_args = 1;
-        args[ct].x = x;
-        args[ct].y = t % nb_fields;
-        ct ++;
-        long last_offset = g.offset_at_timestep(t-1);
-        long last_width = g.width_at_timestep(t-1);
-        for (std::pair<long, long> dep : deps) {
-          num_args += dep.second - dep.first + 1;
-          //debug_printf(1, "%d[%d, %d, %d] ", x, num_args, dep.first, dep.second);
-          //printf("%d[%d, %d, %d]\n ", x, num_args, dep.first, dep.second);
-          for (int i = dep.first; i <= dep.second; i++) {
-            if (i >= last_offset && i < last_offset + last_width) {
-              args[ct].x = i;
-              args[ct].y = (t-1) % nb_fields;
-              ct ++;
-            } else {
-              num_args --;
-            }
-          }
-          //printf("%d[%d, %d, %d]\n ", x, num_args, dep.first, dep.second);
+    task_size = g.output_bytes_at(t, x);
+
+    args.clear();
+    args.push_back({x, (int)(t % nb_fields)});
+    ct ++;
+    if (t > 0) {
+      long last_offset = g.offset_at_timestep(t-1);
+      long last_width = g.width_at_timestep(t-1);
+      g.for_each_dependency_point(dset, x, [&](long i) {
+        if (i >= last_offset && i < last_offset + last_width) {
+          args.push_back({(int)i, (int)((t-1) % nb_fields)});
+          ct ++;
+          num_args ++;
         }
-      }
+      });
     }
 
     assert(num_args == ct);
@@ -526,7 +751,7 @@ void OpenMPApp::execute_timestep(size_t idx, long t)
     payload.y = t;
     payload.x = x;
     payload.graph = g;
-    insert_task(args, num_args, payload, idx, task_size);
+    insert_task(args.data(), num_args, payload, idx, task_size);
   }
 }
 
@@ -537,21 +762,30 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
   if(t > nb_fields){
     for (int tt = t/nb_fields*nb_fields; tt < t/nb_fields*nb_fields+2; tt++){
     	for (int w = 0; w < g.max_width; w++){
-	mat.data[g.max_width*tt+w].output_buff = (char*)malloc(sizeof(char)*g.output_bytes_size[tt][w]);
-	//printf("allocate output bytes ind %d t %d w %d size %ld\n", matrix[i].N*t+w,t, w, graph.output_bytes_size[t][w]);
+	mat.data[g.max_width*tt+w].output_buff = (char*)malloc(sizeof(char)*g.output_bytes_at(tt, w));
+	//printf("allocate output bytes ind %d t %d w %d size %ld\n", matrix[i].N*t+w,t, w, graph.output_bytes_at(t, w));
 	}
     }
   }
 	*/
   tile_t *mat = matrix[graph_id].data;
+  int priority = payload.graph.priority;
   int x0 = args[0].x;
   int y0 = args[0].y;
   //printf("num_args %d, x %d, y %d, mat %p task bytes %ld\n", num_args,x0, y0, mat,task_bytes);
+  if (depend_iterator || num_args > MAX_NUM_ARGS) {
+    int N = matrix[graph_id].N;
+    std::vector<task_args_t> inputs(args + 1, args + num_args);
+    #pragma omp task depend(iterator(it = 0:num_args-1), in: mat[inputs[it].y * N + inputs[it].x]) depend(inout: mat[y0 * N + x0]) firstprivate(inputs) priority(priority) untied mergeable
+      task_n(&mat[y0 * N + x0], mat, N, inputs, payload, payload.graph.output_bytes_at(y0, x0));
+    return;
+  }
+
   switch(num_args) {
   case 1:
   {
-    #pragma omp task depend(inout: mat[y0 * matrix[graph_id].N + x0]) untied mergeable
-      task1(&mat[y0 * matrix[graph_id].N + x0], payload, payload.graph.output_bytes_size[y0][x0]);
+    #pragma omp task depend(inout: mat[y0 * matrix[graph_id].N + x0]) priority(priority) untied mergeable
+      task1(&mat[y0 * matrix[graph_id].N + x0], payload, payload.graph.output_bytes_at(y0, x0));
     break;
   }
 
@@ -559,9 +793,9 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
   {
     int x1 = args[1].x;
     int y1 = args[1].y;
-    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) untied mergeable
+    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) priority(priority) untied mergeable
       task2(&mat[y0 * matrix[graph_id].N + x0],
-            &mat[y1 * matrix[graph_id].N + x1], payload, payload.graph.output_bytes_size[y0][x0],payload.graph.output_bytes_size[y1][x1]);
+            &mat[y1 * matrix[graph_id].N + x1], payload, payload.graph.output_bytes_at(y0, x0),payload.graph.output_bytes_at(y1, x1));
     break;
   }
 
@@ -573,12 +807,12 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
     int y2 = args[2].y;
   //printf("x1 %d, y1 %d, x2 %d, y2 %d\n", x1, y1, x2, y2);
   //printf("mat1 %ld, mat2 %ld, mat3 %ld", y0 * matrix[graph_id].N + x0, y1 * matrix[graph_id].N + x1, y2 * matrix[graph_id].N + x2);
-    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) untied mergeable
+    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) priority(priority) untied mergeable
       task3(&mat[y0 * matrix[graph_id].N + x0],
             &mat[y1 * matrix[graph_id].N + x1],
             &mat[y2 * matrix[graph_id].N + x2], payload,
-	          payload.graph.output_bytes_size[y0][x0],payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2]);
+	          payload.graph.output_bytes_at(y0, x0),payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2));
     break;
   }
 
@@ -590,12 +824,12 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
     int y2 = args[2].y;
     int x3 = args[3].x;
     int y3 = args[3].y;
-    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) untied mergeable
+    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) priority(priority) untied mergeable
       task4(&mat[y0 * matrix[graph_id].N + x0],
             &mat[y1 * matrix[graph_id].N + x1],
             &mat[y2 * matrix[graph_id].N + x2],
-            &mat[y3 * matrix[graph_id].N + x3], payload, payload.graph.output_bytes_size[y0][x0],payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],payload.graph.output_bytes_size[y3][x3]);
+            &mat[y3 * matrix[graph_id].N + x3], payload, payload.graph.output_bytes_at(y0, x0),payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),payload.graph.output_bytes_at(y3, x3));
     break;
   }
 
@@ -609,14 +843,14 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
     int y3 = args[3].y;
     int x4 = args[4].x;
     int y4 = args[4].y;
-    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) untied mergeable
+    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) priority(priority) untied mergeable
       task5(&mat[y0 * matrix[graph_id].N + x0],
             &mat[y1 * matrix[graph_id].N + x1],
             &mat[y2 * matrix[graph_id].N + x2],
             &mat[y3 * matrix[graph_id].N + x3],
-            &mat[y4 * matrix[graph_id].N + x4], payload, payload.graph.output_bytes_size[y0][x0],payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4]);
+            &mat[y4 * matrix[graph_id].N + x4], payload, payload.graph.output_bytes_at(y0, x0),payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4));
     break;
   }
 
@@ -632,15 +866,15 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
     int y4 = args[4].y;
     int x5 = args[5].x;
     int y5 = args[5].y;
-    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(in: mat[y5 * matrix[graph_id].N + x5]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) untied mergeable
+    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(in: mat[y5 * matrix[graph_id].N + x5]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) priority(priority) untied mergeable
       task6(&mat[y0 * matrix[graph_id].N + x0],
             &mat[y1 * matrix[graph_id].N + x1],
             &mat[y2 * matrix[graph_id].N + x2],
             &mat[y3 * matrix[graph_id].N + x3],
             &mat[y4 * matrix[graph_id].N + x4],
-            &mat[y5 * matrix[graph_id].N + x5], payload, payload.graph.output_bytes_size[y0][x0],payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4],payload.graph.output_bytes_size[y5][x5]);
+            &mat[y5 * matrix[graph_id].N + x5], payload, payload.graph.output_bytes_at(y0, x0),payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4),payload.graph.output_bytes_at(y5, x5));
     break;
   }
 
@@ -658,17 +892,17 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
     int y5 = args[5].y;
     int x6 = args[6].x;
     int y6 = args[6].y;
-    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(in: mat[y5 * matrix[graph_id].N + x5]) depend(in: mat[y6 * matrix[graph_id].N + x6]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) untied mergeable
+    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(in: mat[y5 * matrix[graph_id].N + x5]) depend(in: mat[y6 * matrix[graph_id].N + x6]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) priority(priority) untied mergeable
       task7(&mat[y0 * matrix[graph_id].N + x0],
             &mat[y1 * matrix[graph_id].N + x1],
             &mat[y2 * matrix[graph_id].N + x2],
             &mat[y3 * matrix[graph_id].N + x3],
             &mat[y4 * matrix[graph_id].N + x4],
             &mat[y5 * matrix[graph_id].N + x5],
-            &mat[y6 * matrix[graph_id].N + x6], payload, payload.graph.output_bytes_size[y0][x0],payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4],payload.graph.output_bytes_size[y5][x5],
-            payload.graph.output_bytes_size[y6][x6]);
+            &mat[y6 * matrix[graph_id].N + x6], payload, payload.graph.output_bytes_at(y0, x0),payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4),payload.graph.output_bytes_at(y5, x5),
+            payload.graph.output_bytes_at(y6, x6));
     break;
   }
 
@@ -688,7 +922,7 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
     int y6 = args[6].y;
     int x7 = args[7].x;
     int y7 = args[7].y;
-    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(in: mat[y5 * matrix[graph_id].N + x5]) depend(in: mat[y6 * matrix[graph_id].N + x6]) depend(in: mat[y7 * matrix[graph_id].N + x7]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) untied mergeable
+    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(in: mat[y5 * matrix[graph_id].N + x5]) depend(in: mat[y6 * matrix[graph_id].N + x6]) depend(in: mat[y7 * matrix[graph_id].N + x7]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) priority(priority) untied mergeable
       task8(&mat[y0 * matrix[graph_id].N + x0],
             &mat[y1 * matrix[graph_id].N + x1],
             &mat[y2 * matrix[graph_id].N + x2],
@@ -696,10 +930,10 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
             &mat[y4 * matrix[graph_id].N + x4],
             &mat[y5 * matrix[graph_id].N + x5],
             &mat[y6 * matrix[graph_id].N + x6],
-            &mat[y7 * matrix[graph_id].N + x7], payload, payload.graph.output_bytes_size[y0][x0],payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4],payload.graph.output_bytes_size[y5][x5],
-            payload.graph.output_bytes_size[y6][x6],payload.graph.output_bytes_size[y7][x7]);
+            &mat[y7 * matrix[graph_id].N + x7], payload, payload.graph.output_bytes_at(y0, x0),payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4),payload.graph.output_bytes_at(y5, x5),
+            payload.graph.output_bytes_at(y6, x6),payload.graph.output_bytes_at(y7, x7));
     break;
   }
 
@@ -721,7 +955,7 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
     int y7 = args[7].y;
     int x8 = args[8].x;
     int y8 = args[8].y;
-    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(in: mat[y5 * matrix[graph_id].N + x5]) depend(in: mat[y6 * matrix[graph_id].N + x6]) depend(in: mat[y7 * matrix[graph_id].N + x7]) depend(in: mat[y8 * matrix[graph_id].N + x8]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) untied mergeable
+    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(in: mat[y5 * matrix[graph_id].N + x5]) depend(in: mat[y6 * matrix[graph_id].N + x6]) depend(in: mat[y7 * matrix[graph_id].N + x7]) depend(in: mat[y8 * matrix[graph_id].N + x8]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) priority(priority) untied mergeable
       task9(&mat[y0 * matrix[graph_id].N + x0],
             &mat[y1 * matrix[graph_id].N + x1],
             &mat[y2 * matrix[graph_id].N + x2],
@@ -730,11 +964,11 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
             &mat[y5 * matrix[graph_id].N + x5],
             &mat[y6 * matrix[graph_id].N + x6],
             &mat[y7 * matrix[graph_id].N + x7],
-            &mat[y8 * matrix[graph_id].N + x8], payload, payload.graph.output_bytes_size[y0][x0],payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4],payload.graph.output_bytes_size[y5][x5],
-            payload.graph.output_bytes_size[y6][x6],payload.graph.output_bytes_size[y7][x7],
-            payload.graph.output_bytes_size[y8][x8]);
+            &mat[y8 * matrix[graph_id].N + x8], payload, payload.graph.output_bytes_at(y0, x0),payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4),payload.graph.output_bytes_at(y5, x5),
+            payload.graph.output_bytes_at(y6, x6),payload.graph.output_bytes_at(y7, x7),
+            payload.graph.output_bytes_at(y8, x8));
     break;
   }
 
@@ -758,7 +992,7 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
     int y8 = args[8].y;
     int x9 = args[9].x;
     int y9 = args[9].y;
-    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(in: mat[y5 * matrix[graph_id].N + x5]) depend(in: mat[y6 * matrix[graph_id].N + x6]) depend(in: mat[y7 * matrix[graph_id].N + x7]) depend(in: mat[y8 * matrix[graph_id].N + x8]) depend(in: mat[y9 * matrix[graph_id].N + x9]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) untied mergeable
+    #pragma omp task depend(in: mat[y1 * matrix[graph_id].N + x1]) depend(in: mat[y2 * matrix[graph_id].N + x2]) depend(in: mat[y3 * matrix[graph_id].N + x3]) depend(in: mat[y4 * matrix[graph_id].N + x4]) depend(in: mat[y5 * matrix[graph_id].N + x5]) depend(in: mat[y6 * matrix[graph_id].N + x6]) depend(in: mat[y7 * matrix[graph_id].N + x7]) depend(in: mat[y8 * matrix[graph_id].N + x8]) depend(in: mat[y9 * matrix[graph_id].N + x9]) depend(inout: mat[y0 * matrix[graph_id].N + x0]) priority(priority) untied mergeable
       task10(&mat[y0 * matrix[graph_id].N + x0],
             &mat[y1 * matrix[graph_id].N + x1],
             &mat[y2 * matrix[graph_id].N + x2],
@@ -768,11 +1002,11 @@ void OpenMPApp::insert_task(task_args_t *args, int num_args, payload_t payload,
             &mat[y6 * matrix[graph_id].N + x6],
             &mat[y7 * matrix[graph_id].N + x7],
             &mat[y8 * matrix[graph_id].N + x8],
-            &mat[y9 * matrix[graph_id].N + x9], payload, payload.graph.output_bytes_size[y0][x0],payload.graph.output_bytes_size[y1][x1],
-            payload.graph.output_bytes_size[y2][x2],payload.graph.output_bytes_size[y3][x3],
-            payload.graph.output_bytes_size[y4][x4],payload.graph.output_bytes_size[y5][x5],
-            payload.graph.output_bytes_size[y6][x6],payload.graph.output_bytes_size[y7][x7],
-            payload.graph.output_bytes_size[y8][x8],payload.graph.output_bytes_size[y9][x9]);
+            &mat[y9 * matrix[graph_id].N + x9], payload, payload.graph.output_bytes_at(y0, x0),payload.graph.output_bytes_at(y1, x1),
+            payload.graph.output_bytes_at(y2, x2),payload.graph.output_bytes_at(y3, x3),
+            payload.graph.output_bytes_at(y4, x4),payload.graph.output_bytes_at(y5, x5),
+            payload.graph.output_bytes_at(y6, x6),payload.graph.output_bytes_at(y7, x7),
+            payload.graph.output_bytes_at(y8, x8),payload.graph.output_bytes_at(y9, x9));
     break;
   }
 
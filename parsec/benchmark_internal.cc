@@ -25,6 +25,40 @@
 
 #define USE_CORE_VERIFICATION
 
+static bool point_active(const TaskGraph &graph, long t, long x)
+{
+  long offset = graph.offset_at_timestep(t);
+  return t >= 0 && t < graph.timesteps && x >= offset && x < offset + graph.width_at_timestep(t);
+}
+
+// Calls f(slot, point) for each active input of (t, x), and stops early
+// once f returns true.
+template <typename F>
+static void for_each_input(const TaskGraph &graph, long t, long x, F f)
+{
+  if (t == 0) return;
+  int slot = 0;
+  bool done = false;
+  graph.for_each_dependency_point(graph.dependence_set_at_timestep(t), x, [&](long dep) {
+    if (!done && point_active(graph, t-1, dep)) {
+      done = f(slot++, dep);
+    }
+  });
+}
+
+template <typename F>
+static void for_each_output(const TaskGraph &graph, long t, long x, F f)
+{
+  if (t == graph.timesteps - 1) return;
+  int slot = 0;
+  bool done = false;
+  graph.for_each_reverse_dependency_point(graph.dependence_set_at_timestep(t+1), x, [&](long dep) {
+    if (!done && point_active(graph, t+1, dep)) {
+      done = f(slot++, dep);
+    }
+  });
+}
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -300,5 +334,96 @@ int get_num_args_out(task_graph_t g, int t, int x, int out_first, int out_last)
     return out_last - out_first + 2;
 }
 
+
+int CORE_kernel_n(parsec_execution_stream_t *es, task_graph_t g, float *out, float **in,
+                  int n_inputs, int x, int t, int graph_idx, int my_rank, char **extra_local_memory)
+{
+  TaskGraph graph(g);
+
+  std::vector<const char *> input_ptrs(n_inputs);
+  std::vector<size_t> input_bytes(n_inputs, graph.output_bytes_per_task);
+  for (int i = 0; i < n_inputs; i++) {
+    assert(in[i] != NULL);
+    input_ptrs[i] = (const char *)in[i];
+  }
+
+  graph.execute_point(t, x, (char *)out, graph.output_bytes_per_task,
+                      input_ptrs.data(), input_bytes.data(), input_ptrs.size(),
+                      extra_local_memory[es->core_id], graph.scratch_bytes_per_task);
+
+#if defined (TRACK_NB_TASKS)
+  nb_tasks_per_node[es->core_id] ++;
+#endif
+
+  return PARSEC_HOOK_RETURN_DONE;
+}
+
+int get_num_inputs(task_graph_t g, int t, int x) {
+  TaskGraph graph(g);
+  int count = 0;
+  for_each_input(graph, t, x, [&](int slot, long dep) { count++; return false; });
+  return count;
+}
+
+int get_input_point(task_graph_t g, int t, int x, int slot) {
+  TaskGraph graph(g);
+  int point = -1;
+  for_each_input(graph, t, x, [&](int s, long dep) {
+    if (s == slot) point = dep;
+    return point >= 0;
+  });
+  return point;
+}
+
+int get_input_slot(task_graph_t g, int t, int x, int point) {
+  TaskGraph graph(g);
+  int slot = -1;
+  for_each_input(graph, t, x, [&](int s, long dep) {
+    if (dep == point) slot = s;
+    return slot >= 0;
+  });
+  return slot;
+}
+
+int get_num_outputs(task_graph_t g, int t, int x) {
+  TaskGraph graph(g);
+  int count = 0;
+  for_each_output(graph, t, x, [&](int slot, long dep) { count++; return false; });
+  return count;
+}
+
+int get_output_point(task_graph_t g, int t, int x, int slot) {
+  TaskGraph graph(g);
+  int point = -1;
+  for_each_output(graph, t, x, [&](int s, long dep) {
+    if (s == slot) point = dep;
+    return point >= 0;
+  });
+  return point;
+}
+
+int get_output_slot(task_graph_t g, int t, int x, int point) {
+  TaskGraph graph(g);
+  int slot = -1;
+  for_each_output(graph, t, x, [&](int s, long dep) {
+    if (dep == point) slot = s;
+    return slot >= 0;
+  });
+  return slot;
+}
+
+int get_max_inputs(task_graph_t g) {
+  TaskGraph graph(g);
+  int max_inputs = 0;
+  for (long t = 1; t < graph.timesteps; t++) {
+    long offset = graph.offset_at_timestep(t);
+    long width = graph.width_at_timestep(t);
+    for (long x = offset; x < offset + width; x++) {
+      max_inputs = std::max(max_inputs, get_num_inputs(g, t, x));
+    }
+  }
+  return max_inputs;
+}
+
 }
 #endif  /* end __cplusplus */
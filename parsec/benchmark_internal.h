@@ -43,6 +43,25 @@ extern int get_num_args(task_graph_t g, int t, int x, int in_first, int in_last)
 
 extern int get_num_args_out(task_graph_t g, int t, int x, int out_first, int out_last);
 
+/* Used by the generated PTG: inputs and outputs are numbered in the
+ * order of the core's dependency functions, skipping inactive points. */
+extern int CORE_kernel_n(parsec_execution_stream_t *es, task_graph_t graph, float *out, float **in,
+                         int n_inputs, int x, int t, int graph_idx, int my_rank, char **extra_local_memory);
+
+extern int get_num_inputs(task_graph_t g, int t, int x);
+
+extern int get_input_point(task_graph_t g, int t, int x, int slot);
+
+extern int get_input_slot(task_graph_t g, int t, int x, int point);
+
+extern int get_num_outputs(task_graph_t g, int t, int x);
+
+extern int get_output_point(task_graph_t g, int t, int x, int slot);
+
+extern int get_output_slot(task_graph_t g, int t, int x, int point);
+
+extern int get_max_inputs(task_graph_t g);
+
 extern int nb_tasks_per_node[32];
 
 extern int parsec_stencil_1d(parsec_context_t *parsec,
@@ -73,12 +92,20 @@ extern parsec_taskpool_t*
 parsec_spread_radix5_period3_New(parsec_tiled_matrix_dc_t *A, task_graph_t graph, int nb_fields,
                            int time_steps, int graph_idx, char **extra_local_memory);
 
+extern parsec_taskpool_t*
+parsec_task_bench_ptg_New(parsec_tiled_matrix_dc_t *A, task_graph_t graph, int nb_fields,
+                          int time_steps, int graph_idx, char **extra_local_memory);
+
+extern int parsec_task_bench_ptg_max_inputs(void);
+
 extern void parsec_stencil_1d_Destruct(parsec_taskpool_t *taskpool);
 
 extern void parsec_nearest_radix_5_Destruct(parsec_taskpool_t *taskpool);
 
 extern void parsec_spread_radix5_period3_Destruct(parsec_taskpool_t *taskpool);
 
+extern void parsec_task_bench_ptg_Destruct(parsec_taskpool_t *taskpool);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,169 @@
+#!/usr/bin/env python3
+
+# Copyright 2020 Stanford University
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Generates a PTG (JDF) that runs any task graph, by calling the core's
+# dependency functions from the dependence expressions.
+#
+# A PTG flow names the flow it feeds statically, so each edge between
+# a producer and a consumer is its own (empty) edge task: the producer
+# fans out to edge(t, x, 0 .. n_outputs-1), and each edge task knows
+# which input slot of its consumer it feeds. Task classes have a fixed
+# number of flows, so the maximum number of inputs is a parameter.
+
+import argparse
+
+header = '''extern "C" %%{
+/* Generated by gen_ptg.py, do not edit. */
+#include <parsec/data_dist/matrix/matrix.h>
+#include "benchmark_internal.h"
+#include "core_c.h"
+
+#define PTG_MAX_INPUTS %(max_inputs)d
+
+%%}
+
+descA       [ type = "parsec_tiled_matrix_dc_t*" ]
+graph       [ type = "task_graph_t" ]
+nb_fields   [ type = "int" ]
+time_steps  [ type = "int" ]
+graph_idx   [ type = "int" ]
+extra_local_memory   [ type = "char**" ]
+'''
+
+edge = '''
+edge(t, x, r)
+
+t = 0 .. time_steps-2
+
+offset = %%{ return task_graph_offset_at_timestep(graph, t); %%}
+width = %%{ return task_graph_width_at_timestep(graph, t); %%}
+
+x = offset .. offset+width-1
+
+n_outputs = %%{ return get_num_outputs(graph, t, x); %%}
+
+r = 0 .. n_outputs-1
+
+y = %%{ return get_output_point(graph, t, x, r); %%}
+slot = %%{ return get_input_slot(graph, t+1, y, x); %%}
+
+: descA((t+1) %% nb_fields, y)
+
+READ E <- A task(t, x)
+%(outputs)s
+BODY
+{
+}
+END
+'''
+
+task = '''
+task(t, x)
+
+t = 0 .. time_steps-1
+
+offset = %%{ return task_graph_offset_at_timestep(graph, t); %%}
+width = %%{ return task_graph_width_at_timestep(graph, t); %%}
+
+x = offset .. offset+width-1
+m = t %% nb_fields
+
+n_inputs = %%{ return get_num_inputs(graph, t, x); %%}
+n_outputs = %%{ return get_num_outputs(graph, t, x); %%}
+
+: descA(m, x)
+
+%(inputs)s
+
+RW A <- descA(m, x)
+     -> (n_outputs > 0)? E edge(t, x, 0 .. n_outputs-1)
+     -> descA(m, x)
+
+BODY
+{
+    float *inputs[PTG_MAX_INPUTS] = { %(input_list)s };
+    CORE_kernel_n(es, graph, (float *)A, inputs, n_inputs, x, t, graph_idx, descA->super.myrank, extra_local_memory);
+}
+END
+'''
+
+footer = '''
+extern "C" %{
+
+int parsec_task_bench_ptg_max_inputs(void)
+{
+    return PTG_MAX_INPUTS;
+}
+
+parsec_taskpool_t*
+parsec_task_bench_ptg_New(parsec_tiled_matrix_dc_t *A, task_graph_t graph, int nb_fields,
+                          int time_steps, int graph_idx, char **extra_local_memory)
+{
+    parsec_task_bench_ptg_taskpool_t* taskpool = NULL;
+
+    taskpool = parsec_task_bench_ptg_new(A, graph, nb_fields, time_steps, graph_idx, extra_local_memory);
+
+    parsec_matrix_add2arena(&(taskpool->arenas_datatypes[PARSEC_task_bench_ptg_DEFAULT_ARENA]),
+                            parsec_datatype_float_t, matrix_UpperLower,
+                            1, A->mb, A->nb, A->mb,
+                            PARSEC_ARENA_ALIGNMENT_SSE, -1 );
+
+    return (parsec_taskpool_t*)taskpool;
+}
+
+void parsec_task_bench_ptg_Destruct(parsec_taskpool_t *taskpool)
+{
+    parsec_task_bench_ptg_taskpool_t *task_bench_ptg_taskpool = (parsec_task_bench_ptg_taskpool_t *)taskpool;
+    parsec_matrix_del2arena(&(task_bench_ptg_taskpool->arenas_datatypes[PARSEC_task_bench_ptg_DEFAULT_ARENA]));
+    parsec_taskpool_free(taskpool);
+}
+
+%}
+'''
+
+def input_dep(slot):
+    point = '%%{ return get_input_point(graph, t, x, %d); %%}' % slot
+    edge_index = '%%{ return get_output_slot(graph, t-1, get_input_point(graph, t, x, %d), x); %%}' % slot
+    return 'READ IN%d <- (n_inputs > %d)? E edge(t-1, %s, %s) : NULL' % (slot, slot, point, edge_index)
+
+def output_dep(slot):
+    return '       -> (slot == %d)? IN%d task(t+1, y)' % (slot, slot)
+
+def generate(max_inputs):
+    slots = range(max_inputs)
+    return ''.join([
+        header % {'max_inputs': max_inputs},
+        edge % {'outputs': '\n'.join(map(output_dep, slots))},
+        task % {
+            'inputs': '\n'.join(map(input_dep, slots)),
+            'input_list': ', '.join('(float *)IN%d' % slot for slot in slots),
+        },
+        footer,
+    ])
+
+def driver():
+    parser = argparse.ArgumentParser()
+    parser.add_argument('max_inputs', type=int)
+    parser.add_argument('-o', '--output', default='task_bench_ptg.jdf')
+    args = parser.parse_args()
+    if args.max_inputs < 1:
+        parser.error('max_inputs must be at least 1')
+    with open(args.output, 'w') as f:
+        f.write(generate(args.max_inputs))
+
+if __name__ == '__main__':
+    driver()
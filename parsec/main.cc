@@ -513,20 +513,20 @@ void ParsecApp::insert_task(int num_args, payload_t payload, std::vector<parsec_
   nb_tasks ++;
   switch(num_args) {
   case 1:
-    parsec_dtd_taskpool_insert_task(dtd_tp, test_task1,    0,  "test_task1",
+    parsec_dtd_taskpool_insert_task(dtd_tp, test_task1,    payload.graph.priority,  "test_task1",
                                     sizeof(payload_t), &payload, VALUE,
                                     PASSED_BY_REF,  args[0], INOUT | TILE_FULL | AFFINITY,
                                     PARSEC_DTD_ARG_END);
     break;
   case 2:
-    parsec_dtd_taskpool_insert_task(dtd_tp, test_task2,    0,  "test_task2",
+    parsec_dtd_taskpool_insert_task(dtd_tp, test_task2,    payload.graph.priority,  "test_task2",
                                     sizeof(payload_t), &payload, VALUE,
                                     PASSED_BY_REF,  args[1], INPUT | TILE_FULL,
                                     PASSED_BY_REF,  args[0], INOUT | TILE_FULL | AFFINITY,
                                     PARSEC_DTD_ARG_END);
     break;
   case 3:
-    parsec_dtd_taskpool_insert_task(dtd_tp, test_task3,    0,  "test_task3",
+    parsec_dtd_taskpool_insert_task(dtd_tp, test_task3,    payload.graph.priority,  "test_task3",
                                     sizeof(payload_t), &payload, VALUE,
                                     PASSED_BY_REF,  args[1], INPUT | TILE_FULL,
                                     PASSED_BY_REF,  args[2], INPUT | TILE_FULL,
@@ -534,7 +534,7 @@ void ParsecApp::insert_task(int num_args, payload_t payload, std::vector<parsec_
                                     PARSEC_DTD_ARG_END);
     break;
   case 4:
-    parsec_dtd_taskpool_insert_task(dtd_tp, test_task4,    0,  "test_task4",
+    parsec_dtd_taskpool_insert_task(dtd_tp, test_task4,    payload.graph.priority,  "test_task4",
                                     sizeof(payload_t), &payload, VALUE,
                                     PASSED_BY_REF,  args[1], INPUT | TILE_FULL,
                                     PASSED_BY_REF,  args[2], INPUT | TILE_FULL,
@@ -543,7 +543,7 @@ void ParsecApp::insert_task(int num_args, payload_t payload, std::vector<parsec_
                                     PARSEC_DTD_ARG_END);
     break;
   case 5:
-    parsec_dtd_taskpool_insert_task(dtd_tp, test_task5,    0,  "test_task5",
+    parsec_dtd_taskpool_insert_task(dtd_tp, test_task5,    payload.graph.priority,  "test_task5",
                                     sizeof(payload_t), &payload, VALUE,
                                     PASSED_BY_REF,  args[1], INPUT | TILE_FULL,
                                     PASSED_BY_REF,  args[2], INPUT | TILE_FULL,
@@ -553,7 +553,7 @@ void ParsecApp::insert_task(int num_args, payload_t payload, std::vector<parsec_
                                     PARSEC_DTD_ARG_END);
     break;
   case 6:
-    parsec_dtd_taskpool_insert_task(dtd_tp, test_task6,    0,  "test_task6",
+    parsec_dtd_taskpool_insert_task(dtd_tp, test_task6,    payload.graph.priority,  "test_task6",
                                     sizeof(payload_t), &payload, VALUE,
                                     PASSED_BY_REF,  args[1], INPUT | TILE_FULL,
                                     PASSED_BY_REF,  args[2], INPUT | TILE_FULL,
@@ -564,7 +564,7 @@ void ParsecApp::insert_task(int num_args, payload_t payload, std::vector<parsec_
                                     PARSEC_DTD_ARG_END);
     break;
   case 7:
-    parsec_dtd_taskpool_insert_task(dtd_tp, test_task7,    0,  "test_task7",
+    parsec_dtd_taskpool_insert_task(dtd_tp, test_task7,    payload.graph.priority,  "test_task7",
                                     sizeof(payload_t), &payload, VALUE,
                                     PASSED_BY_REF,  args[1], INPUT | TILE_FULL,
                                     PASSED_BY_REF,  args[2], INPUT | TILE_FULL,
@@ -576,7 +576,7 @@ void ParsecApp::insert_task(int num_args, payload_t payload, std::vector<parsec_
                                     PARSEC_DTD_ARG_END);
     break;
   case 8:
-    parsec_dtd_taskpool_insert_task(dtd_tp, test_task8,    0,  "test_task8",
+    parsec_dtd_taskpool_insert_task(dtd_tp, test_task8,    payload.graph.priority,  "test_task8",
                                     sizeof(payload_t), &payload, VALUE,
                                     PASSED_BY_REF,  args[1], INPUT | TILE_FULL,
                                     PASSED_BY_REF,  args[2], INPUT | TILE_FULL,
@@ -589,7 +589,7 @@ void ParsecApp::insert_task(int num_args, payload_t payload, std::vector<parsec_
                                     PARSEC_DTD_ARG_END);
     break;
   case 9:
-    parsec_dtd_taskpool_insert_task(dtd_tp, test_task9,    0,  "test_task9",
+    parsec_dtd_taskpool_insert_task(dtd_tp, test_task9,    payload.graph.priority,  "test_task9",
                                     sizeof(payload_t), &payload, VALUE,
                                     PASSED_BY_REF,  args[1], INPUT | TILE_FULL,
                                     PASSED_BY_REF,  args[2], INPUT | TILE_FULL,
@@ -603,7 +603,7 @@ void ParsecApp::insert_task(int num_args, payload_t payload, std::vector<parsec_
                                     PARSEC_DTD_ARG_END);
     break;
   case 10:
-    parsec_dtd_taskpool_insert_task(dtd_tp, test_task10,    0,  "test_task10",
+    parsec_dtd_taskpool_insert_task(dtd_tp, test_task10,    payload.graph.priority,  "test_task10",
                                     sizeof(payload_t), &payload, VALUE,
                                     PASSED_BY_REF,  args[1], INPUT | TILE_FULL,
                                     PASSED_BY_REF,  args[2], INPUT | TILE_FULL,
@@ -803,18 +803,12 @@ void ParsecApp::execute_main_loop()
   /* start parsec context */
   parsec_context_start(parsec);
   
-  int x, y;
-  
+  for (auto step : issue_order()) {
+    execute_timestep(step.first, step.second);
+  }
+
   for (int i = 0; i < graphs.size(); i++) {
-    const TaskGraph &g = graphs[i];
     matrix_t &mat = mat_array[i];
-
-    debug_printf(0, "rank %d, pid %d, M %d, N %d, MT %d, NT %d, nb_fields %d, timesteps %d\n", rank, getpid(), mat.M, mat.N, mat.MT, mat.NT, nb_fields, g.timesteps);
-
-    for (y = 0; y < g.timesteps; y++) {
-      execute_timestep(i, y);
-    }
-
     parsec_dtd_data_flush_all( dtd_tp, (parsec_data_collection_t *)&(mat.dcC) );
   }
 
@@ -61,7 +61,9 @@ typedef struct payload_s {
   int i;
   int j;
   TaskGraph graph;
-  size_t* output_bytes_size;
+  // Output bytes of the task, then of each input, at their timesteps.
+  // Held by value so that it travels with the payload.
+  size_t output_bytes_size[10];
 }payload_t;
 
 static inline int
@@ -616,10 +618,6 @@ private:
 void ParsecApp::insert_task(int num_args, payload_t payload, std::vector<parsec_dtd_tile_t*> &args)
 {
   nb_tasks ++;
-  printf("check output bytes\n");
-  for (int i = 0; i < num_args; ++i) {
-    printf("%d: %ld\n", i, payload.output_bytes_size[i]);
-  }
   switch(num_args) {
   case 1:
     parsec_dtd_taskpool_insert_task(dtd_tp, test_task1,    0,  "test_task1",
@@ -808,7 +806,8 @@ ParsecApp::ParsecApp(int argc, char **argv)
 
     debug_printf(0, "output_bytes_per_task %d, mb %d, nb %d\n", graph.output_bytes_per_task, mat.MB, mat.NB);
 
-    assert(graph.output_bytes_per_task <= sizeof(float) * mat.MB * mat.NB);
+    // Tiles hold the largest output; tasks see their exact sizes.
+    assert(graph.max_output_bytes() <= sizeof(float) * mat.MB * mat.NB);
 
     two_dim_block_cyclic_init(&mat.dcC, matrix_RealFloat, matrix_Tile,
                                nodes, rank, mat.MB, mat.NB, mat.M, mat.N, 0, 0,
@@ -977,7 +976,6 @@ void ParsecApp::execute_timestep(size_t idx, long t)
     std::vector<std::pair<long, long> > deps = g.dependencies(dset, x);
     int num_args;
     int output_index = 0;
-    payload.output_bytes_size = new size_t [10];
 #ifdef ENABLE_PRUNE_MPI_TASK_INSERT
     int has_task = 0;
     if(rank == mat.__dcC->super.super.rank_of(&mat.__dcC->super.super, t%nb_fields, x)) {
@@ -1020,21 +1018,18 @@ void ParsecApp::execute_timestep(size_t idx, long t)
     if (deps.size() == 0) {
       num_args = 1;
       debug_printf(1, "%d[%d] ", x, num_args);
-      payload.output_bytes_size[output_index++] = g.output_bytes_size[t%nb_fields][x];
-      printf("execute timestep: index %d;t: %d;x:%d; output:%ld\n", output_index, t%nb_fields, x, payload.output_bytes_size[output_index-1]);
+      payload.output_bytes_size[output_index++] = g.output_bytes_at(t, x);
       args.push_back(TILE_OF_MAT(C, t%nb_fields, x));
     } else {
       if (t == 0) {
         num_args = 1;
         debug_printf(1, "%d[%d]\n ", x, num_args);
-        payload.output_bytes_size[output_index++] = g.output_bytes_size[t%nb_fields][x];
-        printf("execute timestep: index %d;t: %d;x:%d; output:%ld\n", output_index, t%nb_fields, x, payload.output_bytes_size[output_index-1]);
+        payload.output_bytes_size[output_index++] = g.output_bytes_at(t, x);
         args.push_back(TILE_OF_MAT(C, t%nb_fields, x));
       } else {
         num_args = 1;
         args.push_back(TILE_OF_MAT(C, t%nb_fields, x));
-        payload.output_bytes_size[output_index++] = g.output_bytes_size[t%nb_fields][x];
-        printf("execute timestep: index %d;t: %d;x:%d; output:%ld\n", output_index, t%nb_fields, x, payload.output_bytes_size[output_index-1]);
+        payload.output_bytes_size[output_index++] = g.output_bytes_at(t, x);
         long last_offset = g.offset_at_timestep(t-1);
         long last_width = g.width_at_timestep(t-1);
         for (std::pair<long, long> dep : deps) {
@@ -1043,8 +1038,7 @@ void ParsecApp::execute_timestep(size_t idx, long t)
           for (int i = dep.first; i <= dep.second; i++) {
             if (i >= last_offset && i < last_offset + last_width) {
               args.push_back(TILE_OF_MAT(C, (t-1)%nb_fields, i));
-              payload.output_bytes_size[output_index++] = g.output_bytes_size[t%nb_fields][x];
-              printf("execute timestep: index %d;t: %d;x:%d; output:%ld\n", output_index, t%nb_fields, x, payload.output_bytes_size[output_index-1]);
+              payload.output_bytes_size[output_index++] = g.output_bytes_at(t-1, i);
             } else {
               num_args --;
             }
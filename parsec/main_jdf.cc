@@ -31,6 +31,9 @@
 
 #define MAX_ARGS  4
 
+// Use the generated PTG even for patterns with a hand-written one.
+#define GENERIC_FLAG "-generic"
+
 #define VERBOSE_LEVEL 0
 
 #define USE_CORE_VERIFICATION
@@ -85,6 +88,8 @@ private:
   int iparam[IPARAM_SIZEOF];
   int nb_tasks;
   int nb_fields;
+  bool generic;
+  bool use_generic(const TaskGraph &g) const;
 };
 
 ParsecApp::ParsecApp(int argc, char **argv)
@@ -108,11 +113,15 @@ ParsecApp::ParsecApp(int argc, char **argv)
   nb_fields = 0;
   
   int nb_fields_arg = 0;
+  generic = false;
   
   for (int i = 1; i < argc; i++) {
     if (!strcmp(argv[i], "-field")) {
       nb_fields_arg = atol(argv[++i]);
     }
+    if (!strcmp(argv[i], GENERIC_FLAG)) {
+      generic = true;
+    }
   }
   
   parsec = setup_parsec(argc, argv, iparam);
@@ -198,6 +207,12 @@ ParsecApp::ParsecApp(int argc, char **argv)
     /* matrix generation */
     //dplasma_dplrnt( parsec, 0, (parsec_tiled_matrix_dc_t *)&dcC, Cseed);
                             
+    if (use_generic(graph) && get_max_inputs(graph) > parsec_task_bench_ptg_max_inputs()) {
+      fprintf(stderr, "error: graph %d needs %d inputs per task, but the generated PTG has %d (rebuild with PTG_MAX_INPUTS=%d)\n",
+              i, get_max_inputs(graph), parsec_task_bench_ptg_max_inputs(), get_max_inputs(graph));
+      abort();
+    }
+
     if (graph.scratch_bytes_per_task > max_scratch_bytes_per_task) {
       max_scratch_bytes_per_task = graph.scratch_bytes_per_task;
     }
@@ -237,6 +252,16 @@ ParsecApp::~ParsecApp()
   
 }
 
+bool ParsecApp::use_generic(const TaskGraph &g) const
+{
+  if (generic) {
+    return true;
+  }
+  return !(g.dependence == DependenceType::STENCIL_1D ||
+           (g.dependence == DependenceType::NEAREST && g.radix == 5) ||
+           (g.dependence == DependenceType::SPREAD && g.radix == 5 && g.timestep_period() == 3));
+}
+
 void ParsecApp::execute_main_loop()
 {
   
@@ -261,7 +286,9 @@ void ParsecApp::execute_main_loop()
 
     debug_printf(0, "rank %d, pid %d, M %d, N %d, MT %d, NT %d, nb_fields %d, timesteps %d\n", rank, getpid(), mat.M, mat.N, mat.MT, mat.NT, nb_fields, g.timesteps);
     
-    if (g.dependence == DependenceType::STENCIL_1D) {
+    if (use_generic(g)) {
+      tp[i] = parsec_task_bench_ptg_New((parsec_tiled_matrix_dc_t *)&mat, g, nb_fields, g.timesteps, i, extra_local_memory);
+    } else if (g.dependence == DependenceType::STENCIL_1D) {
       //parsec_stencil_1d(parsec, (parsec_tiled_matrix_dc_t *)&mat, g, nb_fields, g.timesteps, i, extra_local_memory);
       tp[i] = parsec_stencil_1d_New((parsec_tiled_matrix_dc_t *)&mat, g, nb_fields, g.timesteps, i, extra_local_memory); 
     } else if (g.dependence == DependenceType::NEAREST && g.radix == 5) {
@@ -270,9 +297,6 @@ void ParsecApp::execute_main_loop()
     } else if (g.dependence == DependenceType::SPREAD && g.radix == 5) {
       //parsec_spread_radix5_period3(parsec, (parsec_tiled_matrix_dc_t *)&mat, g, nb_fields, g.timesteps, i, extra_local_memory);
       tp[i] = parsec_spread_radix5_period3_New((parsec_tiled_matrix_dc_t *)&mat, g, nb_fields, g.timesteps, i, extra_local_memory); 
-    } else {
-      assert(0);
-      parsec_benchmark(parsec, (parsec_tiled_matrix_dc_t *)&mat, g, nb_fields, g.timesteps, i, extra_local_memory);
     }
     assert(tp[i] != NULL);
     parsec_enqueue(parsec, tp[i]);
@@ -284,14 +308,14 @@ void ParsecApp::execute_main_loop()
   for (int i = 0; i < graphs.size(); i++) {
     const TaskGraph &g = graphs[i];
     
-    if (g.dependence == DependenceType::STENCIL_1D) {
+    if (use_generic(g)) {
+      parsec_task_bench_ptg_Destruct(tp[i]);
+    } else if (g.dependence == DependenceType::STENCIL_1D) {
       parsec_stencil_1d_Destruct(tp[i]);
     } else if (g.dependence == DependenceType::NEAREST && g.radix == 5) {
       parsec_nearest_radix_5_Destruct(tp[i]);
     } else if (g.dependence == DependenceType::SPREAD && g.radix == 5) {
       parsec_spread_radix5_period3_Destruct(tp[i]);
-    } else {
-      assert(0);
     }
     tp[i] = NULL;
   }
@@ -712,28 +712,25 @@ void shard_task(const void *args, size_t arglen, const void *userdata,
           preconditions.insert(preconditions.begin(),
                                copy_postconditions.at(point - first_point).at(fid - FID_FIRST).begin(),
                                copy_postconditions.at(point - first_point).at(fid - FID_FIRST).end());
-          const auto &dset_deps = graph.dependencies(dset, point);
-          for (auto interval : dset_deps) {
-            for (long dep = interval.first; dep <= interval.second; ++dep) {
-              Barrier &ready = raw_in.at(graph_index).at(point - first_point).at(last_fid - FID_FIRST).at(dep);
-              preconditions.push_back(ready.get_previous_phase());
-
-              if (dep >= last_offset && dep < last_offset + last_width) {
-                char *data = result_base.at(graph_index).at(dep).at(last_fid - FID_FIRST);
-                if (point >= offset && point < offset + width) {
-                  if (data && !force_copies) {
-                    // Data available locally
-                  } else {
-                    // Data is remote
-                    data = input_base.at(graph_index).at(point - first_point).at(slot).at(last_fid - FID_FIRST);
-                  }
+          graph.for_each_dependency_point(dset, point, [&](long dep) {
+            Barrier &ready = raw_in.at(graph_index).at(point - first_point).at(last_fid - FID_FIRST).at(dep);
+            preconditions.push_back(ready.get_previous_phase());
+
+            if (dep >= last_offset && dep < last_offset + last_width) {
+              char *data = result_base.at(graph_index).at(dep).at(last_fid - FID_FIRST);
+              if (point >= offset && point < offset + width) {
+                if (data && !force_copies) {
+                  // Data available locally
+                } else {
+                  // Data is remote
+                  data = input_base.at(graph_index).at(point - first_point).at(slot).at(last_fid - FID_FIRST);
                 }
-                input_ptr.at(n_inputs) = reinterpret_cast<uintptr_t>(data);
-                n_inputs++;
               }
-              slot++;
+              input_ptr.at(n_inputs) = reinterpret_cast<uintptr_t>(data);
+              n_inputs++;
             }
-          }
+            slot++;
+          });
 
           // Dependencies can occur in one of two ways:
           //  1. The dependent task is local, so copy is not necessary.
@@ -742,28 +739,23 @@ void shard_task(const void *args, size_t arglen, const void *userdata,
           //     (In this case the dependency catches on the copy.)
 
           // WAR dependencies (part 1)
-          for (auto interval : graph.reverse_dependencies(last_field_dset, point)) {
-            for (long dep = interval.first; dep <= interval.second; ++dep) {
-              if (dep >= last_field_offset && dep < last_field_offset + last_field_width) {
-                // Only copy when the dependent task doesn't live in the same address space.
-                if (!force_copies && result_base.at(graph_index).at(dep).at(last_fid - FID_FIRST)) {
-                  Barrier &ready = war_in.at(graph_index).at(point - first_point).at(fid - FID_FIRST).at(dep);
-                  preconditions.push_back(ready.get_previous_phase());
-                }
+          graph.for_each_reverse_dependency_point(last_field_dset, point, [&](long dep) {
+            if (dep >= last_field_offset && dep < last_field_offset + last_field_width) {
+              // Only copy when the dependent task doesn't live in the same address space.
+              if (!force_copies && result_base.at(graph_index).at(dep).at(last_fid - FID_FIRST)) {
+                Barrier &ready = war_in.at(graph_index).at(point - first_point).at(fid - FID_FIRST).at(dep);
+                preconditions.push_back(ready.get_previous_phase());
               }
             }
-          }
+          });
 
           // WAR dependencies (part 2)
-          const auto &next_dset_rev_deps = graph.reverse_dependencies(next_dset, point);
-          for (auto interval : next_dset_rev_deps) {
-            for (long dep = interval.first; dep <= interval.second; ++dep) {
-              if (force_copies || !result_base.at(graph_index).at(dep).at(last_fid - FID_FIRST)) {
-                Barrier &ready = war_in.at(graph_index).at(point - first_point).at(fid - FID_FIRST).at(dep);
-                preconditions.push_back(ready.get_previous_phase());
-              }
+          graph.for_each_reverse_dependency_point(next_dset, point, [&](long dep) {
+            if (force_copies || !result_base.at(graph_index).at(dep).at(last_fid - FID_FIRST)) {
+              Barrier &ready = war_in.at(graph_index).at(point - first_point).at(fid - FID_FIRST).at(dep);
+              preconditions.push_back(ready.get_previous_phase());
             }
-          }
+          });
 
           // Launch task
           Event task_postcondition = Event::NO_EVENT;
@@ -472,7 +472,8 @@ void shard_task(const void *args, size_t arglen, const void *userdata,
     std::vector<Barrier> output_barriers(NUM_OUTPUT_REGIONS,
                                          Barrier::NO_BARRIER);
 
-    start_time = Timer::get_cur_time();
+    // Reduced across nodes below, so on a clock they share.
+    start_time = Timer::get_wall_time();
     for (size_t graph_num = 0; graph_num < graphs.size(); graph_num++) {
       TaskGraph graph = graphs[graph_num];
       size_t output_bytes = graph.output_bytes_per_task;
@@ -712,7 +713,7 @@ void shard_task(const void *args, size_t arglen, const void *userdata,
       }
     }
     Event::merge_events(events).wait();
-    time_elapsed = Timer::get_cur_time();
+    time_elapsed = Timer::get_wall_time();
   }
   // printf("taskid: %d, total_time: %f\n", taskid, time_elapsed - start_time);
   a.first_start.arrive(1, Event::NO_EVENT, &start_time, sizeof(start_time));
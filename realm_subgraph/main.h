@@ -34,6 +34,7 @@ public:
   long num_procs;
   long num_fields;
   bool force_copies;
+  long pipeline;
   Realm::Memory sysmem;
   Realm::Memory regmem;
   Realm::Barrier sync;
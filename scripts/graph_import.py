@@ -0,0 +1,298 @@
+#!/usr/bin/env python3
+
+# Copyright 2020 Stanford University
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#     http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#
+
+# Converts a DAG in Graphviz DOT or Chrome trace JSON format into the
+# binary graph file read by -graph-file (layout in core/graph_file.h).
+#
+# DOT: every node is a task and every edge a dependency; the node
+# attributes "iterations" and "output" (bytes) override --iter and
+# --output.
+#
+# Chrome trace: every complete event (ph X, or a B/E pair) is a task with
+# dur * --iter-per-us iterations. Consecutive events on a thread depend on
+# each other, and so do the events bound to consecutive steps of a flow
+# (ph s/t/f). args.output_bytes overrides --output.
+#
+# Tasks are levelized by their longest path from a source, and edges that
+# skip levels go through forwarding tasks (no iterations, the output of
+# their source), since task bench only connects consecutive timesteps.
+
+import argparse
+import array
+import bisect
+import collections
+import json
+import re
+import sys
+
+MAGIC = b'TBGRAPH1'
+MIN_OUTPUT_BYTES = 16
+
+class Graph:
+    def __init__(self):
+        self.index = {}
+        self.iterations = []
+        self.output = []
+        self.edges = []
+
+    def node(self, name, iterations, output):
+        if name not in self.index:
+            self.index[name] = len(self.iterations)
+            self.iterations.append(iterations)
+            self.output.append(output)
+        return self.index[name]
+
+DOT_TOKEN = re.compile(r'"(?:[^"\\]|\\.)*"|->|--|[{}\[\];,=]|[^\s{}\[\];,="]+')
+DOT_COMMENT = re.compile(r'/\*.*?\*/|//[^\n]*|^\s*#[^\n]*', re.S | re.M)
+
+def unquote(token):
+    if token.startswith('"'):
+        return token[1:-1].replace('\\"', '"')
+    return token
+
+def parse_dot(text, iterations, output):
+    graph = Graph()
+    tokens = DOT_TOKEN.findall(DOT_COMMENT.sub('', text))
+    i = 0
+
+    def attributes():
+        nonlocal i
+        attrs = {}
+        while i < len(tokens) and tokens[i] == '[':
+            i += 1
+            while tokens[i] != ']':
+                key = unquote(tokens[i])
+                i += 1
+                if tokens[i] == '=':
+                    attrs[key] = unquote(tokens[i+1])
+                    i += 2
+                if tokens[i] in (',', ';'):
+                    i += 1
+            i += 1
+        return attrs
+
+    def add_node(name, attrs):
+        index = graph.node(name, iterations, output)
+        if 'iterations' in attrs:
+            graph.iterations[index] = int(attrs['iterations'])
+        if 'output' in attrs:
+            graph.output[index] = int(attrs['output'])
+        return index
+
+    while i < len(tokens):
+        token = tokens[i]
+        if token in ('strict', 'graph', 'digraph', 'subgraph') or token in ('{', '}', ';'):
+            i += 1
+            if token in ('graph', 'digraph', 'subgraph') and i < len(tokens) and tokens[i] not in ('{', '['):
+                i += 1 # name
+            if token == 'graph' and i < len(tokens) and tokens[i] == '[':
+                attributes()
+            continue
+        if token in ('node', 'edge'):
+            i += 1
+            attributes()
+            continue
+        if i + 1 < len(tokens) and tokens[i+1] == '=':
+            i += 3 # graph attribute
+            continue
+        chain = [unquote(token)]
+        i += 1
+        while i < len(tokens) and tokens[i] in ('->', '--'):
+            chain.append(unquote(tokens[i+1]))
+            i += 2
+        attrs = attributes()
+        if len(chain) == 1:
+            add_node(chain[0], attrs)
+        else:
+            nodes = [add_node(name, {}) for name in chain]
+            graph.edges.extend(zip(nodes, nodes[1:]))
+    return graph
+
+def parse_chrome_trace(text, iter_per_us, output):
+    trace = json.loads(text)
+    events = trace['traceEvents'] if isinstance(trace, dict) else trace
+
+    # Complete events per thread, as (start, end, args).
+    slices = collections.defaultdict(list)
+    open_slices = collections.defaultdict(list)
+    flows = collections.defaultdict(list)
+    for e in events:
+        ph = e.get('ph')
+        thread = (e.get('pid'), e.get('tid'))
+        if ph == 'X':
+            slices[thread].append((e['ts'], e['ts'] + e.get('dur', 0), e.get('args', {})))
+        elif ph == 'B':
+            open_slices[thread].append(e)
+        elif ph == 'E' and open_slices[thread]:
+            begin = open_slices[thread].pop()
+            slices[thread].append((begin['ts'], e['ts'], begin.get('args', {})))
+        elif ph in ('s', 't', 'f'):
+            flows[(e.get('cat'), e['id'])].append(e)
+
+    graph = Graph()
+    starts = {}
+    for thread in sorted(slices, key=str):
+        slices[thread].sort(key=lambda s: (s[0], -s[1]))
+        starts[thread] = [s[0] for s in slices[thread]]
+        last = None
+        for k, (start, end, args) in enumerate(slices[thread]):
+            index = graph.node((thread, k), int(round((end - start) * iter_per_us)),
+                               int(args.get('output_bytes', output)))
+            if last is not None:
+                graph.edges.append((last, index))
+            last = index
+
+    def bind(e):
+        thread = (e.get('pid'), e.get('tid'))
+        if thread not in starts:
+            return None
+        k = bisect.bisect_right(starts[thread], e['ts']) - 1
+        enclosing = k >= 0 and slices[thread][k][1] >= e['ts']
+        if e['ph'] == 'f' and e.get('bp') != 'e':
+            k = bisect.bisect_left(starts[thread], e['ts'])
+            enclosing = k < len(starts[thread])
+        return graph.index[(thread, k)] if enclosing else None
+
+    for steps in flows.values():
+        steps.sort(key=lambda e: e['ts'])
+        bound = [b for b in map(bind, steps) if b is not None]
+        graph.edges.extend((u, v) for u, v in zip(bound, bound[1:]) if u != v)
+    return graph
+
+def levelize(graph):
+    n = len(graph.iterations)
+    succs = [[] for _ in range(n)]
+    indegree = [0] * n
+    for u, v in graph.edges:
+        succs[u].append(v)
+        indegree[v] += 1
+    level = [0] * n
+    ready = [v for v in range(n) if indegree[v] == 0]
+    visited = 0
+    while ready:
+        u = ready.pop()
+        visited += 1
+        for v in succs[u]:
+            level[v] = max(level[v], level[u] + 1)
+            indegree[v] -= 1
+            if indegree[v] == 0:
+                ready.append(v)
+    if visited != n:
+        sys.exit('error: graph has a cycle')
+    return level
+
+# Points merged into inclusive (first, last) intervals, flattened.
+def intervals(points):
+    result = []
+    for p in sorted(points):
+        if result and result[-1] == p - 1:
+            result[-1] = p
+        else:
+            result.extend((p, p))
+    return result
+
+def write_graph_file(graph, path):
+    level = levelize(graph)
+    n = len(graph.iterations)
+
+    # Tasks of each timestep, in input order, with forwarding tasks for
+    # edges that skip timesteps (shared by every edge of a source).
+    timesteps = max(level) + 1 if n > 0 else 0
+    tasks = [[] for _ in range(timesteps)] # (iterations, output)
+    point = [0] * n
+    for v in range(n):
+        point[v] = len(tasks[level[v]])
+        tasks[level[v]].append((graph.iterations[v], graph.output[v]))
+    forward = {}
+    in_edges = [collections.defaultdict(set) for _ in range(timesteps)]
+    for u, v in graph.edges:
+        src = point[u]
+        for t in range(level[u] + 1, level[v]):
+            if (u, t) not in forward:
+                forward[(u, t)] = len(tasks[t])
+                tasks[t].append((0, graph.output[u]))
+                in_edges[t][forward[(u, t)]].add(src)
+            src = forward[(u, t)]
+        in_edges[level[v]][point[v]].add(src)
+
+    out_edges = [collections.defaultdict(set) for _ in range(timesteps)]
+    for t in range(1, timesteps):
+        for p, deps in in_edges[t].items():
+            for q in deps:
+                out_edges[t-1][q].add(p)
+
+    step_offsets = array.array('Q', [0])
+    in_offsets = array.array('Q', [0])
+    out_offsets = array.array('Q', [0])
+    iterations = array.array('q')
+    output_bytes = array.array('Q')
+    ins = array.array('q')
+    outs = array.array('q')
+    edges = 0
+    for t in range(timesteps):
+        for p, (iters, output) in enumerate(tasks[t]):
+            edges += len(in_edges[t].get(p, ()))
+            ins.extend(intervals(in_edges[t].get(p, ())))
+            outs.extend(intervals(out_edges[t].get(p, ())))
+            in_offsets.append(len(ins) // 2)
+            out_offsets.append(len(outs) // 2)
+            iterations.append(max(iters, 0))
+            output_bytes.append(max(output, MIN_OUTPUT_BYTES))
+        step_offsets.append(len(iterations))
+
+    header = array.array('Q', [timesteps, max((len(ts) for ts in tasks), default=0),
+                               len(iterations), len(ins) // 2, len(outs) // 2,
+                               max(output_bytes, default=MIN_OUTPUT_BYTES)])
+    arrays = [header, step_offsets, in_offsets, out_offsets, iterations, output_bytes, ins, outs]
+    if sys.byteorder != 'little':
+        for a in arrays:
+            a.byteswap()
+    with open(path, 'wb') as f:
+        f.write(MAGIC)
+        for a in arrays:
+            a.tofile(f)
+    return timesteps, header[1], len(iterations), edges
+
+def driver(input, output_file, input_format, iterations, iter_per_us, output):
+    if input_format is None:
+        input_format = 'json' if input.endswith('.json') else 'dot'
+    with open(input) as f:
+        text = f.read()
+    if input_format == 'dot':
+        graph = parse_dot(text, iterations, output)
+    else:
+        graph = parse_chrome_trace(text, iter_per_us, output)
+    if not graph.iterations:
+        sys.exit('error: graph has no tasks')
+    timesteps, width, tasks, edges = write_graph_file(graph, output_file)
+    print('%s: %d timesteps, max width %d, %d tasks (%d forwarding), %d edges' %
+          (output_file, timesteps, width, tasks, tasks - len(graph.iterations), edges))
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('input', help='DOT or Chrome trace JSON file')
+    parser.add_argument('output_file', help='graph file to write')
+    parser.add_argument('--format', dest='input_format', choices=['dot', 'json'],
+                        help='input format (default: from the file extension)')
+    parser.add_argument('--iter', dest='iterations', type=int, default=0,
+                        help='iterations of DOT nodes without an iterations attribute')
+    parser.add_argument('--iter-per-us', type=float, default=1000.0,
+                        help='iterations per microsecond of Chrome trace events')
+    parser.add_argument('--output', type=int, default=MIN_OUTPUT_BYTES,
+                        help='output bytes of tasks without an output size')
+    args = parser.parse_args()
+    driver(**vars(args))
@@ -0,0 +1,336 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <tuple>
+
+#include "core.h"
+#include "alloc.h"
+#include "placement.h"
+#include "timer.h"
+
+#include <shmem.h>
+#include "../mpi/comm_pattern.h"
+
+// OpenSHMEM version of nonblock, with points distributed over PEs the
+// same way. Producers put their outputs straight into input slots of
+// their consumers on the symmetric heap (shmem_putmem_nbi) and, after a
+// fence, add one to the consumer's arrival counter for that timestep,
+// which it waits on locally and then clears for the next run.
+//
+// Slots are indexed by timestep parity, so the puts of timestep t
+// overwrite those read at t - 2. Before putting to a PE, a producer waits
+// until that PE has finished timestep t - 2: every PE publishes the
+// number of timesteps it has finished to the PEs that put to it two
+// timesteps later, in a per-PE counter of theirs that only grows.
+//
+// Symmetric allocations have the same size on every PE, so the layout
+// uses the maximum number of points per PE and of dependencies per point.
+// Puts are computed once per pattern (comm_pattern.h).
+
+struct Put {
+  long point_index; // local producer
+  int pe;
+  long target_index; // consumer, on pe
+  long slot;
+};
+
+struct Pattern {
+  std::vector<Put> puts;
+  // Per local point, the producer of each input, in input order.
+  std::vector<std::vector<long> > input_points;
+  // Per local point, the number of inputs from other PEs.
+  std::vector<long> remote_inputs;
+  // PEs that this PE puts to, and that put to it.
+  std::vector<int> target_pes;
+  std::vector<int> source_pes;
+};
+
+struct GraphState {
+  long first_point, last_point;
+  long max_points, max_deps;
+  size_t slot_bytes;
+  // Symmetric: [parity][point][slot] inputs, [timestep][point] arrivals,
+  // [pe] timesteps finished.
+  char *slots;
+  long *arrivals;
+  long *finished;
+  long runs_finished; // timesteps finished by previous runs, on every PE
+  std::vector<std::vector<const char *> > input_ptr;
+  std::vector<std::vector<size_t> > input_bytes;
+  std::vector<std::vector<char> > outputs[2];
+  std::vector<int> pe_by_point;
+  std::vector<long> first_point_by_pe;
+  std::map<PatternKey, Pattern> patterns;
+};
+
+static void create_pattern(const TaskGraph &graph, const GraphState &state,
+                           const PatternKey &key, Pattern &pattern)
+{
+  long dset, offset, width, last_offset, last_width;
+  std::tie(dset, offset, width, last_offset, last_width) = key;
+
+  const DependencyTable *table = graph.dependency_table();
+
+  long n_points = state.last_point - state.first_point + 1;
+  std::vector<bool> is_target(state.first_point_by_pe.size());
+  std::vector<bool> is_source(state.first_point_by_pe.size());
+  pattern.input_points = pattern_input_points(graph, key, state.first_point, state.last_point);
+  pattern.remote_inputs.resize(n_points);
+  for (long point = state.first_point; point <= state.last_point; ++point) {
+    long point_index = point - state.first_point;
+
+    /* Inputs */
+    for (long dep : pattern.input_points[point_index]) {
+      if (dep < state.first_point || dep > state.last_point) {
+        pattern.remote_inputs[point_index]++;
+        is_source[state.pe_by_point[dep]] = true;
+      }
+    }
+
+    /* Puts */
+    if (point >= last_offset && point < last_offset + last_width) {
+      size_t n_point_rev_deps;
+      const std::pair<long, long> *point_rev_deps = table->reverse_dependencies(dset, point, n_point_rev_deps);
+      for (size_t span = 0; span < n_point_rev_deps; ++span) {
+        for (long dep = point_rev_deps[span].first; dep <= point_rev_deps[span].second; dep++) {
+          if (dep < offset || dep >= offset + width ||
+              (state.first_point <= dep && dep <= state.last_point)) {
+            continue;
+          }
+
+          long slot = pattern_input_slot(graph, key, dep, point);
+          int pe = state.pe_by_point[dep];
+          Put put = {point_index, pe, dep - state.first_point_by_pe[pe], slot};
+          pattern.puts.push_back(put);
+          is_target[pe] = true;
+        }
+      }
+    }
+  }
+
+  for (int pe = 0; pe < (int)is_target.size(); ++pe) {
+    if (is_target[pe]) pattern.target_pes.push_back(pe);
+    if (is_source[pe]) pattern.source_pes.push_back(pe);
+  }
+}
+
+int main(int argc, char *argv[])
+{
+  shmem_init();
+  int n_pes = shmem_n_pes();
+  int pe = shmem_my_pe();
+
+  App app(argc, argv);
+  placement_require_block("shmem");
+  if (pe == 0) app.display();
+
+  std::vector<char *> scratch;
+  std::vector<GraphState> states(app.graphs.size());
+  for (auto graph : app.graphs) {
+    long first_point = pe * graph.max_width / n_pes;
+    long last_point = (pe + 1) * graph.max_width / n_pes - 1;
+    long n_points = last_point - first_point + 1;
+
+    size_t scratch_bytes = graph.scratch_bytes_per_task;
+    scratch.push_back(TaskGraph::allocate_scratch(scratch_bytes, n_points, numa_current_node()));
+
+    GraphState &state = states[graph.graph_index];
+    state.first_point = first_point;
+    state.last_point = last_point;
+    state.pe_by_point.resize(graph.max_width);
+    state.first_point_by_pe.resize(n_pes);
+    state.max_points = 0;
+    for (int p = 0; p < n_pes; ++p) {
+      long p_first_point = p * graph.max_width / n_pes;
+      long p_last_point = (p + 1) * graph.max_width / n_pes - 1;
+      state.first_point_by_pe[p] = p_first_point;
+      state.max_points = std::max(state.max_points, p_last_point - p_first_point + 1);
+      for (long point = p_first_point; point <= p_last_point; ++point) {
+        state.pe_by_point[point] = p;
+      }
+    }
+
+    const DependencyTable *table = graph.dependency_table();
+    assert(table != NULL);
+
+    long max_deps = 0;
+    for (long dset = 0; dset < graph.max_dependence_sets(); ++dset) {
+      for (long point = 0; point < graph.max_width; ++point) {
+        long deps = 0;
+        size_t n_intervals;
+        const std::pair<long, long> *intervals = table->dependencies(dset, point, n_intervals);
+        for (size_t span = 0; span < n_intervals; ++span) {
+          deps += intervals[span].second - intervals[span].first + 1;
+        }
+        max_deps = std::max(max_deps, deps);
+      }
+    }
+    state.max_deps = max_deps;
+    state.slot_bytes = graph.max_output_bytes();
+
+    state.slots = (char *)shmem_malloc(std::max(2 * state.max_points * max_deps * state.slot_bytes, (size_t)1));
+    state.arrivals = (long *)shmem_calloc(std::max(graph.timesteps * state.max_points, 1L), sizeof(long));
+    state.finished = (long *)shmem_calloc(n_pes, sizeof(long));
+    state.runs_finished = 0;
+    if (!state.slots || !state.arrivals || !state.finished) {
+      fprintf(stderr, "error: unable to allocate symmetric heap, try raising SHMEM_SYMMETRIC_SIZE\n");
+      abort();
+    }
+
+    for (int parity = 0; parity < 2; ++parity) {
+      state.outputs[parity].resize(n_points);
+      for (auto &output : state.outputs[parity]) {
+        output.resize(state.slot_bytes);
+      }
+    }
+    state.input_ptr.resize(n_points);
+    state.input_bytes.resize(n_points);
+    for (long point_index = 0; point_index < n_points; ++point_index) {
+      state.input_ptr[point_index].resize(max_deps);
+      state.input_bytes[point_index].resize(max_deps);
+    }
+
+    for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+      PatternKey key = pattern_key(graph, timestep);
+      if (!state.patterns.count(key)) {
+        create_pattern(graph, state, key, state.patterns[key]);
+      }
+    }
+  }
+  shmem_barrier_all();
+
+  auto run = [&] {
+    shmem_barrier_all();
+
+    double start_time = Timer::get_cur_time();
+    app.start_arrivals();
+
+    for (auto graph : app.graphs) {
+      GraphState &state = states[graph.graph_index];
+
+      long first_point = state.first_point;
+      long last_point = state.last_point;
+      long max_points = state.max_points;
+      long max_deps = state.max_deps;
+      size_t slot_bytes = state.slot_bytes;
+
+      size_t scratch_bytes = graph.scratch_bytes_per_task;
+      char *scratch_ptr = scratch[graph.graph_index];
+
+      for (long timestep = 0; timestep < graph.timesteps; ++timestep) {
+        graph.wait_for_release(timestep);
+
+        long offset = graph.offset_at_timestep(timestep);
+        long width = graph.width_at_timestep(timestep);
+
+        int parity = timestep % 2;
+        Pattern &pattern = state.patterns.at(pattern_key(graph, timestep));
+        auto &last_outputs = state.outputs[(timestep + 1) % 2];
+        auto &point_outputs = state.outputs[parity];
+        char *slots = state.slots + parity * max_points * max_deps * slot_bytes;
+        long *arrivals = state.arrivals + timestep * max_points;
+
+        /* Put */
+        // Into slots that the targets read at timestep - 2.
+        if (timestep >= 2) {
+          for (int target_pe : pattern.target_pes) {
+            shmem_long_wait_until(&state.finished[target_pe], SHMEM_CMP_GE,
+                                  state.runs_finished + timestep - 1);
+          }
+        }
+        for (auto &put : pattern.puts) {
+          long point = first_point + put.point_index;
+          shmem_putmem_nbi(slots + (put.target_index * max_deps + put.slot) * slot_bytes,
+                           last_outputs[put.point_index].data(), graph.output_bytes_at(timestep-1, point),
+                           put.pe);
+        }
+        // Puts land before the arrivals that announce them.
+        shmem_fence();
+        for (auto &put : pattern.puts) {
+          shmem_long_atomic_add(&arrivals[put.target_index], 1, put.pe);
+        }
+
+        /* Execute */
+        for (long point = std::max(first_point, offset); point <= std::min(last_point, offset + width - 1); ++point) {
+          long point_index = point - first_point;
+
+          auto &point_input_ptr = state.input_ptr[point_index];
+          auto &point_input_bytes = state.input_bytes[point_index];
+          auto &point_input_points = pattern.input_points[point_index];
+          long point_n_inputs = point_input_points.size();
+
+          long remote_inputs = pattern.remote_inputs[point_index];
+          if (remote_inputs > 0) {
+            shmem_long_wait_until(&arrivals[point_index], SHMEM_CMP_GE, remote_inputs);
+            shmem_long_atomic_set(&arrivals[point_index], 0, pe);
+          }
+
+          for (long slot = 0; slot < point_n_inputs; ++slot) {
+            long dep = point_input_points[slot];
+            // Use shared memory for on-node data.
+            if (first_point <= dep && dep <= last_point) {
+              point_input_ptr[slot] = last_outputs[dep - first_point].data();
+            } else {
+              point_input_ptr[slot] = slots + (point_index * max_deps + slot) * slot_bytes;
+            }
+            point_input_bytes[slot] = graph.output_bytes_at(timestep-1, dep);
+          }
+
+          graph.execute_point(timestep, point,
+                              point_outputs[point_index].data(), graph.output_bytes_at(timestep, point),
+                              point_input_ptr.data(), point_input_bytes.data(), point_n_inputs,
+                              scratch_ptr + scratch_bytes * point_index, scratch_bytes);
+        }
+
+        // The slots of this timestep parity may be written again.
+        if (timestep + 2 < graph.timesteps) {
+          Pattern &next = state.patterns.at(pattern_key(graph, timestep + 2));
+          for (int source_pe : next.source_pes) {
+            shmem_long_atomic_set(&state.finished[pe], state.runs_finished + timestep + 1, source_pe);
+          }
+        }
+
+        // The outputs being put are written again next timestep.
+        shmem_quiet();
+      }
+      state.runs_finished += graph.timesteps;
+    }
+
+    shmem_barrier_all();
+
+    double stop_time = Timer::get_cur_time();
+    return stop_time - start_time;
+  };
+
+  // One untimed warm-up run by default.
+  app.execute_timed(run, pe == 0, 1);
+
+  for (auto &state : states) {
+    shmem_free(state.slots);
+    shmem_free(state.arrivals);
+    shmem_free(state.finished);
+  }
+
+  for (auto scratch_ptr : scratch) {
+    TaskGraph::free_scratch(scratch_ptr);
+  }
+
+  shmem_finalize();
+}
@@ -0,0 +1,394 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <queue>
+#include <vector>
+
+#include "core.h"
+#include "placement.h"
+#include "timer.h"
+
+// Discrete-event simulation of the task graphs on -workers workers spread
+// evenly over -nodes nodes (one by default), in place of running them.
+// Points are placed on the nodes by -placement (placement.h). A task is
+// ready once its inputs have arrived: immediately from the same node, or
+// after -sim-latency plus the output size over -sim-bandwidth from another
+// node. Ready tasks run in ready order (list scheduling) on the first free
+// worker of their node, for -sim-overhead plus their kernel iterations
+// (TaskGraph::task_iterations) times the seconds per iteration, which is
+// measured by running each graph's kernel unless -sim-iteration-time is
+// given. The simulated makespan goes to report_timing as the elapsed time.
+//
+// Dependence state is kept for the timesteps in flight only: timestep t+1
+// is set up when the first task of t starts, which is also when its tasks
+// without inputs become ready.
+
+#define DEFAULT_LATENCY 1e-6
+#define DEFAULT_BANDWIDTH 1e10
+#define CALIBRATION_SECONDS 0.01
+
+struct Event {
+  double time;
+  uint64_t seq; // breaks ties in the order events were created
+  int graph;
+  bool finish; // otherwise the inputs of the task have arrived
+  long timestep;
+  long point;
+
+  bool operator>(const Event &other) const
+  {
+    return time > other.time || (time == other.time && seq > other.seq);
+  }
+};
+
+struct Task {
+  int graph;
+  long timestep;
+  long point;
+};
+
+struct Node {
+  long free_workers;
+  std::deque<Task> ready;
+};
+
+// Dependence state of one timestep in flight.
+struct StepState {
+  long offset;
+  std::vector<long> pending; // inputs not yet arrived, by point - offset
+  std::vector<double> arrival; // latest input arrival so far
+  long remaining; // tasks not finished
+};
+
+struct GraphState {
+  std::vector<int> owner; // node by point
+  double iteration_seconds;
+  long first_step; // timestep of steps.front()
+  std::deque<StepState> steps;
+};
+
+struct SimulatorApp : public App {
+  SimulatorApp(int argc, char **argv);
+  void execute_main_loop();
+
+private:
+  double simulate();
+  void calibrate(const TaskGraph &graph, GraphState &state);
+  void set_up_timestep(int graph, double now);
+  void push_event(double time, bool finish, int graph, long timestep, long point);
+  void start_ready(int node, double now);
+  void finish_task(const Event &event);
+
+  double latency;
+  double bandwidth;
+  double overhead;
+  double iteration_time; // -sim-iteration-time, < 0 to calibrate
+  long n_nodes;
+
+  std::vector<GraphState> states;
+  std::vector<Node> nodes_state;
+  std::priority_queue<Event, std::vector<Event>, std::greater<Event> > events;
+  uint64_t next_seq;
+  double busy_seconds;
+  long long simulated_tasks;
+};
+
+// As in core.cc.
+static void needs_argument(int i, int argc, const char *flag) {
+  if (i+1 >= argc) {
+    fprintf(stderr, "error: Flag \"%s\" requires an argument\n", flag);
+    abort();
+  }
+}
+
+SimulatorApp::SimulatorApp(int argc, char **argv)
+  : App(argc, argv)
+  , latency(DEFAULT_LATENCY)
+  , bandwidth(DEFAULT_BANDWIDTH)
+  , overhead(0)
+  , iteration_time(-1)
+{
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-sim-latency")) {
+      needs_argument(i, argc, "-sim-latency");
+      latency = atof(argv[++i]);
+    }
+    if (!strcmp(argv[i], "-sim-bandwidth")) {
+      needs_argument(i, argc, "-sim-bandwidth");
+      bandwidth = atof(argv[++i]);
+    }
+    if (!strcmp(argv[i], "-sim-overhead")) {
+      needs_argument(i, argc, "-sim-overhead");
+      overhead = atof(argv[++i]);
+    }
+    if (!strcmp(argv[i], "-sim-iteration-time")) {
+      needs_argument(i, argc, "-sim-iteration-time");
+      iteration_time = atof(argv[++i]);
+    }
+  }
+  if (latency < 0 || bandwidth <= 0 || overhead < 0) {
+    fprintf(stderr, "error: -sim-latency and -sim-overhead must be >= 0, -sim-bandwidth > 0\n");
+    abort();
+  }
+
+  n_nodes = std::max(nodes, 1L);
+  if (workers < n_nodes) {
+    fprintf(stderr, "error: simulating %ld nodes needs at least as many -workers\n", n_nodes);
+    abort();
+  }
+
+  for (auto &graph : graphs) {
+    if (graph.child || graph.arrival_rate > 0) {
+      fprintf(stderr, "error: the simulator does not support -child or -arrival-rate\n");
+      abort();
+    }
+    GraphState state;
+    state.owner = point_owners(graph, n_nodes);
+    calibrate(graph, state);
+    states.push_back(state);
+  }
+}
+
+// Seconds per kernel iteration of one task, alone on this thread.
+void SimulatorApp::calibrate(const TaskGraph &graph, GraphState &state)
+{
+  state.iteration_seconds = std::max(iteration_time, 0.0);
+  if (iteration_time >= 0 || graph.kernel.iterations <= 0) {
+    return;
+  }
+
+  Kernel k(graph.kernel);
+  if (k.type == KernelType::LOAD_IMBALANCE || k.type == KernelType::DIST_IMBALANCE) {
+    k.type = KernelType::COMPUTE_BOUND;
+  }
+  Kernel::Function execute = k.resolve();
+  char *scratch_ptr = TaskGraph::allocate_scratch(graph.scratch_bytes_per_task, 1, -1);
+  long runs = 0;
+  double start = Timer::get_cur_time(), elapsed = 0;
+  do {
+    execute(k, graph.graph_index, 0, 0, scratch_ptr, graph.scratch_bytes_per_task);
+    runs++;
+    elapsed = Timer::get_cur_time() - start;
+  } while (runs < 3 || elapsed < CALIBRATION_SECONDS);
+  TaskGraph::free_scratch(scratch_ptr);
+
+  state.iteration_seconds = elapsed / runs / k.iterations;
+}
+
+void SimulatorApp::push_event(double time, bool finish, int graph, long timestep, long point)
+{
+  events.push({time, next_seq++, graph, finish, timestep, point});
+}
+
+void SimulatorApp::set_up_timestep(int graph_index, double now)
+{
+  const TaskGraph &graph = graphs[graph_index];
+  GraphState &state = states[graph_index];
+  long timestep = state.first_step + state.steps.size();
+  if (timestep >= graph.timesteps) {
+    return;
+  }
+
+  StepState step;
+  step.offset = graph.offset_at_timestep(timestep);
+  long width = graph.width_at_timestep(timestep);
+  step.pending.assign(width, 0);
+  step.arrival.assign(width, now);
+  step.remaining = width;
+  if (timestep > 0) {
+    long dset = graph.dependence_set_at_timestep(timestep);
+    long last_offset = graph.offset_at_timestep(timestep - 1);
+    long last_width = graph.width_at_timestep(timestep - 1);
+    for (long i = 0; i < width; ++i) {
+      graph.for_each_dependency(dset, step.offset + i, [&](long first, long last) {
+        first = std::max(first, last_offset);
+        last = std::min(last, last_offset + last_width - 1);
+        if (first <= last) {
+          step.pending[i] += last - first + 1;
+        }
+      });
+    }
+  }
+  state.steps.push_back(std::move(step));
+
+  // Tasks without inputs are ready now.
+  StepState &added = state.steps.back();
+  for (long i = 0; i < width; ++i) {
+    if (added.pending[i] == 0) {
+      long point = added.offset + i;
+      nodes_state[state.owner[point]].ready.push_back({graph_index, timestep, point});
+    }
+  }
+  if (width == 0) {
+    state.steps.pop_back();
+    state.first_step++;
+    set_up_timestep(graph_index, now);
+  }
+}
+
+void SimulatorApp::start_ready(int node, double now)
+{
+  Node &n = nodes_state[node];
+  while (n.free_workers > 0 && !n.ready.empty()) {
+    Task task = n.ready.front();
+    n.ready.pop_front();
+    n.free_workers--;
+
+    const TaskGraph &graph = graphs[task.graph];
+    GraphState &state = states[task.graph];
+    // The first task of the last timestep set up starts: set up the next.
+    if (task.timestep == state.first_step + (long)state.steps.size() - 1) {
+      set_up_timestep(task.graph, now);
+    }
+
+    double duration = overhead + graph.task_iterations(task.timestep, task.point) * state.iteration_seconds;
+    busy_seconds += duration;
+    push_event(now + duration, true, task.graph, task.timestep, task.point);
+  }
+}
+
+void SimulatorApp::finish_task(const Event &event)
+{
+  const TaskGraph &graph = graphs[event.graph];
+  GraphState &state = states[event.graph];
+  int node = state.owner[event.point];
+  nodes_state[node].free_workers++;
+  simulated_tasks++;
+
+  long timestep = event.timestep;
+  long next = timestep + 1;
+  if (next < graph.timesteps) {
+    // Set up when the first task of this timestep started.
+    StepState &step = state.steps[next - state.first_step];
+    long width = step.pending.size();
+    double message = latency + graph.output_bytes_at(timestep, event.point) / bandwidth;
+    long dset = graph.dependence_set_at_timestep(next);
+    graph.for_each_reverse_dependency(dset, event.point, [&](long first, long last) {
+      first = std::max(first, step.offset);
+      last = std::min(last, step.offset + width - 1);
+      for (long point = first; point <= last; ++point) {
+        long i = point - step.offset;
+        int consumer = state.owner[point];
+        double arrival = event.time + (consumer == node ? 0.0 : message);
+        step.arrival[i] = std::max(step.arrival[i], arrival);
+        if (--step.pending[i] == 0) {
+          if (consumer == node && step.arrival[i] <= event.time) {
+            nodes_state[consumer].ready.push_back({event.graph, next, point});
+          } else {
+            push_event(step.arrival[i], false, event.graph, next, point);
+          }
+        }
+      }
+    });
+  }
+
+  StepState &step = state.steps[timestep - state.first_step];
+  step.remaining--;
+  while (!state.steps.empty() && state.steps.front().remaining == 0) {
+    state.steps.pop_front();
+    state.first_step++;
+  }
+}
+
+double SimulatorApp::simulate()
+{
+  nodes_state.assign(n_nodes, Node());
+  for (long node = 0; node < n_nodes; ++node) {
+    nodes_state[node].free_workers = (node + 1) * workers / n_nodes - node * workers / n_nodes;
+  }
+  next_seq = 0;
+  busy_seconds = 0;
+  simulated_tasks = 0;
+  for (size_t i = 0; i < graphs.size(); ++i) {
+    states[i].first_step = 0;
+    states[i].steps.clear();
+    set_up_timestep(i, 0.0);
+  }
+
+  double now = 0;
+  for (long node = 0; node < n_nodes; ++node) {
+    start_ready(node, now);
+  }
+  while (!events.empty()) {
+    Event event = events.top();
+    events.pop();
+    now = event.time;
+    int node = states[event.graph].owner[event.point];
+    if (event.finish) {
+      // Tasks of other nodes made ready here wait for their inputs to
+      // arrive as events of their own.
+      finish_task(event);
+    } else {
+      nodes_state[node].ready.push_back({event.graph, event.timestep, event.point});
+    }
+    start_ready(node, now);
+  }
+
+  for (auto &state : states) {
+    if (!state.steps.empty()) {
+      fprintf(stderr, "error: simulation stopped with tasks that never became ready\n");
+      abort();
+    }
+  }
+  return now;
+}
+
+void SimulatorApp::execute_main_loop()
+{
+  display();
+
+  printf("Simulation:\n");
+  printf("  Nodes %ld, Workers %ld\n", n_nodes, workers);
+  printf("  Latency %e seconds, Bandwidth %e B/s, Overhead %e seconds per task\n",
+         latency, bandwidth, overhead);
+  for (size_t i = 0; i < graphs.size(); ++i) {
+    printf("  Graph %zu: %e seconds per iteration%s\n", i, states[i].iteration_seconds,
+           iteration_time < 0 && graphs[i].kernel.iterations > 0 ? " (measured)" : "");
+  }
+
+  double wall_seconds = 0, makespan = 0;
+  auto run = [&] {
+    double start = Timer::get_cur_time();
+    makespan = simulate();
+    wall_seconds = Timer::get_cur_time() - start;
+    return makespan;
+  };
+  if (metg) {
+    search_metg(run, workers);
+  } else {
+    execute_timed(run);
+  }
+
+  printf("Simulated %lld tasks in %e seconds (%e tasks/s)\n",
+         simulated_tasks, wall_seconds, simulated_tasks / wall_seconds);
+  if (makespan > 0) {
+    printf("Simulated Utilization %f\n", busy_seconds / (workers * makespan));
+  }
+}
+
+int main(int argc, char **argv)
+{
+  SimulatorApp app(argc, argv);
+  app.execute_main_loop();
+
+  return 0;
+}
@@ -0,0 +1,82 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+import java.io.Externalizable;
+import java.io.IOException;
+import java.io.ObjectInput;
+import java.io.ObjectOutput;
+import java.nio.ByteBuffer;
+
+// A task output in a direct ByteBuffer, for -direct. Points execute on
+// these through task_bench_jni.cc without copying through the JVM heap;
+// the bytes are only copied when Spark serializes them (shuffles).
+class NativeBuffer implements Externalizable, Comparable<NativeBuffer> {
+    private static final long serialVersionUID = 1L;
+    static final NativeBuffer DUMMY = new NativeBuffer(1);
+
+    private ByteBuffer buffer;
+
+    public NativeBuffer() {} // for deserialization
+
+    public NativeBuffer(int bytes) {
+        buffer = ByteBuffer.allocateDirect(bytes);
+    }
+
+    public int size() {
+        return buffer.capacity();
+    }
+
+    public static void execute_point(task_graph_t graph, long timestep, long point,
+                                     NativeBuffer output, NativeBuffer[] inputs) {
+        ByteBuffer[] input_buffers = new ByteBuffer[inputs.length];
+        for (int i = 0; i < inputs.length; i++) {
+            input_buffers[i] = inputs[i].buffer;
+        }
+        executePoint(task_graph_t.getCPtr(graph), timestep, point, output.buffer, input_buffers);
+    }
+
+    private static native void executePoint(long graph, long timestep, long point,
+                                            ByteBuffer output, ByteBuffer[] inputs);
+
+    // Same order as the byte[] ordering in main.scala.
+    @Override
+    public int compareTo(NativeBuffer other) {
+        int n = Math.min(size(), other.size());
+        for (int i = 0; i < n; i++) {
+            byte a = buffer.get(i), b = other.buffer.get(i);
+            if (a != b) return a < b ? -1 : 1;
+        }
+        return Integer.compare(size(), other.size());
+    }
+
+    @Override
+    public void writeExternal(ObjectOutput out) throws IOException {
+        int n = size();
+        out.writeInt(n);
+        byte[] bytes = new byte[n];
+        buffer.duplicate().get(bytes);
+        out.write(bytes);
+    }
+
+    @Override
+    public void readExternal(ObjectInput in) throws IOException {
+        int n = in.readInt();
+        byte[] bytes = new byte[n];
+        in.readFully(bytes);
+        buffer = ByteBuffer.allocateDirect(n);
+        buffer.put(bytes);
+        buffer.clear();
+    }
+}
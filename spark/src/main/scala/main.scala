@@ -17,6 +17,57 @@ import scala.collection.mutable.ListBuffer
 import org.apache.spark.sql.SparkSession
 import org.apache.spark.HashPartitioner
 import org.apache.spark.SparkFiles
+import scala.reflect.ClassTag
+
+// How task outputs are held: byte arrays on the JVM heap, passed through
+// the SWIG typemaps (the default), or direct NativeBuffers passed through
+// the JNI binding in task_bench_jni.cc (-direct).
+trait Values[V] extends Serializable {
+    def fake: V
+    def ordering: Ordering[V]
+    def execute_point(taskGraph: task_graph_t, ts: Int, point: Int, inputs: Seq[V]): V
+}
+
+object HeapValues extends Values[Array[Byte]] {
+    val fake = new Array[Byte](1);
+    def ordering = Main.ordering;
+    def execute_point(taskGraph: task_graph_t, ts: Int, point: Int, inputs: Seq[Array[Byte]]) : Array[Byte] = {
+        val outputBytesPerTask = taskGraph.getOutput_bytes_per_task();
+        val output_ptr = new Array[Byte](outputBytesPerTask.asInstanceOf[Int]);
+        val output_bytes = output_ptr.length;
+        val input_ptr = inputs.toArray;
+        val n_inputs = input_ptr.length;
+        val input_bytes = new Array[Long](n_inputs);
+        var b = 0;
+        for (b <- 0 until input_bytes.length) {
+            input_bytes(b) = input_ptr(b).length;
+        }
+
+        val scratchBytesPerTask = taskGraph.getScratch_bytes_per_task();
+        core_c.task_graph_execute_point_scratch_auto(taskGraph, ts, point, output_ptr, output_bytes,
+            input_ptr, input_bytes, n_inputs, scratchBytesPerTask);
+        output_ptr;
+    }
+}
+
+object DirectValues extends Values[NativeBuffer] {
+    def fake = NativeBuffer.DUMMY;
+    val ordering = new math.Ordering[NativeBuffer] {
+        def compare(a: NativeBuffer, b: NativeBuffer): Int = {
+            if (a eq null) {
+                if (b eq null) 0
+                else -1
+            }
+            else if (b eq null) 1
+            else a.compareTo(b)
+        }
+    }
+    def execute_point(taskGraph: task_graph_t, ts: Int, point: Int, inputs: Seq[NativeBuffer]) : NativeBuffer = {
+        val output = new NativeBuffer(taskGraph.getOutput_bytes_per_task().asInstanceOf[Int]);
+        NativeBuffer.execute_point(taskGraph, ts, point, output, inputs.toArray);
+        output;
+    }
+}
 
 object Main {
     //globals 
@@ -66,7 +117,18 @@ object Main {
         spark.sparkContext.setLogLevel("ERROR");
 
         System.loadLibrary("core_c");
-        
+
+        val direct = args.contains("-direct");
+        if (direct) {
+            run(spark, args, DirectValues);
+        } else {
+            run(spark, args, HeapValues);
+        }
+        spark.stop();
+
+    } //end of main
+
+    def run[V: ClassTag](spark: SparkSession, args: Array[String], values: Values[V]) {
         var argsToPass = new Array[String](args.length + 1);
         argsToPass(0) = "dummy";
         var i = 0;
@@ -85,7 +147,7 @@ object Main {
         var maxNumTimesteps = 0;
         var maxWidth = 0;
         var g = 0;
-        val fakeArr = new Array[Byte](1);
+        val fakeVal = values.fake;
         for (g <- 0 until numGraphs) {
             val taskGraph = core_c.task_graph_list_task_graph(taskGraphList, g); 
             if (taskGraph.getTimesteps() > maxNumTimesteps) {
@@ -95,34 +157,32 @@ object Main {
                 maxWidth = taskGraph.getMax_width();
             }
         }
-        val fakeValsRDD = spark.sparkContext.parallelize(0 to maxWidth - 1).map(point=>(point,fakeArr)).partitionBy(oldPartitioner);
+        val fakeValsRDD = spark.sparkContext.parallelize(0 to maxWidth - 1).map(point=>(point,fakeVal)).partitionBy(oldPartitioner);
               
         /*------WARMUP AND TIMING-------*/
         println("Starting warmup");
-        timing( spark, maxNumTimesteps, numGraphs, taskGraphList,  fakeValsRDD ); //warmup
+        timing( spark, maxNumTimesteps, numGraphs, taskGraphList, values, fakeValsRDD ); //warmup
         println("Starting timing");
         val start = System.nanoTime;
-        val end = timing( spark, maxNumTimesteps, numGraphs, taskGraphList, fakeValsRDD ); 
+        val end = timing( spark, maxNumTimesteps, numGraphs, taskGraphList, values, fakeValsRDD ); 
         val elapsed = (end - start) / 1e9d;
         
         core_c.app_report_timing(app, elapsed); //prints elapsed
         core_c.task_graph_list_destroy(taskGraphList);
         core_c.app_destroy(app);
-        spark.stop();
-
-    } //end of main
+    }
 
     /*------FUNCTIONS-------*/
-    def timing( spark: SparkSession, maxNumTimesteps: Int, numGraphs:Int, taskGraphList:task_graph_list_t , fakeValsRDD: org.apache.spark.rdd.RDD[(Int, Array[Byte])] ) : Long = {  
+    def timing[V: ClassTag]( spark: SparkSession, maxNumTimesteps: Int, numGraphs:Int, taskGraphList:task_graph_list_t, values: Values[V], fakeValsRDD: org.apache.spark.rdd.RDD[(Int, V)] ) : Long = {  
         var ts = 0;
-        var global_valsRDDList = new Array[org.apache.spark.rdd.RDD[(Int, Array[Byte])]](numGraphs); 
+        var global_valsRDDList = new Array[org.apache.spark.rdd.RDD[(Int, V)]](numGraphs); 
         for (ts <- 0 until maxNumTimesteps) { //start at ts ZERO
             var g = 0;
             for (g <- 0 until numGraphs) {
                 val taskGraph = core_c.task_graph_list_task_graph(taskGraphList, g);//need #ts for graph 
                 val SERtaskGraph = new SERtask_graph_t(taskGraph);
                 if (ts <= taskGraph.getTimesteps() - 1) {
-                    execute_timestep(spark, SERtaskGraph, g, ts, global_valsRDDList, fakeValsRDD); 
+                    execute_timestep(spark, SERtaskGraph, g, ts, values, global_valsRDDList, fakeValsRDD); 
                     //execute_timestep does joining etc, and task_graph_execute_timestep to get new valsRDD
                 }
             }
@@ -144,38 +204,24 @@ object Main {
         end; 
     }
 
-    def call_execute_point (SERtaskGraph: SERtask_graph_t, ts: Int, point:Int, inputsOrVal: Any, simple: Boolean) : Array[Byte] = { 
+    def call_execute_point[V] (values: Values[V], SERtaskGraph: SERtask_graph_t, ts: Int, point:Int, inputsOrVal: Any, simple: Boolean) : V = { 
         LibraryLoader.load;
         val taskGraph = SERtaskGraph.toTaskGraph(); //create on each worker
         val depType = taskGraph.getDependence().toString(); 
-        val outputBytesPerTask = taskGraph.getOutput_bytes_per_task();
-        val output_ptr = new Array[Byte](outputBytesPerTask.asInstanceOf[Int]); 
-        val output_bytes = output_ptr.length;
-        var input_ptr = new Array[Array[Byte]](1); 
-        input_ptr(0) = new Array[Byte](1); //use fake populated input_ptr on ts0 in case I change ts0 RDD in future
+        var inputs = Seq(values.fake); //use fake populated input on ts0 in case I change ts0 RDD in future
         if (simple && ts != 0) {
-            input_ptr(0) = inputsOrVal.asInstanceOf[Array[Byte]]; 
+            inputs = Seq(inputsOrVal.asInstanceOf[V]); 
         }
         else if (!simple && ts != 0) { //not simple 
-            input_ptr = inputsOrVal.asInstanceOf[Iterable[Array[Byte]]].toArray.sorted(ordering);
+            inputs = inputsOrVal.asInstanceOf[Iterable[V]].toSeq.sorted(values.ordering);
             if (depType == "STENCIL_1D_PERIODIC" && point + 1 >= taskGraph.getMax_width()) {
-                input_ptr = input_ptr.drop(1) ++ input_ptr.take(1);
+                inputs = inputs.drop(1) ++ inputs.take(1);
             } //PERIODIC: move input from 0th point to front if needed (array)
         }
-        val n_inputs = input_ptr.length;
-        val input_bytes = new Array[Long](n_inputs);  
-        var b = 0;
-        for (b <- 0 until input_bytes.length) {
-            input_bytes(b) = input_ptr(b).length;
-        }
-
-        val scratchBytesPerTask = taskGraph.getScratch_bytes_per_task();
-        core_c.task_graph_execute_point_scratch_auto(taskGraph, ts, point, output_ptr, output_bytes, 
-            input_ptr, input_bytes, n_inputs, scratchBytesPerTask);
-        output_ptr;
+        values.execute_point(taskGraph, ts, point, inputs);
     }
 
-    def execute_timestep(spark: SparkSession, SERtaskGraph: SERtask_graph_t, g: Int, ts: Int, global_valsRDDList:Array[org.apache.spark.rdd.RDD[(Int, Array[Byte])]], fakeValsRDD: org.apache.spark.rdd.RDD[(Int, Array[Byte])]) {
+    def execute_timestep[V: ClassTag](spark: SparkSession, SERtaskGraph: SERtask_graph_t, g: Int, ts: Int, values: Values[V], global_valsRDDList:Array[org.apache.spark.rdd.RDD[(Int, V)]], fakeValsRDD: org.apache.spark.rdd.RDD[(Int, V)]) {
         val taskGraph = SERtaskGraph.toTaskGraph();
         val curOffset = core_c.task_graph_offset_at_timestep(taskGraph, ts);  //0 for non-DOM
         val prevWidth = core_c.task_graph_width_at_timestep(taskGraph, math.max(0, ts - 1));
@@ -184,7 +230,7 @@ object Main {
         val depType = taskGraph.getDependence().toString();
 
         var valsRDD = fakeValsRDD;
-        val fakearr = new Array[Byte](1);
+        val fakeVal = values.fake;
         if (ts != 0)  {
             valsRDD = global_valsRDDList(g);  
         }
@@ -196,8 +242,8 @@ object Main {
         relevantValsRDD.collect().foreach(v=>println("point: " + v._1 +  " value: " + v._2.toList)); */
   
         //inputsRDDUngrouped needs to have all relevant points, can't be empty; vals don't matter for ts0, just needs (k,v) pairs
-        var inputsRDDUngrouped = spark.sparkContext.emptyRDD[(Int, Array[Byte])];
-        if (ts == 0) inputsRDDUngrouped = relevantValsRDD.mapValues( v=>fakearr); 
+        var inputsRDDUngrouped = spark.sparkContext.emptyRDD[(Int, V)];
+        if (ts == 0) inputsRDDUngrouped = relevantValsRDD.mapValues( v=>fakeVal); 
 
         /*------CREATE INPUT DATA, NO JOIN: send prev ts values to cur ts to get cur ts inputs-------*/
         if (depType != "NO_COMM" && depType != "TRIVIAL" && !(depType == "NEAREST" && taskGraph.getRadix() <= 1)) { //only send if ts != 0
@@ -208,7 +254,7 @@ object Main {
                         val taskGraph = SERtaskGraph.toTaskGraph(); //create on each worker
                         val intervalList = core_c.task_graph_reverse_dependencies(taskGraph, curDset, point); //where to send from prev ts
                         val numIntervals = core_c.interval_list_num_intervals(intervalList);
-                        var toReturn = ListBuffer.empty[(Int,Array[Byte])]; 
+                        var toReturn = ListBuffer.empty[(Int,V)]; 
                         var i = 0; //map returns a new collection
                         for (i <- 0 until numIntervals) {
                             val interval = core_c.interval_list_interval(intervalList, i);
@@ -232,7 +278,7 @@ object Main {
             /*------CREATE OUTPUT DATA-------*/
             valsRDD = inputsRDDUngrouped.groupByKey().mapPartitions( { iter=>iter.map {  
                 case (point, inputs) =>
-                val output_ptr = call_execute_point(SERtaskGraph, ts, point, inputs, false);
+                val output_ptr = call_execute_point(values, SERtaskGraph, ts, point, inputs, false);
                 (point, output_ptr)
             } }, preservesPartitioning = true); 
         }
@@ -243,7 +289,7 @@ object Main {
             }
             valsRDD = relevantValsRDD.mapPartitions( { iter=>iter.map {
                 case (point, oldVal) =>
-                val output_ptr = call_execute_point(SERtaskGraph, ts, point, oldVal, true);
+                val output_ptr = call_execute_point(values, SERtaskGraph, ts, point, oldVal, true);
                 (point, output_ptr)
             } }, preservesPartitioning = true); 
 
@@ -0,0 +1,107 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Hand-written JNI binding for NativeBuffer: executes a point on direct
+// ByteBuffers, so that no task data is copied across the JNI boundary.
+// Scratch comes from a per-executor native pool, keyed by graph index,
+// instead of being allocated (and prepared) on every call.
+
+#include <jni.h>
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "core_c.h"
+
+namespace {
+
+// Prepared scratch buffers that are not in use, by graph index.
+std::mutex pool_mutex;
+std::map<long, std::vector<char *> > pools;
+
+char *acquire_scratch(long graph_index, size_t bytes)
+{
+  if (bytes == 0) return NULL;
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex);
+    std::vector<char *> &pool = pools[graph_index];
+    if (!pool.empty()) {
+      char *scratch = pool.back();
+      pool.pop_back();
+      return scratch;
+    }
+  }
+  char *scratch = new char[bytes];
+  task_graph_prepare_scratch(scratch, bytes);
+  return scratch;
+}
+
+void release_scratch(long graph_index, char *scratch)
+{
+  if (scratch == NULL) return;
+  std::lock_guard<std::mutex> lock(pool_mutex);
+  pools[graph_index].push_back(scratch);
+}
+
+void throw_runtime_exception(JNIEnv *env, const char *message)
+{
+  jclass cls = env->FindClass("java/lang/RuntimeException");
+  if (cls != NULL) env->ThrowNew(cls, message);
+}
+
+}
+
+extern "C" {
+
+JNIEXPORT void JNICALL
+Java_NativeBuffer_executePoint(JNIEnv *env, jclass, jlong graph_ptr,
+                               jlong timestep, jlong point,
+                               jobject output, jobjectArray inputs)
+{
+  const task_graph_t *graph = reinterpret_cast<const task_graph_t *>(graph_ptr);
+
+  char *output_ptr = static_cast<char *>(env->GetDirectBufferAddress(output));
+  if (output_ptr == NULL) {
+    throw_runtime_exception(env, "output is not a direct ByteBuffer");
+    return;
+  }
+  size_t output_bytes = env->GetDirectBufferCapacity(output);
+
+  jsize n_inputs = env->GetArrayLength(inputs);
+  thread_local std::vector<const char *> input_ptr;
+  thread_local std::vector<size_t> input_bytes;
+  input_ptr.resize(n_inputs);
+  input_bytes.resize(n_inputs);
+  for (jsize i = 0; i < n_inputs; ++i) {
+    jobject input = env->GetObjectArrayElement(inputs, i);
+    input_ptr[i] = static_cast<const char *>(env->GetDirectBufferAddress(input));
+    input_bytes[i] = env->GetDirectBufferCapacity(input);
+    env->DeleteLocalRef(input);
+    if (input_ptr[i] == NULL) {
+      throw_runtime_exception(env, "input is not a direct ByteBuffer");
+      return;
+    }
+  }
+
+  char *scratch = acquire_scratch(graph->graph_index, graph->scratch_bytes_per_task);
+  task_graph_execute_point_scratch_ptr(graph, timestep, point,
+                                       output_ptr, output_bytes,
+                                       input_ptr.data(), input_bytes.data(), n_inputs,
+                                       scratch, graph->scratch_bytes_per_task);
+  release_scratch(graph->graph_index, scratch);
+}
+
+}
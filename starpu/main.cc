@@ -23,7 +23,9 @@
 #include <starpu_mpi.h>
 #include <starpu_profiling.h>
 #include "data.h"
+#include "perfmodel.h"
 #include "core.h"
+#include "placement.h"
 #include "timer.h"
 
 #include <unistd.h>
@@ -501,6 +503,18 @@ struct starpu_codelet cl_task8;
 struct starpu_codelet cl_task9;
 struct starpu_codelet cl_task10;
 
+// Shared by all the codelets: cost does not depend on the number of inputs.
+struct starpu_perfmodel task_model;
+
+static void task_point(struct starpu_task *task, const TaskGraph **graph, long *timestep, long *point)
+{
+  payload_t payload;
+  starpu_codelet_unpack_args(task->cl_arg, &payload);
+  *graph = payload.graph;
+  *timestep = payload.i;
+  *point = payload.j;
+}
+
 typedef struct matrix_s {
   int MT;
   int NT;
@@ -514,11 +528,13 @@ public:
   void execute_main_loop();
   void execute_timestep(size_t idx, long t);
 private:
+  void execute_graph();
   void insert_task(int num_args, payload_t &payload, std::array<starpu_data_handle_t, 10> &args);
   void parse_argument(int argc, char **argv);
   void debug_printf(int verbose_level, const char *format, ...);
 private:
   struct starpu_conf *conf;
+  PerfModelConfig perfmodel;
   int rank;
   int world;
   int nb_cores;
@@ -538,6 +554,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         MPI_COMM_WORLD, &(cl_task1),
         STARPU_VALUE,    &payload, sizeof(payload_t),
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task1",
         0);
     break;
@@ -547,6 +564,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_VALUE,    &payload, sizeof(payload_t),
         STARPU_R, args[1],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task2",
         0);
     break;
@@ -557,6 +575,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[1],
         STARPU_R, args[2],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task3",
         0);
     break;
@@ -568,6 +587,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[2],
         STARPU_R, args[3],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task4",
         0);
     break;
@@ -580,6 +600,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[3],
         STARPU_R, args[4],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task5",
         0);
     break;
@@ -593,6 +614,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[4],
         STARPU_R, args[5],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task6",
         0);
     break;
@@ -607,6 +629,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[5],
         STARPU_R, args[6],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task7",
         0);
     break;
@@ -622,6 +645,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[6],
         STARPU_R, args[7],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task8",
         0);
     break;
@@ -638,6 +662,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[7],
         STARPU_R, args[8],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task9",
         0);
     break;
@@ -655,6 +680,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[8],
         STARPU_R, args[9],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task10",
         0);
     break;
@@ -684,6 +710,7 @@ void StarPUApp::parse_argument(int argc, char **argv)
 StarPUApp::StarPUApp(int argc, char **argv)
   : App(argc, argv)
 {
+  placement_require_block("starpu");
   cl_task1.where     = STARPU_CPU;                                   
   cl_task1.cpu_funcs[0]  = task1;                                       
   cl_task1.nbuffers  = 1;                                           
@@ -741,6 +768,18 @@ StarPUApp::StarPUApp(int argc, char **argv)
   nb_cores = 1;
   
   parse_argument(argc, argv);
+
+  perfmodel = parse_perfmodel_config(argc, argv);
+  if (perfmodel.enabled) {
+    init_task_perfmodel(&task_model, "task_bench", perfmodel, task_point);
+    struct starpu_codelet *codelets[] = {
+      &cl_task1, &cl_task2, &cl_task3, &cl_task4, &cl_task5,
+      &cl_task6, &cl_task7, &cl_task8, &cl_task9, &cl_task10,
+    };
+    for (auto cl : codelets) {
+      cl->model = &task_model;
+    }
+  }
   
   conf =  (struct starpu_conf *)malloc (sizeof(struct starpu_conf));
   starpu_conf_init( conf );
@@ -749,6 +788,7 @@ StarPUApp::StarPUApp(int argc, char **argv)
   conf->ncuda = 0;
   conf->nopencl = 0;
   conf->sched_policy_name = "lws";
+  conf->calibrate = perfmodel.calibrate;
   
   int ret;
   ret = starpu_init(conf);
@@ -847,26 +887,54 @@ void StarPUApp::execute_main_loop()
     }
   }
 
-  /* start timer */
-  starpu_mpi_barrier(MPI_COMM_WORLD);
-  if (rank == 0) {
-    Timer::time_start();
+  // Without -sched, tasks go to the global context (lws); with it, to
+  // a context per policy, one after another.
+  std::vector<std::string> scheds = perfmodel.scheds;
+  if (scheds.empty()) {
+    scheds.push_back("");
   }
-  
-  for (int i = 0; i < graphs.size(); i++) {
-    const TaskGraph &g = graphs[i];
 
-    for (y = 0; y < g.timesteps; y++) {
-      execute_timestep(i, y);
+  for (auto &sched : scheds) {
+    unsigned ctx = 0;
+    if (!sched.empty()) {
+      ctx = push_sched_ctx(sched);
+    }
+
+    // Calibration runs are not timed.
+    for (int run = 0; run < perfmodel.calibrate_runs; run++) {
+      execute_graph();
+    }
+
+    /* start timer */
+    starpu_mpi_barrier(MPI_COMM_WORLD);
+    if (rank == 0) {
+      Timer::time_start();
+    }
+
+    execute_graph();
+
+    starpu_mpi_barrier(MPI_COMM_WORLD);
+    if (rank == 0) {
+      double elapsed = Timer::time_end();
+      if (!sched.empty()) {
+        printf("Scheduler %s\n", sched.c_str());
+      }
+      report_timing(elapsed);
+    }
+
+    if (!sched.empty()) {
+      pop_sched_ctx(ctx);
     }
   }
+}
 
-  starpu_task_wait_for_all();
-  starpu_mpi_barrier(MPI_COMM_WORLD);
-  if (rank == 0) {
-    double elapsed = Timer::time_end();
-    report_timing(elapsed);
+void StarPUApp::execute_graph()
+{
+  for (auto step : issue_order()) {
+    execute_timestep(step.first, step.second);
   }
+
+  starpu_task_wait_for_all();
 }
 
 void StarPUApp::execute_timestep(size_t idx, long t)
@@ -24,6 +24,7 @@
 #include <starpu_profiling.h>
 #include "data.h"
 #include "core.h"
+#include "placement.h"
 #include "timer.h"
 
 #include <unistd.h>
@@ -616,6 +617,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         MPI_COMM_WORLD, &(cl_task1),
         STARPU_VALUE,    &payload, sizeof(payload_t),
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task1",
         0);
     break;
@@ -625,6 +627,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_VALUE,    &payload, sizeof(payload_t),
         STARPU_R, args[1],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task2",
         0);
     break;
@@ -635,6 +638,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[1],
         STARPU_R, args[2],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task3",
         0);
     break;
@@ -646,6 +650,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[2],
         STARPU_R, args[3],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task4",
         0);
     break;
@@ -658,6 +663,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[3],
         STARPU_R, args[4],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task5",
         0);
     break;
@@ -671,6 +677,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[4],
         STARPU_R, args[5],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task6",
         0);
     break;
@@ -685,6 +692,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[5],
         STARPU_R, args[6],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task7",
         0);
     break;
@@ -700,6 +708,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[6],
         STARPU_R, args[7],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task8",
         0);
     break;
@@ -716,6 +725,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[7],
         STARPU_R, args[8],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task9",
         0);
     break;
@@ -733,6 +743,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
         STARPU_R, args[8],
         STARPU_R, args[9],
         STARPU_RW, args[0],
+        STARPU_PRIORITY, payload.graph->priority,
         STARPU_NAME, "task10",
         0);
     break;
@@ -762,6 +773,7 @@ void StarPUApp::parse_argument(int argc, char **argv)
 StarPUApp::StarPUApp(int argc, char **argv)
   : App(argc, argv)
 {
+  placement_require_block("starpu");
   cl_task1.where     = STARPU_CPU;                                   
   cl_task1.cpu_funcs[0]  = task1;                                       
   cl_task1.nbuffers  = 1;                                           
@@ -24,6 +24,7 @@
 #include <array>
 #include "data.h"
 #include "core.h"
+#include "placement.h"
 #include "timer.h"
 
 #include <unistd.h>
@@ -587,6 +588,7 @@ void StarPUApp::insert_task(int num_args, payload_t &payload, std::array<starpu_
       task->dyn_modes[i] = i < num_args-1 ? STARPU_R : STARPU_RW;
     }
   }
+  task->priority = payload.graph->priority;
   task->callback_func = task_clean;
   task->callback_arg = task;
   task->cl_arg = malloc(sizeof(payload_t));
@@ -618,6 +620,7 @@ void StarPUApp::parse_argument(int argc, char **argv)
 StarPUApp::StarPUApp(int argc, char **argv)
   : App(argc, argv)
 {
+  placement_require_block("starpu");
   cl_task1.where     = STARPU_CPU;                                   
   cl_task1.cpu_funcs[0]  = task1;                                       
   cl_task1.nbuffers  = 1;                                           
@@ -24,7 +24,9 @@
 #include <array>
 #include <set>
 #include "data.h"
+#include "perfmodel.h"
 #include "core.h"
+#include "placement.h"
 #include "timer.h"
 
 #include <unistd.h>
@@ -517,6 +519,15 @@ static void task(void *descr[], void *cl_arg)
 }
 
 struct starpu_codelet cl_task; 
+struct starpu_perfmodel task_model;
+
+static void task_point(struct starpu_task *task, const TaskGraph **graph, long *timestep, long *point)
+{
+  payload_t *payload = (payload_t *) task->cl_arg;
+  *graph = payload->graph;
+  *timestep = payload->i;
+  *point = payload->j;
+}
 
 typedef struct matrix_s {
   int MT;
@@ -704,6 +715,7 @@ struct starpu_task *StarPUApp::create_task(payload_t &payload)
   payload_t *task_payload;
 
   task->cl = &cl_task;
+  task->priority = g->priority;
   task->use_tag = 1;
   task->tag_id = tag_in(payload.graph_id, payload.i, payload.j);
   task->regenerate = 1;
@@ -855,6 +867,7 @@ void StarPUApp::parse_argument(int argc, char **argv)
 StarPUApp::StarPUApp(int argc, char **argv)
   : App(argc, argv)
 {
+  placement_require_block("starpu");
   cl_task.where      = STARPU_CPU;                                   
   cl_task.cpu_funcs[0] = task;                                       
   cl_task.name       = "task";
@@ -868,6 +881,18 @@ StarPUApp::StarPUApp(int argc, char **argv)
   unroll = DEFAULT_UNROLL;
   
   parse_argument(argc, argv);
+
+  // Tasks regenerate themselves, so the graph runs only once: models
+  // calibrate during the timed run, and there is no policy sweep.
+  PerfModelConfig perfmodel = parse_perfmodel_config(argc, argv);
+  if (!perfmodel.scheds.empty() || perfmodel.calibrate_runs > 0) {
+    fprintf(stderr, "error: main_static supports neither -sched nor -calibrate runs (use -calibrate 0)\n");
+    abort();
+  }
+  if (perfmodel.enabled) {
+    init_task_perfmodel(&task_model, "task_bench_static", perfmodel, task_point);
+    cl_task.model = &task_model;
+  }
   
   conf =  (struct starpu_conf *)malloc (sizeof(struct starpu_conf));
   starpu_conf_init( conf );
@@ -876,6 +901,7 @@ StarPUApp::StarPUApp(int argc, char **argv)
   conf->ncuda = 0;
   conf->nopencl = 0;
   conf->sched_policy_name = "lws";
+  conf->calibrate = perfmodel.calibrate;
   
   int ret;
   ret = starpu_init(conf);
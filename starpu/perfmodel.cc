@@ -0,0 +1,161 @@
+/* Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "perfmodel.h"
+#include "core_kernel.h"
+
+// Only one model is active per binary.
+static void (*model_task_point)(struct starpu_task *task, const TaskGraph **graph,
+                                long *timestep, long *point) = NULL;
+static std::string model_symbol;
+
+static long task_iterations(const TaskGraph &g, long timestep, long point)
+{
+  switch (g.kernel.type) {
+  case KernelType::LOAD_IMBALANCE:
+    return select_imbalance_iterations(g.kernel, g.graph_index, timestep, point);
+  case KernelType::DIST_IMBALANCE:
+    return select_dist_iterations(g.kernel, g.graph_index, timestep, point);
+  default:
+    return g.kernel.iterations;
+  }
+}
+
+static uint32_t task_footprint(struct starpu_task *task)
+{
+  const TaskGraph *g;
+  long timestep, point;
+  model_task_point(task, &g, &timestep, &point);
+
+  uint32_t type = g->kernel.type;
+  uint64_t iterations = task_iterations(*g, timestep, point);
+  uint64_t scratch_bytes = g->scratch_bytes_per_task;
+  uint32_t hash = starpu_hash_crc32c_be(type, 0);
+  hash = starpu_hash_crc32c_be_n(&iterations, sizeof(iterations), hash);
+  return starpu_hash_crc32c_be_n(&scratch_bytes, sizeof(scratch_bytes), hash);
+}
+
+// Regression models fit time against this: the iterations, times the
+// scratch bytes for kernels that sweep their scratch each iteration.
+static size_t task_size_base(struct starpu_task *task, struct starpu_perfmodel_arch *arch, unsigned nimpl)
+{
+  const TaskGraph *g;
+  long timestep, point;
+  model_task_point(task, &g, &timestep, &point);
+
+  size_t size = std::max(1L, task_iterations(*g, timestep, point));
+  if (g->scratch_bytes_per_task > 0) {
+    size *= g->scratch_bytes_per_task;
+  }
+  return size;
+}
+
+PerfModelConfig parse_perfmodel_config(int argc, char **argv)
+{
+  PerfModelConfig config;
+  config.enabled = true;
+  config.type = STARPU_HISTORY_BASED;
+  config.calibrate = 0;
+  config.calibrate_runs = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-perfmodel")) {
+      const char *name = argv[++i];
+      if (!strcmp(name, "none")) {
+        config.enabled = false;
+      } else if (!strcmp(name, "history")) {
+        config.type = STARPU_HISTORY_BASED;
+      } else if (!strcmp(name, "regression")) {
+        config.type = STARPU_REGRESSION_BASED;
+      } else if (!strcmp(name, "nl_regression")) {
+        config.type = STARPU_NL_REGRESSION_BASED;
+      } else {
+        fprintf(stderr, "error: Invalid flag \"-perfmodel %s\"\n", name);
+        abort();
+      }
+    }
+    if (!strcmp(argv[i], "-calibrate")) {
+      config.calibrate_runs = atoi(argv[++i]);
+      if (config.calibrate_runs < 0) {
+        fprintf(stderr, "error: Invalid flag \"-calibrate %d\" must be >= 0\n", config.calibrate_runs);
+        abort();
+      }
+      config.calibrate = 1;
+    }
+    if (!strcmp(argv[i], "-sched")) {
+      char *names = strdup(argv[++i]);
+      for (char *name = strtok(names, ","); name; name = strtok(NULL, ",")) {
+        config.scheds.push_back(name);
+      }
+      free(names);
+      if (config.scheds.empty()) {
+        fprintf(stderr, "error: Invalid flag \"-sched\" needs at least one policy\n");
+        abort();
+      }
+    }
+  }
+
+  if (config.calibrate && !config.enabled) {
+    fprintf(stderr, "error: -calibrate requires a -perfmodel\n");
+    abort();
+  }
+  return config;
+}
+
+void init_task_perfmodel(struct starpu_perfmodel *model, const char *symbol,
+                         const PerfModelConfig &config,
+                         void (*task_point)(struct starpu_task *task, const TaskGraph **graph,
+                                            long *timestep, long *point))
+{
+  assert(model_task_point == NULL);
+  model_task_point = task_point;
+
+  // History and regression files must not be mixed up.
+  model_symbol = symbol;
+  model_symbol += config.type == STARPU_HISTORY_BASED ? "_history" :
+                  config.type == STARPU_REGRESSION_BASED ? "_regression" : "_nl_regression";
+
+  model->type = config.type;
+  model->symbol = model_symbol.c_str();
+  model->footprint = task_footprint;
+  if (config.type != STARPU_HISTORY_BASED) {
+    model->size_base = task_size_base;
+  }
+}
+
+unsigned push_sched_ctx(const std::string &policy)
+{
+  int nworkers = starpu_worker_get_count();
+  std::vector<int> workers(nworkers);
+  for (int w = 0; w < nworkers; w++) {
+    workers[w] = w;
+  }
+  unsigned ctx = starpu_sched_ctx_create(workers.data(), nworkers, policy.c_str(),
+                                         STARPU_SCHED_CTX_POLICY_NAME, policy.c_str(), 0);
+  starpu_sched_ctx_set_context(&ctx);
+  return ctx;
+}
+
+void pop_sched_ctx(unsigned ctx)
+{
+  unsigned global = STARPU_GLOBAL_SCHED_CTX;
+  starpu_sched_ctx_set_context(&global);
+  starpu_sched_ctx_delete(ctx);
+}
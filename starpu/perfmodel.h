@@ -0,0 +1,54 @@
+/* Copyright 2020 Los Alamos National Laboratory
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PERFMODEL_H
+#define PERFMODEL_H
+
+#include <string>
+#include <vector>
+#include <starpu.h>
+#include "core.h"
+
+// Performance models for task bench codelets, so that the model-based
+// schedulers (dmda, dmdas, heft, ...) can predict task durations. Tasks
+// are keyed on (kernel type, iterations, scratch bytes), with the
+// iterations of the task itself for imbalanced kernels.
+
+struct PerfModelConfig {
+  bool enabled;
+  enum starpu_perfmodel_type type;
+  int calibrate; // starpu_conf::calibrate
+  int calibrate_runs; // untimed runs before the timed one
+  std::vector<std::string> scheds; // empty: the default policy only
+};
+
+// Parses -perfmodel none|history|regression|nl_regression (default
+// history), -calibrate RUNS and -sched POLICY[,POLICY...].
+PerfModelConfig parse_perfmodel_config(int argc, char **argv);
+
+// Fills in model (zero-initialized) for tasks whose graph and point are
+// given by task_point. Calibration files are named after symbol and the
+// model type, and shared between runs of the same binary.
+void init_task_perfmodel(struct starpu_perfmodel *model, const char *symbol,
+                         const PerfModelConfig &config,
+                         void (*task_point)(struct starpu_task *task, const TaskGraph **graph,
+                                            long *timestep, long *point));
+
+// Workers in a new scheduling context with the given policy, which
+// then receives the tasks submitted by this thread.
+unsigned push_sched_ctx(const std::string &policy);
+void pop_sched_ctx(unsigned ctx);
+
+#endif
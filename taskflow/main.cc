@@ -0,0 +1,249 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <taskflow/taskflow.hpp>
+
+#include "core.h"
+#include "alloc.h"
+#include "timer.h"
+
+// Taskflow implementation, in two shapes. By default the whole graph is
+// one tf::Taskflow, built once from dependencies() before the timed run.
+// With -stream, a taskflow of one task per point of every graph is built
+// instead and run once per timestep (tf::Executor::run_until).
+//
+// Outputs are kept for OUTPUT_ROWS timesteps. In the full taskflow a
+// task therefore also waits for the readers of the slot it overwrites
+// (and for its previous writer); streamed timesteps are ordered anyway.
+
+#define OUTPUT_ROWS 4
+
+#define STREAM_FLAG "-stream"
+
+struct GraphState {
+  long first_task; // index of (timestep 0, point 0) in tasks
+  size_t slot_bytes;
+  char *outputs; // [OUTPUT_ROWS][max_width] slots
+};
+
+struct TaskflowApp : public App {
+  TaskflowApp(int argc, char **argv);
+  ~TaskflowApp();
+  void execute_main_loop();
+private:
+  void execute_task(size_t idx, long t, long x);
+  void build_taskflow();
+  void build_stream();
+private:
+  int nb_workers;
+  bool stream;
+  std::vector<GraphState> states;
+  std::vector<char *> scratch; // per executor worker
+  std::unique_ptr<tf::Executor> executor;
+  tf::Taskflow taskflow;
+  long timestep; // of the current run, with -stream
+  long max_timesteps;
+};
+
+static bool active_at(const TaskGraph &g, long t, long x)
+{
+  long offset = g.offset_at_timestep(t);
+  return t >= 0 && t < g.timesteps && x >= offset && x < offset + g.width_at_timestep(t);
+}
+
+TaskflowApp::TaskflowApp(int argc, char **argv)
+  : App(argc, argv)
+{
+  nb_workers = std::thread::hardware_concurrency();
+  stream = false;
+
+  for (int k = 1; k < argc; k++) {
+    if (!strcmp(argv[k], "-worker")) {
+      nb_workers = atol(argv[++k]);
+    }
+    if (!strcmp(argv[k], STREAM_FLAG)) {
+      stream = true;
+    }
+  }
+  if (nb_workers < 1) {
+    fprintf(stderr, "error: -worker must be at least 1\n");
+    abort();
+  }
+
+  long first_task = 0;
+  size_t max_scratch_bytes = 0;
+  max_timesteps = 0;
+  for (auto &graph : graphs) {
+    if (graph.arrival_rate > 0) {
+      fprintf(stderr, "error: taskflow does not support -arrival-rate\n");
+      abort();
+    }
+
+    GraphState state;
+    state.first_task = first_task;
+    first_task += graph.timesteps * graph.max_width;
+    state.slot_bytes = graph.max_output_bytes();
+    state.outputs = alloc_buffer(OUTPUT_ROWS * graph.max_width * state.slot_bytes, -1);
+    states.push_back(state);
+
+    max_scratch_bytes = std::max(max_scratch_bytes, graph.scratch_bytes_per_task);
+    max_timesteps = std::max(max_timesteps, graph.timesteps);
+  }
+
+  executor.reset(new tf::Executor(nb_workers));
+  for (int w = 0; w < nb_workers; w++) {
+    scratch.push_back(TaskGraph::allocate_scratch(max_scratch_bytes, 1, -1));
+  }
+
+  if (stream) {
+    build_stream();
+  } else {
+    build_taskflow();
+  }
+}
+
+TaskflowApp::~TaskflowApp()
+{
+  for (auto &state : states) {
+    free_buffer(state.outputs);
+  }
+  for (auto scratch_ptr : scratch) {
+    TaskGraph::free_scratch(scratch_ptr);
+  }
+}
+
+void TaskflowApp::execute_task(size_t idx, long t, long x)
+{
+  const TaskGraph &g = graphs[idx];
+  const GraphState &state = states[idx];
+  long row = t % OUTPUT_ROWS;
+  long last_row = (t + OUTPUT_ROWS - 1) % OUTPUT_ROWS;
+
+  thread_local std::vector<const char *> input_ptrs;
+  thread_local std::vector<size_t> input_bytes;
+  input_ptrs.clear();
+  input_bytes.clear();
+  if (t > 0) {
+    g.for_each_dependency_point(g.dependence_set_at_timestep(t), x, [&](long i) {
+      if (active_at(g, t-1, i)) {
+        input_ptrs.push_back(state.outputs + (last_row * g.max_width + i) * state.slot_bytes);
+        input_bytes.push_back(g.output_bytes_at(t-1, i));
+      }
+    });
+  }
+
+  g.execute_point(t, x,
+                  state.outputs + (row * g.max_width + x) * state.slot_bytes, g.output_bytes_at(t, x),
+                  input_ptrs.data(), input_bytes.data(), input_ptrs.size(),
+                  scratch[executor->this_worker_id()], g.scratch_bytes_per_task);
+}
+
+void TaskflowApp::build_taskflow()
+{
+  std::vector<tf::Task> tasks;
+  for (size_t idx = 0; idx < graphs.size(); idx++) {
+    const TaskGraph &g = graphs[idx];
+    long first_task = states[idx].first_task;
+    tasks.resize(first_task + g.timesteps * g.max_width);
+    auto task_at = [&](long t, long x) -> tf::Task & { return tasks[first_task + t * g.max_width + x]; };
+
+    for (long t = 0; t < g.timesteps; ++t) {
+      long offset = g.offset_at_timestep(t);
+      long width = g.width_at_timestep(t);
+      for (long x = offset; x < offset + width; ++x) {
+        tf::Task task = taskflow.emplace([this, idx, t, x]() { execute_task(idx, t, x); });
+        task_at(t, x) = task;
+
+        if (t > 0) {
+          g.for_each_dependency_point(g.dependence_set_at_timestep(t), x, [&](long i) {
+            if (active_at(g, t-1, i)) {
+              task_at(t-1, i).precede(task);
+            }
+          });
+        }
+
+        // The slot was last written at timestep t - OUTPUT_ROWS and
+        // read by the timestep after that.
+        long writer = t - OUTPUT_ROWS;
+        if (writer >= 0 && active_at(g, writer, x)) {
+          task_at(writer, x).precede(task);
+
+          long reader = writer + 1;
+          long reader_offset = g.offset_at_timestep(reader);
+          long reader_width = g.width_at_timestep(reader);
+          size_t n_rev_deps;
+          const std::pair<long, long> *rev_deps =
+            g.dependency_table()->reverse_dependencies(g.dependence_set_at_timestep(reader), x, n_rev_deps);
+          for (size_t span = 0; span < n_rev_deps; ++span) {
+            long first = std::max(rev_deps[span].first, reader_offset);
+            long last = std::min(rev_deps[span].second, reader_offset + reader_width - 1);
+            for (long y = first; y <= last; ++y) {
+              task_at(reader, y).precede(task);
+            }
+          }
+        }
+      }
+    }
+  }
+}
+
+void TaskflowApp::build_stream()
+{
+  // Points inactive in the current timestep (or past the end of their
+  // graph) return at once.
+  for (size_t idx = 0; idx < graphs.size(); idx++) {
+    const TaskGraph &g = graphs[idx];
+    for (long x = 0; x < g.max_width; ++x) {
+      taskflow.emplace([this, idx, x]() {
+        if (active_at(graphs[idx], timestep, x)) {
+          execute_task(idx, timestep, x);
+        }
+      });
+    }
+  }
+}
+
+void TaskflowApp::execute_main_loop()
+{
+  display();
+
+  Timer::time_start();
+  if (stream) {
+    // The predicate runs before every run, including the first.
+    timestep = -1;
+    executor->run_until(taskflow, [this]() { return ++timestep >= max_timesteps; }).wait();
+  } else {
+    executor->run(taskflow).wait();
+  }
+  double elapsed = Timer::time_end();
+
+  report_timing(elapsed);
+}
+
+int main(int argc, char **argv)
+{
+  TaskflowApp app(argc, argv);
+  app.execute_main_loop();
+
+  return 0;
+}
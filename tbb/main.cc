@@ -0,0 +1,299 @@
+/* Copyright 2020 Stanford University
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <tbb/blocked_range.h>
+#include <tbb/flow_graph.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include "core.h"
+#include "alloc.h"
+#include "timer.h"
+
+// oneTBB implementation, in two shapes. By default the whole graph is
+// one tbb::flow::graph of continue_nodes, built once from dependencies()
+// before the timed run. With -stream, timesteps are instead run one at a
+// time, as a parallel_for over the points of every graph.
+//
+// Outputs are kept for OUTPUT_ROWS timesteps. In the flow graph a task
+// therefore also waits for the readers of the slot it overwrites (and
+// for its previous writer); streamed timesteps are ordered anyway.
+
+#define OUTPUT_ROWS 4
+
+#define STREAM_FLAG "-stream"
+
+typedef tbb::flow::continue_node<tbb::flow::continue_msg> TaskNode;
+
+struct GraphState {
+  long first_node; // index of (timestep 0, point 0) in nodes
+  size_t slot_bytes;
+  char *outputs; // [OUTPUT_ROWS][max_width] slots
+};
+
+struct TBBApp : public App {
+  TBBApp(int argc, char **argv);
+  ~TBBApp();
+  void execute_main_loop();
+private:
+  void execute_task(size_t idx, long t, long x);
+  void build_flow_graph();
+  void run_flow_graph();
+  void run_stream();
+private:
+  int nb_workers;
+  bool stream;
+  std::vector<GraphState> states;
+  std::vector<char *> scratch; // per arena slot
+  std::unique_ptr<tbb::task_arena> arena;
+  std::unique_ptr<tbb::flow::graph> flow;
+  std::vector<std::unique_ptr<TaskNode> > nodes; // null for inactive points
+  std::vector<TaskNode *> sources;
+};
+
+static bool active_at(const TaskGraph &g, long t, long x)
+{
+  long offset = g.offset_at_timestep(t);
+  return t >= 0 && t < g.timesteps && x >= offset && x < offset + g.width_at_timestep(t);
+}
+
+TBBApp::TBBApp(int argc, char **argv)
+  : App(argc, argv)
+{
+  nb_workers = tbb::this_task_arena::max_concurrency();
+  stream = false;
+
+  for (int k = 1; k < argc; k++) {
+    if (!strcmp(argv[k], "-worker")) {
+      nb_workers = atol(argv[++k]);
+    }
+    if (!strcmp(argv[k], STREAM_FLAG)) {
+      stream = true;
+    }
+  }
+  if (nb_workers < 1) {
+    fprintf(stderr, "error: -worker must be at least 1\n");
+    abort();
+  }
+
+  long first_node = 0;
+  size_t max_scratch_bytes = 0;
+  for (auto &graph : graphs) {
+    if (graph.arrival_rate > 0) {
+      fprintf(stderr, "error: tbb does not support -arrival-rate\n");
+      abort();
+    }
+
+    GraphState state;
+    state.first_node = first_node;
+    first_node += graph.timesteps * graph.max_width;
+    state.slot_bytes = graph.max_output_bytes();
+    state.outputs = alloc_buffer(OUTPUT_ROWS * graph.max_width * state.slot_bytes, -1);
+    states.push_back(state);
+
+    max_scratch_bytes = std::max(max_scratch_bytes, graph.scratch_bytes_per_task);
+  }
+
+  arena.reset(new tbb::task_arena(nb_workers));
+  for (int w = 0; w < arena->max_concurrency(); w++) {
+    scratch.push_back(TaskGraph::allocate_scratch(max_scratch_bytes, 1, -1));
+  }
+
+  if (!stream) {
+    nodes.resize(first_node);
+    build_flow_graph();
+  }
+}
+
+TBBApp::~TBBApp()
+{
+  // Nodes must go before the graph they belong to.
+  nodes.clear();
+  flow.reset();
+  for (auto &state : states) {
+    free_buffer(state.outputs);
+  }
+  for (auto scratch_ptr : scratch) {
+    TaskGraph::free_scratch(scratch_ptr);
+  }
+}
+
+void TBBApp::execute_task(size_t idx, long t, long x)
+{
+  const TaskGraph &g = graphs[idx];
+  const GraphState &state = states[idx];
+  long row = t % OUTPUT_ROWS;
+  long last_row = (t + OUTPUT_ROWS - 1) % OUTPUT_ROWS;
+
+  thread_local std::vector<const char *> input_ptrs;
+  thread_local std::vector<size_t> input_bytes;
+  input_ptrs.clear();
+  input_bytes.clear();
+  if (t > 0) {
+    g.for_each_dependency_point(g.dependence_set_at_timestep(t), x, [&](long i) {
+      if (active_at(g, t-1, i)) {
+        input_ptrs.push_back(state.outputs + (last_row * g.max_width + i) * state.slot_bytes);
+        input_bytes.push_back(g.output_bytes_at(t-1, i));
+      }
+    });
+  }
+
+  g.execute_point(t, x,
+                  state.outputs + (row * g.max_width + x) * state.slot_bytes, g.output_bytes_at(t, x),
+                  input_ptrs.data(), input_bytes.data(), input_ptrs.size(),
+                  scratch[tbb::this_task_arena::current_thread_index()], g.scratch_bytes_per_task);
+}
+
+void TBBApp::build_flow_graph()
+{
+  // The graph belongs to the arena it is created in.
+  arena->execute([&] { flow.reset(new tbb::flow::graph); });
+
+  for (size_t idx = 0; idx < graphs.size(); idx++) {
+    const TaskGraph &g = graphs[idx];
+    long first_node = states[idx].first_node;
+    auto node = [&](long t, long x) { return nodes[first_node + t * g.max_width + x].get(); };
+
+    for (long t = 0; t < g.timesteps; ++t) {
+      long offset = g.offset_at_timestep(t);
+      long width = g.width_at_timestep(t);
+      for (long x = offset; x < offset + width; ++x) {
+        TaskNode *task = new TaskNode(*flow, [this, idx, t, x](const tbb::flow::continue_msg &) {
+          execute_task(idx, t, x);
+        });
+        nodes[first_node + t * g.max_width + x].reset(task);
+
+        long preds = 0;
+        if (t > 0) {
+          g.for_each_dependency_point(g.dependence_set_at_timestep(t), x, [&](long i) {
+            if (active_at(g, t-1, i)) {
+              tbb::flow::make_edge(*node(t-1, i), *task);
+              preds++;
+            }
+          });
+        }
+
+        // The slot was last written at timestep t - OUTPUT_ROWS and
+        // read by the timestep after that.
+        long writer = t - OUTPUT_ROWS;
+        if (writer >= 0 && active_at(g, writer, x)) {
+          tbb::flow::make_edge(*node(writer, x), *task);
+          preds++;
+
+          long reader = writer + 1;
+          long reader_offset = g.offset_at_timestep(reader);
+          long reader_width = g.width_at_timestep(reader);
+          size_t n_rev_deps;
+          const std::pair<long, long> *rev_deps =
+            g.dependency_table()->reverse_dependencies(g.dependence_set_at_timestep(reader), x, n_rev_deps);
+          for (size_t span = 0; span < n_rev_deps; ++span) {
+            long first = std::max(rev_deps[span].first, reader_offset);
+            long last = std::min(rev_deps[span].second, reader_offset + reader_width - 1);
+            for (long y = first; y <= last; ++y) {
+              tbb::flow::make_edge(*node(reader, y), *task);
+              preds++;
+            }
+          }
+        }
+
+        if (preds == 0) {
+          sources.push_back(task);
+        }
+      }
+    }
+  }
+}
+
+void TBBApp::run_flow_graph()
+{
+  arena->execute([&] {
+    for (auto source : sources) {
+      source->try_put(tbb::flow::continue_msg());
+    }
+    flow->wait_for_all();
+  });
+}
+
+void TBBApp::run_stream()
+{
+  long max_timesteps = 0;
+  for (auto &g : graphs) {
+    max_timesteps = std::max(max_timesteps, g.timesteps);
+  }
+
+  // (graph, point) of the tasks of the current timestep.
+  std::vector<std::pair<size_t, long> > tasks;
+  for (long t = 0; t < max_timesteps; ++t) {
+    tasks.clear();
+    for (size_t idx = 0; idx < graphs.size(); idx++) {
+      const TaskGraph &g = graphs[idx];
+      if (t >= g.timesteps) {
+        continue;
+      }
+      long offset = g.offset_at_timestep(t);
+      long width = g.width_at_timestep(t);
+      for (long x = offset; x < offset + width; ++x) {
+        tasks.emplace_back(idx, x);
+      }
+    }
+
+    arena->execute([&] {
+      tbb::parallel_for(tbb::blocked_range<size_t>(0, tasks.size()),
+                        [&](const tbb::blocked_range<size_t> &range) {
+        for (size_t i = range.begin(); i != range.end(); ++i) {
+          execute_task(tasks[i].first, t, tasks[i].second);
+        }
+      });
+    });
+  }
+}
+
+void TBBApp::execute_main_loop()
+{
+  display();
+
+  // Continue nodes reset their counts once they fire, so the flow graph
+  // can be run again.
+  auto run = [&] {
+    Timer::time_start();
+    if (stream) {
+      run_stream();
+    } else {
+      run_flow_graph();
+    }
+    return Timer::time_end();
+  };
+
+  if (metg) {
+    search_metg(run, nb_workers);
+  } else {
+    execute_timed(run);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  TBBApp app(argc, argv);
+  app.execute_main_loop();
+
+  return 0;
+}
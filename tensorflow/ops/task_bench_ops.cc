@@ -36,6 +36,22 @@ REGISTER_OP("ExecutePointOp")
 
 REGISTER_KERNEL_BUILDER(Name("ExecutePointOp").Device(DEVICE_CPU), ExecutePointOp)
 
+REGISTER_OP("ExecuteRowOp")
+    .Attr("task_graph: string")
+    .Attr("timestep: int")
+    .Attr("first_point: int")
+    .Attr("n_points: int >= 1")
+    .Attr("prev_first: int")
+    .Attr("prev_n: int >= 0")
+    .Attr("parallel: bool = false")
+    .Input("outputs_in: n_points * uint8")
+    .Input("scratch_in: n_points * uint8")
+    .Input("prev: prev_n * uint8")
+    .Output("outputs: n_points * uint8")
+    .Output("scratch: n_points * uint8");
+
+REGISTER_KERNEL_BUILDER(Name("ExecuteRowOp").Device(DEVICE_CPU), ExecuteRowOp)
+
 REGISTER_OP("PrepareScratchOp")
     .Input("task_graph: uint8")
     .Input("dummy_in: uint8")
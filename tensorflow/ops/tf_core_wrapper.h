@@ -20,6 +20,8 @@
 #include "tensorflow/core/framework/op_kernel.h"
 #include "tensorflow/core/framework/shape_inference.h"
 
+#include "tensorflow/core/util/work_sharder.h"
+
 #include "core_c.h"
 
 using namespace tensorflow;
@@ -94,4 +96,95 @@ public:
   }
 };
 
+// Runs points [first_point, first_point + n_points) of one timestep in a
+// single kernel invocation. The task graph is decoded once, from the
+// task_graph attribute, when the kernel is constructed. The previous
+// row is passed as prev_n tensors for points [prev_first, ...), and
+// each point picks its own dependencies from it.
+class ExecuteRowOp : public OpKernel {
+public:
+  explicit ExecuteRowOp(OpKernelConstruction* context) : OpKernel(context)
+  {
+    string bytes;
+    OP_REQUIRES_OK(context, context->GetAttr("task_graph", &bytes));
+    OP_REQUIRES(context, bytes.size() == sizeof(task_graph_t),
+                errors::InvalidArgument("task_graph attribute has the wrong size"));
+    memcpy(&graph, bytes.data(), sizeof(graph));
+
+    OP_REQUIRES_OK(context, context->GetAttr("timestep", &timestep));
+    OP_REQUIRES_OK(context, context->GetAttr("first_point", &first_point));
+    OP_REQUIRES_OK(context, context->GetAttr("n_points", &n_points));
+    OP_REQUIRES_OK(context, context->GetAttr("prev_first", &prev_first));
+    OP_REQUIRES_OK(context, context->GetAttr("prev_n", &prev_n));
+    OP_REQUIRES_OK(context, context->GetAttr("parallel", &parallel));
+
+    // Dependencies do not change between calls, so resolve them here.
+    long last_offset = task_graph_offset_at_timestep(graph, timestep - 1);
+    long last_width = task_graph_width_at_timestep(graph, timestep - 1);
+    long dset = task_graph_dependence_set_at_timestep(graph, timestep);
+    deps.resize(n_points);
+    for (int i = 0; i < n_points; ++i) {
+      if (timestep == 0) continue;
+      struct Visit { std::vector<int> *deps; long last_offset, last_width; };
+      Visit visit = { &deps[i], last_offset, last_width };
+      task_graph_for_each_dependency(graph, dset, first_point + i, [](long first, long last, void *data) {
+        Visit *v = reinterpret_cast<Visit *>(data);
+        for (long dep = first; dep <= last; ++dep) {
+          if (dep >= v->last_offset && dep < v->last_offset + v->last_width) {
+            v->deps->push_back(dep);
+          }
+        }
+      }, &visit);
+      for (int dep : deps[i]) {
+        OP_REQUIRES(context, dep >= prev_first && dep < prev_first + prev_n,
+                    errors::InvalidArgument("dependency outside of the previous row range"));
+      }
+    }
+  }
+
+  void Compute(OpKernelContext* context) override
+  {
+    // Inputs: outputs_in (n_points), scratch_in (n_points), prev (prev_n).
+    std::vector<Tensor *> outputs(n_points), scratch(n_points);
+    for (int i = 0; i < n_points; ++i) {
+      OP_REQUIRES_OK(context,
+                     context->forward_input_or_allocate_output({i}, i, context->input(i).shape(), &outputs[i]));
+      OP_REQUIRES_OK(context,
+                     context->forward_input_or_allocate_output({n_points + i}, n_points + i,
+                                                               context->input(n_points + i).shape(), &scratch[i]));
+    }
+
+    auto run = [&](int64 begin, int64 end) {
+      std::vector<const char *> input_ptrs;
+      std::vector<size_t> input_bytes;
+      for (int64 i = begin; i < end; ++i) {
+        input_ptrs.clear();
+        input_bytes.clear();
+        for (int dep : deps[i]) {
+          const Tensor &input = context->input(2 * n_points + dep - prev_first);
+          input_ptrs.push_back(input.tensor_data().data());
+          input_bytes.push_back(input.tensor_data().size());
+        }
+        task_graph_execute_point_scratch(graph, timestep, first_point + i,
+                                         const_cast<char *>(outputs[i]->tensor_data().data()), outputs[i]->tensor_data().size(),
+                                         input_ptrs.data(), input_bytes.data(), input_ptrs.size(),
+                                         const_cast<char *>(scratch[i]->tensor_data().data()), scratch[i]->tensor_data().size());
+      }
+    };
+
+    if (parallel) {
+      auto workers = context->device()->tensorflow_cpu_worker_threads();
+      Shard(workers->num_threads, workers->workers, n_points, 1 << 20 /* cost per point */, run);
+    } else {
+      run(0, n_points);
+    }
+  }
+
+private:
+  task_graph_t graph;
+  int timestep, first_point, n_points, prev_first, prev_n;
+  bool parallel;
+  std::vector<std::vector<int> > deps;
+};
+
 #endif
@@ -35,8 +35,35 @@ c = ffi.dlopen("libcore.so")
 
 ops = tf.load_op_library("task_bench_ops.so")
 kernel_op = ops.execute_point_op
+row_op = ops.execute_row_op
 prepare_scratch_op = ops.prepare_scratch_op
 
+# With -row, each timestep runs as ExecuteRowOps over chunks of
+# -row-points points (default: the whole row), instead of one op per
+# point. -row-parallel runs each chunk on the intra-op thread pool.
+ROW_FLAG = "-row"
+ROW_POINTS_FLAG = "-row-points"
+ROW_PARALLEL_FLAG = "-row-parallel"
+
+
+def parse_row_args(args):
+    row = False
+    row_points = 0
+    row_parallel = False
+    for i, arg in enumerate(args):
+        if arg == ROW_FLAG:
+            row = True
+        elif arg == ROW_POINTS_FLAG:
+            row = True
+            row_points = int(args[i + 1])
+            if row_points < 1:
+                print("error: %s must be at least 1" % ROW_POINTS_FLAG)
+                sys.exit(1)
+        elif arg == ROW_PARALLEL_FLAG:
+            row = True
+            row_parallel = True
+    return row, row_points, row_parallel
+
 
 def app_create(args):
     c_args = []
@@ -85,6 +112,56 @@ def task_graph_dependencies(graph, timestep, point):
                 yield dep
 
 
+def execute_task_graph_rows(graph, row_points, row_parallel):
+    graph_bytes = bytes(ffi.buffer(ffi.addressof(graph), ffi.sizeof(graph)))
+    graph_tensor = build_task_graph_tensor(graph)
+
+    feed = {}
+
+    dummy_name = "dummy_%s" % graph.graph_index
+    dummy = tf.placeholder(
+        tf.uint8, shape=(graph.output_bytes_per_task, ), name=dummy_name)
+    feed["%s:0" % dummy_name] = np.zeros(
+        graph.output_bytes_per_task, dtype=np.uint8)
+
+    scratch_dummy_name = "scratch_dummy_%s" % graph.graph_index
+    scratch_dummy = tf.placeholder(
+        tf.uint8, shape=(0, ), name=scratch_dummy_name)
+    feed["%s:0" % scratch_dummy_name] = np.zeros(0, dtype=np.uint8)
+
+    scratch = [prepare_scratch_op(graph_tensor, scratch_dummy) for point in range(graph.max_width)]
+
+    chunk = row_points if row_points > 0 else graph.max_width
+
+    outputs = []
+    last_row = [dummy for point in range(graph.max_width)]
+    for timestep in range(0, graph.timesteps):
+        offset = c.task_graph_offset_at_timestep(graph, timestep)
+        width = c.task_graph_width_at_timestep(graph, timestep)
+        row = list(last_row)
+        for first in range(offset, offset + width, chunk):
+            n_points = min(chunk, offset + width - first)
+            deps = [dep
+                    for point in range(first, first + n_points)
+                    for dep in task_graph_dependencies(graph, timestep, point)]
+            # Active points are contiguous, so every point between the
+            # smallest and largest dependency has an output.
+            prev_first = min(deps) if deps else 0
+            prev_n = max(deps) - prev_first + 1 if deps else 0
+            ops_out, ops_scratch = row_op(
+                last_row[first:first + n_points],
+                scratch[first:first + n_points],
+                last_row[prev_first:prev_first + prev_n],
+                task_graph=graph_bytes, timestep=timestep, first_point=first,
+                prev_first=prev_first, parallel=row_parallel)
+            row[first:first + n_points] = ops_out
+            scratch[first:first + n_points] = ops_scratch
+            outputs.extend(ops_out)
+        last_row = row
+
+    return outputs, feed
+
+
 def execute_task_graph(graph):
 
     graph_tensor = build_task_graph_tensor(graph)
@@ -134,6 +211,7 @@ def execute_task_graph(graph):
 
 
 def execute_task_bench():
+    row, row_points, row_parallel = parse_row_args(sys.argv)
     app = app_create(sys.argv)
     task_graphs = app_task_graphs(app)
 
@@ -141,7 +219,10 @@ def execute_task_bench():
     all_feed = {}
 
     for task_graph in task_graphs:
-        output, feed = execute_task_graph(task_graph)
+        if row:
+            output, feed = execute_task_graph_rows(task_graph, row_points, row_parallel)
+        else:
+            output, feed = execute_task_graph(task_graph)
         all_output.extend(output)
         all_feed.update(feed)
 
@@ -15,6 +15,13 @@ basic_types=(
     no_comm
     stencil_1d
     stencil_1d_periodic
+    "stencil_2d -width 12"
+    "stencil_3d -width 8"
+    "v_cycle -width 16"
+    "w_cycle -width 8"
+    "elastic_ramp -width 8"
+    "elastic_sawtooth -period 5"
+    elastic_random
     dom
     tree
     fft
@@ -42,12 +49,41 @@ set -x
 if [[ $TASKBENCH_USE_MPI -eq 1 ]]; then
     for t in "${extended_types[@]}"; do
         for k in "${kernels[@]}"; do
-            for binary in nonblock bulk_synchronous; do
+            for binary in nonblock bulk_synchronous neighbor persistent rma shared; do
                 mpirun -np 1 ./mpi/$binary -steps $steps -type $t $k -nodes 1
                 mpirun -np 2 ./mpi/$binary -steps $steps -type $t $k -nodes 2
                 mpirun -np 4 ./mpi/$binary -steps $steps -type $t $k -nodes 4
                 mpirun -np 4 ./mpi/$binary -steps $steps -type $t $k -and -steps $steps -type $t $k -nodes 4
             done
+            for validate in sample none; do
+                mpirun -np 4 ./mpi/nonblock -steps $steps -type $t $k -validate $validate -nodes 4
+            done
+        done
+    done
+    for d in normal normal_random gamma; do
+        for binary in nonblock bulk_synchronous neighbor persistent rma shared; do
+            mpirun -np 4 ./mpi/$binary -steps $steps -type stencil_1d -output 1024 -output-dist $d -nodes 4
+        done
+    done
+    for binary in nonblock bulk_synchronous neighbor persistent rma shared; do
+        mpirun -np 4 ./mpi/$binary -steps $steps -type stencil_1d -arrival-rate 1000 -arrival poisson -nodes 4
+    done
+    mpirun -np 2 ./mpi/bulk_synchronous -steps $steps -type stencil_1d $compute_bound -metg -nodes 2
+    mpirun -np 2 ./mpi/nonblock -steps $steps -type stencil_1d -warmup 2 -reps 3 -nodes 2
+    mpirun -np 2 ./mpi/nonblock -steps $steps -type stencil_1d $compute_bound -utilization -nodes 2
+    mpirun -np 2 ./mpi/nonblock -steps $steps -type stencil_1d -memory -nodes 2
+    mpirun -np 2 ./mpi/nonblock -steps $steps -type stencil_1d $compute_bound -slow-ranks 0.5 -noise-frequency 1000 -noise-duration 1e-5 -noise-seed 1 -nodes 2
+    mpirun -np 2 ./mpi/nonblock -steps $steps -type stencil_1d -measure-transfer -reps 2 -nodes 2
+    mpirun -np 2 ./mpi/bulk_synchronous -steps $steps -type all_to_all -measure-transfer -nodes 2
+    for p in cyclic block_cyclic greedy; do
+        for binary in nonblock bulk_synchronous; do
+            mpirun -np 3 ./mpi/$binary -steps $steps -type spread -period 2 -radix 3 -output 1024 -output-dist gamma -placement $p -nodes 3
+            mpirun -np 3 ./mpi/$binary -steps $steps -type random_nearest -placement $p -measure-transfer -nodes 3
+        done
+    done
+    for t in stencil_1d nearest spread; do
+        for binary in nonblock bulk_synchronous neighbor persistent rma shared; do
+            mpirun -np 2 ./mpi/$binary -steps $steps -type $t -width 1024 -radix 5 -nodes 2
         done
     done
     for t in no_comm stencil_1d stencil_1d_periodic all_to_all; do # FIXME: trivial dom tree fft nearest spread random_nearest are broken
@@ -67,8 +103,34 @@ if [[ $USE_MPI_OPENMP -eq 1 ]]; then
             mpirun -np 2 ./mpi_openmp/forall -steps $steps -type $t $k -nodes 2
             mpirun -np 4 ./mpi_openmp/forall -steps $steps -type $t $k -nodes 4
             mpirun -np 4 ./mpi_openmp/forall -steps $steps -type $t $k -and -steps $steps -type $t $k -nodes 4
+            mpirun -np 4 ./mpi_openmp/overlap -steps $steps -type $t $k -nodes 4
+            mpirun -np 4 ./mpi_openmp/overlap -steps $steps -type $t $k -tasks -nodes 4
         done
     done
+    for d in normal normal_random gamma; do
+        mpirun -np 4 ./mpi_openmp/forall -steps $steps -type stencil_1d -output 1024 -output-dist $d -nodes 4
+    done
+    mpirun -np 4 ./mpi_openmp/forall -steps $steps -type stencil_1d -arrival-rate 1000 -nodes 4
+    mpirun -np 2 ./mpi_openmp/forall -steps $steps -type nearest -width 1024 -radix 5 -nodes 2
+fi
+
+if [[ $USE_SHMEM -eq 1 ]]; then
+    for t in "${extended_types[@]}"; do
+        for k in "${kernels[@]}"; do
+            oshrun -np 1 ./shmem/main -steps $steps -type $t $k -nodes 1
+            oshrun -np 2 ./shmem/main -steps $steps -type $t $k -nodes 2
+            oshrun -np 4 ./shmem/main -steps $steps -type $t $k -nodes 4
+            oshrun -np 4 ./shmem/main -steps $steps -type $t $k -and -steps $steps -type $t $k -nodes 4
+        done
+    done
+    for d in normal normal_random gamma; do
+        oshrun -np 4 ./shmem/main -steps $steps -type stencil_1d -output 1024 -output-dist $d -nodes 4
+    done
+    # More points than PEs, so that producers of a slot change between timesteps.
+    for t in fft "spread -radix 2"; do
+        oshrun -np 4 ./shmem/main -steps 9 -width 8 -type $t -nodes 4
+        oshrun -np 4 ./shmem/main -steps 9 -width 16 -type $t -nodes 4
+    done
 fi
 
 if [[ $USE_LEGION -eq 1 ]]; then
@@ -113,6 +175,8 @@ if [[ $USE_REALM -eq 1 ]]; then
                     ./$variant/task_bench -steps $steps -type $t $k -and -steps $steps -type $t $k -ll:cpu 2 $option
                 done
             done
+            ./realm_subgraph/task_bench -steps $steps -type $t $k -ll:cpu 2 -pipeline 4
+            ./realm_subgraph/task_bench -steps $steps -type $t $k -and -steps $steps -type $t $k -ll:cpu 2 -pipeline 4
 
             # FIXME: Realm old triggers a bug in GASNet MPI conduit with higher steps.
             ./realm_old/task_bench -steps 9 -type $t $k -ll:cpu 1
@@ -154,6 +218,10 @@ if [[ $USE_STARPU -eq 1 ]]; then
             done
         done
     done
+    for k in "${kernels[@]}"; do
+        mpirun -np 2 ./starpu/main -steps $steps -type stencil_1d $k -core 2 -calibrate 2 -sched dmda,dmdas,heft,lws -nodes 2
+        mpirun -np 1 ./starpu/main -steps $steps -type stencil_1d $k -core 2 -perfmodel regression -calibrate 1 -sched dmda -nodes 1
+    done
 fi
 
 if [[ $USE_PARSEC -eq 1 ]]; then
@@ -179,6 +247,14 @@ if [[ $USE_PARSEC -eq 1 ]]; then
         mpirun -np 2 ./parsec/main_ptg -p 1 -S 4 -c 2 -steps $steps -type stencil_1d $k -width 8 -and -steps $steps -type stencil_1d $k -width 8 -nodes 2
         mpirun -np 2 ./parsec/main_ptg -p 1 -S 4 -c 2 -steps $steps -type nearest -radix 5 $k -width 8 -field 2 -nodes 2
         mpirun -np 2 ./parsec/main_ptg -p 1 -S 4 -c 2 -steps $steps -type nearest -radix 5 $k -width 8 -and -steps $steps -type nearest -radix 5 $k -width 8 -nodes 2
+        mpirun -np 2 ./parsec/main_ptg -p 1 -S 4 -c 2 -steps $steps -type stencil_1d $k -width 8 -generic -nodes 2
+    done
+    for t in "${extended_types[@]}"; do
+        for k in "${kernels[@]}"; do
+            mpirun -np 1 ./parsec/main_ptg -c 2 -steps $steps -type $t $k -width 8 -nodes 1
+            mpirun -np 2 ./parsec/main_ptg -p 1 -S 4 -c 2 -steps $steps -type $t $k -width 8 -field 2 -nodes 2
+            mpirun -np 2 ./parsec/main_ptg -p 1 -S 4 -c 2 -steps $steps -type $t $k -width 8 -and -steps $steps -type $t $k -width 8 -nodes 2
+        done
     done
 fi
 
@@ -187,6 +263,8 @@ if [[ $USE_CHARM -eq 1 ]]; then
         for k in "${kernels[@]}"; do
             ./charm++/charmrun +p1 ++mpiexec ./charm++/benchmark -steps $steps -type $t $k
             ./charm++/charmrun +p1 ++mpiexec ./charm++/benchmark -steps $steps -type $t $k -and -steps $steps -type $t $k
+            ./charm++/charmrun +p1 ++mpiexec ./charm++/benchmark -steps $steps -type $t $k -aggregate
+            ./charm++/charmrun +p1 ++mpiexec ./charm++/benchmark -steps $steps -type $t $k -and -steps $steps -type $t $k -aggregate -aggregate-bytes 64
         done
     done
     rm charmrun.*
@@ -214,14 +292,113 @@ fi
     done
 fi)
 
+if [[ $USE_CPP_THREADS -eq 1 ]]; then
+    for t in "${extended_types[@]}"; do
+        for k in "${kernels[@]}"; do
+            ./cpp_threads/main -steps $steps -type $t $k -worker 2
+            ./cpp_threads/main -steps $steps -type $t $k -and -steps $steps -type $t $k -worker 2
+        done
+    done
+    for d in normal normal_random gamma; do
+        ./cpp_threads/main -steps $steps -type stencil_1d -output 1024 -output-dist $d -worker 2
+    done
+    ./cpp_threads/main -steps $steps -type all_to_all -width 32 -worker 4
+    ./cpp_threads/main -steps $steps -type stencil_1d $compute_bound -metg -worker 2
+fi
+
+if [[ $USE_SIMULATOR -eq 1 ]]; then
+    for t in "${extended_types[@]}"; do
+        for k in "${kernels[@]}"; do
+            ./simulator/main -steps $steps -type $t $k -workers 4 -nodes 2
+            ./simulator/main -steps $steps -type $t $k -and -steps $steps -type $t $k -workers 4 -nodes 2
+        done
+    done
+    ./simulator/main -steps $steps -type stencil_1d -output 1024 -output-dist gamma -workers 8 -nodes 4 -sim-latency 1e-5
+    ./simulator/main -steps $steps -type spread -period 2 -radix 3 -workers 8 -nodes 4 -placement greedy
+    ./simulator/main -steps $steps -type stencil_1d $compute_bound -metg -workers 2 -sim-iteration-time 1e-9 -sim-overhead 1e-6
+fi
+
+if [[ $USE_HPX -eq 1 ]]; then
+    for t in "${extended_types[@]}"; do
+        for k in "${kernels[@]}"; do
+            ./hpx/main_local -steps $steps -type $t $k --hpx:threads=2
+            ./hpx/main -steps $steps -type $t $k --hpx:threads=2
+            ./hpx/main -steps $steps -type $t $k -and -steps $steps -type $t $k --hpx:threads=2
+            ./hpx/main -steps $steps -type $t $k --hpx:localities=2 --hpx:node=0 --hpx:threads=1 &
+            ./hpx/main -steps $steps -type $t $k --hpx:localities=2 --hpx:node=1 --hpx:threads=1
+            wait
+        done
+    done
+fi
+
+if [[ $USE_TBB -eq 1 ]]; then
+    for t in "${extended_types[@]}"; do
+        for k in "${kernels[@]}"; do
+            for shape in "" -stream; do
+                ./tbb/main -steps $steps -type $t $k $shape -worker 2
+                ./tbb/main -steps $steps -type $t $k -and -steps $steps -type $t $k $shape -worker 2
+            done
+        done
+    done
+    for shape in "" -stream; do
+        ./tbb/main -steps $steps -type stencil_1d $compute_bound -metg $shape -worker 2
+    done
+fi
+
+if [[ $USE_TASKFLOW -eq 1 ]]; then
+    for t in "${extended_types[@]}"; do
+        for k in "${kernels[@]}"; do
+            for shape in "" -stream; do
+                ./taskflow/main -steps $steps -type $t $k $shape -worker 2
+                ./taskflow/main -steps $steps -type $t $k -and -steps $steps -type $t $k $shape -worker 2
+            done
+        done
+    done
+fi
+
 if [[ $USE_OPENMP -eq 1 ]]; then
     export LD_LIBRARY_PATH=/usr/local/clang/lib:$LD_LIBRARY_PATH
     for t in "${basic_types[@]}"; do
         for k in "${kernels[@]}"; do
             ./openmp/main -steps $steps -type $t $k -worker 2
+            ./openmp/main -steps $steps -type $t $k -latency -worker 2
             ./openmp/main -steps $steps -type $t $k -and -steps $steps -type $t $k -worker 2
         done
     done
+    ./openmp/main -steps $steps -type stencil_1d -arrival-rate 1000 -arrival poisson -worker 2
+    ./openmp/main -steps $steps -type stencil_1d $compute_bound -metg -metg-efficiency 0.8 -worker 2
+    ./openmp/main -steps $steps -type stencil_1d $compute_bound -warmup 1 -reps 5 -latency -worker 2
+    ./openmp/main -steps $steps -type stencil_1d $compute_bound -counters -worker 2
+    ./openmp/main -steps $steps -type stencil_1d $compute_bound -utilization -reps 2 -worker 2
+    ./openmp/main -steps $steps -type stencil_1d $compute_bound -memory -memory-period 1 -worker 2
+    ./openmp/main -steps $steps -type stencil_1d $compute_bound -noise-frequency 1000 -noise-duration 1e-5 -slow-workers 0.5 -slow-factor 3 -reps 2 -report csv report_test.csv -worker 2
+    ./openmp/main -steps $steps -type stencil_1d -measure-transfer -worker 2
+    ./openmp/main -steps $steps -type stencil_1d -latency -report json report_test.json -and -steps $steps -type fft -worker 2
+    ./openmp/main -steps $steps -type stencil_1d -report csv report_test.csv -worker 2
+    rm -f report_test.json report_test.csv
+    OMP_MAX_TASK_PRIORITY=4 ./openmp/main -steps $steps -type stencil_1d -priority 4 -weight 2 -and -steps $steps -type all_to_all -worker 2
+    for t in "${basic_types[@]}"; do
+        ./openmp/main -steps $steps -type $t -depend-iterator -worker 2
+        ./openmp/main -steps $steps -type $t -replay -worker 2
+        ./openmp/main -steps $steps -type $t -replay -and -steps $steps -type $t -output-dist gamma -worker 2
+    done
+    ./openmp/main -steps $steps -type all_to_all -width 32 -worker 2
+    ./openmp/main -steps $steps -type nearest -radix 17 -width 32 -worker 2
+    for m in sync uring; do
+        ./openmp/main -steps $steps -type stencil_1d -kernel io_bound -iter 4 -io-mode $m -worker 2
+    done
+    for k in "compute_bound -iter 1024" "memory_bound -iter 1024 -scratch 65536" "compute_dgemm -iter 1 -scratch 98304"; do
+        ./openmp/main -steps $steps -type stencil_1d -kernel $k -task-threads 2 -worker 2
+    done
+    for t in "${basic_types[@]}"; do
+        ./openmp/main -steps 4 -type stencil_1d -child -steps 4 -type $t -output 64 -worker 2
+    done
+    graph_dir=$(mktemp -d)
+    echo 'digraph { a -> b -> d; a -> c -> d; a -> d; e -> d; d [output=64] }' > $graph_dir/graph.dot
+    ./scripts/graph_import.py $graph_dir/graph.dot $graph_dir/graph.tbg --iter 1024
+    ./openmp/main -graph-file $graph_dir/graph.tbg -kernel compute_bound -worker 2
+    ./openmp/main -steps 4 -type stencil_1d -child -graph-file $graph_dir/graph.tbg -worker 2
+    rm -r $graph_dir
 fi
 
 if [[ $USE_OMPSS -eq 1 ]]; then
@@ -291,6 +468,7 @@ fi
         for k in "${kernels[@]}"; do
             run_spark -steps $steps -type $t $k -skip-graph-validation
             run_spark -steps $steps -type $t $k -and -steps $steps -type $t $k -skip-graph-validation
+            run_spark -steps $steps -type $t $k -skip-graph-validation -direct
         done
     done
 
@@ -321,6 +499,8 @@ fi)
         for k in "${kernels[@]}"; do
             python task_bench.py -steps $steps -type $t $k
             python task_bench.py -steps $steps -type $t $k -and -steps $steps -type $t $k
+            python task_bench.py -steps $steps -type $t $k -row
+            python task_bench.py -steps $steps -type $t $k -row-points 2 -row-parallel
         done
     done
     popd
@@ -344,6 +524,7 @@ fi)
             for variant in "" _direct; do
                 python ./dask/task_bench$variant.py -steps $steps -type $t $k -scheduler $SCHEDULER_URL -expect-workers 2 -skip-graph-validation
                 python ./dask/task_bench$variant.py -steps $steps -type $t $k -and -steps $steps -type $t $k -scheduler $SCHEDULER_URL -expect-workers 2 -skip-graph-validation
+                python ./dask/task_bench$variant.py -steps $steps -type $t $k -scheduler $SCHEDULER_URL -expect-workers 2 -skip-graph-validation -shm
             done
         done
     done